@@ -30,6 +30,8 @@
 #include "Common.h"
 #include "INpp.h"
 #include "GTags.h"
+#include "PluginInterface.h"
+#include "ComplRank.h"
 #include "AutoCompleteWin.h"
 
 
@@ -38,9 +40,14 @@ namespace GTags
 
 const TCHAR AutoCompleteWin::cClassName[]    = _T("AutoCompleteWin");
 const int AutoCompleteWin::cBackgroundColor  = COLOR_INFOBK;
+const int AutoCompleteWin::cVisibleRows      = 8;
+const UINT AutoCompleteWin::cResultReadyMsg  = WM_USER + 1;
+const UINT AutoCompleteWin::cChunkReadyMsg   = WM_USER + 2;
 
 
 AutoCompleteWin* AutoCompleteWin::ACW = NULL;
+Mutex AutoCompleteWin::Lock;
+bool AutoCompleteWin::FullList = false;
 
 
 /**
@@ -76,12 +83,15 @@ void AutoCompleteWin::Unregister()
 
 
 /**
- *  \brief
+ *  \brief  Creates the window hidden before the completion command is run so the user can
+ *          continue typing. The window is shown when the first candidates arrive
  */
 void AutoCompleteWin::Show(const std::shared_ptr<Cmd>& cmd)
 {
     if (ACW)
-        return;
+        SendMessage(ACW->_hWnd, WM_CLOSE, 0, 0);
+
+    AUTOLOCK(Lock);
 
     ACW = new AutoCompleteWin(cmd);
     if (ACW->composeWindow(cmd->Name()) == NULL)
@@ -89,16 +99,91 @@ void AutoCompleteWin::Show(const std::shared_ptr<Cmd>& cmd)
         delete ACW;
         ACW = NULL;
     }
+    else
+    {
+        ACW->_fullList = FullList;
+    }
+
+    FullList = false;
+}
+
+
+/**
+ *  \brief  Called from the command thread with the candidates as they are read.
+ *          Returns false if the command should stop - the visible list is already full
+ */
+bool AutoCompleteWin::ResultChunk(const std::shared_ptr<Cmd>& cmd, const std::vector<char>& lines)
+{
+    AUTOLOCK(Lock);
+
+    if (!ACW || ACW->_cmd != cmd)
+        return false;
+
+    if (ACW->_stopReq)
+    {
+        ACW->_truncated = true;
+        return false;
+    }
+
+    ACW->_pending.insert(ACW->_pending.end(), lines.begin(), lines.end());
+
+    if (!ACW->_chunkPosted)
+    {
+        ACW->_chunkPosted = true;
+        PostMessage(ACW->_hWnd, cChunkReadyMsg, 0, 0);
+    }
+
+    return true;
+}
+
+
+/**
+ *  \brief  Tells if the command should go on with the next completion kind
+ */
+bool AutoCompleteWin::WantsMore(const std::shared_ptr<Cmd>& cmd)
+{
+    AUTOLOCK(Lock);
+
+    if (!ACW || ACW->_cmd != cmd)
+        return false;
+
+    if (ACW->_stopReq)
+    {
+        ACW->_truncated = true;
+        return false;
+    }
+
+    return true;
+}
+
+
+/**
+ *  \brief  Called from the command thread when the completion command is ready
+ */
+void AutoCompleteWin::ResultReady(const std::shared_ptr<Cmd>& cmd)
+{
+    AUTOLOCK(Lock);
+
+    if (ACW && ACW->_cmd == cmd)
+        PostMessage(ACW->_hWnd, cResultReadyMsg, 0, 0);
 }
 
 
 /**
  *  \brief
  */
-AutoCompleteWin::AutoCompleteWin(const std::shared_ptr<Cmd>& cmd) :
+AutoCompleteWin::AutoCompleteWin(const std::shared_ptr<Cmd>& cmd) : _cmd(cmd),
     _hWnd(NULL), _hLVWnd(NULL), _hFont(NULL), _cmdId(cmd->Id()),
-    _cmdTagLen((_cmdId == AUTOCOMPLETE_FILE ? cmd->TagLen() - 1 : cmd->TagLen())), _result(cmd->Result())
-{}
+    _cmdTagLen((_cmdId == AUTOCOMPLETE_FILE ? cmd->TagLen() - 1 : cmd->TagLen())), _dbPath(cmd->DbPath()),
+    _newChunk(NULL), _lvFilled(false), _rankedRows(0), _recentRows(0), _chunkPosted(false), _fullList(false), _scrolled(false), _stopReq(false), _truncated(false), _complete(false)
+{
+    INpp& npp = INpp::Get();
+
+    // Remember the completed word position to detect if the results are still valid when ready
+    _hSci       = npp.GetSciHandle();
+    _docPtr     = npp.GetDocPointer();
+    _wordStart  = npp.GetWordStartPos();
+}
 
 
 /**
@@ -133,7 +218,7 @@ HWND AutoCompleteWin::composeWindow(const TCHAR* header)
     _hLVWnd = CreateWindow(WC_LISTVIEW, NULL,
             WS_CHILD | WS_VISIBLE |
             LVS_REPORT | LVS_SINGLESEL | LVS_NOLABELWRAP |
-            LVS_NOSORTHEADER | LVS_SORTASCENDING,
+            LVS_NOSORTHEADER,
             0, 0, win.right - win.left, win.bottom - win.top,
             _hWnd, NULL, HMod, NULL);
 
@@ -166,70 +251,84 @@ HWND AutoCompleteWin::composeWindow(const TCHAR* header)
     ListView_SetBkColor(_hLVWnd, backgroundColor);
     ListView_SetTextBkColor(_hLVWnd, backgroundColor);
 
-    if (!fillLV())
-    {
-        SendMessage(_hWnd, WM_CLOSE, 0, 0);
-        return NULL;
-    }
-
-    ShowWindow(_hWnd, SW_SHOWNORMAL);
-    UpdateWindow(_hWnd);
-
     return _hWnd;
 }
 
 
 /**
- *  \brief
+ *  \brief  Splits the result chunk to completion items and merges them in ranked order
  */
-int AutoCompleteWin::fillLV()
+void AutoCompleteWin::addCandidates(const CText& chunk)
 {
-    LVITEM lvItem   = {0};
-    lvItem.mask     = LVIF_TEXT | LVIF_STATE;
+    // Chunks are kept separately as the index points into them
+    _result.push_back(chunk);
+    _newChunk = &_result.back();
+
+    const unsigned sortedCount = _resultIndex.size();
 
     TCHAR* pTmp = NULL;
-    for (TCHAR* pToken = _tcstok_s(_result.C_str(), _T("\n\r"), &pTmp);
+    for (TCHAR* pToken = _tcstok_s(_result.back().C_str(), _T("\n\r"), &pTmp);
             pToken; pToken = _tcstok_s(NULL, _T("\n\r"), &pTmp))
-    {
-        lvItem.pszText = (_cmdId == AUTOCOMPLETE_FILE) ? pToken + 1 : pToken;
-        ListView_InsertItem(_hLVWnd, &lvItem);
-        ++lvItem.iItem;
-        _resultIndex.push_back(lvItem.pszText);
-    }
+        _resultIndex.push_back(ComplRank::Candidate(0, (_cmdId == AUTOCOMPLETE_FILE) ? pToken + 1 : pToken));
 
-    if (lvItem.iItem > 0)
-    {
-        ListView_SetItemState(_hLVWnd, 0, LVIS_FOCUSED | LVIS_SELECTED, LVIS_FOCUSED | LVIS_SELECTED);
-        resizeLV();
-    }
+    CPath file;
+    INpp::Get().GetFilePath(file);
 
-    return lvItem.iItem;
+    // The list is not sorted by the control - items are inserted in ranked order
+    ComplRank::Get().Sort(_dbPath, file, _resultIndex, sortedCount);
 }
 
 
 /**
- *  \brief
+ *  \brief  Lists the candidates starting with filter in ranked order. If the filter hasn't changed
+ *          only the candidates of the last chunk are inserted - at their ranked positions
  */
 int AutoCompleteWin::filterLV(const CText& filter)
 {
     LVITEM lvItem   = {0};
     lvItem.mask     = LVIF_TEXT | LVIF_STATE;
 
-    int len = filter.Len();
+    const bool append = (_lvFilled && _lvFilter == filter);
+
+    if (!append)
+    {
+        ListView_DeleteAllItems(_hLVWnd);
+        _lvFilter = filter;
+        _lvFilled = true;
+    }
 
-    ListView_DeleteAllItems(_hLVWnd);
+    const int itemsCnt = ListView_GetItemCount(_hLVWnd);
+    const int len = filter.Len();
+
+    const TCHAR* chunkStart = _newChunk ? _newChunk->C_str() : NULL;
+    const TCHAR* chunkEnd = _newChunk ? chunkStart + _newChunk->Len() : NULL;
+
+    _newChunk = NULL;
+    _rankedRows = 0;
+    _recentRows = 0;
 
     for (unsigned i = 0; i < _resultIndex.size(); ++i)
     {
-        if (!_tcsncmp(_resultIndex[i], filter.C_str(), len))
+        TCHAR* name = _resultIndex[i].second;
+
+        if (_tcsncmp(name, filter.C_str(), len))
+            continue;
+
+        if (!append || (name >= chunkStart && name < chunkEnd))
         {
-            lvItem.pszText = _resultIndex[i];
+            lvItem.pszText = name;
             ListView_InsertItem(_hLVWnd, &lvItem);
-            ++lvItem.iItem;
         }
+        ++lvItem.iItem;
+
+        // File names have no ranking data - their alphabetical order is final
+        if (_resultIndex[i].first > 0 || _cmdId == AUTOCOMPLETE_FILE)
+            ++_rankedRows;
+        if (ComplRank::IsRecent(_resultIndex[i]))
+            ++_recentRows;
     }
 
-    if (lvItem.iItem > 0)
+    if (lvItem.iItem > 0 && lvItem.iItem != itemsCnt)
     {
         ListView_SetItemState(_hLVWnd, 0, LVIS_FOCUSED | LVIS_SELECTED, LVIS_FOCUSED | LVIS_SELECTED);
         resizeLV();
@@ -246,9 +345,9 @@ void AutoCompleteWin::resizeLV()
 {
     bool scroll = false;
     int rowsCount = ListView_GetItemCount(_hLVWnd) - 1;
-    if (rowsCount > 7)
+    if (rowsCount > cVisibleRows - 1)
     {
-        rowsCount = 7;
+        rowsCount = cVisibleRows - 1;
         scroll = true;
     }
 
@@ -309,6 +408,198 @@ void AutoCompleteWin::resizeLV()
 }
 
 
+/**
+ *  \brief  Tells if the candidates still to come are unlikely to get into the visible rows - they are full
+ *          of candidates ordered by ranking data and all recently selected names matching the word are in
+ */
+bool AutoCompleteWin::isSettled()
+{
+    if (_rankedRows < cVisibleRows)
+        return false;
+
+    return ((unsigned)_recentRows >= ComplRank::Get().RecentCount(_lvFilter.C_str()));
+}
+
+
+/**
+ *  \brief  Checks if the user has moved away from the completed word while the command was running
+ */
+bool AutoCompleteWin::isStale()
+{
+    INpp& npp = INpp::Get();
+
+    if (npp.ReadSciHandle() != _hSci || npp.GetDocPointer() != _docPtr)
+        return true;
+
+    if (npp.GetWordStartPos() != _wordStart || npp.GetWordSize() < _cmdTagLen)
+        return true;
+
+    return false;
+}
+
+
+/**
+ *  \brief  Filters the list by the word being completed and closes the window if nothing is left to choose
+ */
+void AutoCompleteWin::narrowToWord()
+{
+    CTextA wordA;
+    INpp::Get().GetWord(wordA, true);
+    CText word(wordA.C_str());
+    int lvItemsCnt = filterLV(word);
+
+    // The command was stopped when the list was settled - now the rest of the candidates are needed
+    if (_truncated && !isSettled())
+    {
+        restart();
+        return;
+    }
+
+    // More candidates might still come
+    if (!_complete)
+        return;
+
+    if (lvItemsCnt == 0)
+    {
+        SendMessage(_hWnd, WM_CLOSE, 0, 0);
+    }
+    else if (lvItemsCnt == 1)
+    {
+        TCHAR itemTxt[MAX_PATH];
+        LVITEM lvItem       = {0};
+        lvItem.mask         = LVIF_TEXT;
+        lvItem.iItem        = ListView_GetNextItem(_hLVWnd, -1, LVNI_SELECTED);
+        lvItem.pszText      = itemTxt;
+        lvItem.cchTextMax   = _countof(itemTxt);
+
+        ListView_GetItem(_hLVWnd, &lvItem);
+        lvItem.pszText[lvItem.cchTextMax - 1] = 0;
+
+        if (!_tcscmp(word.C_str(), lvItem.pszText))
+            SendMessage(_hWnd, WM_CLOSE, 0, 0);
+    }
+}
+
+
+/**
+ *  \brief  Re-runs the completion of the current word with the whole candidates list
+ */
+void AutoCompleteWin::restart()
+{
+    // AutoComplete and AutoComplete Filename are the first plugin menu items
+    const int menuCmdId = Menu[(_cmdId == AUTOCOMPLETE_FILE) ? 1 : 0]._cmdID;
+
+    FullList = true;
+
+    SendMessage(_hWnd, WM_CLOSE, 0, 0);
+    PostMessage(INpp::Get().GetHandle(), WM_COMMAND, menuCmdId, 0);
+}
+
+
+/**
+ *  \brief
+ */
+void AutoCompleteWin::onChunkReady()
+{
+    CText chunk;
+    {
+        AUTOLOCK(Lock);
+
+        _chunkPosted = false;
+
+        if (_pending.empty())
+            return;
+
+        _pending.push_back(0);
+        chunk = _pending.data();
+        _pending.clear();
+    }
+
+    if (isStale())
+    {
+        SendMessage(_hWnd, WM_CLOSE, 0, 0);
+        return;
+    }
+
+    // Keep the item the user has moved to selected
+    TCHAR selTxt[MAX_PATH];
+    selTxt[0] = 0;
+
+    int sel = ListView_GetNextItem(_hLVWnd, -1, LVNI_SELECTED);
+    if (_scrolled && sel >= 0)
+        ListView_GetItemText(_hLVWnd, sel, 0, selTxt, _countof(selTxt));
+
+    addCandidates(chunk);
+
+    // Narrow the list by what the user has typed in the meantime
+    narrowToWord();
+
+    // Check if the window wasn't closed
+    if (!ACW)
+        return;
+
+    if (selTxt[0])
+    {
+        LVFINDINFO lvFind   = {0};
+        lvFind.flags        = LVFI_STRING;
+        lvFind.psz          = selTxt;
+
+        sel = ListView_FindItem(_hLVWnd, -1, &lvFind);
+        if (sel > 0)
+        {
+            ListView_SetItemState(_hLVWnd, sel, LVIS_FOCUSED | LVIS_SELECTED, LVIS_FOCUSED | LVIS_SELECTED);
+            ListView_EnsureVisible(_hLVWnd, sel, FALSE);
+        }
+    }
+
+    const int lvItemsCnt = ListView_GetItemCount(_hLVWnd);
+
+    if (lvItemsCnt && !IsWindowVisible(_hWnd))
+    {
+        ShowWindow(_hWnd, SW_SHOWNORMAL);
+        UpdateWindow(_hWnd);
+    }
+
+    // No need to wait for more candidates (nor for the symbols pass) if the visible list is settled
+    // and the user is not browsing it. Alphabetical order of the results alone is not enough
+    if (!_fullList && !_scrolled && isSettled())
+    {
+        AUTOLOCK(Lock);
+        _stopReq = true;
+    }
+}
+
+
+/**
+ *  \brief
+ */
+void AutoCompleteWin::onResultReady()
+{
+    // Take the candidates whose notification might still be queued
+    onChunkReady();
+
+    if (!ACW)
+        return;
+
+    _complete = true;
+
+    if (_cmd->Status() != OK || _resultIndex.empty() || isStale())
+    {
+        SendMessage(_hWnd, WM_CLOSE, 0, 0);
+        return;
+    }
+
+    narrowToWord();
+
+    // Check if the window wasn't closed because there is nothing to show
+    if (ACW)
+    {
+        ShowWindow(_hWnd, SW_SHOWNORMAL);
+        UpdateWindow(_hWnd);
+    }
+}
+
+
 /**
  *  \brief
  */
@@ -324,6 +615,8 @@ void AutoCompleteWin::onDblClick()
     ListView_GetItem(_hLVWnd, &lvItem);
     lvItem.pszText[lvItem.cchTextMax - 1] = 0;
 
+    ComplRank::Get().Selected(itemTxt);
+
     CTextA completion(itemTxt);
     INpp::Get().ReplaceWord(completion.C_str());
 
@@ -340,6 +633,9 @@ bool AutoCompleteWin::onKeyDown(int keyCode)
     {
         case VK_UP:
         case VK_DOWN:
+        case VK_PRIOR:
+        case VK_NEXT:
+            _scrolled = true;
         return false;
 
         case VK_SPACE:
@@ -388,30 +684,7 @@ bool AutoCompleteWin::onKeyDown(int keyCode)
         }
     }
 
-    CTextA wordA;
-    INpp::Get().GetWord(wordA, true);
-    CText word(wordA.C_str());
-    int lvItemsCnt = filterLV(word);
-
-    if (lvItemsCnt == 0)
-    {
-        SendMessage(_hWnd, WM_CLOSE, 0, 0);
-    }
-    else if (lvItemsCnt == 1)
-    {
-        TCHAR itemTxt[MAX_PATH];
-        LVITEM lvItem       = {0};
-        lvItem.mask         = LVIF_TEXT;
-        lvItem.iItem        = ListView_GetNextItem(_hLVWnd, -1, LVNI_SELECTED);
-        lvItem.pszText      = itemTxt;
-        lvItem.cchTextMax   = _countof(itemTxt);
-
-        ListView_GetItem(_hLVWnd, &lvItem);
-        lvItem.pszText[lvItem.cchTextMax - 1] = 0;
-
-        if (!_tcscmp(word.C_str(), lvItem.pszText))
-            SendMessage(_hWnd, WM_CLOSE, 0, 0);
-    }
+    narrowToWord();
 
     return true;
 }
@@ -446,13 +719,32 @@ LRESULT APIENTRY AutoCompleteWin::wndProc(HWND hWnd, UINT uMsg, WPARAM wParam, L
                 case NM_DBLCLK:
                     ACW->onDblClick();
                 return 0;
+
+                case LVN_BEGINSCROLL:
+                    ACW->_scrolled = true;
+                break;
             }
         break;
 
+        case cChunkReadyMsg:
+            ACW->onChunkReady();
+        return 0;
+
+        case cResultReadyMsg:
+            ACW->onResultReady();
+        return 0;
+
         case WM_DESTROY:
-            INpp::Get().ClearSelection();
+        {
+            // The word is selected only if the results were shown
+            if (!ACW->_result.empty())
+                INpp::Get().ClearSelection();
+
+            AUTOLOCK(Lock);
+
             delete ACW;
             ACW = NULL;
+        }
         return 0;
     }
 
@@ -27,9 +27,12 @@
 
 #include <windows.h>
 #include <tchar.h>
+#include <list>
 #include <vector>
 #include "Common.h"
+#include "AutoLock.h"
 #include "CmdEngine.h"
+#include "ComplRank.h"
 
 
 namespace GTags
@@ -46,10 +49,16 @@ public:
     static void Unregister();
 
     static void Show(const std::shared_ptr<Cmd>& cmd);
+    static bool ResultChunk(const std::shared_ptr<Cmd>& cmd, const std::vector<char>& lines);
+    static bool WantsMore(const std::shared_ptr<Cmd>& cmd);
+    static void ResultReady(const std::shared_ptr<Cmd>& cmd);
 
 private:
     static const TCHAR  cClassName[];
     static const int    cBackgroundColor;
+    static const int    cVisibleRows;
+    static const UINT   cResultReadyMsg;
+    static const UINT   cChunkReadyMsg;
 
     static LRESULT APIENTRY wndProc(HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM lParam);
 
@@ -58,22 +67,50 @@ private:
     ~AutoCompleteWin();
 
     HWND composeWindow(const TCHAR* header);
-    int fillLV();
+    void addCandidates(const CText& chunk);
     int filterLV(const CText& filter);
     void resizeLV();
+    bool isSettled();
+    bool isStale();
+    void narrowToWord();
+    void restart();
 
+    void onChunkReady();
+    void onResultReady();
     void onDblClick();
     bool onKeyDown(int keyCode);
 
     static AutoCompleteWin* ACW;
+    static Mutex            Lock;
+    static bool             FullList;
+
+    std::shared_ptr<Cmd>    _cmd;
+    HWND                _hSci;
+    void*               _docPtr;
+    long                _wordStart;
 
     HWND                _hWnd;
     HWND                _hLVWnd;
     HFONT               _hFont;
     const CmdId_t       _cmdId;
     const int           _cmdTagLen;
-    CText               _result;
-    std::vector<TCHAR*> _resultIndex;
+    const CPath         _dbPath;
+    std::list<CText>    _result;
+    std::vector<ComplRank::Candidate>   _resultIndex;
+    const CText*        _newChunk;
+
+    CText               _lvFilter;
+    bool                _lvFilled;
+    int                 _rankedRows;
+    int                 _recentRows;
+
+    std::vector<char>   _pending;
+    bool                _chunkPosted;
+    bool                _fullList;
+    bool                _scrolled;
+    bool                _stopReq;
+    bool                _truncated;
+    bool                _complete;
 };
 
 } // namespace GTags
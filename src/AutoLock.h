@@ -25,19 +25,67 @@
 #pragma once
 
 
+#ifdef _WIN32
 #include <windows.h>
+#else
+#include <mutex>
+#include <condition_variable>
+#endif
+#include <atomic>
+#include <vector>
 
 
 #define AUTOLOCK(x)             AutoLock __lock_obj(x)
+#define AUTOLOCK_SHARED(x)      AutoSharedLock __lock_obj(x)
 #define IF_AUTO_TRYLOCK_FAIL(x) AutoTryLock __lock_obj(x); \
                                 if (!__lock_obj.IsLocked())
 
 
+/**
+ *  \class  LockCounters
+ *  \brief  Lock acquisitions and those that had to wait - counted in development builds only
+ */
+class LockCounters
+{
+public:
+#ifdef DEVELOPMENT
+    LockCounters() : _acquired(0), _contended(0) {}
+
+    inline void Count(bool contended)
+    {
+        _acquired.fetch_add(1, std::memory_order_relaxed);
+        if (contended)
+            _contended.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    inline void GetContention(unsigned& acquired, unsigned& contended) const
+    {
+        acquired = _acquired.load(std::memory_order_relaxed);
+        contended = _contended.load(std::memory_order_relaxed);
+    }
+
+private:
+    std::atomic<unsigned> _acquired;
+    std::atomic<unsigned> _contended;
+#else
+    inline void Count(bool) {}
+
+    inline void GetContention(unsigned& acquired, unsigned& contended) const
+    {
+        acquired = 0;
+        contended = 0;
+    }
+#endif
+};
+
+
+#ifdef _WIN32
+
 /**
  *  \class  Mutex
- *  \brief
+ *  \brief  Recursive
  */
-class Mutex
+class Mutex : public LockCounters
 {
 public:
     Mutex()
@@ -52,12 +100,19 @@ public:
 
     inline void Lock()
     {
+#ifdef DEVELOPMENT
+        bool contended = !TryEnterCriticalSection(&_lock);
+        if (contended)
+            EnterCriticalSection(&_lock);
+        Count(contended);
+#else
         EnterCriticalSection(&_lock);
+#endif
     }
 
-    inline BOOL TryLock()
+    inline bool TryLock()
     {
-        return TryEnterCriticalSection(&_lock);
+        return (TryEnterCriticalSection(&_lock) != FALSE);
     }
 
     inline void Unlock()
@@ -70,25 +125,219 @@ private:
 };
 
 
+/**
+ *  \class  RWMutex
+ *  \brief  Shared (read) / exclusive (write) lock. Writers are preferred - a waiting writer holds back
+ *          new readers. Not recursive. Works on XP, SRW locks need Vista
+ */
+class RWMutex : public LockCounters
+{
+public:
+    RWMutex() : _readers(0)
+    {
+        InitializeCriticalSectionAndSpinCount(&_lock, 1024);
+        _noReaders = CreateEvent(NULL, FALSE, FALSE, NULL);
+    }
+
+    ~RWMutex()
+    {
+        CloseHandle(_noReaders);
+        DeleteCriticalSection(&_lock);
+    }
+
+    inline void LockShared()
+    {
+#ifdef DEVELOPMENT
+        bool contended = !TryEnterCriticalSection(&_lock);
+        if (contended)
+            EnterCriticalSection(&_lock);
+        Count(contended);
+#else
+        EnterCriticalSection(&_lock);
+#endif
+        InterlockedIncrement(&_readers);
+        LeaveCriticalSection(&_lock);
+    }
+
+    inline void UnlockShared()
+    {
+        if (InterlockedDecrement(&_readers) == 0)
+            SetEvent(_noReaders);
+    }
+
+    inline void Lock()
+    {
+        bool contended = !TryEnterCriticalSection(&_lock);
+        if (contended)
+            EnterCriticalSection(&_lock);
+
+        // No new readers get in meanwhile. The event may be left set by readers gone before -
+        // the count is checked again then
+        while (InterlockedCompareExchange(&_readers, 0, 0))
+        {
+            contended = true;
+            WaitForSingleObject(_noReaders, INFINITE);
+        }
+
+        Count(contended);
+    }
+
+    inline void Unlock()
+    {
+        LeaveCriticalSection(&_lock);
+    }
+
+private:
+    CRITICAL_SECTION    _lock;
+    HANDLE              _noReaders;
+    volatile LONG       _readers;
+};
+
+#else
+
+/**
+ *  \class  Mutex
+ *  \brief  Recursive, portable implementation for building the primitives outside Windows
+ */
+class Mutex : public LockCounters
+{
+public:
+    inline void Lock()
+    {
+        bool contended = !_lock.try_lock();
+        if (contended)
+            _lock.lock();
+        Count(contended);
+    }
+
+    inline bool TryLock()
+    {
+        return _lock.try_lock();
+    }
+
+    inline void Unlock()
+    {
+        _lock.unlock();
+    }
+
+private:
+    std::recursive_mutex _lock;
+};
+
+
+/**
+ *  \class  RWMutex
+ *  \brief  Shared (read) / exclusive (write) lock, portable implementation. Writers are preferred.
+ *          Not recursive
+ */
+class RWMutex : public LockCounters
+{
+public:
+    RWMutex() : _readers(0), _writer(false) {}
+
+    inline void LockShared()
+    {
+        std::unique_lock<std::mutex> lock(_lock);
+
+        bool contended = _writer;
+        while (_writer)
+            _cond.wait(lock);
+
+        ++_readers;
+        Count(contended);
+    }
+
+    inline void UnlockShared()
+    {
+        std::unique_lock<std::mutex> lock(_lock);
+
+        if (--_readers == 0)
+            _cond.notify_all();
+    }
+
+    inline void Lock()
+    {
+        std::unique_lock<std::mutex> lock(_lock);
+
+        bool contended = (_writer || _readers);
+        while (_writer)
+            _cond.wait(lock);
+
+        _writer = true;
+        while (_readers)
+            _cond.wait(lock);
+
+        Count(contended);
+    }
+
+    inline void Unlock()
+    {
+        std::unique_lock<std::mutex> lock(_lock);
+
+        _writer = false;
+        _cond.notify_all();
+    }
+
+private:
+    std::mutex              _lock;
+    std::condition_variable _cond;
+    unsigned                _readers;
+    bool                    _writer;
+};
+
+#endif
+
+
 /**
  *  \class  AutoLock
- *  \brief
+ *  \brief  Exclusive lock for the scope
  */
 class AutoLock
 {
 public:
-    AutoLock(Mutex& lock) : _lock(lock)
+    AutoLock(Mutex& lock) : _lock(&lock), _rwLock(NULL)
     {
-        _lock.Lock();
+        _lock->Lock();
+    }
+
+    AutoLock(RWMutex& lock) : _lock(NULL), _rwLock(&lock)
+    {
+        _rwLock->Lock();
     }
 
     ~AutoLock()
     {
-        _lock.Unlock();
+        if (_lock)
+            _lock->Unlock();
+        else
+            _rwLock->Unlock();
+    }
+
+private:
+    Mutex*      _lock;
+    RWMutex*    _rwLock;
+};
+
+
+/**
+ *  \class  AutoSharedLock
+ *  \brief  Shared lock for the scope
+ */
+class AutoSharedLock
+{
+public:
+    AutoSharedLock(RWMutex& lock) : _lock(lock)
+    {
+        _lock.LockShared();
+    }
+
+    ~AutoSharedLock()
+    {
+        _lock.UnlockShared();
     }
 
 private:
-    Mutex& _lock;
+    RWMutex& _lock;
 };
 
 
@@ -110,9 +359,90 @@ public:
             _lock.Unlock();
     }
 
-	BOOL IsLocked() { return _isLocked; }
+	bool IsLocked() { return _isLocked; }
 
 private:
     Mutex&  _lock;
-    BOOL    _isLocked;
+    bool    _isLocked;
+};
+
+
+/**
+ *  \class  MpscQueue
+ *  \brief  Lock-free queue for multiple producers and a consumer. Producers push single items,
+ *          the consumer takes all queued items at once in push order
+ */
+template <typename T>
+class MpscQueue
+{
+public:
+    MpscQueue() : _head(NULL) {}
+
+    ~MpscQueue()
+    {
+        std::vector<T> items;
+        PopAll(items);
+    }
+
+    void Push(const T& item)
+    {
+        Node* node = new Node(item);
+        node->_next = _head.load(std::memory_order_relaxed);
+
+        while (!_head.compare_exchange_weak(node->_next, node,
+                std::memory_order_release, std::memory_order_relaxed));
+    }
+
+    /**
+     *  \brief  Appends the queued items to items, returns false if there were none
+     */
+    bool PopAll(std::vector<T>& items)
+    {
+        Node* node = _head.exchange(NULL, std::memory_order_acquire);
+        if (!node)
+            return false;
+
+        // The list is newest first
+        Node* first = NULL;
+        while (node)
+        {
+            Node* next = node->_next;
+            node->_next = first;
+            first = node;
+            node = next;
+        }
+
+        while (first)
+        {
+            Node* next = first->_next;
+            items.push_back(first->_item);
+            delete first;
+            first = next;
+        }
+
+        return true;
+    }
+
+    inline bool IsEmpty() const
+    {
+        return (_head.load(std::memory_order_acquire) == NULL);
+    }
+
+private:
+    /**
+     *  \struct  Node
+     *  \brief
+     */
+    struct Node
+    {
+        Node(const T& item) : _item(item), _next(NULL) {}
+
+        T       _item;
+        Node*   _next;
+    };
+
+    MpscQueue(const MpscQueue&);
+    MpscQueue& operator=(const MpscQueue&);
+
+    std::atomic<Node*> _head;
 };
@@ -0,0 +1,154 @@
+/**
+ *  \file
+ *  \brief  GTags command class
+ *
+ *  \author  Pavel Nedev <pg.nedev@gmail.com>
+ *
+ *  \section COPYRIGHT
+ *  Copyright(C) 2015 Pavel Nedev
+ *
+ *  \section LICENSE
+ *  This program is free software; you can redistribute it and/or modify it
+ *  under the terms of the GNU General Public License version 2 as published
+ *  by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful, but
+ *  WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ *  or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ *  for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+#pragma once
+
+
+#include <tchar.h>
+#include <memory>
+#include <vector>
+#include "Common.h"
+#include "DbManager.h"
+
+
+namespace GTags
+{
+
+enum CmdId_t
+{
+    CREATE_DATABASE = 0,
+    UPDATE_SINGLE,
+    UPDATE_INCREMENTAL,
+    AUTOCOMPLETE,
+    AUTOCOMPLETE_SYMBOL,
+    AUTOCOMPLETE_REFERENCE,
+    AUTOCOMPLETE_FILE,
+    FIND_FILE,
+    FIND_SIBLING,
+    FIND_DEFINITION,
+    FIND_REFERENCE,
+    FIND_SYMBOL,
+    LIST_DEFINITIONS,
+    LIST_REFERENCES,
+    GREP,
+    VERSION
+};
+
+
+enum CmdStatus_t
+{
+    CANCELLED = 0,
+    RUN_ERROR,
+    FAILED,
+    OK
+};
+
+
+class Cmd;
+
+
+/**
+ *  \brief  Receives complete output lines while the command runs, returns false to stop the command early
+ */
+typedef bool (*StreamCB)(const std::shared_ptr<Cmd>&, const std::vector<char>& lines);
+
+
+/**
+ *  \class  Cmd
+ *  \brief
+ */
+class Cmd
+{
+public:
+    Cmd(CmdId_t id, const TCHAR* name, DbHandle db = NULL, const TCHAR* tag = NULL,
+            bool regExp = false, bool matchCase = true);
+    ~Cmd() {};
+
+    inline void Id(CmdId_t id) { _id = id; }
+    inline CmdId_t Id() const { return _id; }
+
+    inline void Name(const TCHAR* name) { if (name) _name = name; }
+    inline const TCHAR* Name() const { return _name.C_str(); }
+
+    inline DbHandle Db() const { return _db; }
+    // Only for the DBs not managed by DbManager (library DBs)
+    inline void DbPath(const TCHAR* dbPath) { if (!_db) _dbPath = dbPath; }
+    inline const TCHAR* DbPath() const { return _dbPath.C_str(); }
+
+    inline void Tag(const TCHAR* tag) { if (tag) _tag = tag; }
+    inline const TCHAR* Tag() const { return _tag.C_str(); }
+    inline unsigned TagLen() const { return _tag.Len(); }
+
+    inline void RegExp(bool re) { _regExp = re; }
+    inline bool RegExp() const { return _regExp; }
+
+    inline void MatchCase(bool mc) { _matchCase = mc; }
+    inline bool MatchCase() const { return _matchCase; }
+
+    inline void Silent(bool silent) { _silent = silent; }
+    inline bool Silent() const { return _silent; }
+
+    inline void Stream(StreamCB streamCB) { _streamCB = streamCB; }
+    inline StreamCB Stream() const { return _streamCB; }
+
+    inline void Status(CmdStatus_t stat) { _status = stat; }
+    inline CmdStatus_t Status() const { return _status; }
+
+    inline char* Result() { return _result.data(); }
+    inline const char* Result() const { return _result.data(); }
+    inline unsigned ResultLen() const { return _result.size() - 1; }
+
+    void SetResult(const std::vector<char>& result)
+    {
+        _result.assign(result.cbegin(), result.cend());
+    }
+
+    void AppendResult(const std::vector<char>& result)
+    {
+        // Drop the previous result string termination
+        if (!_result.empty())
+            _result.pop_back();
+        _result.insert(_result.cend(), result.cbegin(), result.cend());
+    }
+
+private:
+    friend class CmdEngine;
+
+    CmdId_t             _id;
+    CText               _name;
+    DbHandle const      _db;
+    CPath               _dbPath;
+
+    CText               _tag;
+    bool                _regExp;
+    bool                _matchCase;
+    bool                _silent;
+    StreamCB            _streamCB;
+
+    CmdStatus_t         _status;
+    std::vector<char>   _result;
+};
+
+} // namespace GTags
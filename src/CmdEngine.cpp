@@ -25,46 +25,145 @@
 #include <windows.h>
 #include <tchar.h>
 #include <process.h>
+#include <stdio.h>
+#include <string.h>
+#include <unordered_set>
 #include "Common.h"
+#include "Trace.h"
 #include "INpp.h"
 #include "Config.h"
 #include "GTags.h"
 #include "ActivityWin.h"
-#include "ReadPipe.h"
+#include "TagIndex.h"
+#include "PathIndex.h"
+#include "FileWalker.h"
+#include "TagFilter.h"
+#include "DbWarmer.h"
 #include "CmdEngine.h"
 
 
+namespace
+{
+
+/**
+ *  \struct  LineRef
+ *  \brief  Result line in a buffer that outlives the reference
+ */
+struct LineRef
+{
+    LineRef(const char* line, unsigned len) : _line(line), _len(len) {}
+
+    const char* _line;
+    unsigned    _len;
+};
+
+
+/**
+ *  \struct  LineHash
+ *  \brief
+ */
+struct LineHash
+{
+    size_t operator()(const LineRef& ref) const
+    {
+        // FNV-1a
+        size_t hash = 2166136261U;
+
+        for (unsigned i = 0; i < ref._len; ++i)
+        {
+            hash ^= (unsigned char)ref._line[i];
+            hash *= 16777619U;
+        }
+
+        return hash;
+    }
+};
+
+
+/**
+ *  \struct  LineEqual
+ *  \brief
+ */
+struct LineEqual
+{
+    bool operator()(const LineRef& ref1, const LineRef& ref2) const
+    {
+        return (ref1._len == ref2._len && !memcmp(ref1._line, ref2._line, ref1._len));
+    }
+};
+
+
+typedef std::unordered_set<LineRef, LineHash, LineEqual> LineSet;
+
+
+/**
+ *  \brief  Adds the new line separated lines of buf to the set
+ */
+void addLines(LineSet& lines, const char* buf, unsigned len)
+{
+    for (unsigned i = 0, start = 0; i <= len; ++i)
+    {
+        if (i == len || buf[i] == '\n' || buf[i] == '\r' || buf[i] == 0)
+        {
+            if (i > start)
+                lines.insert(LineRef(buf + start, i - start));
+            start = i + 1;
+        }
+    }
+}
+
+} // anonymous namespace
+
+
 namespace GTags
 {
 
+// CmdId_t names
+const TCHAR* const cCmdIdNames[] =
+{
+    _T("CREATE_DATABASE"),
+    _T("UPDATE_SINGLE"),
+    _T("UPDATE_INCREMENTAL"),
+    _T("AUTOCOMPLETE"),
+    _T("AUTOCOMPLETE_SYMBOL"),
+    _T("AUTOCOMPLETE_REFERENCE"),
+    _T("AUTOCOMPLETE_FILE"),
+    _T("FIND_FILE"),
+    _T("FIND_SIBLING"),
+    _T("FIND_DEFINITION"),
+    _T("FIND_REFERENCE"),
+    _T("FIND_SYMBOL"),
+    _T("LIST_DEFINITIONS"),
+    _T("LIST_REFERENCES"),
+    _T("GREP"),
+    _T("VERSION")
+};
+
+
 const TCHAR CmdEngine::cCreateDatabaseCmd[] = _T("\"%s\\gtags.exe\" -c --skip-unreadable");
 const TCHAR CmdEngine::cUpdateSingleCmd[]   = _T("\"%s\\gtags.exe\" -c --skip-unreadable --single-update \"%s\"");
+const TCHAR CmdEngine::cUpdateIncrementalCmd[] = _T("\"%s\\gtags.exe\" -c --skip-unreadable -i");
 const TCHAR CmdEngine::cAutoComplCmd[]      = _T("\"%s\\global.exe\" -cT \"%s\"");
 const TCHAR CmdEngine::cAutoComplSymCmd[]   = _T("\"%s\\global.exe\" -cs \"%s\"");
+const TCHAR CmdEngine::cAutoComplRefCmd[]   = _T("\"%s\\global.exe\" -cr \"%s\"");
 const TCHAR CmdEngine::cAutoComplFileCmd[]  = _T("\"%s\\global.exe\" -cP --match-part=all \"%s\"");
 const TCHAR CmdEngine::cFindFileCmd[]       = _T("\"%s\\global.exe\" -P \"%s\"");
 const TCHAR CmdEngine::cFindDefinitionCmd[] = _T("\"%s\\global.exe\" -dT --result=grep \"%s\"");
 const TCHAR CmdEngine::cFindReferenceCmd[]  = _T("\"%s\\global.exe\" -r --result=grep \"%s\"");
 const TCHAR CmdEngine::cFindSymbolCmd[]     = _T("\"%s\\global.exe\" -s --result=grep \"%s\"");
+const TCHAR CmdEngine::cListDefinitionsCmd[] = _T("\"%s\\global.exe\" -d --result=ctags \"%s\"");
+const TCHAR CmdEngine::cListReferencesCmd[] = _T("\"%s\\global.exe\" -r --result=ctags \"%s\"");
 const TCHAR CmdEngine::cGrepCmd[]           = _T("\"%s\\global.exe\" -g --result=grep \"%s\"");
 const TCHAR CmdEngine::cVersionCmd[]        = _T("\"%s\\global.exe\" --version");
 
+const DWORD CmdEngine::cStreamPeriod = 20;
 
-/**
- *  \brief
- */
-Cmd::Cmd(CmdId_t id, const TCHAR* name, DbHandle db, const TCHAR* tag, bool regExp, bool matchCase) :
-        _id(id), _db(db), _regExp(regExp), _matchCase(matchCase), _status(CANCELLED)
-{
-    if (db)
-        _dbPath = *db;
-
-    if (name)
-        _name = name;
-
-    if (tag)
-        _tag = tag;
-}
+Mutex       CmdEngine::StatsLock;
+unsigned    CmdEngine::LibQueries       = 0;
+unsigned    CmdEngine::LibRuns          = 0;
+unsigned    CmdEngine::LibSkipped       = 0;
+unsigned    CmdEngine::LibDuplicates    = 0;
+CmdEngine::CmdTimes CmdEngine::Times[VERSION + 1] = {};
 
 
 /**
@@ -115,6 +214,90 @@ bool CmdEngine::Run(const std::shared_ptr<Cmd>& cmd, CompletionCB complCB)
 }
 
 
+/**
+ *  \brief
+ */
+void CmdEngine::GetStats(CText& stats)
+{
+    AUTOLOCK(StatsLock);
+
+    if (!LibQueries)
+        return;
+
+    TCHAR buf[160];
+    _sntprintf_s(buf, _countof(buf), _TRUNCATE,
+            _T(" %u queries, %u library DB runs, %u skipped by the tag index, %u duplicates dropped\n"),
+            LibQueries, LibRuns, LibSkipped, LibDuplicates);
+
+    stats += buf;
+}
+
+
+/**
+ *  \brief  Per command kind run times summary
+ */
+void CmdEngine::GetTimings(CText& stats)
+{
+    AUTOLOCK(StatsLock);
+
+    for (unsigned id = 0; id < _countof(Times); ++id)
+    {
+        const CmdTimes& times = Times[id];
+        if (!times._count)
+            continue;
+
+        unsigned avg = (unsigned)(times._total / times._count);
+        unsigned p90 = percentile(times, 90);
+
+        TCHAR buf[192];
+        _sntprintf_s(buf, _countof(buf), _TRUNCATE,
+                _T(" %s: %u runs, %u.%u ms average, %u.%u ms p90, %u.%u ms max\n"),
+                cCmdIdNames[id], times._count, avg / 1000, (avg % 1000) / 100,
+                p90 / 1000, (p90 % 1000) / 100, times._max / 1000, (times._max % 1000) / 100);
+
+        stats += buf;
+    }
+}
+
+
+/**
+ *  \brief  Saves the per command kind run times as JSON so separate builds / sessions can be compared
+ */
+bool CmdEngine::SaveTimings(const CPath& file)
+{
+    FILE* fp;
+    _tfopen_s(&fp, file.C_str(), _T("wt"));
+    if (fp == NULL)
+        return false;
+
+    AUTOLOCK(StatsLock);
+
+    _ftprintf(fp, _T("{\"commands\":["));
+
+    bool first = true;
+    for (unsigned id = 0; id < _countof(Times); ++id)
+    {
+        const CmdTimes& times = Times[id];
+        if (!times._count)
+            continue;
+
+        _ftprintf(fp, _T("%s\n{\"cmd\":\"%s\",\"count\":%u,\"failed\":%u,\"avg_us\":%u,")
+                _T("\"p50_us\":%u,\"p90_us\":%u,\"p99_us\":%u,\"max_us\":%u}"),
+                first ? _T("") : _T(","), cCmdIdNames[id], times._count, times._failed,
+                (unsigned)(times._total / times._count), percentile(times, 50), percentile(times, 90),
+                percentile(times, 99), times._max);
+        first = false;
+    }
+
+    _ftprintf(fp, _T("\n]}\n"));
+
+    bool success = (ferror(fp) == 0);
+    fclose(fp);
+
+    return success;
+}
+
+
 /**
  *  \brief
  */
@@ -134,7 +317,24 @@ CmdEngine::~CmdEngine()
 unsigned __stdcall CmdEngine::threadFunc(void* data)
 {
     CmdEngine* engine = static_cast<CmdEngine*>(data);
-    unsigned r = engine->runProcess();
+    const Cmd& cmd = *engine->_cmd;
+
+    // Latency of the first user lookup in the DB since it was activated - cold vs warm DB files
+    DbWarmer::Temp_t temp = DbWarmer::NONE;
+    if (cmd._db && cmd.TagLen() && (!cmd._silent || cmd._streamCB) && cmd._id != UPDATE_SINGLE)
+        temp = DbWarmer::Get().FirstLookup(cmd._dbPath);
+
+    LARGE_INTEGER freq, start, end;
+    QueryPerformanceFrequency(&freq);
+    QueryPerformanceCounter(&start);
+
+    unsigned r = engine->runCmd();
+
+    QueryPerformanceCounter(&end);
+    unsigned time_us = (unsigned)(((end.QuadPart - start.QuadPart) * 1000000) / freq.QuadPart);
+
+    DbWarmer::Get().LookupDone(temp, time_us / 1000);
+    addTime(cmd, time_us);
 
     if (engine->_complCB)
         delete engine;
@@ -154,10 +354,14 @@ const TCHAR* CmdEngine::getCmdLine() const
             return cCreateDatabaseCmd;
         case UPDATE_SINGLE:
             return cUpdateSingleCmd;
+        case UPDATE_INCREMENTAL:
+            return cUpdateIncrementalCmd;
         case AUTOCOMPLETE:
             return cAutoComplCmd;
         case AUTOCOMPLETE_SYMBOL:
             return cAutoComplSymCmd;
+        case AUTOCOMPLETE_REFERENCE:
+            return cAutoComplRefCmd;
         case AUTOCOMPLETE_FILE:
             return cAutoComplFileCmd;
         case FIND_FILE:
@@ -168,6 +372,10 @@ const TCHAR* CmdEngine::getCmdLine() const
             return cFindReferenceCmd;
         case FIND_SYMBOL:
             return cFindSymbolCmd;
+        case LIST_DEFINITIONS:
+            return cListDefinitionsCmd;
+        case LIST_REFERENCES:
+            return cListReferencesCmd;
         case GREP:
             return cGrepCmd;
         case VERSION:
@@ -183,16 +391,18 @@ const TCHAR* CmdEngine::getCmdLine() const
  */
 void CmdEngine::composeCmd(CText& buf) const
 {
+    TRACE_SPAN("CmdEngine::composeCmd");
+
     CPath path(DllPath);
     path.StripFilename();
     path += cBinsDir;
 
-    if (_cmd->_id == CREATE_DATABASE || _cmd->_id == VERSION)
+    if (_cmd->_id == CREATE_DATABASE || _cmd->_id == UPDATE_INCREMENTAL || _cmd->_id == VERSION)
         _sntprintf_s(buf.C_str(), buf.Size(), _TRUNCATE, getCmdLine(), path.C_str());
     else
         _sntprintf_s(buf.C_str(), buf.Size(), _TRUNCATE, getCmdLine(), path.C_str(), _cmd->Tag());
 
-    if (_cmd->_id == CREATE_DATABASE || _cmd->_id == UPDATE_SINGLE)
+    if (_cmd->_id == CREATE_DATABASE || _cmd->_id == UPDATE_SINGLE || _cmd->_id == UPDATE_INCREMENTAL)
     {
         path += _T("\\gtags.conf");
         if (path.FileExists())
@@ -217,6 +427,180 @@ void CmdEngine::composeCmd(CText& buf) const
 }
 
 
+/**
+ *  \brief
+ */
+unsigned CmdEngine::runCmd()
+{
+    TRACE_SPAN("CmdEngine::runCmd");
+
+    TagIndex::Kind_t kind;
+
+    // Path lookups are served from memory - no need to run global
+    if (PathIndex::Serves(*_cmd))
+        return runPathIndexed();
+
+    std::vector<LibRun> libRuns;
+
+    // Library DBs are queried in parallel to the project DB instead of one after another by global.
+    // Empty tag lists all project names (index builds) - libraries are not part of that
+    if (_cmd->_db && (_cmd->_id == AUTOCOMPLETE || _cmd->_id == FIND_DEFINITION) && Config._useLibDb &&
+            _cmd->TagLen())
+        startLibRuns(libRuns);
+
+    if (TagIndex::GetKind(_cmd->_id, kind))
+    {
+        unsigned r = runTagLookup();
+
+        if (!libRuns.empty())
+            mergeLibRuns(libRuns);
+
+        return r;
+    }
+
+    // gtags gets the file list from the plugin walker - falls back to walking the tree itself on failure
+    if (_cmd->_id == CREATE_DATABASE || _cmd->_id == UPDATE_INCREMENTAL)
+        FileWalker::Get().Walk(_cmd->DbPath(), _listFile);
+
+    unsigned r = runProcess();
+
+    if (!_listFile.IsEmpty())
+        DeleteFile(_listFile.C_str());
+
+    if (_cmd->_id == UPDATE_SINGLE || _cmd->_id == UPDATE_INCREMENTAL || _cmd->_id == CREATE_DATABASE)
+        DbManager::Get().EndUpdate(_cmd->_db, _cmd->_status == OK);
+
+    return r;
+}
+
+
+/**
+ *  \brief  Answers lookups of names the DB surely lacks without running global (DB tag filter)
+ */
+unsigned CmdEngine::runTagLookup()
+{
+    TagIndex::Kind_t kind;
+    TagIndex::GetKind(_cmd->_id, kind);
+
+    bool checked = false;
+
+    if (_cmd->_db && !_cmd->_regExp && _cmd->TagLen())
+    {
+        bool prefix = (_cmd->_id == AUTOCOMPLETE || _cmd->_id == AUTOCOMPLETE_SYMBOL);
+
+        if (!TagFilter::Get().MayContain(_cmd->_dbPath, kind, _cmd->Tag(), prefix, checked))
+        {
+            _cmd->_status = OK;
+            return 0;
+        }
+
+        // Have the filter ready for the next lookups
+        if (!checked)
+            TagFilter::Get().Prefetch(_cmd->_dbPath);
+    }
+
+    unsigned resultLen = _cmd->_result.size();
+
+    // Ignore-case lookups make global scan the whole DB so resolve them through the tag index instead
+    unsigned r = (!_cmd->_matchCase && !_cmd->_regExp) ? runIndexed() : runProcess();
+
+    if (checked && _cmd->_status == OK && _cmd->_result.size() == resultLen)
+        TagFilter::Get().FalsePositive();
+
+    return r;
+}
+
+
+/**
+ *  \brief  Completes the tag from the index or runs exact-case global lookups
+ *          for each indexed spelling of the tag. Runs global as is until the index is built
+ */
+unsigned CmdEngine::runIndexed()
+{
+    TRACE_SPAN("CmdEngine::runIndexed");
+
+    TagIndex::Kind_t kind;
+    TagIndex::GetKind(_cmd->_id, kind);
+
+    TagIndex::NamesPtr names = TagIndex::Get().Acquire(*_cmd, kind);
+    if (!names)
+        return runProcess();
+
+    CTextA tag(_cmd->Tag());
+
+    if (_cmd->_id == AUTOCOMPLETE || _cmd->_id == AUTOCOMPLETE_SYMBOL)
+    {
+        std::vector<char> result;
+        names->Complete(tag.C_str(), result);
+
+        if (!result.empty())
+        {
+            _cmd->AppendResult(result);
+            streamResult(result);
+        }
+
+        _cmd->_status = OK;
+        return 0;
+    }
+
+    std::vector<CTextA> variants;
+    names->GetVariants(tag.C_str(), variants);
+
+    _cmd->_status = OK;
+
+    unsigned r = 0;
+    CText origTag(_cmd->_tag);
+
+    _cmd->_matchCase = true;
+
+    for (std::vector<CTextA>::iterator iVariant = variants.begin(); iVariant != variants.end(); ++iVariant)
+    {
+        _cmd->_tag = iVariant->C_str();
+        r = runProcess();
+        if (r)
+            break;
+    }
+
+    _cmd->_tag = origTag;
+    _cmd->_matchCase = false;
+
+    return r;
+}
+
+
+/**
+ *  \brief  Serves the path lookup from the DB path index, falls back to global if the index is unavailable
+ */
+unsigned CmdEngine::runPathIndexed()
+{
+    TRACE_SPAN("CmdEngine::runPathIndexed");
+
+    std::vector<char> result;
+
+    if (!PathIndex::Get().Run(*_cmd, result))
+    {
+        // Header / source lookup has no global counterpart
+        if (_cmd->_id == FIND_SIBLING)
+        {
+            _cmd->_status = RUN_ERROR;
+            return 1;
+        }
+
+        return runProcess();
+    }
+
+    if (!result.empty())
+    {
+        _cmd->AppendResult(result);
+        streamResult(result);
+    }
+
+    _cmd->_status = OK;
+
+    return 0;
+}
+
+
 /**
  *  \brief
  */
@@ -225,22 +609,62 @@ unsigned CmdEngine::runProcess()
     CText buf(2048);
     composeCmd(buf);
 
-    DWORD createFlags = NORMAL_PRIORITY_CLASS | CREATE_NO_WINDOW;
+    DWORD createFlags = (_cmd->_silent ? BELOW_NORMAL_PRIORITY_CLASS : NORMAL_PRIORITY_CLASS) | CREATE_NO_WINDOW;
     const TCHAR* env = NULL;
     const TCHAR* currentDir = _cmd->DbPath();
 
-    CText envVars(_T("GTAGSLIBPATH="));
-    if (Config._useLibDb)
-        envVars += Config._libDbPath;
+    std::vector<TCHAR> envVars;
+    CPath snapshotDir;
+
+    if (!_listFile.IsEmpty())
+    {
+        buf += _T(" -f \"");
+        buf += _listFile;
+        buf += _T("\"");
+    }
 
-    if (_cmd->_id == VERSION)
+    if (_cmd->_id == UPDATE_SINGLE || _cmd->_id == UPDATE_INCREMENTAL ||
+            (_cmd->_id == CREATE_DATABASE && DbManager::Get().IsUpdateLocked(_cmd->_db)))
+    {
+        // The update / re-creation is written to a DB snapshot so readers are not blocked meanwhile
+        if (!DbManager::Get().BeginUpdate(_cmd->_db, snapshotDir, _cmd->_id != CREATE_DATABASE))
+        {
+            _cmd->_status = RUN_ERROR;
+            return 1;
+        }
+
+        stripTrailingSlash(snapshotDir);
+        buf += _T(" \"");
+        buf += snapshotDir;
+        buf += _T("\"");
+    }
+    else if (_cmd->_id == VERSION)
     {
         currentDir = NULL;
     }
-    else if (_cmd->_id == AUTOCOMPLETE || _cmd->_id == FIND_DEFINITION)
+    else
     {
-        env = envVars.C_str();
-        createFlags |= CREATE_UNICODE_ENVIRONMENT;
+        // Library DBs are queried separately
+        if (_cmd->_id == AUTOCOMPLETE || _cmd->_id == FIND_DEFINITION)
+            addEnvVar(envVars, _T("GTAGSLIBPATH"), _T(""));
+
+        // Reader is pinned to a DB snapshot that is not moved to the DB folder yet
+        if (_cmd->_id != CREATE_DATABASE && DbManager::Get().GetSnapshotDir(_cmd->_db, snapshotDir))
+        {
+            CPath root(_cmd->DbPath());
+            stripTrailingSlash(root);
+            stripTrailingSlash(snapshotDir);
+
+            addEnvVar(envVars, _T("GTAGSROOT"), root.C_str());
+            addEnvVar(envVars, _T("GTAGSDBPATH"), snapshotDir.C_str());
+        }
+
+        if (!envVars.empty())
+        {
+            envVars.push_back(0);
+            env = envVars.data();
+            createFlags |= CREATE_UNICODE_ENVIRONMENT;
+        }
     }
 
     ReadPipe errorPipe;
@@ -253,10 +677,14 @@ unsigned CmdEngine::runProcess()
     si.hStdOutput   = dataPipe.GetInputHandle();
 
     PROCESS_INFORMATION pi;
-    if (!CreateProcess(NULL, buf.C_str(), NULL, NULL, TRUE, createFlags, (LPVOID)env, currentDir, &si, &pi))
     {
-        _cmd->_status = RUN_ERROR;
-        return 1;
+        TRACE_SPAN("CreateProcess");
+
+        if (!CreateProcess(NULL, buf.C_str(), NULL, NULL, TRUE, createFlags, (LPVOID)env, currentDir, &si, &pi))
+        {
+            _cmd->_status = RUN_ERROR;
+            return 1;
+        }
     }
 
     SetThreadPriority(pi.hThread, THREAD_PRIORITY_NORMAL);
@@ -268,17 +696,32 @@ unsigned CmdEngine::runProcess()
         return 1;
     }
 
-    CText header(_cmd->Name());
-    header += _T(" - \"");
-    if (_cmd->_id == CREATE_DATABASE)
-        header += _cmd->DbPath();
-    else if (_cmd->_id != VERSION)
-        header += _cmd->Tag();
-    header += _T('\"');
+    bool cancelled = false;
+
+    // Background commands are not shown to the user and cannot be cancelled
+    if (_cmd->_silent)
+    {
+        if (_cmd->_streamCB)
+            streamOutput(pi, dataPipe);
+        else
+            WaitForSingleObject(pi.hProcess, INFINITE);
+    }
+    else
+    {
+        CText header(_cmd->Name());
+        header += _T(" - \"");
+        if (_cmd->_id == CREATE_DATABASE || _cmd->_id == UPDATE_INCREMENTAL)
+            header += _cmd->DbPath();
+        else if (_cmd->_id != VERSION)
+            header += _cmd->Tag();
+        header += _T('\"');
+
+        // Display activity window and block until process is ready or user has cancelled the operation
+        cancelled = ActivityWin::Show(pi.hProcess, 600, header.C_str(),
+                (_cmd->_id == CREATE_DATABASE || _cmd->_id == UPDATE_SINGLE ||
+                _cmd->_id == UPDATE_INCREMENTAL) ? 0 : 300);
+    }
 
-    // Display activity window and block until process is ready or user has cancelled the operation
-    bool cancelled = ActivityWin::Show(pi.hProcess, 600, header.C_str(),
-            (_cmd->_id == CREATE_DATABASE || _cmd->_id == UPDATE_SINGLE) ? 0 : 300);
     endProcess(pi);
 
     if (cancelled)
@@ -289,11 +732,11 @@ unsigned CmdEngine::runProcess()
 
     if (!dataPipe.GetOutput().empty())
     {
-        _cmd->appendResult(dataPipe.GetOutput());
+        _cmd->AppendResult(dataPipe.GetOutput());
     }
     else if (!errorPipe.GetOutput().empty())
     {
-        _cmd->setResult(errorPipe.GetOutput());
+        _cmd->SetResult(errorPipe.GetOutput());
 
         if (_cmd->_id != CREATE_DATABASE)
         {
@@ -308,6 +751,378 @@ unsigned CmdEngine::runProcess()
 }
 
 
+/**
+ *  \brief  Passes the process output to the stream callback in complete lines as it is read.
+ *          Terminates the process if the callback doesn't need more - the result is cut to what was passed
+ */
+void CmdEngine::streamOutput(PROCESS_INFORMATION& pi, ReadPipe& dataPipe)
+{
+    std::vector<char> lines;
+    unsigned streamed = 0;
+    bool more = true;
+
+    while (more && WaitForSingleObject(pi.hProcess, cStreamPeriod) == WAIT_TIMEOUT)
+    {
+        lines.clear();
+        streamed = dataPipe.PeekLines(lines, streamed);
+
+        if (!lines.empty())
+            more = _cmd->_streamCB(_cmd, lines);
+    }
+
+    if (!more)
+        TerminateProcess(pi.hProcess, 0);
+
+    std::vector<char>& output = dataPipe.GetOutput();
+
+    if (!more)
+    {
+        output.resize(streamed);
+        if (streamed)
+            output.push_back('\0');
+    }
+    else if (output.size() > streamed + 1)
+    {
+        // The rest of the output without the string termination
+        lines.assign(output.begin() + streamed, output.end() - 1);
+        _cmd->_streamCB(_cmd, lines);
+    }
+}
+
+
+/**
+ *  \brief  Passes result that didn't come from a process to the stream callback
+ */
+void CmdEngine::streamResult(const std::vector<char>& result)
+{
+    if (_cmd->_streamCB && result.size() > 1)
+    {
+        std::vector<char> lines(result.begin(), result.end() - 1);
+        _cmd->_streamCB(_cmd, lines);
+    }
+}
+
+
+/**
+ *  \brief  Project DB commands only - library queries are part of the project one.
+ *          Empty tag lookups list all names for the in-memory indexes, those are not counted
+ */
+void CmdEngine::addTime(const Cmd& cmd, unsigned time_us)
+{
+    if ((!cmd._db && cmd._id != VERSION) || (!cmd.TagLen() && cmd._id >= AUTOCOMPLETE && cmd._id != VERSION))
+        return;
+
+    unsigned bucket = 0;
+    while (bucket < cTimeBuckets - 1 && (1U << bucket) <= time_us)
+        ++bucket;
+
+    AUTOLOCK(StatsLock);
+
+    CmdTimes& times = Times[cmd._id];
+
+    ++times._count;
+    if (cmd._status != OK)
+        ++times._failed;
+    times._total += time_us;
+    if (times._max < time_us)
+        times._max = time_us;
+    ++times._buckets[bucket];
+}
+
+
+/**
+ *  \brief  Upper bound of the run time of pct percent of the runs. Must be called under lock
+ */
+unsigned CmdEngine::percentile(const CmdTimes& times, unsigned pct)
+{
+    unsigned target = (times._count * pct + 99) / 100;
+    unsigned count = 0;
+
+    for (unsigned bucket = 0; bucket < cTimeBuckets; ++bucket)
+    {
+        count += times._buckets[bucket];
+        if (count >= target)
+        {
+            unsigned bound = 1U << bucket;
+            return (bound < times._max) ? bound : times._max;
+        }
+    }
+
+    return times._max;
+}
+
+
+/**
+ *  \brief  Appends NAME=value to environment block
+ */
+void CmdEngine::addEnvVar(std::vector<TCHAR>& env, const TCHAR* name, const TCHAR* value)
+{
+    env.insert(env.end(), name, name + _tcslen(name));
+    env.push_back(_T('='));
+    env.insert(env.end(), value, value + _tcslen(value));
+    env.push_back(0);
+}
+
+
+/**
+ *  \brief  Starts the queries of the configured library DBs - each in its own thread
+ */
+void CmdEngine::startLibRuns(std::vector<LibRun>& runs)
+{
+    std::vector<CPath> libs;
+    const TCHAR* list = Config._libDbPath.C_str();
+
+    for (const TCHAR* sep = list; *list; list = sep + 1)
+    {
+        while (*list == _T(' ') || *list == _T('\t'))
+            ++list;
+
+        sep = _tcschr(list, _T(';'));
+        unsigned len = sep ? sep - list : _tcslen(list);
+
+        while (len && (list[len - 1] == _T(' ') || list[len - 1] == _T('\t')))
+            --len;
+
+        if (len)
+        {
+            CPath lib;
+            lib.Append(list, len);
+            if (lib.C_str()[len - 1] != _T('\\'))
+                lib += _T("\\");
+
+            bool dup = CPathEqual()(lib, _cmd->_dbPath);
+            for (unsigned i = 0; !dup && i < libs.size(); ++i)
+                dup = CPathEqual()(lib, libs[i]);
+
+            if (!dup)
+                libs.push_back(lib);
+        }
+
+        if (!sep)
+            break;
+    }
+
+    if (libs.empty())
+        return;
+
+    runs.reserve(libs.size());
+
+    unsigned skipped = 0;
+
+    for (unsigned i = 0; i < libs.size(); ++i)
+    {
+        if (!libMayMatch(libs[i]))
+        {
+            ++skipped;
+            continue;
+        }
+
+        LibRun run;
+
+        // Definition results are shown relative to the project, libraries on other drives with their
+        // absolute paths
+        if (_cmd->_id == FIND_DEFINITION)
+        {
+            CText prefix;
+
+            if (!relativePath(_cmd->_dbPath, libs[i], prefix))
+                for (const TCHAR* c = libs[i].C_str(); *c; ++c)
+                    prefix += (*c == _T('\\')) ? _T('/') : *c;
+
+            run._prefix = prefix.C_str();
+        }
+
+        std::shared_ptr<Cmd> libCmd(new Cmd(_cmd->_id, _cmd->Name(), NULL, _cmd->Tag(),
+                _cmd->_regExp, _cmd->_matchCase));
+        libCmd->DbPath(libs[i].C_str());
+        libCmd->Silent(true);
+        libCmd->Status(RUN_ERROR);
+
+        run._engine = new CmdEngine(libCmd, NULL);
+        run._engine->_hThread = (HANDLE)_beginthreadex(NULL, 0, threadFunc, run._engine, 0, NULL);
+        if (run._engine->_hThread == NULL)
+        {
+            delete run._engine;
+            continue;
+        }
+
+        runs.push_back(run);
+    }
+
+    AUTOLOCK(StatsLock);
+
+    ++LibQueries;
+    LibRuns += runs.size();
+    LibSkipped += skipped;
+}
+
+
+/**
+ *  \brief  Appends the library results in config order as they become ready dropping the duplicates
+ */
+void CmdEngine::mergeLibRuns(std::vector<LibRun>& runs)
+{
+    TRACE_SPAN("CmdEngine::mergeLibRuns");
+
+    // The lines the result already has - copy as the result buffer grows
+    std::vector<char> projectResult(_cmd->_result);
+    LineSet lines;
+    addLines(lines, projectResult.data(), projectResult.size());
+
+    unsigned duplicates = 0;
+    std::vector<HANDLE> threads;
+
+    for (unsigned i = 0; i < runs.size(); ++i)
+        threads.push_back(runs[i]._engine->_hThread);
+
+    for (unsigned next = 0; next < runs.size();)
+    {
+        // Wait for the next library in order, the later ones go on meanwhile
+        WaitForSingleObject(threads[next], INFINITE);
+
+        for (; next < runs.size() && WaitForSingleObject(threads[next], 0) == WAIT_OBJECT_0; ++next)
+        {
+            const std::shared_ptr<Cmd>& libCmd = runs[next]._engine->_cmd;
+            if (_cmd->_status != OK || libCmd->_status != OK || libCmd->_result.size() < 2)
+                continue;
+
+            std::vector<char>& buf = runs[next]._lines;
+            std::vector<unsigned> starts;
+            const char* src = libCmd->_result.data();
+
+            // Prefix all first, line references are taken once the buffer doesn't grow anymore
+            for (const char* eol; *src; src = eol)
+            {
+                for (eol = src; *eol && *eol != '\n' && *eol != '\r'; ++eol);
+
+                if (eol > src)
+                {
+                    starts.push_back(buf.size());
+                    buf.insert(buf.end(), runs[next]._prefix.C_str(),
+                            runs[next]._prefix.C_str() + runs[next]._prefix.Len());
+                    buf.insert(buf.end(), src, eol);
+                    buf.push_back('\n');
+                }
+
+                while (*eol == '\n' || *eol == '\r')
+                    ++eol;
+            }
+
+            std::vector<char> added;
+
+            for (unsigned j = 0; j < starts.size(); ++j)
+            {
+                unsigned end = (j + 1 < starts.size()) ? starts[j + 1] : buf.size();
+
+                if (!lines.insert(LineRef(buf.data() + starts[j], end - starts[j] - 1)).second)
+                {
+                    ++duplicates;
+                    continue;
+                }
+
+                added.insert(added.end(), buf.begin() + starts[j], buf.begin() + end);
+            }
+
+            if (!added.empty())
+            {
+                added.push_back(0);
+                _cmd->AppendResult(added);
+                streamResult(added);
+            }
+        }
+    }
+
+    for (unsigned i = 0; i < runs.size(); ++i)
+        delete runs[i]._engine;
+
+    runs.clear();
+
+    AUTOLOCK(StatsLock);
+
+    LibDuplicates += duplicates;
+}
+
+
+/**
+ *  \brief  Tells if the library DB may have the tag. Consults the DB tag index if it is already built -
+ *          libraries that surely lack the tag are not queried at all
+ */
+bool CmdEngine::libMayMatch(const CPath& libPath) const
+{
+    if (_cmd->_regExp)
+        return true;
+
+    bool checked;
+    if (!TagFilter::Get().MayContain(libPath, TagIndex::DEFINITIONS, _cmd->Tag(), _cmd->_id == AUTOCOMPLETE, checked))
+        return false;
+
+    if (!checked)
+        TagFilter::Get().Prefetch(libPath);
+
+    TagIndex::NamesPtr names = TagIndex::Get().Peek(libPath, TagIndex::DEFINITIONS);
+    if (!names)
+        return true;
+
+    CTextA tag(_cmd->Tag());
+
+    return names->Contains(tag.C_str(), _cmd->_id == AUTOCOMPLETE);
+}
+
+
+/**
+ *  \brief  Gets the path of 'to' folder relative to 'from' folder ('/' separated, with trailing '/').
+ *          Fails if there is no relative path (different drives or UNC shares)
+ */
+bool CmdEngine::relativePath(const CPath& from, const CPath& to, CText& rel)
+{
+    const TCHAR* f = from.C_str();
+    const TCHAR* t = to.C_str();
+    unsigned common = 0;
+
+    // Length of the common folders part (including the separator)
+    for (unsigned i = 0; f[i] && t[i] && _totlower(f[i]) == _totlower(t[i]); ++i)
+        if (f[i] == _T('\\'))
+            common = i + 1;
+
+    if (common == 0)
+        return false;
+
+    // UNC paths on different servers or shares have only the leading separators in common
+    if (f[0] == _T('\\') && f[1] == _T('\\'))
+    {
+        unsigned seps = 0;
+        for (unsigned i = 0; i < common; ++i)
+            if (f[i] == _T('\\'))
+                ++seps;
+
+        if (seps < 4)
+            return false;
+    }
+
+    rel.Clear();
+
+    for (unsigned i = common; f[i]; ++i)
+        if (f[i] == _T('\\'))
+            rel += _T("../");
+
+    for (unsigned i = common; t[i]; ++i)
+        rel += (t[i] == _T('\\')) ? _T('/') : t[i];
+
+    return true;
+}
+
+
+/**
+ *  \brief  Quoted command line args and GTags env vars must not end with backslash
+ */
+void CmdEngine::stripTrailingSlash(CPath& dir)
+{
+    unsigned len = dir.Len();
+    if (len && dir.C_str()[len - 1] == _T('\\'))
+        dir.Resize(len - 1);
+}
+
+
 /**
  *  \brief
  */
@@ -30,101 +30,15 @@
 #include <memory>
 #include <vector>
 #include "Common.h"
+#include "AutoLock.h"
 #include "DbManager.h"
+#include "ReadPipe.h"
+#include "Cmd.h"
 
 
 namespace GTags
 {
 
-enum CmdId_t
-{
-    CREATE_DATABASE = 0,
-    UPDATE_SINGLE,
-    AUTOCOMPLETE,
-    AUTOCOMPLETE_SYMBOL,
-    AUTOCOMPLETE_FILE,
-    FIND_FILE,
-    FIND_DEFINITION,
-    FIND_REFERENCE,
-    FIND_SYMBOL,
-    GREP,
-    VERSION
-};
-
-
-enum CmdStatus_t
-{
-    CANCELLED = 0,
-    RUN_ERROR,
-    FAILED,
-    OK
-};
-
-
-/**
- *  \class  Cmd
- *  \brief
- */
-class Cmd
-{
-public:
-    Cmd(CmdId_t id, const TCHAR* name, DbHandle db = NULL, const TCHAR* tag = NULL,
-            bool regExp = false, bool matchCase = true);
-    ~Cmd() {};
-
-    inline void Id(CmdId_t id) { _id = id; }
-    inline CmdId_t Id() const { return _id; }
-
-    inline void Name(const TCHAR* name) { if (name) _name = name; }
-    inline const TCHAR* Name() const { return _name.C_str(); }
-
-    inline DbHandle Db() const { return _db; }
-    inline const TCHAR* DbPath() const { return _dbPath.C_str(); }
-
-    inline void Tag(const TCHAR* tag) { if (tag) _tag = tag; }
-    inline const TCHAR* Tag() const { return _tag.C_str(); }
-    inline unsigned TagLen() const { return _tag.Len(); }
-
-    inline void RegExp(bool re) { _regExp = re; }
-    inline bool RegExp() const { return _regExp; }
-
-    inline void MatchCase(bool mc) { _matchCase = mc; }
-    inline bool MatchCase() const { return _matchCase; }
-
-    inline void Status(CmdStatus_t stat) { _status = stat; }
-    inline CmdStatus_t Status() const { return _status; }
-
-    inline char* Result() { return _result.data(); }
-    inline const char* Result() const { return _result.data(); }
-    inline unsigned ResultLen() const { return _result.size() - 1; }
-
-private:
-    friend class CmdEngine;
-
-    void setResult(const std::vector<char>& result)
-    {
-        _result.assign(result.cbegin(), result.cend());
-    }
-
-    void appendResult(const std::vector<char>& result)
-    {
-        _result.insert(_result.cend(), result.cbegin(), result.cend());
-    }
-
-    CmdId_t             _id;
-    CText               _name;
-    DbHandle const      _db;
-    CPath               _dbPath;
-
-    CText               _tag;
-    bool                _regExp;
-    bool                _matchCase;
-
-    CmdStatus_t         _status;
-    std::vector<char>   _result;
-};
-
-
 typedef void (*CompletionCB)(const std::shared_ptr<Cmd>&);
 
 
@@ -137,19 +51,65 @@ class CmdEngine
 public:
     static bool Run(const std::shared_ptr<Cmd>& cmd,
             CompletionCB complCB = NULL);
+    static void GetStats(CText& stats);
+    static void GetTimings(CText& stats);
+    static bool SaveTimings(const CPath& file);
 
 private:
+    static const unsigned cTimeBuckets = 26;
+
     static const TCHAR  cCreateDatabaseCmd[];
     static const TCHAR  cUpdateSingleCmd[];
+    static const TCHAR  cUpdateIncrementalCmd[];
     static const TCHAR  cAutoComplCmd[];
     static const TCHAR  cAutoComplSymCmd[];
+    static const TCHAR  cAutoComplRefCmd[];
     static const TCHAR  cAutoComplFileCmd[];
     static const TCHAR  cFindFileCmd[];
     static const TCHAR  cFindDefinitionCmd[];
     static const TCHAR  cFindReferenceCmd[];
     static const TCHAR  cFindSymbolCmd[];
+    static const TCHAR  cListDefinitionsCmd[];
+    static const TCHAR  cListReferencesCmd[];
     static const TCHAR  cGrepCmd[];
     static const TCHAR  cVersionCmd[];
+    static const DWORD  cStreamPeriod;
+
+    /**
+     *  \struct  LibRun
+     *  \brief  Query of single library DB running in parallel to the project DB one
+     */
+    struct LibRun
+    {
+        LibRun() : _engine(NULL) {}
+
+        CmdEngine*          _engine;
+        // Library path relative to the project (absolute if on another drive) - prepended to the result
+        // file paths, UTF-8 as the results are
+        CTextA              _prefix;
+        // Library results with the prefixed paths
+        std::vector<char>   _lines;
+    };
+
+    /**
+     *  \struct  CmdTimes
+     *  \brief  Run times of one command kind - log2 microseconds histogram for the percentiles
+     */
+    struct CmdTimes
+    {
+        unsigned            _count;
+        unsigned            _failed;
+        unsigned long long  _total;
+        unsigned            _max;
+        unsigned            _buckets[cTimeBuckets];
+    };
+
+    static Mutex    StatsLock;
+    static unsigned LibQueries;
+    static unsigned LibRuns;
+    static unsigned LibSkipped;
+    static unsigned LibDuplicates;
+    static CmdTimes Times[VERSION + 1];
 
     static unsigned __stdcall threadFunc(void* data);
 
@@ -158,12 +118,29 @@ private:
 
     const TCHAR* getCmdLine() const;
     void composeCmd(CText& buf) const;
+    unsigned runCmd();
+    unsigned runTagLookup();
+    unsigned runIndexed();
+    unsigned runPathIndexed();
     unsigned runProcess();
+    void startLibRuns(std::vector<LibRun>& runs);
+    void mergeLibRuns(std::vector<LibRun>& runs);
+    bool libMayMatch(const CPath& libPath) const;
+    void streamOutput(PROCESS_INFORMATION& pi, ReadPipe& dataPipe);
+    void streamResult(const std::vector<char>& result);
     void endProcess(PROCESS_INFORMATION& pi);
 
+    static void addTime(const Cmd& cmd, unsigned time_us);
+    static unsigned percentile(const CmdTimes& times, unsigned pct);
+    static void addEnvVar(std::vector<TCHAR>& env, const TCHAR* name, const TCHAR* value);
+    static void stripTrailingSlash(CPath& dir);
+    static bool relativePath(const CPath& from, const CPath& to, CText& rel);
+
     std::shared_ptr<Cmd>    _cmd;
     CompletionCB const      _complCB;
     HANDLE                  _hThread;
+    // Files to index for DB creation and full updates
+    CPath                   _listFile;
 };
 
 } // namespace GTags
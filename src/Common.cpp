@@ -25,161 +25,147 @@
 #include "Common.h"
 
 
-/**
- *  \brief
- */
-CTextW::CTextW(const wchar_t* str) : _invalidStrLen(false)
+namespace
 {
-    if (str)
-        _buf.assign(str, str + wcslen(str) + 1);
-    else
-        _buf.push_back(L'\0');
-}
+
+#ifdef _WIN64
+const size_t cHighBitsA = 0x8080808080808080ULL;
+const size_t cHighBitsW = 0xFF80FF80FF80FF80ULL;
+#else
+const size_t cHighBitsA = 0x80808080U;
+const size_t cHighBitsW = 0xFF80FF80U;
+#endif
 
 
 /**
- *  \brief
+ *  \brief  Returns the length of the pure ASCII prefix checking a machine word at a time
  */
-CTextW::CTextW(const char* str) : _invalidStrLen(false)
+unsigned asciiLen(const char* str, unsigned len)
 {
-    if (str)
-    {
-        _buf.resize(strlen(str) + 1, L'\0');
-        size_t cnt;
-        mbstowcs_s(&cnt, _buf.data(), _buf.size(), str, _TRUNCATE);
-    }
-    else
+    unsigned i = 0;
+
+    for (; i + sizeof(size_t) <= len; i += sizeof(size_t))
     {
-        _buf.push_back('\0');
+        size_t word;
+        memcpy(&word, str + i, sizeof(word));
+        if (word & cHighBitsA)
+            break;
     }
+
+    for (; i < len && !(str[i] & 0x80); ++i);
+
+    return i;
 }
 
 
 /**
- *  \brief
+ *  \brief  Returns the length of the pure ASCII prefix checking a machine word at a time
  */
-const CTextW& CTextW::operator=(const CTextW& txt)
+unsigned asciiLen(const wchar_t* str, unsigned len)
 {
-    if (this != &txt)
+    const unsigned cWordChars = sizeof(size_t) / sizeof(wchar_t);
+    unsigned i = 0;
+
+    for (; i + cWordChars <= len; i += cWordChars)
     {
-        _buf = txt._buf;
-        _invalidStrLen = txt._invalidStrLen;
+        size_t word;
+        memcpy(&word, str + i, sizeof(word));
+        if (word & cHighBitsW)
+            break;
     }
-    return *this;
+
+    for (; i < len && str[i] < 0x80; ++i);
+
+    return i;
 }
 
 
 /**
  *  \brief
  */
-const CTextW& CTextW::operator=(const wchar_t* str)
+inline void countConversion(unsigned len, unsigned ascii)
 {
-    if (str)
-    {
-        _buf.assign(str, str + wcslen(str) + 1);
-        _invalidStrLen = false;
-    }
-    return *this;
+    InterlockedIncrement(&TextConversions);
+    InterlockedExchangeAdd(&TextConvertedChars, len);
+    InterlockedExchangeAdd(&TextAsciiChars, ascii);
 }
 
+} // anonymous namespace
+
+
+volatile LONG TextHeapAllocs = 0;
+volatile LONG TextConversions = 0;
+volatile LONG TextConvertedChars = 0;
+volatile LONG TextAsciiChars = 0;
+
 
 /**
  *  \brief
  */
-const CTextW& CTextW::operator=(const char* str)
+CTextW::CTextW(const wchar_t* str)
 {
     if (str)
-    {
-        _buf.resize(strlen(str) + 1, L'\0');
-        size_t cnt;
-        mbstowcs_s(&cnt, _buf.data(), _buf.size(), str, _TRUNCATE);
-        _invalidStrLen = false;
-    }
-
-    return *this;
+        assign(str, wcslen(str));
 }
 
 
 /**
  *  \brief
  */
-void CTextW::operator+=(const CTextW& txt)
+CTextW::CTextW(const char* str)
 {
-    AutoFit();
-
-    _buf.pop_back();
-    _buf.insert(_buf.cend(), txt._buf.begin(), txt._buf.begin() + txt.Len() + 1);
+    if (str)
+        appendConverted(str);
 }
 
 
 /**
  *  \brief
  */
-void CTextW::operator+=(const wchar_t* str)
+const CTextW& CTextW::operator=(const wchar_t* str)
 {
-    AutoFit();
-
     if (str)
-    {
-        unsigned len = wcslen(str);
-        if (len)
-        {
-            _buf.pop_back();
-            _buf.insert(_buf.cend(), str, str + len + 1);
-        }
-    }
+        assign(str, wcslen(str));
+    else
+        Clear();
+
+    return *this;
 }
 
 
 /**
  *  \brief
  */
-void CTextW::operator+=(const char* str)
+const CTextW& CTextW::operator=(const char* str)
 {
-    AutoFit();
+    Clear();
 
     if (str)
-    {
-        unsigned len = strlen(str);
-        if (len)
-        {
-            _buf.pop_back();
+        appendConverted(str);
 
-            unsigned size = _buf.size();
-            _buf.resize(size + len + 1, L'\0');
-
-            size_t cnt;
-            mbstowcs_s(&cnt, &_buf[size], len + 1, str, _TRUNCATE);
-        }
-    }
+    return *this;
 }
 
 
 /**
  *  \brief
  */
-void CTextW::operator+=(wchar_t letter)
+void CTextW::operator+=(const CTextW& txt)
 {
     AutoFit();
-
-    _buf.pop_back();
-    _buf.push_back(letter);
-    _buf.push_back(L'\0');
+    append(txt.C_str(), txt.Len());
 }
 
 
 /**
  *  \brief
  */
-void CTextW::Append(const wchar_t* data, unsigned len)
+void CTextW::operator+=(const wchar_t* str)
 {
-    AutoFit();
-
-    if (data && len)
+    if (str)
     {
-        _buf.pop_back();
-        _buf.insert(_buf.cend(), data, data + len);
-        _buf.push_back(L'\0');
+        AutoFit();
+        append(str, wcslen(str));
     }
 }
 
@@ -187,90 +173,82 @@ void CTextW::Append(const wchar_t* data, unsigned len)
 /**
  *  \brief
  */
-void CTextW::Insert(unsigned at_pos, wchar_t letter)
+void CTextW::operator+=(const char* str)
 {
-    AutoFit();
-
-    if (at_pos < _buf.size())
-        _buf.insert(_buf.cbegin() + at_pos, letter);
+    if (str)
+    {
+        AutoFit();
+        appendConverted(str);
+    }
 }
 
 
 /**
  *  \brief
  */
-void CTextW::Insert(unsigned at_pos, const wchar_t* data, unsigned len)
+void CTextW::operator+=(wchar_t letter)
 {
     AutoFit();
-
-    if ((at_pos < _buf.size()) && data && len)
-        _buf.insert(_buf.cbegin() + at_pos, data, data + len);
+    append(&letter, 1);
 }
 
 
 /**
- *  \brief
+ *  \brief  Converts UTF-8 text. The length must be valid (AutoFit-ed). The pure ASCII start is
+ *          just widened, text that is not valid UTF-8 (gtags paths) is taken as ANSI
  */
-void CTextW::Clear()
+void CTextW::appendConverted(const char* str)
 {
-    _buf.clear();
-    _buf.push_back(L'\0');
-    _invalidStrLen = false;
-}
+    unsigned len = strlen(str);
+    if (!len)
+        return;
 
+    // Neither UTF-8 nor ANSI text gives more wide chars than bytes
+    reserve(_len + len);
 
-/**
- *  \brief
- */
-void CTextW::Resize(unsigned size)
-{
-    _buf.resize(size);
-    _buf.push_back(L'\0');
-    _invalidStrLen = true;
-}
+    wchar_t* dst = _data + _len;
+    unsigned ascii = asciiLen(str, len);
 
+    for (unsigned i = 0; i < ascii; ++i)
+        dst[i] = str[i];
 
-/**
- *  \brief
- */
-CTextA::CTextA(const char* str) : _invalidStrLen(false)
-{
-    if (str)
-        _buf.assign(str, str + strlen(str) + 1);
-    else
-        _buf.push_back('\0');
+    unsigned cnt = ascii;
+
+    if (ascii < len)
+    {
+        int room = _capacity - _len - ascii - 1;
+        int converted = MultiByteToWideChar(CP_UTF8, MB_ERR_INVALID_CHARS,
+                str + ascii, len - ascii, dst + ascii, room);
+        if (converted <= 0)
+            converted = MultiByteToWideChar(CP_ACP, 0, str + ascii, len - ascii, dst + ascii, room);
+        if (converted > 0)
+            cnt += converted;
+    }
+
+    _len += cnt;
+    _data[_len] = 0;
+
+    countConversion(len, ascii);
 }
 
 
 /**
  *  \brief
  */
-CTextA::CTextA(const wchar_t* str) : _invalidStrLen(false)
+CTextA::CTextA(const char* str)
 {
     if (str)
-    {
-        _buf.resize(wcslen(str) + 1, '\0');
-        size_t cnt;
-        wcstombs_s(&cnt, _buf.data(), _buf.size(), str, _TRUNCATE);
-    }
-    else
-    {
-        _buf.push_back('\0');
-    }
+        assign(str, strlen(str));
 }
 
 
 /**
  *  \brief
  */
-const CTextA& CTextA::operator=(const CTextA& txt)
+CTextA::CTextA(const wchar_t* str)
 {
-    if (this != &txt)
-    {
-        _buf = txt._buf;
-        _invalidStrLen = txt._invalidStrLen;
-    }
-    return *this;
+    if (str)
+        appendConverted(str);
 }
 
 
@@ -280,10 +258,10 @@ const CTextA& CTextA::operator=(const CTextA& txt)
 const CTextA& CTextA::operator=(const char* str)
 {
     if (str)
-    {
-        _buf.assign(str, str + strlen(str) + 1);
-        _invalidStrLen = false;
-    }
+        assign(str, strlen(str));
+    else
+        Clear();
+
     return *this;
 }
 
@@ -293,13 +271,10 @@ const CTextA& CTextA::operator=(const char* str)
  */
 const CTextA& CTextA::operator=(const wchar_t* str)
 {
+    Clear();
+
     if (str)
-    {
-        _buf.resize(wcslen(str) + 1, '\0');
-        size_t cnt;
-        wcstombs_s(&cnt, _buf.data(), _buf.size(), str, _TRUNCATE);
-        _invalidStrLen = false;
-    }
+        appendConverted(str);
 
     return *this;
 }
@@ -311,9 +286,7 @@ const CTextA& CTextA::operator=(const wchar_t* str)
 void CTextA::operator+=(const CTextA& txt)
 {
     AutoFit();
-
-    _buf.pop_back();
-    _buf.insert(_buf.cend(), txt._buf.begin(), txt._buf.begin() + txt.Len() + 1);
+    append(txt.C_str(), txt.Len());
 }
 
 
@@ -322,16 +295,10 @@ void CTextA::operator+=(const CTextA& txt)
  */
 void CTextA::operator+=(const char* str)
 {
-    AutoFit();
-
     if (str)
     {
-        unsigned len = strlen(str);
-        if (len)
-        {
-            _buf.pop_back();
-            _buf.insert(_buf.cend(), str, str + len + 1);
-        }
+        AutoFit();
+        append(str, strlen(str));
     }
 }
 
@@ -341,21 +308,10 @@ void CTextA::operator+=(const char* str)
  */
 void CTextA::operator+=(const wchar_t* str)
 {
-    AutoFit();
-
     if (str)
     {
-        unsigned len = wcslen(str);
-        if (len)
-        {
-            _buf.pop_back();
-
-            unsigned size = _buf.size();
-            _buf.resize(size + len + 1, '\0');
-
-            size_t cnt;
-            wcstombs_s(&cnt, &_buf[size], len + 1, str, _TRUNCATE);
-        }
+        AutoFit();
+        appendConverted(str);
     }
 }
 
@@ -366,72 +322,44 @@ void CTextA::operator+=(const wchar_t* str)
 void CTextA::operator+=(char letter)
 {
     AutoFit();
-
-    _buf.pop_back();
-    _buf.push_back(letter);
-    _buf.push_back('\0');
-}
-
-
-/**
- *  \brief
- */
-void CTextA::Append(const char* data, unsigned len)
-{
-    AutoFit();
-
-    if (data && len)
-    {
-        _buf.pop_back();
-        _buf.insert(_buf.cend(), data, data + len);
-        _buf.push_back('\0');
-    }
+    append(&letter, 1);
 }
 
 
 /**
- *  \brief
+ *  \brief  Converts to UTF-8. The length must be valid (AutoFit-ed). The pure ASCII start is
+ *          just narrowed
  */
-void CTextA::Insert(unsigned at_pos, char letter)
+void CTextA::appendConverted(const wchar_t* str)
 {
-    AutoFit();
+    unsigned len = wcslen(str);
+    if (!len)
+        return;
 
-    if (at_pos < _buf.size())
-        _buf.insert(_buf.cbegin() + at_pos, letter);
-}
+    unsigned ascii = asciiLen(str, len);
 
+    // A wide char takes up to 3 bytes in UTF-8
+    reserve(_len + ascii + (len - ascii) * 3);
 
-/**
- *  \brief
- */
-void CTextA::Insert(unsigned at_pos, const char* data, unsigned len)
-{
-    AutoFit();
+    char* dst = _data + _len;
 
-    if ((at_pos < _buf.size()) && data && len)
-        _buf.insert(_buf.cbegin() + at_pos, data, data + len);
-}
+    for (unsigned i = 0; i < ascii; ++i)
+        dst[i] = (char)str[i];
 
+    unsigned cnt = ascii;
 
-/**
- *  \brief
- */
-void CTextA::Clear()
-{
-    _buf.clear();
-    _buf.push_back('\0');
-    _invalidStrLen = false;
-}
+    if (ascii < len)
+    {
+        int converted = WideCharToMultiByte(CP_UTF8, 0, str + ascii, len - ascii,
+                dst + ascii, _capacity - _len - ascii - 1, NULL, NULL);
+        if (converted > 0)
+            cnt += converted;
+    }
 
+    _len += cnt;
+    _data[_len] = 0;
 
-/**
- *  \brief
- */
-void CTextA::Resize(unsigned size)
-{
-    _buf.resize(size);
-    _buf.push_back('\0');
-    _invalidStrLen = true;
+    countConversion(len, ascii);
 }
 
 
@@ -445,11 +373,11 @@ unsigned CPath::StripFilename()
     unsigned len = Len();
 
     for (; len > 0; --len)
-        if (_buf[len - 1] == _T('\\') || _buf[len - 1] == _T('/'))
+        if (_data[len - 1] == _T('\\') || _data[len - 1] == _T('/'))
             break;
 
-    _buf.erase(_buf.begin() + len, _buf.end());
-    _buf.push_back(_T('\0'));
+    _data[len] = 0;
+    _len = len;
 
     return len;
 }
@@ -463,15 +391,15 @@ unsigned CPath::DirUp()
     AutoFit();
 
     unsigned len = Len();
-    if (_buf[len - 1] == _T('\\') || _buf[len - 1] == _T('/'))
+    if (_data[len - 1] == _T('\\') || _data[len - 1] == _T('/'))
         --len;
 
     for (; len > 0; --len)
-        if (_buf[len - 1] == _T('\\') || _buf[len - 1] == _T('/'))
+        if (_data[len - 1] == _T('\\') || _data[len - 1] == _T('/'))
             break;
 
-    _buf.erase(_buf.begin() + len, _buf.end());
-    _buf.push_back(_T('\0'));
+    _data[len] = 0;
+    _len = len;
 
     return len;
 }
@@ -485,13 +413,10 @@ const TCHAR* CPath::GetFilename() const
     unsigned len = Len();
 
     for (; len > 0; --len)
-        if (_buf[len - 1] == _T('\\') || _buf[len - 1] == _T('/'))
-        {
-            ++len;
+        if (_data[len - 1] == _T('\\') || _data[len - 1] == _T('/'))
             break;
-        }
 
-    return &_buf[len];
+    return &_data[len];
 }
 
 
@@ -504,7 +429,7 @@ bool CPath::IsParentOf(const CPath& path) const
     if (len >= path.Len())
         return false;
 
-    return !_tcsncmp(_buf.data(), path._buf.data(), len);
+    return !_tcsncmp(_data, path.C_str(), len);
 }
 
 
@@ -517,7 +442,7 @@ bool CPath::IsParentOf(const TCHAR* pathStr) const
     if (len >= _tcslen(pathStr))
         return false;
 
-    return !_tcsncmp(_buf.data(), pathStr, len);
+    return !_tcsncmp(_data, pathStr, len);
 }
 
 
@@ -530,7 +455,7 @@ bool CPath::IsSubpathOf(const CPath& path) const
     if (len >= Len())
         return false;
 
-    return !_tcsncmp(_buf.data(), path._buf.data(), len);
+    return !_tcsncmp(_data, path.C_str(), len);
 }
 
 
@@ -543,7 +468,24 @@ bool CPath::IsSubpathOf(const TCHAR* pathStr) const
     if (len >= Len())
         return false;
 
-    return !_tcsncmp(_buf.data(), pathStr, len);
+    return !_tcsncmp(_data, pathStr, len);
+}
+
+
+/**
+ *  \brief  FNV-1a over the lower-cased path
+ */
+size_t CPathHash::operator()(const CPath& path) const
+{
+    size_t hash = 2166136261U;
+
+    for (const TCHAR* c = path.C_str(); *c; ++c)
+    {
+        hash ^= (size_t)_totlower(*c);
+        hash *= 16777619U;
+    }
+
+    return hash;
 }
 
 
@@ -30,6 +30,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <vector>
+#include <utility>
 
 
 #ifdef UNICODE
@@ -76,125 +77,320 @@ inline void MsgNum(int num, int radix = 10)
 } // namespace Tools
 
 
+// Heap allocations made by all text buffers
+extern volatile LONG TextHeapAllocs;
+
+// UTF-8 <-> wide text conversions, chars converted and chars that took the ASCII fast path
+extern volatile LONG TextConversions;
+extern volatile LONG TextConvertedChars;
+extern volatile LONG TextAsciiChars;
+
+
+inline unsigned textLen(const char* str) { return strlen(str); }
+inline unsigned textLen(const wchar_t* str) { return wcslen(str); }
+inline int textCmp(const char* str1, const char* str2) { return strcmp(str1, str2); }
+inline int textCmp(const wchar_t* str1, const wchar_t* str2) { return wcscmp(str1, str2); }
+
+
 /**
- *  \class  CTextW
- *  \brief
+ *  \class  CTextBuf
+ *  \brief  NUL terminated text buffer. Short texts are kept in the object itself, longer ones on the heap
+ *          growing by half the capacity so appending is amortized. The length is cached unless the buffer
+ *          was written directly through C_str() (Resize() or size constructor)
  */
-class CTextW
+template <typename C>
+class CTextBuf
 {
+public:
+    inline void AutoFit()
+    {
+        if (_invalidStrLen)
+        {
+            _len = textLen(_data);
+            _invalidStrLen = false;
+        }
+    }
+
+    inline bool operator==(const CTextBuf& txt) const
+    {
+        unsigned len = Len();
+        return (len == txt.Len() && !memcmp(_data, txt._data, len * sizeof(C)));
+    }
+
+    inline bool operator==(const C* str) const { return !textCmp(_data, str); }
+
+    void Append(const C* data, unsigned len)
+    {
+        AutoFit();
+
+        if (data && len)
+            append(data, len);
+    }
+
+    void Insert(unsigned at_pos, C letter)
+    {
+        Insert(at_pos, &letter, 1);
+    }
+
+    void Insert(unsigned at_pos, const C* data, unsigned len)
+    {
+        AutoFit();
+
+        if (at_pos > _len || !data || !len)
+            return;
+
+        if (isOwn(data))
+        {
+            std::vector<C> copy(data, data + len);
+            Insert(at_pos, copy.data(), len);
+            return;
+        }
+
+        reserve(_len + len);
+        memmove(_data + at_pos + len, _data + at_pos, (_len - at_pos + 1) * sizeof(C));
+        memcpy(_data + at_pos, data, len * sizeof(C));
+        _len += len;
+    }
+
+    void Clear()
+    {
+        _data[0] = 0;
+        _len = 0;
+        _invalidStrLen = false;
+    }
+
+    void Resize(unsigned size)
+    {
+        unsigned len = Len();
+
+        reserve(size);
+        for (; len < size; ++len)
+            _data[len] = 0;
+        _data[size] = 0;
+
+        _len = size;
+        _invalidStrLen = true;
+    }
+
+    inline unsigned Len() const { return (_invalidStrLen) ? textLen(_data) : _len; }
+    inline bool IsEmpty() const { return (Len() == 0); }
+    inline const C* C_str() const { return _data; }
+    inline C* C_str() { return _data; }
+    // Chars that can be written through C_str() including the terminating NUL
+    inline unsigned Size() const { return _capacity; }
+
 protected:
-    std::vector<wchar_t>    _buf;
-    bool                    _invalidStrLen;
+    static const unsigned cSmallSize = 32;
 
-public:
-    CTextW() : _invalidStrLen(false) { _buf.push_back(L'\0'); }
-    CTextW(unsigned size) : _invalidStrLen(true) { _buf.resize(size + 1, L'\0'); }
+    CTextBuf() : _data(_small), _len(0), _capacity(cSmallSize), _invalidStrLen(false)
+    {
+        _small[0] = 0;
+    }
 
-    CTextW(const wchar_t* str);
-    CTextW(const char* str);
+    CTextBuf(unsigned size) : _data(_small), _len(0), _capacity(cSmallSize), _invalidStrLen(true)
+    {
+        reserve(size);
+        memset(_data, 0, (size + 1) * sizeof(C));
+    }
 
-    CTextW(const CTextW& txt) : _buf(txt._buf), _invalidStrLen(txt._invalidStrLen) {}
+    CTextBuf(const CTextBuf& txt) : _data(_small), _len(0), _capacity(cSmallSize), _invalidStrLen(false)
+    {
+        assign(txt._data, txt.Len());
+    }
 
-    ~CTextW() {}
+    CTextBuf(CTextBuf&& txt) : _data(_small), _len(0), _capacity(cSmallSize), _invalidStrLen(false)
+    {
+        take(txt);
+    }
 
-    inline void AutoFit()
+    ~CTextBuf()
     {
-        if (_invalidStrLen)
+        if (_data != _small)
+            delete [] _data;
+    }
+
+    void copyFrom(const CTextBuf& txt)
+    {
+        if (this != &txt)
+            assign(txt._data, txt.Len());
+    }
+
+    void moveFrom(CTextBuf& txt)
+    {
+        if (this != &txt)
         {
-            _buf.resize(wcslen(_buf.data()) + 1);
-            _invalidStrLen = false;
+            if (_data != _small)
+                delete [] _data;
+            take(txt);
+        }
+    }
+
+    inline bool isOwn(const C* data) const
+    {
+        return (data >= _data && data < _data + _capacity);
+    }
+
+    void assign(const C* data, unsigned len)
+    {
+        // Own text is never longer than the buffer - no reallocation
+        reserve(len);
+        memmove(_data, data, len * sizeof(C));
+        _data[len] = 0;
+
+        _len = len;
+        _invalidStrLen = false;
+    }
+
+    /**
+     *  \brief  The length must be valid (AutoFit-ed)
+     */
+    void append(const C* data, unsigned len)
+    {
+        if (isOwn(data) && _len + len >= _capacity)
+        {
+            std::vector<C> copy(data, data + len);
+            append(copy.data(), len);
+            return;
+        }
+
+        reserve(_len + len);
+        memmove(_data + _len, data, len * sizeof(C));
+        _len += len;
+        _data[_len] = 0;
+    }
+
+    /**
+     *  \brief  Makes room for len chars + NUL
+     */
+    void reserve(unsigned len)
+    {
+        if (len < _capacity)
+            return;
+
+        unsigned capacity = _capacity + _capacity / 2;
+        if (capacity < len + 1)
+            capacity = len + 1;
+
+        C* data = new C[capacity];
+
+        // The whole buffer - the length may be unknown
+        memcpy(data, _data, _capacity * sizeof(C));
+
+        if (_data != _small)
+            delete [] _data;
+
+        _data = data;
+        _capacity = capacity;
+
+        InterlockedIncrement(&TextHeapAllocs);
+    }
+
+    C*          _data;
+    unsigned    _len;
+    unsigned    _capacity;
+    bool        _invalidStrLen;
+
+private:
+    void take(CTextBuf& txt)
+    {
+        _len = txt._len;
+        _invalidStrLen = txt._invalidStrLen;
+
+        if (txt._data == txt._small)
+        {
+            memcpy(_small, txt._small, sizeof(_small));
+            _data = _small;
+            _capacity = cSmallSize;
         }
+        else
+        {
+            _data = txt._data;
+            _capacity = txt._capacity;
+
+            txt._data = txt._small;
+            txt._capacity = cSmallSize;
+        }
+
+        txt._small[0] = 0;
+        txt._len = 0;
+        txt._invalidStrLen = false;
     }
 
-    const CTextW& operator=(const CTextW& txt);
+    C           _small[cSmallSize];
+};
+
+
+/**
+ *  \class  CTextW
+ *  \brief  Wide text, char text is converted from UTF-8
+ */
+class CTextW : public CTextBuf<wchar_t>
+{
+public:
+    CTextW() {}
+    CTextW(unsigned size) : CTextBuf<wchar_t>(size) {}
+
+    CTextW(const wchar_t* str);
+    CTextW(const char* str);
+
+    CTextW(const CTextW& txt) : CTextBuf<wchar_t>(txt) {}
+    CTextW(CTextW&& txt) : CTextBuf<wchar_t>(std::move(txt)) {}
+
+    ~CTextW() {}
+
+    const CTextW& operator=(const CTextW& txt) { copyFrom(txt); return *this; }
+    const CTextW& operator=(CTextW&& txt) { moveFrom(txt); return *this; }
     const CTextW& operator=(const wchar_t* str);
     const CTextW& operator=(const char* str);
 
-    inline bool operator==(const CTextW& txt) const { return (_buf == txt._buf); }
-    inline bool operator==(const wchar_t* str) const { return !wcscmp(_buf.data(), str); }
-
     void operator+=(const CTextW& txt);
     void operator+=(const wchar_t* str);
     void operator+=(const char* str);
     void operator+=(wchar_t letter);
 
-    void Append(const wchar_t* data, unsigned len);
-    void Insert(unsigned at_pos, wchar_t letter);
-    void Insert(unsigned at_pos, const wchar_t* data, unsigned len);
-
-    void Clear();
-    void Resize(unsigned size);
-
-    inline unsigned Len() const { return (_invalidStrLen) ? wcslen(_buf.data()) : (_buf.size() - 1); }
-    inline bool IsEmpty() const { return (Len() == 0); }
-    inline const wchar_t* C_str() const { return _buf.data(); }
-    inline wchar_t* C_str() { return _buf.data(); }
-    inline unsigned Size() const { return _buf.size(); }
-
 #ifdef DEVELOPMENT
     inline void Print() { Tools::MsgW(C_str()); }
 #endif
+
+private:
+    void appendConverted(const char* str);
 };
 
 
 /**
  *  \class  CTextA
- *  \brief
+ *  \brief  UTF-8 text, wide text is converted to UTF-8
  */
-class CTextA
+class CTextA : public CTextBuf<char>
 {
-protected:
-    std::vector<char>   _buf;
-    bool                _invalidStrLen;
-
 public:
-    CTextA() : _invalidStrLen(false) { _buf.push_back('\0'); }
-    CTextA(unsigned size) : _invalidStrLen(true) { _buf.resize(size + 1, '\0'); }
+    CTextA() {}
+    CTextA(unsigned size) : CTextBuf<char>(size) {}
 
     CTextA(const char* str);
     CTextA(const wchar_t* str);
 
-    CTextA(const CTextA& txt) : _buf(txt._buf), _invalidStrLen(txt._invalidStrLen) {}
+    CTextA(const CTextA& txt) : CTextBuf<char>(txt) {}
+    CTextA(CTextA&& txt) : CTextBuf<char>(std::move(txt)) {}
 
     ~CTextA() {}
 
-    inline void AutoFit()
-    {
-        if (_invalidStrLen)
-        {
-            _buf.resize(strlen(_buf.data()) + 1);
-            _invalidStrLen = false;
-        }
-    }
-
-    const CTextA& operator=(const CTextA& txt);
+    const CTextA& operator=(const CTextA& txt) { copyFrom(txt); return *this; }
+    const CTextA& operator=(CTextA&& txt) { moveFrom(txt); return *this; }
     const CTextA& operator=(const char* str);
     const CTextA& operator=(const wchar_t* str);
 
-    inline bool operator==(const CTextA& txt) const { return (_buf == txt._buf); }
-    inline bool operator==(const char* str) const { return !strcmp(_buf.data(), str); }
-
     void operator+=(const CTextA& txt);
     void operator+=(const char* str);
     void operator+=(const wchar_t* str);
     void operator+=(char letter);
 
-    void Append(const char* data, unsigned len);
-    void Insert(unsigned at_pos, char letter);
-    void Insert(unsigned at_pos, const char* data, unsigned len);
-
-    void Clear();
-    void Resize(unsigned size);
-
-    inline unsigned Len() const { return (_invalidStrLen) ? strlen(_buf.data()) : (_buf.size() - 1); }
-    inline bool IsEmpty() const { return (Len() == 0); }
-    inline const char* C_str() const { return _buf.data(); }
-    inline char* C_str() { return _buf.data(); }
-    inline unsigned Size() const { return _buf.size(); }
-
 #ifdef DEVELOPMENT
     inline void Print() { Tools::MsgA(C_str()); }
 #endif
+
+private:
+    void appendConverted(const wchar_t* str);
 };
 
 
@@ -207,11 +403,17 @@ class CPath : public CText
 public:
 	CPath() : CText() {}
     CPath(const CPath& path) : CText(static_cast<const CText&>(path)) {}
+    CPath(CPath&& path) : CText(std::move(static_cast<CText&>(path))) {}
 	CPath(const char* pathStr) : CText(pathStr) {}
 	CPath(const wchar_t* pathStr) : CText(pathStr) {}
     CPath(unsigned size) : CText(size) {}
     ~CPath() {}
 
+    const CPath& operator=(const CPath& path) { CText::operator=(path); return *this; }
+    const CPath& operator=(CPath&& path) { CText::operator=(std::move(static_cast<CText&>(path))); return *this; }
+    const CPath& operator=(const char* pathStr) { CText::operator=(pathStr); return *this; }
+    const CPath& operator=(const wchar_t* pathStr) { CText::operator=(pathStr); return *this; }
+
     inline bool Exists() const
     {
         DWORD dwAttrib = GetFileAttributes(C_str());
@@ -233,3 +435,26 @@ public:
     bool IsSubpathOf(const CPath& path) const;
     bool IsSubpathOf(const TCHAR* pathStr) const;
 };
+
+
+/**
+ *  \struct  CPathHash
+ *  \brief  Case-insensitive path hash for the hashed containers
+ */
+struct CPathHash
+{
+    size_t operator()(const CPath& path) const;
+};
+
+
+/**
+ *  \struct  CPathEqual
+ *  \brief  Case-insensitive path compare for the hashed containers
+ */
+struct CPathEqual
+{
+    bool operator()(const CPath& path1, const CPath& path2) const
+    {
+        return !_tcsicmp(path1.C_str(), path2.C_str());
+    }
+};
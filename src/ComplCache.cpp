@@ -0,0 +1,351 @@
+/**
+ *  \file
+ *  \brief  Completion results cache
+ *
+ *  \author  Pavel Nedev <pg.nedev@gmail.com>
+ *
+ *  \section COPYRIGHT
+ *  Copyright(C) 2015 Pavel Nedev
+ *
+ *  \section LICENSE
+ *  This program is free software; you can redistribute it and/or modify it
+ *  under the terms of the GNU General Public License version 2 as published
+ *  by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful, but
+ *  WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ *  or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ *  for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+#include <windows.h>
+#include <tchar.h>
+#include <algorithm>
+#include "GTags.h"
+#include "ComplCache.h"
+
+
+namespace GTags
+{
+
+const unsigned ComplCache::cMaxItems = 16;
+
+
+ComplCache ComplCache::Instance;
+
+
+/**
+ *  \brief
+ */
+ComplCache::Entry::Entry(CmdId_t cmdId, const char* result) : _data(result)
+{
+    if (!result)
+        return;
+
+    TCHAR* pTmp = NULL;
+    for (TCHAR* pToken = _tcstok_s(_data.C_str(), _T("\n\r"), &pTmp); pToken;
+            pToken = _tcstok_s(NULL, _T("\n\r"), &pTmp))
+    {
+        if (cmdId == AUTOCOMPLETE_FILE)
+            ++pToken;
+        _exact.push_back(pToken);
+    }
+
+    // Keep the list sorted both ways so narrowing by prefix is a range lookup
+    std::sort(_exact.begin(), _exact.end(), exactLess);
+    _exact.erase(std::unique(_exact.begin(), _exact.end(), exactEqual), _exact.end());
+
+    _folded = _exact;
+    std::stable_sort(_folded.begin(), _folded.end(), foldedLess);
+}
+
+
+/**
+ *  \brief  Finds the sorted candidates that start with prefix. Returns their count
+ */
+unsigned ComplCache::Entry::Narrow(const TCHAR* prefix, bool matchCase, unsigned& first) const
+{
+    const std::vector<const TCHAR*>& sorted = matchCase ? _exact : _folded;
+    int (*pCompare)(const TCHAR*, const TCHAR*, size_t) = matchCase ? &_tcsncmp : &_tcsnicmp;
+    const size_t len = _tcslen(prefix);
+
+    unsigned lo = 0, hi = sorted.size();
+    while (lo < hi)
+    {
+        unsigned mid = (lo + hi) / 2;
+        if (pCompare(sorted[mid], prefix, len) < 0)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    first = lo;
+
+    for (hi = sorted.size(); lo < hi;)
+    {
+        unsigned mid = (lo + hi) / 2;
+        if (pCompare(sorted[mid], prefix, len) <= 0)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    return lo - first;
+}
+
+
+/**
+ *  \brief
+ */
+bool ComplCache::Entry::exactLess(const TCHAR* lhs, const TCHAR* rhs)
+{
+    return (_tcscmp(lhs, rhs) < 0);
+}
+
+
+/**
+ *  \brief
+ */
+bool ComplCache::Entry::foldedLess(const TCHAR* lhs, const TCHAR* rhs)
+{
+    return (_tcsicmp(lhs, rhs) < 0);
+}
+
+
+/**
+ *  \brief
+ */
+bool ComplCache::Entry::exactEqual(const TCHAR* lhs, const TCHAR* rhs)
+{
+    return !_tcscmp(lhs, rhs);
+}
+
+
+/**
+ *  \brief  Returns the cached completion list that covers the given prefix or empty pointer
+ *          if there is no such list. The list is case-insensitive superset so it needs filtering
+ */
+ComplCache::EntryPtr ComplCache::Find(const CPath& dbPath, CmdId_t cmdId, const TCHAR* prefix)
+{
+    if (!prefix || !*prefix)
+        return EntryPtr();
+
+    CText key(prefix);
+    foldCase(key);
+
+    AUTOLOCK(_lock);
+
+    std::list<Item>::iterator iItem = findItem(dbPath, cmdId, key);
+    if (iItem == _items.end())
+        return EntryPtr();
+
+    // Keep most recently used items in front
+    _items.splice(_items.begin(), _items, iItem);
+
+    return iItem->_entry;
+}
+
+
+/**
+ *  \brief  Starts background completion for the given prefix unless there is already cached
+ *          or running one that covers it. Returns true if hNotify will receive notifyMsg
+ *          when the completion is ready
+ */
+bool ComplCache::Prefetch(DbHandle db, CmdId_t cmdId, const TCHAR* prefix, HWND hNotify, UINT notifyMsg)
+{
+    if (!db || !prefix || !*prefix)
+        return false;
+
+    CText key(prefix);
+    foldCase(key);
+
+    {
+        AUTOLOCK(_lock);
+
+        if (findItem(*db, cmdId, key) != _items.end())
+            return false;
+
+        for (std::list<Request>::iterator iReq = _requests.begin(); iReq != _requests.end(); ++iReq)
+        {
+            if (iReq->_cmdId == cmdId && iReq->_dbPath == *db && isCovering(iReq->_key, key))
+            {
+                if (hNotify)
+                {
+                    iReq->_hNotify = hNotify;
+                    iReq->_notifyMsg = notifyMsg;
+                }
+                return (hNotify != NULL);
+            }
+        }
+    }
+
+    bool success;
+    db = DbManager::Get().GetDb(*db, false, &success);
+    if (!db || !success)
+        return false;
+
+    CText tag;
+    if (cmdId == AUTOCOMPLETE_FILE)
+        tag = _T("/");
+    tag += key;
+
+    // Fetch case-insensitive results to be able to narrow them later regardless of the match case setting
+    std::shared_ptr<Cmd> cmd(new Cmd(cmdId, _T("AutoComplete"), db, tag.C_str(), false, false));
+    cmd->Silent(true);
+
+    {
+        AUTOLOCK(_lock);
+
+        Request req;
+        req._cmd        = cmd.get();
+        req._dbPath     = *db;
+        req._cmdId      = cmdId;
+        req._key        = key;
+        req._generation = _generation;
+        req._hNotify    = hNotify;
+        req._notifyMsg  = notifyMsg;
+
+        _requests.push_back(req);
+    }
+
+    CmdEngine::Run(cmd, prefetchReady);
+
+    return (hNotify != NULL);
+}
+
+
+/**
+ *  \brief  Drops all cached lists for the given database - to be called when the DB has changed
+ */
+void ComplCache::Invalidate(const CPath& dbPath)
+{
+    AUTOLOCK(_lock);
+
+    // Results of the still running requests are outdated as well
+    ++_generation;
+
+    for (std::list<Item>::iterator iItem = _items.begin(); iItem != _items.end();)
+    {
+        if (iItem->_dbPath == dbPath)
+            iItem = _items.erase(iItem);
+        else
+            ++iItem;
+    }
+}
+
+
+/**
+ *  \brief
+ */
+void ComplCache::prefetchReady(const std::shared_ptr<Cmd>& cmd)
+{
+    // Symbols completion follows the definitions one
+    if (cmd->Id() == AUTOCOMPLETE && cmd->Status() == OK)
+    {
+        cmd->Id(AUTOCOMPLETE_SYMBOL);
+        CmdEngine::Run(cmd, prefetchReady);
+        return;
+    }
+
+    DbManager::Get().PutDb(cmd->Db());
+
+    RunSheduledUpdate(cmd->DbPath());
+
+    Instance.store(cmd);
+}
+
+
+/**
+ *  \brief
+ */
+void ComplCache::foldCase(CText& txt)
+{
+    TCHAR* pTxt = txt.C_str();
+
+    for (unsigned i = txt.Len(); i; --i, ++pTxt)
+        *pTxt = _totlower(*pTxt);
+}
+
+
+/**
+ *  \brief
+ */
+bool ComplCache::isCovering(const CText& key, const CText& foldedPrefix)
+{
+    return (key.Len() <= foldedPrefix.Len() && !_tcsncmp(key.C_str(), foldedPrefix.C_str(), key.Len()));
+}
+
+
+/**
+ *  \brief  Finds the most narrow cached list covering the key. Must be called under lock
+ */
+std::list<ComplCache::Item>::iterator ComplCache::findItem(const CPath& dbPath, CmdId_t cmdId, const CText& key)
+{
+    std::list<Item>::iterator iFound = _items.end();
+
+    for (std::list<Item>::iterator iItem = _items.begin(); iItem != _items.end(); ++iItem)
+    {
+        if (iItem->_cmdId == cmdId && iItem->_dbPath == dbPath && isCovering(iItem->_key, key))
+        {
+            if (iFound == _items.end() || iFound->_key.Len() < iItem->_key.Len())
+                iFound = iItem;
+        }
+    }
+
+    return iFound;
+}
+
+
+/**
+ *  \brief
+ */
+void ComplCache::store(const std::shared_ptr<Cmd>& cmd)
+{
+    const CmdId_t cmdId = (cmd->Id() == AUTOCOMPLETE_FILE) ? AUTOCOMPLETE_FILE : AUTOCOMPLETE;
+
+    // Failed completion is cached as empty one to avoid re-running it on every key press
+    EntryPtr entry(new Entry(cmdId, (cmd->Status() == OK) ? cmd->Result() : NULL));
+
+    HWND hNotify = NULL;
+    UINT notifyMsg = 0;
+
+    {
+        AUTOLOCK(_lock);
+
+        std::list<Request>::iterator iReq;
+        for (iReq = _requests.begin(); iReq != _requests.end(); ++iReq)
+            if (iReq->_cmd == cmd.get())
+                break;
+
+        if (iReq == _requests.end())
+            return;
+
+        if (iReq->_generation == _generation)
+        {
+            Item item;
+            item._dbPath    = iReq->_dbPath;
+            item._cmdId     = iReq->_cmdId;
+            item._key       = iReq->_key;
+            item._entry     = entry;
+
+            _items.push_front(item);
+            if (_items.size() > cMaxItems)
+                _items.pop_back();
+        }
+
+        hNotify = iReq->_hNotify;
+        notifyMsg = iReq->_notifyMsg;
+
+        _requests.erase(iReq);
+    }
+
+    if (hNotify)
+        PostMessage(hNotify, notifyMsg, 0, 0);
+}
+
+} // namespace GTags
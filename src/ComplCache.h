@@ -0,0 +1,139 @@
+/**
+ *  \file
+ *  \brief  Completion results cache
+ *
+ *  \author  Pavel Nedev <pg.nedev@gmail.com>
+ *
+ *  \section COPYRIGHT
+ *  Copyright(C) 2015 Pavel Nedev
+ *
+ *  \section LICENSE
+ *  This program is free software; you can redistribute it and/or modify it
+ *  under the terms of the GNU General Public License version 2 as published
+ *  by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful, but
+ *  WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ *  or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ *  for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+#pragma once
+
+
+#include <windows.h>
+#include <tchar.h>
+#include <list>
+#include <memory>
+#include <vector>
+#include "Common.h"
+#include "AutoLock.h"
+#include "DbManager.h"
+#include "CmdEngine.h"
+
+
+namespace GTags
+{
+
+/**
+ *  \class  ComplCache
+ *  \brief  Keeps case-folded completion supersets per database and prefix
+ *          so that further typing is narrowed locally instead of re-running global
+ */
+class ComplCache
+{
+public:
+    /**
+     *  \class  Entry
+     *  \brief  Tokenized completion list - immutable once created
+     */
+    class Entry
+    {
+    public:
+        Entry(CmdId_t cmdId, const char* result);
+        ~Entry() {}
+
+        inline unsigned Size() const { return _exact.size(); }
+        inline const TCHAR* Sorted(bool matchCase, unsigned pos) const
+        {
+            return matchCase ? _exact[pos] : _folded[pos];
+        }
+
+        unsigned Narrow(const TCHAR* prefix, bool matchCase, unsigned& first) const;
+
+    private:
+        static bool exactLess(const TCHAR* lhs, const TCHAR* rhs);
+        static bool foldedLess(const TCHAR* lhs, const TCHAR* rhs);
+        static bool exactEqual(const TCHAR* lhs, const TCHAR* rhs);
+
+        Entry(const Entry&);
+        const Entry& operator=(const Entry&);
+
+        CText                       _data;
+        std::vector<const TCHAR*>   _exact;
+        std::vector<const TCHAR*>   _folded;
+    };
+
+    typedef std::shared_ptr<const Entry> EntryPtr;
+
+    static ComplCache& Get() { return Instance; }
+
+    EntryPtr Find(const CPath& dbPath, CmdId_t cmdId, const TCHAR* prefix);
+    bool Prefetch(DbHandle db, CmdId_t cmdId, const TCHAR* prefix, HWND hNotify = NULL, UINT notifyMsg = 0);
+    void Invalidate(const CPath& dbPath);
+
+private:
+    static const unsigned cMaxItems;
+
+    /**
+     *  \struct  Item
+     *  \brief
+     */
+    struct Item
+    {
+        CPath       _dbPath;
+        CmdId_t     _cmdId;
+        CText       _key;
+        EntryPtr    _entry;
+    };
+
+    /**
+     *  \struct  Request
+     *  \brief
+     */
+    struct Request
+    {
+        const Cmd*  _cmd;
+        CPath       _dbPath;
+        CmdId_t     _cmdId;
+        CText       _key;
+        unsigned    _generation;
+        HWND        _hNotify;
+        UINT        _notifyMsg;
+    };
+
+    static ComplCache Instance;
+
+    static void prefetchReady(const std::shared_ptr<Cmd>& cmd);
+    static void foldCase(CText& txt);
+    static bool isCovering(const CText& key, const CText& foldedPrefix);
+
+    ComplCache() : _generation(0) {}
+    ComplCache(const ComplCache&);
+    ~ComplCache() {}
+
+    std::list<Item>::iterator findItem(const CPath& dbPath, CmdId_t cmdId, const CText& key);
+    void store(const std::shared_ptr<Cmd>& cmd);
+
+    Mutex               _lock;
+    unsigned            _generation;
+    std::list<Item>     _items;
+    std::list<Request>  _requests;
+};
+
+} // namespace GTags
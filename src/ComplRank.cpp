@@ -0,0 +1,460 @@
+/**
+ *  \file
+ *  \brief  Completion candidates ranking
+ *
+ *  \author  Pavel Nedev <pg.nedev@gmail.com>
+ *
+ *  \section COPYRIGHT
+ *  Copyright(C) 2015 Pavel Nedev
+ *
+ *  \section LICENSE
+ *  This program is free software; you can redistribute it and/or modify it
+ *  under the terms of the GNU General Public License version 2 as published
+ *  by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful, but
+ *  WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ *  or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ *  for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+#include <windows.h>
+#include <tchar.h>
+#include <string.h>
+#include <algorithm>
+#include <utility>
+#include "GTags.h"
+#include "ComplRank.h"
+
+
+namespace
+{
+
+/**
+ *  \struct  NameLess
+ *  \brief  Orders the definition lines by name
+ */
+struct NameLess
+{
+    NameLess(const char* data) : _data(data) {}
+
+    bool operator()(const std::pair<unsigned, unsigned>& lhs, const std::pair<unsigned, unsigned>& rhs) const
+    {
+        return (strcmp(_data + lhs.first, _data + rhs.first) < 0);
+    }
+
+    const char* _data;
+};
+
+
+/**
+ *  \brief  Higher score first, then alphabetically
+ */
+bool scoreLess(const GTags::ComplRank::Candidate& lhs, const GTags::ComplRank::Candidate& rhs)
+{
+    if (lhs.first != rhs.first)
+        return (lhs.first > rhs.first);
+
+    return (_tcscmp(lhs.second, rhs.second) < 0);
+}
+
+} // anonymous namespace
+
+
+namespace GTags
+{
+
+const unsigned ComplRank::cMaxRecent = 32;
+const unsigned ComplRank::cMaxUpdatedFiles = 64;
+
+
+ComplRank ComplRank::Instance;
+
+
+/**
+ *  \brief  Takes the ownership of the definitions buffer (global ctags format output)
+ */
+ComplRank::Ranks::Ranks(std::vector<char>& defs)
+{
+    _data.swap(defs);
+
+    std::vector<std::pair<unsigned, unsigned>> lines;
+
+    for (unsigned i = 0; i < _data.size();)
+    {
+        const unsigned name = i;
+
+        for (; i < _data.size() && _data[i] != '\t' && _data[i] != '\n'; ++i);
+        if (i == _data.size() || _data[i] == '\n')
+        {
+            ++i;
+            continue;
+        }
+        _data[i++] = 0;
+
+        if (i + 1 < _data.size() && _data[i] == '.' && (_data[i + 1] == '/' || _data[i + 1] == '\\'))
+            i += 2;
+
+        const unsigned path = i;
+
+        for (; i < _data.size() && _data[i] != '\t' && _data[i] != '\n'; ++i)
+            if (_data[i] == '\\')
+                _data[i] = '/';
+        if (i < _data.size())
+            _data[i++] = 0;
+
+        for (; i < _data.size() && _data[i] != '\n'; ++i);
+        ++i;
+
+        lines.push_back(std::make_pair(name, path));
+    }
+
+    if (!_data.empty() && _data.back())
+        _data.push_back(0);
+
+    const char* data = _data.data();
+
+    std::stable_sort(lines.begin(), lines.end(), NameLess(data));
+
+    // Keep the first definition of each name
+    for (unsigned i = 0; i < lines.size(); ++i)
+    {
+        if (!_names.empty() && !strcmp(data + _names.back(), data + lines[i].first))
+            continue;
+
+        _names.push_back(lines[i].first);
+        _paths.push_back(lines[i].second);
+    }
+
+    _refs.resize(_names.size(), 0);
+}
+
+
+/**
+ *  \brief  Counts the references per name from global ctags format output
+ */
+void ComplRank::Ranks::CountRefs(const char* refs)
+{
+    while (*refs)
+    {
+        const char* nameEnd = strchr(refs, '\t');
+        if (!nameEnd)
+            break;
+
+        int idx = find(refs, nameEnd - refs);
+        if (idx >= 0)
+            ++_refs[idx];
+
+        refs = strchr(nameEnd, '\n');
+        if (!refs)
+            break;
+        ++refs;
+    }
+}
+
+
+/**
+ *  \brief  file is DB relative path with '/' separators
+ */
+int ComplRank::Ranks::Score(const char* name, const char* file) const
+{
+    int idx = find(name, strlen(name));
+    if (idx < 0)
+        return 0;
+
+    int proximity = 0;
+
+    // Count the common folders of the definition and the file
+    const char* path = _data.data() + _paths[idx];
+    for (; *path && *path == *file; ++path, ++file)
+        if (*path == '/')
+            ++proximity;
+
+    // Same file
+    if (*path == 0 && *file == 0)
+        ++proximity;
+
+    int refsWeight = 0;
+    for (unsigned refs = _refs[idx]; refs; refs >>= 1)
+        ++refsWeight;
+
+    return proximity * 4 + refsWeight;
+}
+
+
+/**
+ *  \brief
+ */
+int ComplRank::Ranks::find(const char* name, unsigned len) const
+{
+    const char* data = _data.data();
+
+    int lo = 0;
+    int hi = (int)_names.size() - 1;
+
+    while (lo <= hi)
+    {
+        int mid = (lo + hi) / 2;
+        const char* midName = data + _names[mid];
+
+        int r = strncmp(midName, name, len);
+        if (r == 0)
+            r = (midName[len] != 0);
+
+        if (r == 0)
+            return mid;
+        if (r < 0)
+            lo = mid + 1;
+        else
+            hi = mid - 1;
+    }
+
+    return -1;
+}
+
+
+/**
+ *  \brief  Starts building the DB ranking data in background if it is missing or outdated
+ */
+void ComplRank::Prefetch(DbHandle db)
+{
+    if (!db)
+        return;
+
+    {
+        AUTOLOCK(_lock);
+
+        std::list<Item>::iterator iItem = findItem(*db);
+        if (iItem == _items.end())
+        {
+            Item item;
+            item._dbPath        = *db;
+            item._updatedFiles  = 0;
+            item._outdated      = true;
+            item._building      = false;
+
+            _items.push_back(item);
+            iItem = --_items.end();
+        }
+
+        if (!iItem->_outdated || iItem->_building)
+            return;
+
+        iItem->_updatedFiles    = 0;
+        iItem->_outdated        = false;
+        iItem->_building        = true;
+    }
+
+    bool success;
+    DbHandle lockedDb = DbManager::Get().GetDb(*db, false, &success);
+    if (!lockedDb || !success)
+    {
+        AUTOLOCK(_lock);
+
+        std::list<Item>::iterator iItem = findItem(*db);
+        if (iItem != _items.end())
+        {
+            iItem->_outdated = true;
+            iItem->_building = false;
+        }
+        return;
+    }
+
+    std::shared_ptr<Cmd> cmd(new Cmd(LIST_DEFINITIONS, _T("Rank Completion"), lockedDb, _T(".*"), true));
+    cmd->Silent(true);
+
+    CmdEngine::Run(cmd, buildReady);
+}
+
+
+/**
+ *  \brief  Marks the DB ranking data as outdated - it is still used until re-built
+ */
+void ComplRank::Invalidate(const CPath& dbPath)
+{
+    AUTOLOCK(_lock);
+
+    std::list<Item>::iterator iItem = findItem(dbPath);
+    if (iItem != _items.end())
+        iItem->_outdated = true;
+}
+
+
+/**
+ *  \brief  Counts the files updated in the DB. The ranks are re-built only once enough of them
+ *          have changed - a few files changes affect little the ranking of the whole DB
+ */
+void ComplRank::FilesUpdated(const CPath& dbPath, unsigned count)
+{
+    AUTOLOCK(_lock);
+
+    std::list<Item>::iterator iItem = findItem(dbPath);
+    if (iItem == _items.end())
+        return;
+
+    iItem->_updatedFiles += count;
+    if (iItem->_updatedFiles >= cMaxUpdatedFiles)
+        iItem->_outdated = true;
+}
+
+
+/**
+ *  \brief  Scores and orders the candidates - recently selected first, then by score, then alphabetically.
+ *          The first sortedCount candidates are already scored and ordered - the rest are sorted and merged in
+ */
+void ComplRank::Sort(const CPath& dbPath, const CPath& file, std::vector<Candidate>& candidates, unsigned sortedCount)
+{
+    CTextA relFile;
+    if (file.IsSubpathOf(dbPath))
+    {
+        relFile = file.C_str() + dbPath.Len();
+
+        char* pFile = relFile.C_str();
+        for (unsigned i = relFile.Len(); i; --i, ++pFile)
+            if (*pFile == '\\')
+                *pFile = '/';
+    }
+
+    {
+        AUTOLOCK(_lock);
+
+        RanksPtr ranks;
+
+        std::list<Item>::iterator iItem = findItem(dbPath);
+        if (iItem != _items.end())
+            ranks = iItem->_ranks;
+
+        for (unsigned i = sortedCount; i < candidates.size(); ++i)
+        {
+            int score = recentScore(candidates[i].second) << 16;
+
+            if (ranks)
+            {
+                CTextA name(candidates[i].second);
+                score += ranks->Score(name.C_str(), relFile.C_str());
+            }
+
+            candidates[i].first = score;
+        }
+    }
+
+    std::sort(candidates.begin() + sortedCount, candidates.end(), scoreLess);
+    std::inplace_merge(candidates.begin(), candidates.begin() + sortedCount, candidates.end(), scoreLess);
+}
+
+
+/**
+ *  \brief  Records the user selected completion for this session
+ */
+void ComplRank::Selected(const TCHAR* name)
+{
+    AUTOLOCK(_lock);
+
+    for (std::list<CText>::iterator iName = _recent.begin(); iName != _recent.end(); ++iName)
+    {
+        if (*iName == name)
+        {
+            _recent.splice(_recent.begin(), _recent, iName);
+            return;
+        }
+    }
+
+    _recent.push_front(CText(name));
+    if (_recent.size() > cMaxRecent)
+        _recent.pop_back();
+}
+
+
+/**
+ *  \brief  Counts the recently selected names starting with prefix
+ */
+unsigned ComplRank::RecentCount(const TCHAR* prefix)
+{
+    const unsigned len = _tcslen(prefix);
+    unsigned count = 0;
+
+    AUTOLOCK(_lock);
+
+    for (std::list<CText>::iterator iName = _recent.begin(); iName != _recent.end(); ++iName)
+        if (!_tcsncmp(iName->C_str(), prefix, len))
+            ++count;
+
+    return count;
+}
+
+
+/**
+ *  \brief
+ */
+void ComplRank::buildReady(const std::shared_ptr<Cmd>& cmd)
+{
+    RanksPtr ranks;
+
+    if (cmd->Status() == OK)
+    {
+        std::vector<char> defs;
+        if (cmd->Result())
+            defs.assign(cmd->Result(), cmd->Result() + cmd->ResultLen());
+
+        std::shared_ptr<Ranks> newRanks(new Ranks(defs));
+
+        std::shared_ptr<Cmd> refsCmd(new Cmd(LIST_REFERENCES, cmd->Name(), cmd->Db(), _T(".*"), true));
+        refsCmd->Silent(true);
+
+        // Parsers without references support fail here - rank then without references count
+        if (CmdEngine::Run(refsCmd) && refsCmd->Result())
+            newRanks->CountRefs(refsCmd->Result());
+
+        ranks = newRanks;
+    }
+
+    DbManager::Get().PutDb(cmd->Db());
+
+    RunSheduledUpdate(cmd->DbPath());
+
+    AUTOLOCK(Instance._lock);
+
+    std::list<Item>::iterator iItem = Instance.findItem(cmd->DbPath());
+    if (iItem != Instance._items.end())
+    {
+        iItem->_building = false;
+        if (ranks)
+            iItem->_ranks = ranks;
+    }
+}
+
+
+/**
+ *  \brief  Must be called under lock
+ */
+std::list<ComplRank::Item>::iterator ComplRank::findItem(const CPath& dbPath)
+{
+    std::list<Item>::iterator iItem;
+    for (iItem = _items.begin(); iItem != _items.end(); ++iItem)
+        if (iItem->_dbPath == dbPath)
+            break;
+
+    return iItem;
+}
+
+
+/**
+ *  \brief  Must be called under lock
+ */
+int ComplRank::recentScore(const TCHAR* name)
+{
+    int score = cMaxRecent;
+
+    for (std::list<CText>::iterator iName = _recent.begin(); iName != _recent.end(); ++iName, --score)
+        if (*iName == name)
+            return score;
+
+    return 0;
+}
+
+} // namespace GTags
@@ -0,0 +1,133 @@
+/**
+ *  \file
+ *  \brief  Completion candidates ranking
+ *
+ *  \author  Pavel Nedev <pg.nedev@gmail.com>
+ *
+ *  \section COPYRIGHT
+ *  Copyright(C) 2015 Pavel Nedev
+ *
+ *  \section LICENSE
+ *  This program is free software; you can redistribute it and/or modify it
+ *  under the terms of the GNU General Public License version 2 as published
+ *  by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful, but
+ *  WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ *  or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ *  for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+#pragma once
+
+
+#include <windows.h>
+#include <tchar.h>
+#include <list>
+#include <memory>
+#include <utility>
+#include <vector>
+#include "Common.h"
+#include "AutoLock.h"
+#include "DbManager.h"
+#include "CmdEngine.h"
+
+
+namespace GTags
+{
+
+/**
+ *  \class  ComplRank
+ *  \brief  Orders completion candidates by recent selection, definition proximity to the
+ *          current file and references count. Per DB ranking data is precomputed in background
+ */
+class ComplRank
+{
+public:
+    /**
+     *  \brief  Completion candidate and its score
+     */
+    typedef std::pair<int, TCHAR*> Candidate;
+
+    /**
+     *  \brief  Recently selected candidates are scored above all others
+     */
+    static inline bool IsRecent(const Candidate& candidate) { return ((candidate.first >> 16) != 0); }
+
+    static ComplRank& Get() { return Instance; }
+
+    void Prefetch(DbHandle db);
+    void Invalidate(const CPath& dbPath);
+    void FilesUpdated(const CPath& dbPath, unsigned count);
+
+    void Sort(const CPath& dbPath, const CPath& file, std::vector<Candidate>& candidates, unsigned sortedCount = 0);
+    void Selected(const TCHAR* name);
+    unsigned RecentCount(const TCHAR* prefix);
+
+private:
+    static const unsigned cMaxRecent;
+    static const unsigned cMaxUpdatedFiles;
+
+    /**
+     *  \class  Ranks
+     *  \brief  Compact per DB ranking arrays - immutable once built
+     */
+    class Ranks
+    {
+    public:
+        Ranks(std::vector<char>& defs);
+        ~Ranks() {}
+
+        void CountRefs(const char* refs);
+        int Score(const char* name, const char* file) const;
+
+    private:
+        Ranks(const Ranks&);
+        const Ranks& operator=(const Ranks&);
+
+        int find(const char* name, unsigned len) const;
+
+        std::vector<char>       _data;
+        std::vector<unsigned>   _names;
+        std::vector<unsigned>   _paths;
+        std::vector<unsigned>   _refs;
+    };
+
+    typedef std::shared_ptr<const Ranks> RanksPtr;
+
+    /**
+     *  \struct  Item
+     *  \brief
+     */
+    struct Item
+    {
+        CPath       _dbPath;
+        RanksPtr    _ranks;
+        // Files updated since the ranks were built
+        unsigned    _updatedFiles;
+        bool        _outdated;
+        bool        _building;
+    };
+
+    static ComplRank Instance;
+
+    static void buildReady(const std::shared_ptr<Cmd>& cmd);
+
+    ComplRank() {}
+    ComplRank(const ComplRank&);
+    ~ComplRank() {}
+
+    std::list<Item>::iterator findItem(const CPath& dbPath);
+    int recentScore(const TCHAR* name);
+
+    Mutex               _lock;
+    std::list<Item>     _items;
+    std::list<CText>    _recent;
+};
+
+} // namespace GTags
@@ -53,6 +53,7 @@ const TCHAR CConfig::cParserKey[]       = _T("Parser = ");
 const TCHAR CConfig::cAutoUpdateKey[]   = _T("AutoUpdate = ");
 const TCHAR CConfig::cUseLibraryKey[]   = _T("UseLibrary = ");
 const TCHAR CConfig::cLibraryPathKey[]  = _T("LibraryPath = ");
+const TCHAR CConfig::cExcludeListKey[]  = _T("ExcludeList = ");
 
 
 /**
@@ -86,6 +87,7 @@ void CConfig::SetDefaults()
     _autoUpdate = true;
     _useLibDb = false;
     _libDbPath.Clear();
+    _excludeList.Clear();
 }
 
 
@@ -148,6 +150,11 @@ bool CConfig::LoadFromFile(const TCHAR* file)
             unsigned pos = _countof(cLibraryPathKey) - 1;
             _libDbPath = &line[pos];
         }
+        else if (!_tcsncmp(line, cExcludeListKey, _countof(cExcludeListKey) - 1))
+        {
+            unsigned pos = _countof(cExcludeListKey) - 1;
+            _excludeList = &line[pos];
+        }
         else
         {
             SetDefaults();
@@ -182,6 +189,7 @@ bool CConfig::SaveToFile(const TCHAR* file) const
     if (_ftprintf_s(fp, _T("%s%s\n"), cAutoUpdateKey, (_autoUpdate ? _T("yes") : _T("no"))) > 0)
     if (_ftprintf_s(fp, _T("%s%s\n"), cUseLibraryKey, (_useLibDb ? _T("yes") : _T("no"))) > 0)
     if (_ftprintf_s(fp, _T("%s%s\n"), cLibraryPathKey, _libDbPath.C_str()) > 0)
+    if (_ftprintf_s(fp, _T("%s%s\n"), cExcludeListKey, _excludeList.C_str()) > 0)
         success = true;
 
     fclose(fp);
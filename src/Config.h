@@ -68,6 +68,7 @@ public:
     bool    _autoUpdate;
     bool    _useLibDb;
     CText   _libDbPath;
+    CText   _excludeList;
 
 private:
     static const TCHAR cDefaultParser[];
@@ -82,6 +83,7 @@ private:
     static const TCHAR cAutoUpdateKey[];
     static const TCHAR cUseLibraryKey[];
     static const TCHAR cLibraryPathKey[];
+    static const TCHAR cExcludeListKey[];
 };
 
 } // namespace GTags
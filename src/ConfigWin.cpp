@@ -180,7 +180,7 @@ HWND ConfigWin::composeWindow(HWND hOwner)
     DWORD styleEx   = WS_EX_OVERLAPPEDWINDOW | WS_EX_TOOLWINDOW;
     DWORD style     = WS_POPUP | WS_CAPTION | WS_SYSMENU;
 
-    RECT win = adjustSizeAndPos(hOwner, styleEx, style, 500, 5 * txtHeight + 120);
+    RECT win = adjustSizeAndPos(hOwner, styleEx, style, 500, 7 * txtHeight + 145);
     int width = win.right - win.left;
     int height = win.bottom - win.top;
 
@@ -248,6 +248,24 @@ HWND ConfigWin::composeWindow(HWND hOwner)
             win.left, win.top, win.right - win.left, win.bottom - win.top,
             _hWnd, NULL, HMod, NULL);
 
+    yPos += (win.bottom - win.top + 10);
+    hStatic = CreateWindowEx(0, _T("STATIC"), NULL,
+            WS_CHILD | WS_VISIBLE | BS_TEXT | SS_LEFT,
+            10, yPos, width - 20, txtHeight, _hWnd, NULL, HMod, NULL);
+
+    SetWindowText(hStatic, _T("Exclude from databases (';' separated .gitignore style patterns)"));
+
+    yPos += (txtHeight + 5);
+    win.top     = yPos;
+    win.bottom  = win.top + txtHeight;
+    win.left    = 10;
+    win.right   = width - 10;
+
+    AdjustWindowRectEx(&win, style, FALSE, styleEx);
+    _hExclude = CreateWindowEx(styleEx, RICHEDIT_CLASS, NULL, style,
+            win.left, win.top, win.right - win.left, win.bottom - win.top,
+            _hWnd, NULL, HMod, NULL);
+
     yPos += (win.bottom - win.top + 15);
     width = width / 5;
     _hOK = CreateWindowEx(0, _T("BUTTON"), _T("OK"),
@@ -268,13 +286,21 @@ HWND ConfigWin::composeWindow(HWND hOwner)
     _tcscpy_s(fmt.szFaceName, _countof(fmt.szFaceName), ncm.lfMessageFont.lfFaceName);
 
     SendMessage(_hLibDb, EM_SETCHARFORMAT, SCF_ALL, (LPARAM)&fmt);
+    SendMessage(_hExclude, EM_SETCHARFORMAT, SCF_ALL, (LPARAM)&fmt);
 
     _hFont = CreateFontIndirect(&ncm.lfMessageFont);
 
     if (_hFont)
+    {
         SendMessage(_hLibDb, WM_SETFONT, (WPARAM)_hFont, TRUE);
+        SendMessage(_hExclude, WM_SETFONT, (WPARAM)_hFont, TRUE);
+    }
 
     SendMessage(_hLibDb, EM_SETEVENTMASK, 0, 0);
+    SendMessage(_hExclude, EM_SETEVENTMASK, 0, 0);
+
+    if (!_cfg->_excludeList.IsEmpty())
+        Edit_SetText(_hExclude, _cfg->_excludeList.C_str());
 
     if (!_cfg->_libDbPath.IsEmpty())
         Edit_SetText(_hLibDb, _cfg->_libDbPath.C_str());
@@ -329,6 +355,17 @@ void ConfigWin::onOK()
         _cfg->_libDbPath.Clear();
     }
 
+    len = Edit_GetTextLength(_hExclude);
+    if (len)
+    {
+        _cfg->_excludeList.Resize(len);
+        Edit_GetText(_hExclude, _cfg->_excludeList.C_str(), _cfg->_excludeList.Size());
+    }
+    else
+    {
+        _cfg->_excludeList.Clear();
+    }
+
     _cfg->_autoUpdate   = (Button_GetCheck(_hAutoUpdate) == BST_CHECKED) ? true : false;
     _cfg->_useLibDb     = (Button_GetCheck(_hEnLibDb) == BST_CHECKED) ? true : false;
 
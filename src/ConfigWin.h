@@ -71,6 +71,7 @@ private:
     HWND        _hEnLibDb;
     HWND        _hCreateDb;
     HWND        _hLibDb;
+    HWND        _hExclude;
     HWND        _hOK;
     HWND        _hCancel;
     HHOOK       _hKeyHook;
@@ -24,11 +24,19 @@
 
 #include "DbManager.h"
 #include <windows.h>
+#include <vector>
 
 
 namespace GTags
 {
 
+const TCHAR*    DbManager::cDbFiles[]       = { _T("GPATH"), _T("GTAGS"), _T("GRTAGS") };
+const TCHAR     DbManager::cSnapshotDir[]   = _T("GTAGS.%u\\");
+const TCHAR     DbManager::cReplacedSuffix[] = _T(".replaced");
+const DWORD     DbManager::cDirCacheTTL = 10000;
+const unsigned  DbManager::cDirCacheMax = 4096;
+
+
 DbManager DbManager::Instance;
 
 
@@ -41,7 +49,14 @@ DbHandle DbManager::RegisterDb(const CPath& dbPath)
 
     AUTOLOCK(_lock);
 
-    return lockDb(dbPath, true, &success);
+    DbHandle db = lockDb(dbPath, WRITE_LOCK, &success);
+
+    // DB files appear when the creation finishes so the directories resolved
+    // meanwhile have to be resolved again then
+    findDb(db)->second._creating = true;
+    ++_generation;
+
+    return db;
 }
 
 
@@ -57,17 +72,15 @@ bool DbManager::UnregisterDb(DbHandle db)
 
     AUTOLOCK(_lock);
 
-    for (std::list<GTagsDb>::iterator dbi = _dbList.begin(); dbi != _dbList.end(); ++dbi)
+    DbList::iterator dbi = findDb(db);
+    if (dbi != _dbList.end())
     {
-        if (db == &(dbi->_path))
+        dbi->second._writeLock = false;
+        if (!dbi->second.IsLocked())
         {
-            dbi->Unlock();
-            if (!dbi->IsLocked())
-            {
-                ret = deleteDb(dbi->_path);
-                _dbList.erase(dbi);
-            }
-            break;
+            ret = deleteDb(dbi->second);
+            _dbList.erase(dbi);
+            ++_generation;
         }
     }
 
@@ -79,25 +92,108 @@ bool DbManager::UnregisterDb(DbHandle db)
  *  \brief
  */
 DbHandle DbManager::GetDb(const CPath& filePath, bool writeEn, bool* success)
+{
+    return resolveAndLock(filePath, writeEn ? WRITE_LOCK : READ_LOCK, success);
+}
+
+
+/**
+ *  \brief  Locks the DB for update in a snapshot - readers are not blocked meanwhile
+ */
+DbHandle DbManager::UpdateDb(const CPath& filePath, bool* success)
+{
+    return resolveAndLock(filePath, UPDATE_LOCK, success);
+}
+
+
+/**
+ *  \brief
+ */
+DbHandle DbManager::resolveAndLock(const CPath& filePath, LockMode_t mode, bool* success)
 {
     if (!success)
         return NULL;
 
-    AUTOLOCK(_lock);
-
     *success = false;
 
     CPath dbPath(filePath);
     int len = dbPath.StripFilename();
+    if (len == 0)
+        return NULL;
 
+    std::vector<CPath> visited;
+    unsigned generation;
+    bool cached = false;
+
+    {
+        AUTOLOCK(_lock);
+
+        generation = _generation;
+
+        if (lookupDir(dbPath, dbPath))
+        {
+            ++_hits;
+            if (dbPath.IsEmpty())
+                return NULL;
+
+            return lockDb(dbPath, mode, success);
+        }
+
+        ++_misses;
+    }
+
+    // Probe the file system without holding the lock, stop at the first directory
+    // the cache already knows about
     for (; len; len = dbPath.DirUp())
+    {
+        {
+            AUTOLOCK(_lock);
+
+            if (lookupDir(dbPath, dbPath))
+            {
+                cached = true;
+                len = dbPath.Len();
+                break;
+            }
+
+            ++_probes;
+        }
+
         if (DbExistsInFolder(dbPath))
             break;
 
+        visited.push_back(dbPath);
+    }
+
+    AUTOLOCK(_lock);
+
+    if (len == 0)
+        dbPath.Clear();
+
+    const PathId dbId = len ? PathTable::Get().Intern(dbPath) : cNoPath;
+
+    // Do not cache anything resolved while DBs were created or deleted (or the path table is full)
+    if (generation == _generation && (dbId != cNoPath || !len))
+    {
+        if (_dirCache.size() + visited.size() > cDirCacheMax)
+            _dirCache.clear();
+
+        DirEntry entry;
+        entry._db           = dbId;
+        entry._generation   = _generation;
+        entry._time         = GetTickCount();
+
+        for (std::vector<CPath>::iterator iDir = visited.begin(); iDir != visited.end(); ++iDir)
+            _dirCache[*iDir] = entry;
+
+        if (len && !cached)
+            _dirCache[dbPath] = entry;
+    }
+
     if (len == 0)
         return NULL;
 
-    return lockDb(dbPath, writeEn, success);
+    return lockDb(dbPath, mode, success);
 }
 
 
@@ -111,16 +207,146 @@ bool DbManager::PutDb(DbHandle db)
 
     AUTOLOCK(_lock);
 
-    for (std::list<GTagsDb>::iterator dbi = _dbList.begin(); dbi != _dbList.end(); ++dbi)
+    DbList::iterator dbi = findDb(db);
+    if (dbi == _dbList.end())
+        return false;
+
+    GTagsDb& gdb = dbi->second;
+
+    if (db == &gdb._path)
     {
-        if (db == &(dbi->_path))
+        if (gdb._writeLock)
         {
-            dbi->Unlock();
-            return dbi->IsLocked();
+            if (gdb._creating)
+            {
+                gdb._creating = false;
+                ++_generation;
+            }
+
+            gdb._writeLock = false;
         }
+        else
+        {
+            gdb._updateLock = false;
+        }
+    }
+    else
+    {
+        --findSnapshot(gdb, db)->_readLocks;
     }
 
-    return false;
+    collectSnapshots(gdb);
+
+    return gdb.IsLocked();
+}
+
+
+/**
+ *  \brief
+ */
+bool DbManager::IsUpdateLocked(DbHandle db)
+{
+    AUTOLOCK(_lock);
+
+    DbList::iterator dbi = findDb(db);
+
+    return (dbi != _dbList.end() && db == &(dbi->second._path) && dbi->second._updateLock);
+}
+
+
+/**
+ *  \brief  Creates new snapshot folder for the update lock holder to write to. Copies there the current
+ *          DB files unless the DB is going to be re-created
+ */
+bool DbManager::BeginUpdate(DbHandle db, CPath& snapshotDir, bool copyFiles)
+{
+    CPath srcDir;
+
+    {
+        AUTOLOCK(_lock);
+
+        DbList::iterator dbi = findDb(db);
+        if (dbi == _dbList.end() || db != &(dbi->second._path) || !dbi->second._updateLock)
+            return false;
+
+        GTagsDb& gdb = dbi->second;
+
+        TCHAR dir[32];
+        _sntprintf_s(dir, _countof(dir), _TRUNCATE, cSnapshotDir, ++gdb._snapshotId);
+
+        gdb._updateDir = gdb._path;
+        gdb._updateDir += dir;
+
+        // The current snapshot cannot be moved or removed while the update lock is held
+        srcDir = gdb._snapshots.back()._dir;
+        snapshotDir = gdb._updateDir;
+    }
+
+    removeSnapshot(snapshotDir);
+
+    if (!CreateDirectory(snapshotDir.C_str(), NULL))
+        return false;
+
+    SetFileAttributes(snapshotDir.C_str(), FILE_ATTRIBUTE_HIDDEN);
+
+    for (unsigned i = 0; copyFiles && i < _countof(cDbFiles); ++i)
+    {
+        CPath src(srcDir);
+        src += cDbFiles[i];
+        CPath dst(snapshotDir);
+        dst += cDbFiles[i];
+
+        if (!CopyFile(src.C_str(), dst.C_str(), FALSE))
+        {
+            removeSnapshot(snapshotDir);
+            return false;
+        }
+    }
+
+    return true;
+}
+
+
+/**
+ *  \brief  Publishes the updated snapshot to new readers or drops it
+ */
+void DbManager::EndUpdate(DbHandle db, bool commit)
+{
+    AUTOLOCK(_lock);
+
+    DbList::iterator dbi = findDb(db);
+    if (dbi == _dbList.end() || db != &(dbi->second._path) || dbi->second._updateDir.IsEmpty())
+        return;
+
+    GTagsDb& gdb = dbi->second;
+
+    if (commit)
+        gdb._snapshots.push_back(GTagsDb::Snapshot(gdb._path, gdb._updateDir));
+    else
+        removeSnapshot(gdb._updateDir);
+
+    gdb._updateDir.Clear();
+}
+
+
+/**
+ *  \brief  Gets the folder of the DB files the reader is pinned to if it is not the DB folder itself
+ */
+bool DbManager::GetSnapshotDir(DbHandle db, CPath& snapshotDir)
+{
+    AUTOLOCK(_lock);
+
+    DbList::iterator dbi = findDb(db);
+    if (dbi == _dbList.end() || db == &(dbi->second._path))
+        return false;
+
+    std::list<GTagsDb::Snapshot>::iterator iSnap = findSnapshot(dbi->second, db);
+    if (dbi->second.isRoot(*iSnap))
+        return false;
+
+    snapshotDir = iSnap->_dir;
+
+    return true;
 }
 
 
@@ -138,47 +364,259 @@ bool DbManager::DbExistsInFolder(const CPath& folder)
 /**
  *  \brief
  */
-bool DbManager::deleteDb(CPath& dbPath)
+void DbManager::GetStats(CText& stats)
+{
+    AUTOLOCK(_lock);
+
+    if (!_hits && !_misses)
+        return;
+
+    TCHAR buf[160];
+    _sntprintf_s(buf, _countof(buf), _TRUNCATE,
+            _T(" %u hits, %u misses, %u folder probes, %u folders cached\n"),
+            _hits, _misses, _probes, _dirCache.size());
+
+    stats += buf;
+
+#ifdef DEVELOPMENT
+    unsigned acquired, contended;
+    _lock.GetContention(acquired, contended);
+    _sntprintf_s(buf, _countof(buf), _TRUNCATE, _T(" lock taken %u times, %u contended\n"), acquired, contended);
+
+    stats += buf;
+#endif
+}
+
+
+/**
+ *  \brief  Deletes the DB files and all snapshot folders, also the ones left over by a previous session.
+ *          The current DB generation may live in a snapshot so DB files missing from the DB folder are fine
+ */
+bool DbManager::deleteDb(const GTagsDb& gdb)
 {
-    dbPath += _T("GTAGS");
-    BOOL ret = DeleteFile(dbPath.C_str());
-    if (ret)
+    bool ret = true;
+
+    for (unsigned i = 0; i < _countof(cDbFiles); ++i)
     {
-        dbPath.StripFilename();
-        dbPath += _T("GPATH");
-        ret = DeleteFile(dbPath.C_str());
+        CPath file(gdb._path);
+        file += cDbFiles[i];
+
+        if (!DeleteFile(file.C_str()) && GetLastError() != ERROR_FILE_NOT_FOUND)
+            ret = false;
     }
-    if (ret)
+
+    CPath pattern(gdb._path);
+    pattern += _T("GTAGS.*");
+
+    WIN32_FIND_DATA fd;
+    HANDLE hFind = FindFirstFile(pattern.C_str(), &fd);
+    if (hFind == INVALID_HANDLE_VALUE)
+        return ret;
+
+    do
     {
-        dbPath.StripFilename();
-        dbPath += _T("GRTAGS");
-        ret = DeleteFile(dbPath.C_str());
+        // Only the folders named the way BeginUpdate names them - GTAGS.<number>
+        const TCHAR* id = fd.cFileName + 6;
+
+        if (!(fd.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) || !*id || id[_tcsspn(id, _T("0123456789"))])
+            continue;
+
+        CPath dir(gdb._path);
+        dir += fd.cFileName;
+        dir += _T("\\");
+
+        if (!removeSnapshot(dir))
+            ret = false;
     }
+    while (FindNextFile(hFind, &fd));
+
+    FindClose(hFind);
+
+    return ret;
+}
+
+
+/**
+ *  \brief
+ */
+DbHandle DbManager::lockDb(const CPath& dbPath, LockMode_t mode, bool* success)
+{
+    DbList::iterator dbi = _dbList.find(dbPath);
+    if (dbi == _dbList.end())
+        dbi = _dbList.insert(DbList::value_type(dbPath, GTagsDb(dbPath))).first;
 
-    return ret ? true : false;
+    *success = dbi->second.Lock(mode);
+
+    return dbi->second.Handle(mode);
+}
+
+
+/**
+ *  \brief  DB handles point into the DB list entries so they are looked up by their path
+ */
+DbManager::DbList::iterator DbManager::findDb(DbHandle db)
+{
+    DbList::iterator dbi = _dbList.find(*db);
+    if (dbi == _dbList.end() || &(dbi->second._path) == db)
+        return dbi;
+
+    if (findSnapshot(dbi->second, db) == dbi->second._snapshots.end())
+        return _dbList.end();
+
+    return dbi;
 }
 
 
 /**
  *  \brief
  */
-DbHandle DbManager::lockDb(const CPath& dbPath, bool writeEn, bool* success)
+std::list<DbManager::GTagsDb::Snapshot>::iterator DbManager::findSnapshot(GTagsDb& gdb, DbHandle db)
+{
+    std::list<GTagsDb::Snapshot>::iterator iSnap;
+    for (iSnap = gdb._snapshots.begin(); iSnap != gdb._snapshots.end(); ++iSnap)
+        if (&(iSnap->_path) == db)
+            break;
+
+    return iSnap;
+}
+
+
+/**
+ *  \brief  Removes the superseded snapshots nobody reads anymore and moves the current one
+ *          back to the DB folder once it is not in use
+ */
+void DbManager::collectSnapshots(GTagsDb& gdb)
+{
+    std::list<GTagsDb::Snapshot>::iterator iRoot = gdb._snapshots.end();
+    std::list<GTagsDb::Snapshot>::iterator iCurrent = --gdb._snapshots.end();
+
+    for (std::list<GTagsDb::Snapshot>::iterator iSnap = gdb._snapshots.begin(); iSnap != iCurrent;)
+    {
+        if (gdb.isRoot(*iSnap))
+        {
+            iRoot = iSnap++;
+        }
+        else if (!iSnap->_readLocks)
+        {
+            removeSnapshot(iSnap->_dir);
+            iSnap = gdb._snapshots.erase(iSnap);
+        }
+        else
+        {
+            ++iSnap;
+        }
+    }
+
+    if (iRoot == gdb._snapshots.end() || iRoot->_readLocks || iCurrent->_readLocks ||
+            gdb._writeLock || gdb._updateLock)
+        return;
+
+    // On failure the snapshot stays the current one and the move is retried on the next release
+    if (moveDbFiles(iCurrent->_dir, gdb._path))
+    {
+        removeSnapshot(iCurrent->_dir);
+        gdb._snapshots.erase(iCurrent);
+        gdb._snapshots.splice(gdb._snapshots.end(), gdb._snapshots, iRoot);
+    }
+}
+
+
+/**
+ *  \brief  Returns false if the folder could not be removed
+ */
+bool DbManager::removeSnapshot(const CPath& dir)
+{
+    for (unsigned i = 0; i < _countof(cDbFiles); ++i)
+    {
+        CPath file(dir);
+        file += cDbFiles[i];
+        DeleteFile(file.C_str());
+    }
+
+    return (RemoveDirectory(dir.C_str()) != FALSE);
+}
+
+
+/**
+ *  \brief  Moves all DB files or none. The replaced files are set aside until all new ones are in place
+ *          so a failed move (file held open by antivirus or indexer) is rolled back and the source
+ *          snapshot stays complete
+ */
+bool DbManager::moveDbFiles(const CPath& srcDir, const CPath& dstDir)
 {
-    for (std::list<GTagsDb>::iterator dbi = _dbList.begin(); dbi != _dbList.end(); ++dbi)
+    const unsigned cCount = _countof(cDbFiles);
+
+    CPath src[cCount];
+    CPath dst[cCount];
+    CPath replaced[cCount];
+    bool setAside[cCount] = { false };
+
+    unsigned moved;
+    for (moved = 0; moved < cCount; ++moved)
+    {
+        src[moved] = srcDir;
+        src[moved] += cDbFiles[moved];
+        dst[moved] = dstDir;
+        dst[moved] += cDbFiles[moved];
+        replaced[moved] = dst[moved];
+        replaced[moved] += cReplacedSuffix;
+
+        if (dst[moved].FileExists())
+        {
+            if (!MoveFileEx(dst[moved].C_str(), replaced[moved].C_str(), MOVEFILE_REPLACE_EXISTING))
+                break;
+            setAside[moved] = true;
+        }
+
+        if (!MoveFileEx(src[moved].C_str(), dst[moved].C_str(), 0))
+        {
+            if (setAside[moved])
+                MoveFileEx(replaced[moved].C_str(), dst[moved].C_str(), 0);
+            break;
+        }
+    }
+
+    if (moved < cCount)
     {
-        if (dbi->_path == dbPath)
+        while (moved--)
         {
-            *success = dbi->Lock(writeEn);
-            return &(dbi->_path);
+            MoveFileEx(dst[moved].C_str(), src[moved].C_str(), 0);
+            if (setAside[moved])
+                MoveFileEx(replaced[moved].C_str(), dst[moved].C_str(), 0);
         }
+
+        return false;
     }
 
-    GTagsDb newDb(dbPath, writeEn);
-    _dbList.push_back(newDb);
+    for (unsigned i = 0; i < cCount; ++i)
+        if (setAside[i])
+            DeleteFile(replaced[i].C_str());
+
+    return true;
+}
+
+
+/**
+ *  \brief  Looks up the directory DB in the cache, stale entries are dropped
+ */
+bool DbManager::lookupDir(const CPath& dir, CPath& dbPath)
+{
+    DirCache::iterator iDir = _dirCache.find(dir);
+    if (iDir == _dirCache.end())
+        return false;
+
+    if (iDir->second._generation != _generation || GetTickCount() - iDir->second._time > cDirCacheTTL)
+    {
+        _dirCache.erase(iDir);
+        return false;
+    }
 
-    *success = true;
+    if (iDir->second._db == cNoPath)
+        dbPath.Clear();
+    else
+        dbPath = PathTable::Get().Path(iDir->second._db);
 
-    return &(_dbList.rbegin()->_path);
+    return true;
 }
 
 } // namespace GTags
@@ -27,8 +27,10 @@
 
 #include <tchar.h>
 #include <list>
+#include <unordered_map>
 #include "Common.h"
 #include "AutoLock.h"
+#include "PathTable.h"
 
 
 namespace GTags
@@ -49,10 +51,42 @@ public:
     DbHandle RegisterDb(const CPath& dbPath);
     bool UnregisterDb(DbHandle db);
     DbHandle GetDb(const CPath& filePath, bool writeEn, bool* success);
+    DbHandle UpdateDb(const CPath& filePath, bool* success);
     bool PutDb(DbHandle db);
+    bool IsUpdateLocked(DbHandle db);
+    bool BeginUpdate(DbHandle db, CPath& snapshotDir, bool copyFiles = true);
+    void EndUpdate(DbHandle db, bool commit);
+    bool GetSnapshotDir(DbHandle db, CPath& snapshotDir);
     bool DbExistsInFolder(const CPath& folder);
+    void GetStats(CText& stats);
 
 private:
+    enum LockMode_t
+    {
+        READ_LOCK = 0,
+        WRITE_LOCK,
+        UPDATE_LOCK
+    };
+
+    static const TCHAR*     cDbFiles[];
+    static const TCHAR      cSnapshotDir[];
+    static const TCHAR      cReplacedSuffix[];
+    static const DWORD      cDirCacheTTL;
+    static const unsigned   cDirCacheMax;
+
+    /**
+     *  \struct  DirEntry
+     *  \brief  Resolved DB (interned path id) for a directory, cNoPath if there is none
+     */
+    struct DirEntry
+    {
+        PathId      _db;
+        unsigned    _generation;
+        DWORD       _time;
+    };
+
+    typedef std::unordered_map<CPath, DirEntry, CPathHash, CPathEqual> DirCache;
+
     /**
      *  \class  GTagsDb
      *  \brief
@@ -62,61 +96,111 @@ private:
     public:
         ~GTagsDb() {}
 
-        bool IsLocked()
+        bool IsLocked() const
         {
-            return (_writeLock || _readLocks);
+            if (_writeLock || _updateLock)
+                return true;
+
+            for (std::list<Snapshot>::const_iterator iSnap = _snapshots.begin(); iSnap != _snapshots.end(); ++iSnap)
+                if (iSnap->_readLocks)
+                    return true;
+
+            return false;
         }
 
-        bool Lock(bool writeEn)
+        bool Lock(LockMode_t mode)
         {
-            if (writeEn)
+            if (mode == WRITE_LOCK)
             {
-                if (_writeLock || _readLocks)
+                if (IsLocked())
                     return false;
                 _writeLock = true;
             }
+            else if (mode == UPDATE_LOCK)
+            {
+                if (_writeLock || _updateLock)
+                    return false;
+                _updateLock = true;
+            }
             else
             {
                 if (_writeLock)
                     return false;
-                ++_readLocks;
+                ++_snapshots.back()._readLocks;
             }
             return true;
         }
 
-        void Unlock()
+        DbHandle Handle(LockMode_t mode) const
         {
-            if (_writeLock)
-                _writeLock = false;
-            else if (_readLocks > 0)
-                --_readLocks;
+            return (mode == READ_LOCK) ? &(_snapshots.back()._path) : &_path;
         }
 
     private:
         friend class DbManager;
 
-        GTagsDb(const CPath& dbPath, bool writeEn) : _path(dbPath), _writeLock(writeEn)
+        /**
+         *  \struct  Snapshot
+         *  \brief  DB files generation readers are pinned to, its path is the readers DB handle
+         */
+        struct Snapshot
+        {
+            Snapshot(const CPath& dbPath, const CPath& dir) : _path(dbPath), _dir(dir), _readLocks(0) {}
+
+            CPath   _path;
+            CPath   _dir;
+            int     _readLocks;
+        };
+
+        GTagsDb(const CPath& dbPath) : _path(dbPath), _writeLock(false), _updateLock(false), _creating(false),
+            _snapshotId(0)
         {
-            _readLocks = writeEn ? 0 : 1;
+            _snapshots.push_back(Snapshot(dbPath, dbPath));
+        }
+
+        bool isRoot(const Snapshot& snapshot) const
+        {
+            return (snapshot._dir == _path);
         }
 
         CPath   _path;
 
-        int     _readLocks;
-        bool    _writeLock;
+        // Readers use the last snapshot, the DB folder itself is always one of them
+        std::list<Snapshot> _snapshots;
+        CPath               _updateDir;
+
+        bool        _writeLock;
+        bool        _updateLock;
+        bool        _creating;
+        unsigned    _snapshotId;
     };
 
+    typedef std::unordered_map<CPath, GTagsDb, CPathHash, CPathEqual> DbList;
+
     static DbManager Instance;
 
-    DbManager() {}
+    DbManager() : _generation(0), _hits(0), _misses(0), _probes(0) {}
     DbManager(const DbManager&);
     ~DbManager() {}
 
-    bool deleteDb(CPath& dbPath);
-    DbHandle lockDb(const CPath& dbPath, bool writeEn, bool* success);
-
-    Mutex               _lock;
-    std::list<GTagsDb>  _dbList;
+    bool deleteDb(const GTagsDb& gdb);
+    DbHandle resolveAndLock(const CPath& filePath, LockMode_t mode, bool* success);
+    DbHandle lockDb(const CPath& dbPath, LockMode_t mode, bool* success);
+    DbList::iterator findDb(DbHandle db);
+    std::list<GTagsDb::Snapshot>::iterator findSnapshot(GTagsDb& gdb, DbHandle db);
+    void collectSnapshots(GTagsDb& gdb);
+    bool removeSnapshot(const CPath& dir);
+    bool moveDbFiles(const CPath& srcDir, const CPath& dstDir);
+    bool lookupDir(const CPath& dir, CPath& dbPath);
+
+    Mutex       _lock;
+    DbList      _dbList;
+    DirCache    _dirCache;
+    unsigned    _generation;
+
+    unsigned    _hits;
+    unsigned    _misses;
+    unsigned    _probes;
 };
 
 } // namespace GTags
@@ -0,0 +1,326 @@
+/**
+ *  \file
+ *  \brief  GTags DB warm-up
+ *
+ *  \author  Pavel Nedev <pg.nedev@gmail.com>
+ *
+ *  \section COPYRIGHT
+ *  Copyright(C) 2015 Pavel Nedev
+ *
+ *  \section LICENSE
+ *  This program is free software; you can redistribute it and/or modify it
+ *  under the terms of the GNU General Public License version 2 as published
+ *  by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful, but
+ *  WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ *  or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ *  for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+#include <windows.h>
+#include <tchar.h>
+#include <process.h>
+#include <vector>
+#include "GTags.h"
+#include "TagFilter.h"
+#include "DbWarmer.h"
+
+
+namespace GTags
+{
+
+// DB not activated for that long is considered cold again - the OS cache has likely dropped it
+const DWORD     DbWarmer::cIdleTime     = 10 * 60 * 1000;
+// Small reads - the stop request is checked between them
+const DWORD     DbWarmer::cChunkSize    = 64 * 1024;
+// Reading more than that would only push out of the cache the rest of the DB
+const DWORD     DbWarmer::cMaxFileSize  = 512 * 1024 * 1024;
+// In the order lookups need them
+const TCHAR*    DbWarmer::cDbFiles[]    = { _T("GPATH"), _T("GTAGS"), _T("GRTAGS") };
+
+
+DbWarmer DbWarmer::Instance;
+
+
+/**
+ *  \brief  Starts the warm-up of the file DB if it is not warm already
+ */
+void DbWarmer::Activate(const CPath& file)
+{
+    if (_stop)
+        return;
+
+    bool success;
+    DbHandle db = DbManager::Get().GetDb(file, false, &success);
+    if (!db || !success)
+        return;
+
+    DWORD now = GetTickCount();
+    {
+        AUTOLOCK(_lock);
+
+        // Reap the finished warm-ups
+        for (std::list<HANDLE>::iterator iThread = _threads.begin(); iThread != _threads.end();)
+        {
+            if (WaitForSingleObject(*iThread, 0) == WAIT_OBJECT_0)
+            {
+                CloseHandle(*iThread);
+                iThread = _threads.erase(iThread);
+            }
+            else
+            {
+                ++iThread;
+            }
+        }
+
+        std::list<Item>::iterator iItem = findItem(*db);
+        if (iItem == _items.end())
+        {
+            _items.push_back(Item());
+            iItem = --_items.end();
+            iItem->_dbPath = *db;
+        }
+
+        if (!iItem->_lastActive || now - iItem->_lastActive > cIdleTime)
+        {
+            iItem->_warm = false;
+            iItem->_firstPending = true;
+        }
+
+        iItem->_lastActive = now;
+
+        if (iItem->_warm || iItem->_warming)
+        {
+            DbManager::Get().PutDb(db);
+            return;
+        }
+
+        iItem->_warming = true;
+    }
+
+    // The thread owns the DB read lock until it opens the DB files
+    HANDLE hThread = (HANDLE)_beginthreadex(NULL, 0, threadFunc, const_cast<CPath*>(db), 0, NULL);
+
+    AUTOLOCK(_lock);
+
+    if (hThread)
+    {
+        _threads.push_back(hThread);
+        return;
+    }
+
+    std::list<Item>::iterator iItem = findItem(*db);
+    if (iItem != _items.end())
+        iItem->_warming = false;
+
+    DbManager::Get().PutDb(db);
+}
+
+
+/**
+ *  \brief  Tells if that is the first lookup in the DB since it was activated and if the DB was warm by then
+ */
+DbWarmer::Temp_t DbWarmer::FirstLookup(const CPath& dbPath)
+{
+    AUTOLOCK(_lock);
+
+    std::list<Item>::iterator iItem = findItem(dbPath);
+    if (iItem == _items.end() || !iItem->_firstPending)
+        return NONE;
+
+    iItem->_firstPending = false;
+
+    return iItem->_warm ? WARM : COLD;
+}
+
+
+/**
+ *  \brief
+ */
+void DbWarmer::LookupDone(Temp_t temp, DWORD time)
+{
+    if (temp == NONE)
+        return;
+
+    AUTOLOCK(_lock);
+
+    LatencyStats& stats = (temp == WARM) ? _warmLookups : _cold;
+
+    ++stats._count;
+    stats._total += time;
+    if (stats._max < time)
+        stats._max = time;
+}
+
+
+/**
+ *  \brief
+ */
+void DbWarmer::Stop()
+{
+    std::list<HANDLE> threads;
+
+    {
+        AUTOLOCK(_lock);
+
+        _stop = true;
+        threads.swap(_threads);
+    }
+
+    // The threads check the stop request between the small reads so they exit shortly
+    for (std::list<HANDLE>::iterator iThread = threads.begin(); iThread != threads.end(); ++iThread)
+    {
+        WaitForSingleObject(*iThread, INFINITE);
+        CloseHandle(*iThread);
+    }
+}
+
+
+/**
+ *  \brief
+ */
+void DbWarmer::GetStats(CText& stats)
+{
+    AUTOLOCK(_lock);
+
+    if (!_warmUps && !_cold._count && !_warmLookups._count)
+        return;
+
+    TCHAR buf[256];
+    _sntprintf_s(buf, _countof(buf), _TRUNCATE, _T(" %u warm-ups, %u MB read, %u ms average\n"),
+            _warmUps, (unsigned)(_bytesRead / (1024 * 1024)), _warmUps ? _warmTime / _warmUps : 0);
+
+    stats += buf;
+
+    _sntprintf_s(buf, _countof(buf), _TRUNCATE,
+            _T(" First lookup on cold DB: %u times, %u ms average, %u ms max\n")
+            _T(" First lookup on warm DB: %u times, %u ms average, %u ms max\n"),
+            _cold._count, _cold._count ? _cold._total / _cold._count : 0, _cold._max,
+            _warmLookups._count, _warmLookups._count ? _warmLookups._total / _warmLookups._count : 0,
+            _warmLookups._max);
+
+    stats += buf;
+}
+
+
+/**
+ *  \brief  Reads the DB files at background priority, then builds the DB resident tag filters
+ */
+unsigned __stdcall DbWarmer::threadFunc(void* data)
+{
+    DbHandle db = static_cast<DbHandle>(data);
+    DWORD start = GetTickCount();
+
+    // Low I/O and memory priority - interactive lookups and editing go first. Windows XP has no
+    // background mode so only the CPU priority is lowered there
+    const bool background = (SetThreadPriority(GetCurrentThread(), THREAD_MODE_BACKGROUND_BEGIN) != FALSE);
+    if (!background)
+        SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_IDLE);
+
+    CPath dir;
+    if (!DbManager::Get().GetSnapshotDir(db, dir))
+        dir = *db;
+
+    // Open handles keep reading the same files even if an update replaces them meanwhile -
+    // the DB lock is not held during the read so it doesn't hold off the updates
+    HANDLE hFiles[_countof(cDbFiles)];
+
+    for (unsigned i = 0; i < _countof(cDbFiles); ++i)
+    {
+        CPath file(dir);
+        file += cDbFiles[i];
+
+        hFiles[i] = CreateFile(file.C_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    }
+
+    CPath dbPath(*db);
+    DbManager::Get().PutDb(db);
+
+    std::vector<char> buf(cChunkSize);
+    unsigned long long bytes = 0;
+
+    for (unsigned i = 0; i < _countof(cDbFiles); ++i)
+    {
+        if (hFiles[i] == INVALID_HANDLE_VALUE)
+            continue;
+
+        if (!Instance._stop)
+            bytes += readFile(hFiles[i], buf);
+
+        CloseHandle(hFiles[i]);
+    }
+
+    SetThreadPriority(GetCurrentThread(), background ? THREAD_MODE_BACKGROUND_END : THREAD_PRIORITY_NORMAL);
+
+    if (Instance._stop)
+        return 0;
+
+    RunSheduledUpdate(dbPath.C_str());
+
+    Instance.warmDone(dbPath, bytes, GetTickCount() - start);
+
+    // Lookups of names not in the DB don't touch the DB files at all
+    TagFilter::Get().Prefetch(dbPath);
+
+    return 0;
+}
+
+
+/**
+ *  \brief  Reads the file sequentially - the cache manager reads ahead aggressively then. Mapping the file
+ *          instead would charge the pages to Notepad++ working set
+ */
+unsigned long long DbWarmer::readFile(HANDLE hFile, std::vector<char>& buf)
+{
+    unsigned long long total = 0;
+    DWORD bytesRead;
+
+    while (!Instance._stop && total < cMaxFileSize &&
+            ReadFile(hFile, buf.data(), (DWORD)buf.size(), &bytesRead, NULL) && bytesRead)
+        total += bytesRead;
+
+    return total;
+}
+
+
+/**
+ *  \brief  Must be called under lock
+ */
+std::list<DbWarmer::Item>::iterator DbWarmer::findItem(const CPath& dbPath)
+{
+    std::list<Item>::iterator iItem;
+    for (iItem = _items.begin(); iItem != _items.end(); ++iItem)
+        if (CPathEqual()(iItem->_dbPath, dbPath))
+            break;
+
+    return iItem;
+}
+
+
+/**
+ *  \brief
+ */
+void DbWarmer::warmDone(const CPath& dbPath, unsigned long long bytes, DWORD time)
+{
+    AUTOLOCK(_lock);
+
+    ++_warmUps;
+    _bytesRead += bytes;
+    _warmTime += time;
+
+    std::list<Item>::iterator iItem = findItem(dbPath);
+    if (iItem != _items.end())
+    {
+        iItem->_warming = false;
+        iItem->_warm = true;
+    }
+}
+
+} // namespace GTags
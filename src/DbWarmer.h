@@ -0,0 +1,123 @@
+/**
+ *  \file
+ *  \brief  GTags DB warm-up
+ *
+ *  \author  Pavel Nedev <pg.nedev@gmail.com>
+ *
+ *  \section COPYRIGHT
+ *  Copyright(C) 2015 Pavel Nedev
+ *
+ *  \section LICENSE
+ *  This program is free software; you can redistribute it and/or modify it
+ *  under the terms of the GNU General Public License version 2 as published
+ *  by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful, but
+ *  WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ *  or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ *  for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+#pragma once
+
+
+#include <windows.h>
+#include <tchar.h>
+#include <list>
+#include <vector>
+#include "Common.h"
+#include "AutoLock.h"
+#include "DbManager.h"
+
+
+namespace GTags
+{
+
+/**
+ *  \class  DbWarmer
+ *  \brief  Reads in background the DB files into the OS file cache when a file in the DB is activated
+ *          so the first lookup is not slowed down by disk reads. Tracks the first lookup latency
+ *          on cold and on warm DB
+ */
+class DbWarmer
+{
+public:
+    enum Temp_t
+    {
+        NONE = 0,
+        COLD,
+        WARM
+    };
+
+    static DbWarmer& Get() { return Instance; }
+
+    void Activate(const CPath& file);
+    Temp_t FirstLookup(const CPath& dbPath);
+    void LookupDone(Temp_t temp, DWORD time);
+    void Stop();
+    void GetStats(CText& stats);
+
+private:
+    static const DWORD      cIdleTime;
+    static const DWORD      cChunkSize;
+    static const DWORD      cMaxFileSize;
+    static const TCHAR*     cDbFiles[];
+
+    /**
+     *  \struct  Item
+     *  \brief
+     */
+    struct Item
+    {
+        Item() : _lastActive(0), _warming(false), _warm(false), _firstPending(false) {}
+
+        CPath   _dbPath;
+        DWORD   _lastActive;
+        bool    _warming;
+        bool    _warm;
+        bool    _firstPending;
+    };
+
+    /**
+     *  \struct  LatencyStats
+     *  \brief
+     */
+    struct LatencyStats
+    {
+        LatencyStats() : _count(0), _total(0), _max(0) {}
+
+        unsigned    _count;
+        unsigned    _total;
+        unsigned    _max;
+    };
+
+    static DbWarmer Instance;
+
+    static unsigned __stdcall threadFunc(void* data);
+    static unsigned long long readFile(HANDLE hFile, std::vector<char>& buf);
+
+    DbWarmer() : _stop(false), _warmUps(0), _bytesRead(0), _warmTime(0) {}
+    DbWarmer(const DbWarmer&);
+    ~DbWarmer() {}
+
+    std::list<Item>::iterator findItem(const CPath& dbPath);
+    void warmDone(const CPath& dbPath, unsigned long long bytes, DWORD time);
+
+    Mutex               _lock;
+    std::list<Item>     _items;
+    std::list<HANDLE>   _threads;
+    volatile bool       _stop;
+
+    unsigned            _warmUps;
+    unsigned long long  _bytesRead;
+    unsigned            _warmTime;
+    LatencyStats        _cold;
+    LatencyStats        _warmLookups;
+};
+
+} // namespace GTags
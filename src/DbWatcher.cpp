@@ -0,0 +1,747 @@
+/**
+ *  \file
+ *  \brief  GTags DB folder watcher
+ *
+ *  \author  Pavel Nedev <pg.nedev@gmail.com>
+ *
+ *  \section COPYRIGHT
+ *  Copyright(C) 2015 Pavel Nedev
+ *
+ *  \section LICENSE
+ *  This program is free software; you can redistribute it and/or modify it
+ *  under the terms of the GNU General Public License version 2 as published
+ *  by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful, but
+ *  WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ *  or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ *  for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+#include <windows.h>
+#include <tchar.h>
+#include <process.h>
+#include <vector>
+#ifndef _WIN32
+#include <errno.h>
+#include <dirent.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <string>
+#include <unordered_map>
+#endif
+#include "Config.h"
+#include "GTags.h"
+#include "UpdateFilter.h"
+#include "FileWalker.h"
+#include "PathIndex.h"
+#include "DbWatcher.h"
+
+
+namespace
+{
+
+using namespace GTags;
+
+
+const DWORD cBufSize = 64 * 1024;
+
+
+#ifdef _WIN32
+
+// Pending read cancellation
+const DWORD cCancelTimeout = 1000;
+
+
+/**
+ *  \class  DirChanges
+ *  \brief  Overlapped ReadDirectoryChangesW on the folder tree
+ */
+class DirChanges : public DbWatcher::Backend
+{
+public:
+    DirChanges() : _hDir(INVALID_HANDLE_VALUE), _reading(false), _buf(cBufSize / sizeof(DWORD))
+    {
+        ZeroMemory(&_ovl, sizeof(_ovl));
+        _hStop = CreateEvent(NULL, TRUE, FALSE, NULL);
+    }
+
+    virtual ~DirChanges()
+    {
+        if (_hStop)
+            CloseHandle(_hStop);
+    }
+
+    bool IsValid() const { return (_hStop != NULL); }
+
+    virtual bool Open(const CPath& dbPath)
+    {
+        _hDir = CreateFile(dbPath.C_str(), FILE_LIST_DIRECTORY,
+                FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, NULL, OPEN_EXISTING,
+                FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OVERLAPPED, NULL);
+        if (_hDir == INVALID_HANDLE_VALUE)
+            return false;
+
+        _ovl.hEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+
+        return (_ovl.hEvent != NULL);
+    }
+
+    virtual Result_t Read(DWORD timeout, std::vector<DbWatcher::Change>& changes)
+    {
+        if (!_reading)
+        {
+            ResetEvent(_ovl.hEvent);
+
+            // DWORD aligned buffer as ReadDirectoryChangesW requires
+            if (!ReadDirectoryChangesW(_hDir, _buf.data(), cBufSize, TRUE,
+                    FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_DIR_NAME | FILE_NOTIFY_CHANGE_LAST_WRITE,
+                    NULL, &_ovl, NULL))
+                return STOPPED;
+
+            _reading = true;
+        }
+
+        HANDLE events[] = { _hStop, _ovl.hEvent };
+
+        DWORD r = WaitForMultipleObjects(_countof(events), events, FALSE, timeout);
+        if (r == WAIT_TIMEOUT)
+            return QUIET;
+        if (r != WAIT_OBJECT_0 + 1)
+            return STOPPED;
+
+        _reading = false;
+
+        DWORD bytes = 0;
+        if (!GetOverlappedResult(_hDir, &_ovl, &bytes, FALSE))
+            return STOPPED;
+
+        // Zero bytes - the changes didn't fit in the buffer
+        if (bytes == 0)
+            return OVERFLOWED;
+
+        for (BYTE* entry = (BYTE*)_buf.data(); ; )
+        {
+            FILE_NOTIFY_INFORMATION* info = (FILE_NOTIFY_INFORMATION*)entry;
+
+            changes.push_back(DbWatcher::Change());
+            changes.back()._action = (DbWatcher::Action_t)info->Action;
+            changes.back()._name.Append(info->FileName, info->FileNameLength / sizeof(WCHAR));
+
+            if (!info->NextEntryOffset)
+                break;
+            entry += info->NextEntryOffset;
+        }
+
+        return CHANGED;
+    }
+
+    virtual void Close()
+    {
+        // Only the thread that started the read can cancel it
+        if (_reading)
+        {
+            CancelIo(_hDir);
+            WaitForSingleObject(_ovl.hEvent, cCancelTimeout);
+        }
+
+        if (_ovl.hEvent)
+            CloseHandle(_ovl.hEvent);
+        if (_hDir != INVALID_HANDLE_VALUE)
+            CloseHandle(_hDir);
+    }
+
+    virtual void Stop()
+    {
+        SetEvent(_hStop);
+    }
+
+private:
+    HANDLE              _hStop;
+    HANDLE              _hDir;
+    OVERLAPPED          _ovl;
+    bool                _reading;
+    std::vector<DWORD>  _buf;
+};
+
+#else
+
+/**
+ *  \class  InotifyChanges
+ *  \brief  inotify watch on each folder of the tree - the folders created or moved in are added as
+ *          they are reported. Used by the native (non Windows) builds
+ */
+class InotifyChanges : public DbWatcher::Backend
+{
+public:
+    InotifyChanges() : _fd(-1), _buf(cBufSize / sizeof(DWORD))
+    {
+        _stopFd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    }
+
+    virtual ~InotifyChanges()
+    {
+        if (_stopFd >= 0)
+            close(_stopFd);
+    }
+
+    bool IsValid() const { return (_stopFd >= 0); }
+
+    virtual bool Open(const CPath& dbPath)
+    {
+        char path[MAX_PATH * 3];
+        if (!WideCharToMultiByte(CP_UTF8, 0, dbPath.C_str(), -1, path, sizeof(path), NULL, NULL))
+            return false;
+
+        _root = path;
+        for (unsigned i = 0; i < _root.size(); ++i)
+            if (_root[i] == '\\')
+                _root[i] = '/';
+
+        _fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if (_fd < 0)
+            return false;
+
+        addTree(std::string());
+
+        return true;
+    }
+
+    virtual Result_t Read(DWORD timeout, std::vector<DbWatcher::Change>& changes)
+    {
+        pollfd fds[] = { { _stopFd, POLLIN, 0 }, { _fd, POLLIN, 0 } };
+
+        int r;
+        do
+            r = poll(fds, _countof(fds), (timeout == INFINITE) ? -1 : (int)timeout);
+        while (r < 0 && errno == EINTR);
+
+        if (r < 0 || fds[0].revents)
+            return STOPPED;
+        if (r == 0)
+            return QUIET;
+
+        ssize_t len = read(_fd, _buf.data(), cBufSize);
+        if (len < 0)
+            return (errno == EAGAIN || errno == EINTR) ? CHANGED : STOPPED;
+
+        bool overflowed = false;
+
+        for (char* entry = (char*)_buf.data(); entry < (char*)_buf.data() + len; )
+        {
+            const inotify_event* event = (const inotify_event*)entry;
+            entry += sizeof(inotify_event) + event->len;
+
+            if (event->mask & IN_Q_OVERFLOW)
+            {
+                overflowed = true;
+                continue;
+            }
+
+            if (event->mask & IN_IGNORED)
+            {
+                _dirs.erase(event->wd);
+                continue;
+            }
+
+            std::unordered_map<int, std::string>::const_iterator iDir = _dirs.find(event->wd);
+            if (iDir == _dirs.end() || !event->len)
+                continue;
+
+            std::string rel(iDir->second);
+            rel += event->name;
+
+            DbWatcher::Action_t action;
+
+            if (event->mask & IN_CREATE)
+                action = DbWatcher::ADDED;
+            else if (event->mask & IN_DELETE)
+                action = DbWatcher::REMOVED;
+            else if (event->mask & IN_MOVED_FROM)
+                action = DbWatcher::RENAMED_OLD;
+            else if (event->mask & IN_MOVED_TO)
+                action = DbWatcher::RENAMED_NEW;
+            else
+                action = DbWatcher::MODIFIED;
+
+            // Files created in a new folder before its watch is added leave it non-empty when checked
+            if (event->mask & IN_ISDIR)
+            {
+                if (action == DbWatcher::ADDED || action == DbWatcher::RENAMED_NEW)
+                    addTree(rel + '/');
+                else if (action == DbWatcher::RENAMED_OLD)
+                    removeTree(rel + '/');
+            }
+
+            changes.push_back(DbWatcher::Change());
+            changes.back()._action = action;
+
+            wchar_t name[MAX_PATH];
+            if (!MultiByteToWideChar(CP_UTF8, 0, rel.c_str(), -1, name, _countof(name)))
+            {
+                changes.pop_back();
+                continue;
+            }
+
+            for (wchar_t* c = name; *c; ++c)
+                if (*c == L'/')
+                    *c = L'\\';
+
+            changes.back()._name = name;
+        }
+
+        return overflowed ? OVERFLOWED : CHANGED;
+    }
+
+    virtual void Close()
+    {
+        if (_fd >= 0)
+            close(_fd);
+        _fd = -1;
+        _dirs.clear();
+    }
+
+    virtual void Stop()
+    {
+        unsigned long long count = 1;
+        ssize_t ret = write(_stopFd, &count, sizeof(count));
+        (void)ret;
+    }
+
+private:
+    void addTree(const std::string& rel);
+    void removeTree(const std::string& rel);
+
+    int                                     _stopFd;
+    int                                     _fd;
+    std::string                             _root;
+    // Watched folders relative paths ('/' separated, with trailing '/') by watch descriptor
+    std::unordered_map<int, std::string>    _dirs;
+    std::vector<DWORD>                      _buf;
+};
+
+
+/**
+ *  \brief  Watches the folder and its sub-folders - symbolic links are not followed
+ */
+void InotifyChanges::addTree(const std::string& rel)
+{
+    const std::string path = _root + rel;
+
+    int wd = inotify_add_watch(_fd, path.c_str(), IN_CREATE | IN_DELETE | IN_MODIFY | IN_MOVED_FROM |
+            IN_MOVED_TO | IN_ONLYDIR | IN_DONT_FOLLOW);
+    if (wd < 0)
+        return;
+
+    _dirs[wd] = rel;
+
+    DIR* dir = opendir(path.c_str());
+    if (!dir)
+        return;
+
+    for (dirent* entry = readdir(dir); entry; entry = readdir(dir))
+    {
+        if (!strcmp(entry->d_name, ".") || !strcmp(entry->d_name, ".."))
+            continue;
+
+        std::string sub(rel);
+        sub += entry->d_name;
+
+        struct stat st;
+        if (lstat((_root + sub).c_str(), &st) || !S_ISDIR(st.st_mode))
+            continue;
+
+        addTree(sub + '/');
+    }
+
+    closedir(dir);
+}
+
+
+/**
+ *  \brief  Drops the watches of the folder moved away - it is watched again under its new name
+ */
+void InotifyChanges::removeTree(const std::string& rel)
+{
+    for (std::unordered_map<int, std::string>::iterator iDir = _dirs.begin(); iDir != _dirs.end();)
+    {
+        if (!iDir->second.compare(0, rel.size(), rel))
+        {
+            inotify_rm_watch(_fd, iDir->first);
+            iDir = _dirs.erase(iDir);
+        }
+        else
+        {
+            ++iDir;
+        }
+    }
+}
+
+#endif
+
+} // anonymous namespace
+
+
+namespace GTags
+{
+
+// Changes are collected until there are none for that long
+const DWORD     DbWatcher::cQuietTime   = 500;
+// Over that many changed files (a checkout, a build) one incremental update of the whole DB is run instead
+const unsigned  DbWatcher::cMaxPending  = 1000;
+const DWORD     DbWatcher::cStopTimeout = 1000;
+// DB files and update snapshot folders names start with these
+const TCHAR*    DbWatcher::cDbFiles[]   = { _T("GTAGS"), _T("GRTAGS"), _T("GPATH") };
+
+
+DbWatcher DbWatcher::Instance;
+
+
+/**
+ *  \brief  Returns NULL if the platform notifications cannot be set up
+ */
+DbWatcher::Backend* DbWatcher::Backend::Create()
+{
+#ifdef _WIN32
+    DirChanges* backend = new DirChanges;
+#else
+    InotifyChanges* backend = new InotifyChanges;
+#endif
+
+    if (!backend->IsValid())
+    {
+        delete backend;
+        return NULL;
+    }
+
+    return backend;
+}
+
+
+/**
+ *  \brief  Starts watching the DB folder tree if not watched already
+ */
+void DbWatcher::Watch(const CPath& dbPath)
+{
+    AUTOLOCK(_lock);
+
+    for (std::list<std::shared_ptr<Folder>>::iterator iFolder = _folders.begin(); iFolder != _folders.end();
+            ++iFolder)
+        if (CPathEqual()((*iFolder)->_dbPath, dbPath))
+            return;
+
+    std::shared_ptr<Folder> folder(new Folder(dbPath));
+
+    folder->_backend.reset(Backend::Create());
+    if (!folder->_backend)
+        return;
+
+    // The thread gets its own reference - the folder outlives the watcher list entry if not stopped in time
+    std::shared_ptr<Folder>* threadRef = new std::shared_ptr<Folder>(folder);
+
+    folder->_hThread = (HANDLE)_beginthreadex(NULL, 0, threadFunc, threadRef, 0, NULL);
+    if (!folder->_hThread)
+    {
+        delete threadRef;
+        return;
+    }
+
+    _folders.push_back(folder);
+}
+
+
+/**
+ *  \brief
+ */
+void DbWatcher::Unwatch(const CPath& dbPath)
+{
+    std::shared_ptr<Folder> folder;
+
+    {
+        AUTOLOCK(_lock);
+
+        for (std::list<std::shared_ptr<Folder>>::iterator iFolder = _folders.begin(); iFolder != _folders.end();
+                ++iFolder)
+        {
+            if (CPathEqual()((*iFolder)->_dbPath, dbPath))
+            {
+                folder = *iFolder;
+                _folders.erase(iFolder);
+                break;
+            }
+        }
+    }
+
+    if (folder)
+        stop(folder);
+}
+
+
+/**
+ *  \brief
+ */
+void DbWatcher::UnwatchAll()
+{
+    std::list<std::shared_ptr<Folder>> folders;
+
+    {
+        AUTOLOCK(_lock);
+        folders.swap(_folders);
+    }
+
+    for (std::list<std::shared_ptr<Folder>>::iterator iFolder = folders.begin(); iFolder != folders.end();
+            ++iFolder)
+        stop(*iFolder);
+}
+
+
+/**
+ *  \brief
+ */
+void DbWatcher::GetStats(CText& stats)
+{
+    AUTOLOCK(_lock);
+
+    if (_folders.empty() && !_events)
+        return;
+
+    TCHAR buf[192];
+    _sntprintf_s(buf, _countof(buf), _TRUNCATE,
+            _T(" %u folders watched, %u changes, %u ignored, %u files queued, %u full DB updates\n"),
+            _folders.size(), _events, _ignored, _queued, _fullUpdates);
+
+    stats += buf;
+}
+
+
+/**
+ *  \brief
+ */
+unsigned __stdcall DbWatcher::threadFunc(void* data)
+{
+    std::shared_ptr<Folder>* threadRef = static_cast<std::shared_ptr<Folder>*>(data);
+
+    Instance.watch(**threadRef);
+
+    delete threadRef;
+
+    return 0;
+}
+
+
+/**
+ *  \brief  Watcher thread loop - collects the changes until they calm down and passes them to the DB updater
+ */
+void DbWatcher::watch(Folder& folder)
+{
+    Backend& backend = *folder._backend;
+
+    std::vector<Change> changes;
+    FileSet pending;
+    bool full = false;
+
+    for (bool open = backend.Open(folder._dbPath); open;)
+    {
+        changes.clear();
+
+        Backend::Result_t r = backend.Read((pending.empty() && !full) ? INFINITE : cQuietTime, changes);
+
+        if (r == Backend::STOPPED)
+            break;
+
+        if (r == Backend::QUIET)
+        {
+            flush(folder, pending, full);
+            continue;
+        }
+
+        // The changes are lost so update the whole DB
+        if (r == Backend::OVERFLOWED)
+        {
+            full = true;
+            pending.clear();
+            continue;
+        }
+
+        for (std::vector<Change>::const_iterator iChange = changes.begin(); iChange != changes.end(); ++iChange)
+            onChange(folder, *iChange, pending, full);
+    }
+
+    backend.Close();
+}
+
+
+/**
+ *  \brief  Coalesces a change into the pending set
+ */
+void DbWatcher::onChange(const Folder& folder, const Change& change, FileSet& pending, bool& full)
+{
+    const TCHAR* name = change._name.C_str();
+    const unsigned nameLen = change._name.Len();
+
+    {
+        AUTOLOCK(_lock);
+        ++_events;
+    }
+
+    // DB own changes
+    for (unsigned i = 0; i < _countof(cDbFiles); ++i)
+    {
+        size_t len = _tcslen(cDbFiles[i]);
+        if (nameLen >= len && !_tcsnicmp(name, cDbFiles[i], len))
+        {
+            AUTOLOCK(_lock);
+            ++_ignored;
+            return;
+        }
+    }
+
+    if (full)
+        return;
+
+    CPath file(folder._dbPath);
+    file.Append(name, nameLen);
+
+    // VCS metadata, DB snapshots and excluded paths are not in the DB
+    if (FileWalker::Get().IsExcluded(folder._dbPath, file))
+    {
+        AUTOLOCK(_lock);
+        ++_ignored;
+        return;
+    }
+
+    bool indexed = UpdateFilter::Get().IsIndexed(file);
+
+    // Folder renames / deletions don't report the files in them, neither do folders moved in
+    if (!indexed)
+    {
+        if (needsFullUpdate(folder, change._action, file))
+        {
+            full = true;
+            pending.clear();
+            return;
+        }
+
+        AUTOLOCK(_lock);
+        ++_ignored;
+        return;
+    }
+
+    pending.insert(file);
+
+    // Too many to update one by one - let gtags find the changed files itself
+    if (pending.size() > cMaxPending)
+    {
+        full = true;
+        pending.clear();
+    }
+}
+
+
+/**
+ *  \brief  Checks if a not indexed name change could hide DB files changes - a folder with DB files
+ *          removed or renamed away, or a non-empty folder moved in. The renamed folder new name
+ *          is covered by its old name
+ */
+bool DbWatcher::needsFullUpdate(const Folder& folder, Action_t action, const CPath& file)
+{
+    if (action == REMOVED || action == RENAMED_OLD)
+    {
+        bool has;
+
+        // Can't tell - better update the whole DB than miss the files
+        if (!PathIndex::Get().HasFilesIn(folder._dbPath, file, has))
+            return true;
+
+        return has;
+    }
+
+    if (action != ADDED)
+        return false;
+
+    DWORD attrib = GetFileAttributes(file.C_str());
+    if (attrib == INVALID_FILE_ATTRIBUTES || !(attrib & FILE_ATTRIBUTE_DIRECTORY))
+        return false;
+
+    // Newly created folders are empty - the files created in them are reported on their own
+    CPath pattern(file);
+    pattern += _T("\\*");
+
+    WIN32_FIND_DATA fd;
+    HANDLE hFind = FindFirstFile(pattern.C_str(), &fd);
+    if (hFind == INVALID_HANDLE_VALUE)
+        return false;
+
+    bool empty = true;
+
+    do
+    {
+        if (_tcscmp(fd.cFileName, _T(".")) && _tcscmp(fd.cFileName, _T("..")))
+            empty = false;
+    }
+    while (empty && FindNextFile(hFind, &fd));
+
+    FindClose(hFind);
+
+    return !empty;
+}
+
+
+/**
+ *  \brief  Passes the collected changes to the DB updater
+ */
+void DbWatcher::flush(const Folder& folder, FileSet& pending, bool& full)
+{
+    // Changes are still collected but not acted upon while the auto-update is off
+    if (Config._autoUpdate)
+    {
+        if (full)
+        {
+            {
+                AUTOLOCK(_lock);
+                ++_fullUpdates;
+            }
+
+            UpdateDatabase(folder._dbPath);
+        }
+        else
+        {
+            std::vector<CPath> files(pending.begin(), pending.end());
+
+            {
+                AUTOLOCK(_lock);
+                _queued += files.size();
+            }
+
+            UpdateFiles(files);
+        }
+    }
+
+    pending.clear();
+    full = false;
+}
+
+
+/**
+ *  \brief
+ */
+void DbWatcher::stop(const std::shared_ptr<Folder>& folder)
+{
+    folder->_backend->Stop();
+
+    // Don't block forever - the thread holds its own folder reference and exits on its own
+    WaitForSingleObject(folder->_hThread, cStopTimeout);
+
+    CloseHandle(folder->_hThread);
+    folder->_hThread = NULL;
+}
+
+} // namespace GTags
@@ -0,0 +1,149 @@
+/**
+ *  \file
+ *  \brief  GTags DB folder watcher
+ *
+ *  \author  Pavel Nedev <pg.nedev@gmail.com>
+ *
+ *  \section COPYRIGHT
+ *  Copyright(C) 2015 Pavel Nedev
+ *
+ *  \section LICENSE
+ *  This program is free software; you can redistribute it and/or modify it
+ *  under the terms of the GNU General Public License version 2 as published
+ *  by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful, but
+ *  WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ *  or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ *  for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+#pragma once
+
+
+#include <windows.h>
+#include <tchar.h>
+#include <list>
+#include <memory>
+#include <vector>
+#include <unordered_set>
+#include "Common.h"
+#include "AutoLock.h"
+
+
+namespace GTags
+{
+
+/**
+ *  \class  DbWatcher
+ *  \brief  Watches the DB folder trees for changes made outside Notepad++ and schedules DB updates
+ *          for the changed indexable files once the changes calm down
+ */
+class DbWatcher
+{
+public:
+    /**
+     *  \brief  Change kinds - the FILE_ACTION_* values
+     */
+    enum Action_t
+    {
+        ADDED = 1,
+        REMOVED,
+        MODIFIED,
+        RENAMED_OLD,
+        RENAMED_NEW
+    };
+
+    /**
+     *  \struct  Change
+     *  \brief  Changed path relative to the DB folder
+     */
+    struct Change
+    {
+        Action_t    _action;
+        CText       _name;
+    };
+
+    /**
+     *  \class  Backend
+     *  \brief  Folder tree change notifications of the platform - ReadDirectoryChangesW on Windows,
+     *          inotify elsewhere. Opened, read and closed by the watcher thread, stopped from any thread
+     */
+    class Backend
+    {
+    public:
+        enum Result_t
+        {
+            CHANGED = 0,
+            QUIET,
+            OVERFLOWED,
+            STOPPED
+        };
+
+        static Backend* Create();
+
+        virtual ~Backend() {}
+
+        virtual bool Open(const CPath& dbPath) = 0;
+        virtual Result_t Read(DWORD timeout, std::vector<Change>& changes) = 0;
+        virtual void Close() = 0;
+        virtual void Stop() = 0;
+    };
+
+    static DbWatcher& Get() { return Instance; }
+
+    void Watch(const CPath& dbPath);
+    void Unwatch(const CPath& dbPath);
+    void UnwatchAll();
+    void GetStats(CText& stats);
+
+private:
+    static const DWORD      cQuietTime;
+    static const unsigned   cMaxPending;
+    static const DWORD      cStopTimeout;
+    static const TCHAR*     cDbFiles[];
+
+    typedef std::unordered_set<CPath, CPathHash, CPathEqual> FileSet;
+
+    /**
+     *  \struct  Folder
+     *  \brief  Watched DB folder - owned by its thread while it runs
+     */
+    struct Folder
+    {
+        Folder(const CPath& dbPath) : _dbPath(dbPath), _hThread(NULL) {}
+
+        CPath                       _dbPath;
+        std::unique_ptr<Backend>    _backend;
+        HANDLE                      _hThread;
+    };
+
+    static DbWatcher Instance;
+
+    static unsigned __stdcall threadFunc(void* data);
+
+    DbWatcher() : _events(0), _ignored(0), _queued(0), _fullUpdates(0) {}
+    DbWatcher(const DbWatcher&);
+    ~DbWatcher() {}
+
+    void watch(Folder& folder);
+    void onChange(const Folder& folder, const Change& change, FileSet& pending, bool& full);
+    bool needsFullUpdate(const Folder& folder, Action_t action, const CPath& file);
+    void flush(const Folder& folder, FileSet& pending, bool& full);
+    void stop(const std::shared_ptr<Folder>& folder);
+
+    Mutex                               _lock;
+    std::list<std::shared_ptr<Folder>>  _folders;
+
+    unsigned    _events;
+    unsigned    _ignored;
+    unsigned    _queued;
+    unsigned    _fullUpdates;
+};
+
+} // namespace GTags
@@ -0,0 +1,855 @@
+/**
+ *  \file
+ *  \brief  GTags project file walker
+ *
+ *  \author  Pavel Nedev <pg.nedev@gmail.com>
+ *
+ *  \section COPYRIGHT
+ *  Copyright(C) 2015 Pavel Nedev
+ *
+ *  \section LICENSE
+ *  This program is free software; you can redistribute it and/or modify it
+ *  under the terms of the GNU General Public License version 2 as published
+ *  by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful, but
+ *  WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ *  or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ *  for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <windows.h>
+#include <tchar.h>
+#include <stdio.h>
+#include <process.h>
+#include "Config.h"
+#include "GTags.h"
+#include "FileWalker.h"
+
+
+// Windows 7 and later only
+#ifndef FIND_FIRST_EX_LARGE_FETCH
+#define FIND_FIRST_EX_LARGE_FETCH   2
+#endif
+
+
+namespace
+{
+
+// Set once FindFirstFileEx rejects the Windows 7 basic info / large fetch parameters
+volatile bool FastFindUnsupported = false;
+
+
+/**
+ *  \brief  Starts folder listing - without the short names and with larger fetches where supported
+ */
+HANDLE findFirst(const TCHAR* pattern, WIN32_FIND_DATA& fd)
+{
+    if (!FastFindUnsupported)
+    {
+        HANDLE hFind = FindFirstFileEx(pattern, FindExInfoBasic, &fd, FindExSearchNameMatch, NULL,
+                FIND_FIRST_EX_LARGE_FETCH);
+        if (hFind != INVALID_HANDLE_VALUE || GetLastError() != ERROR_INVALID_PARAMETER)
+            return hFind;
+
+        FastFindUnsupported = true;
+    }
+
+    return FindFirstFileEx(pattern, FindExInfoStandard, &fd, FindExSearchNameMatch, NULL, 0);
+}
+
+} // anonymous namespace
+
+
+namespace GTags
+{
+
+// Folder listing is I/O bound so a few threads are enough to keep the disk busy
+const unsigned  FileWalker::cMaxThreads     = 8;
+const unsigned  FileWalker::cMaxCachedDirs  = 200000;
+// Later files take precedence
+const TCHAR*    FileWalker::cIgnoreFiles[]  = { _T(".gitignore"), _T(".ignore") };
+const TCHAR*    FileWalker::cSkipDirs[]     = { _T(".git"), _T(".svn"), _T(".hg"), _T(".bzr"), _T("CVS") };
+// DB update snapshot folders
+const TCHAR     FileWalker::cSnapshotPrefix[] = _T("GTAGS.");
+
+
+FileWalker FileWalker::Instance;
+
+
+/**
+ *  \brief  Walks the DB folder tree and writes the files to index to a new temp file (gtags -f format)
+ */
+bool FileWalker::Walk(const CPath& dbPath, CPath& listFile)
+{
+    DWORD startTime = GetTickCount();
+
+    CPath root(dbPath);
+    if (root.IsEmpty())
+        return false;
+    if (root.C_str()[root.Len() - 1] != _T('\\'))
+        root += _T("\\");
+
+    // Root that can't be listed gives empty list - let gtags walk the tree itself then
+    {
+        DirEntry entry;
+        bool cached;
+
+        if (!listDir(root, entry, cached))
+            return false;
+    }
+
+    Context ctx(root);
+    loadExcludeList(ctx._exclude);
+
+    ctx._hWork = CreateSemaphore(NULL, 0, 0x7FFFFFFF, NULL);
+    if (!ctx._hWork)
+        return false;
+
+    SYSTEM_INFO si;
+    GetSystemInfo(&si);
+
+    unsigned threadsCount = si.dwNumberOfProcessors;
+    if (threadsCount > cMaxThreads)
+        threadsCount = cMaxThreads;
+    else if (threadsCount == 0)
+        threadsCount = 1;
+
+    ctx._out.resize(threadsCount);
+
+    Job job;
+    job._path = root;
+
+    ctx._jobs.push_back(job);
+    ctx._pending = 1;
+    ReleaseSemaphore(ctx._hWork, 1, NULL);
+
+    std::vector<Worker> workers(threadsCount);
+    std::vector<HANDLE> threads;
+
+    for (unsigned i = 1; i < threadsCount; ++i)
+    {
+        workers[i]._ctx = &ctx;
+        workers[i]._idx = i;
+
+        HANDLE hThread = (HANDLE)_beginthreadex(NULL, 0, threadFunc, &workers[i], 0, NULL);
+        if (hThread)
+            threads.push_back(hThread);
+    }
+
+    // The calling thread walks too - with no helper threads it walks alone
+    work(ctx, 0);
+
+    if (!threads.empty())
+    {
+        WaitForMultipleObjects(threads.size(), threads.data(), TRUE, INFINITE);
+
+        for (unsigned i = 0; i < threads.size(); ++i)
+            CloseHandle(threads[i]);
+    }
+
+    CloseHandle(ctx._hWork);
+
+    TCHAR tmpDir[MAX_PATH];
+    TCHAR tmpFile[MAX_PATH];
+
+    if (!GetTempPath(_countof(tmpDir), tmpDir) || !GetTempFileName(tmpDir, _T("gtl"), 0, tmpFile))
+        return false;
+
+    FILE* fp;
+    _tfopen_s(&fp, tmpFile, _T("wb"));
+    if (fp == NULL)
+    {
+        DeleteFile(tmpFile);
+        return false;
+    }
+
+    bool success = true;
+
+    for (unsigned i = 0; success && i < ctx._out.size(); ++i)
+        if (!ctx._out[i].empty())
+            success = (fwrite(ctx._out[i].data(), 1, ctx._out[i].size(), fp) == ctx._out[i].size());
+
+    fclose(fp);
+
+    if (!success)
+    {
+        DeleteFile(tmpFile);
+        return false;
+    }
+
+    listFile = tmpFile;
+
+    AUTOLOCK(_lock);
+
+    ++_walks;
+    _lastTime = GetTickCount() - startTime;
+    _dirs += ctx._dirs;
+    _cachedDirs += ctx._cachedDirs;
+    _files += ctx._files;
+    _excluded += ctx._excluded;
+
+    return true;
+}
+
+
+/**
+ *  \brief  Checks if the file under the DB folder would be left out by the walker
+ */
+bool FileWalker::IsExcluded(const CPath& dbPath, const CPath& file)
+{
+    unsigned rootLen = dbPath.Len();
+    if (rootLen == 0 || file.Len() <= rootLen || _tcsnicmp(file.C_str(), dbPath.C_str(), rootLen))
+        return false;
+
+    Context ctx(dbPath);
+    loadExcludeList(ctx._exclude);
+
+    CText rel(file.C_str() + rootLen);
+    for (TCHAR* c = rel.C_str(); *c; ++c)
+        if (*c == _T('\\'))
+            *c = _T('/');
+
+    std::shared_ptr<const Rules> rules;
+    CPath dir(dbPath);
+
+    for (const TCHAR* name = rel.C_str();;)
+    {
+        DirEntry entry;
+        bool cached;
+
+        if (listDir(dir, entry, cached) && !entry._rules.empty())
+        {
+            Rules* dirRules = new Rules;
+            dirRules->_parent = rules;
+            dirRules->_base.Append(rel.C_str(), name - rel.C_str());
+            dirRules->_rules.swap(entry._rules);
+            rules.reset(dirRules);
+        }
+
+        const TCHAR* sep = _tcschr(name, _T('/'));
+        unsigned nameLen = sep ? sep - name : _tcslen(name);
+
+        CText relName;
+        relName.Append(rel.C_str(), name - rel.C_str() + nameLen);
+
+        CText dirName;
+        dirName.Append(name, nameLen);
+
+        // Could be a removed folder as well - VCS metadata and DB snapshot names are skipped either way
+        if (!sep)
+            return isSkippedDir(dirName.C_str()) ||
+                    isExcluded(ctx, rules.get(), relName.C_str(), dirName.C_str(), false);
+
+        if (isSkippedDir(dirName.C_str()) || isExcluded(ctx, rules.get(), relName.C_str(), dirName.C_str(), true))
+            return true;
+
+        dir += dirName;
+        dir += _T("\\");
+        name = sep + 1;
+    }
+}
+
+
+/**
+ *  \brief  Drops the cached listings of the DB folder tree
+ */
+void FileWalker::Invalidate(const CPath& dbPath)
+{
+    unsigned len = dbPath.Len();
+
+    AUTOLOCK(_lock);
+
+    for (std::unordered_map<CPath, DirEntry, CPathHash, CPathEqual>::iterator iDir = _cache.begin();
+            iDir != _cache.end();)
+    {
+        if (iDir->first.Len() >= len && !_tcsnicmp(iDir->first.C_str(), dbPath.C_str(), len))
+            iDir = _cache.erase(iDir);
+        else
+            ++iDir;
+    }
+}
+
+
+/**
+ *  \brief
+ */
+void FileWalker::GetStats(CText& stats)
+{
+    AUTOLOCK(_lock);
+
+    if (!_walks)
+        return;
+
+    TCHAR buf[192];
+    _sntprintf_s(buf, _countof(buf), _TRUNCATE,
+            _T(" %u walks, last %u ms, %u folders listed, %u from cache, %u files, %u excluded\n"),
+            _walks, _lastTime, _dirs, _cachedDirs, _files, _excluded);
+
+    stats += buf;
+}
+
+
+/**
+ *  \brief
+ */
+unsigned __stdcall FileWalker::threadFunc(void* data)
+{
+    Worker* worker = static_cast<Worker*>(data);
+
+    Instance.work(*worker->_ctx, worker->_idx);
+
+    return 0;
+}
+
+
+/**
+ *  \brief  Case-insensitive gitignore style wildcard match - '*' and '?' don't match '/', '**' does
+ */
+bool FileWalker::globMatch(const TCHAR* pattern, const TCHAR* str)
+{
+    for (; *pattern; ++pattern, ++str)
+    {
+        if (*pattern == _T('*'))
+        {
+            if (pattern[1] == _T('*'))
+            {
+                pattern += 2;
+
+                // "**/" matches zero or more folders
+                if (*pattern == _T('/'))
+                {
+                    ++pattern;
+
+                    for (;;)
+                    {
+                        if (globMatch(pattern, str))
+                            return true;
+
+                        str = _tcschr(str, _T('/'));
+                        if (!str)
+                            return false;
+                        ++str;
+                    }
+                }
+
+                for (;; ++str)
+                {
+                    if (globMatch(pattern, str))
+                        return true;
+                    if (!*str)
+                        return false;
+                }
+            }
+
+            for (++pattern;; ++str)
+            {
+                if (globMatch(pattern, str))
+                    return true;
+                if (!*str || *str == _T('/'))
+                    return false;
+            }
+        }
+
+        if (!*str)
+            return false;
+
+        if (*pattern == _T('?'))
+        {
+            if (*str == _T('/'))
+                return false;
+            continue;
+        }
+
+        if (*pattern == _T('['))
+        {
+            const TCHAR* end = _tcschr(pattern + 1, _T(']'));
+
+            // Not a class - match '[' literally
+            if (end && end > pattern + 1)
+            {
+                const TCHAR* c = pattern + 1;
+                bool negate = (*c == _T('!') || *c == _T('^'));
+                if (negate)
+                    ++c;
+
+                TCHAR ch = _totlower(*str);
+                bool found = false;
+
+                for (; c < end; ++c)
+                {
+                    if (c + 2 < end && c[1] == _T('-'))
+                    {
+                        if (ch >= _totlower(c[0]) && ch <= _totlower(c[2]))
+                            found = true;
+                        c += 2;
+                    }
+                    else if (ch == _totlower(*c))
+                    {
+                        found = true;
+                    }
+                }
+
+                if (found == negate || *str == _T('/'))
+                    return false;
+
+                pattern = end;
+                continue;
+            }
+        }
+
+        if (*pattern == _T('\\') && pattern[1])
+            ++pattern;
+
+        if (_totlower(*pattern) != _totlower(*str))
+            return false;
+    }
+
+    return !*str;
+}
+
+
+/**
+ *  \brief  Parses single ignore pattern line
+ */
+void FileWalker::addRule(const TCHAR* str, unsigned len, std::vector<Rule>& rules)
+{
+    // Trailing spaces are ignored unless escaped
+    while (len && (str[len - 1] == _T(' ') || str[len - 1] == _T('\t') || str[len - 1] == _T('\r')) &&
+            !(len > 1 && str[len - 2] == _T('\\')))
+        --len;
+
+    while (len && (*str == _T(' ') || *str == _T('\t')))
+    {
+        ++str;
+        --len;
+    }
+
+    if (len == 0 || *str == _T('#'))
+        return;
+
+    Rule rule;
+
+    if (*str == _T('!'))
+    {
+        rule._negate = true;
+        ++str;
+        --len;
+    }
+    else if (*str == _T('\\') && len > 1 && (str[1] == _T('!') || str[1] == _T('#')))
+    {
+        ++str;
+        --len;
+    }
+
+    if (len && str[len - 1] == _T('/'))
+    {
+        rule._dirOnly = true;
+        --len;
+    }
+
+    for (unsigned i = 0; i < len; ++i)
+    {
+        if (str[i] == _T('/'))
+        {
+            rule._anchored = true;
+            break;
+        }
+    }
+
+    if (len && *str == _T('/'))
+    {
+        ++str;
+        --len;
+    }
+
+    if (len == 0)
+        return;
+
+    rule._pattern.Append(str, len);
+    rules.push_back(rule);
+}
+
+
+/**
+ *  \brief  Reads the patterns of UTF-8 encoded ignore file
+ */
+void FileWalker::readRules(const CPath& file, std::vector<Rule>& rules)
+{
+    FILE* fp;
+    _tfopen_s(&fp, file.C_str(), _T("rb"));
+    if (fp == NULL)
+        return;
+
+    std::vector<char> text;
+    char buf[4096];
+    size_t len;
+
+    while ((len = fread(buf, 1, sizeof(buf), fp)) > 0)
+        text.insert(text.end(), buf, buf + len);
+
+    fclose(fp);
+
+    text.push_back('\n');
+
+    std::vector<TCHAR> line;
+
+    for (size_t pos = 0, end; pos < text.size(); pos = end + 1)
+    {
+        for (end = pos; text[end] != '\n'; ++end);
+
+        if (end == pos)
+            continue;
+
+        int lineLen = MultiByteToWideChar(CP_UTF8, 0, &text[pos], end - pos, NULL, 0);
+        if (lineLen <= 0)
+            continue;
+
+        line.resize(lineLen);
+        MultiByteToWideChar(CP_UTF8, 0, &text[pos], end - pos, line.data(), lineLen);
+
+        addRule(line.data(), lineLen, rules);
+    }
+}
+
+
+/**
+ *  \brief  Appends the relative path to the list in the form gtags expects
+ */
+void FileWalker::appendPath(std::vector<char>& out, const TCHAR* rel)
+{
+    int len = WideCharToMultiByte(CP_ACP, 0, rel, -1, NULL, 0, NULL, NULL);
+    if (len <= 0)
+        return;
+
+    size_t pos = out.size();
+
+    out.resize(pos + len + 2);
+    out[pos] = '.';
+    out[pos + 1] = '/';
+    WideCharToMultiByte(CP_ACP, 0, rel, -1, &out[pos + 2], len, NULL, NULL);
+    // Replace the terminating '\0'
+    out.back() = '\n';
+}
+
+
+/**
+ *  \brief  Checks the rules from the last - the one that matches first decides
+ */
+bool FileWalker::matches(const std::vector<Rule>& rules, const TCHAR* rel, const TCHAR* name, bool isDir,
+        bool& excluded)
+{
+    for (unsigned i = rules.size(); i; --i)
+    {
+        const Rule& rule = rules[i - 1];
+
+        if (rule._dirOnly && !isDir)
+            continue;
+
+        if (globMatch(rule._pattern.C_str(), rule._anchored ? rel : name))
+        {
+            excluded = !rule._negate;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+
+/**
+ *  \brief  The plugin exclude list can't be overridden, deeper ignore files take precedence over the upper ones
+ */
+bool FileWalker::isExcluded(const Context& ctx, const Rules* rules, const TCHAR* rel, const TCHAR* name,
+        bool isDir)
+{
+    bool excluded = false;
+
+    if (matches(ctx._exclude, rel, name, isDir, excluded) && excluded)
+        return true;
+
+    for (; rules; rules = rules->_parent.get())
+        if (matches(rules->_rules, rel + rules->_base.Len(), name, isDir, excluded))
+            return excluded;
+
+    return false;
+}
+
+
+/**
+ *  \brief
+ */
+bool FileWalker::isSkippedDir(const TCHAR* name)
+{
+    for (unsigned i = 0; i < _countof(cSkipDirs); ++i)
+        if (!_tcsicmp(name, cSkipDirs[i]))
+            return true;
+
+    return !_tcsnicmp(name, cSnapshotPrefix, _countof(cSnapshotPrefix) - 1);
+}
+
+
+/**
+ *  \brief  Walker thread loop - takes folders from the queue until the whole tree is walked
+ */
+void FileWalker::work(Context& ctx, unsigned idx)
+{
+    for (;;)
+    {
+        WaitForSingleObject(ctx._hWork, INFINITE);
+
+        Job job;
+
+        {
+            AUTOLOCK(ctx._lock);
+
+            // Woken up with nothing to do - the walk is over
+            if (ctx._jobs.empty())
+                return;
+
+            job = ctx._jobs.front();
+            ctx._jobs.pop_front();
+        }
+
+        walkDir(ctx, job, ctx._out[idx]);
+
+        bool done;
+
+        {
+            AUTOLOCK(ctx._lock);
+            done = (--ctx._pending == 0);
+        }
+
+        if (done)
+            ReleaseSemaphore(ctx._hWork, ctx._out.size(), NULL);
+    }
+}
+
+
+/**
+ *  \brief  Lists the files of a single folder and queues its sub-folders
+ */
+void FileWalker::walkDir(Context& ctx, const Job& job, std::vector<char>& out)
+{
+    DirEntry entry;
+    bool cached;
+
+    if (!listDir(job._path, entry, cached))
+        return;
+
+    std::shared_ptr<const Rules> rules(job._rules);
+
+    if (!entry._rules.empty())
+    {
+        Rules* dirRules = new Rules;
+        dirRules->_parent = job._rules;
+        dirRules->_base = job._rel;
+        dirRules->_rules.swap(entry._rules);
+        rules.reset(dirRules);
+    }
+
+    unsigned relLen = job._rel.Len();
+    std::vector<TCHAR> rel(job._rel.C_str(), job._rel.C_str() + relLen);
+
+    unsigned files = 0;
+    unsigned excluded = 0;
+
+    for (const TCHAR* name = entry._files.data(); name < entry._files.data() + entry._files.size();
+            name += _tcslen(name) + 1)
+    {
+        rel.resize(relLen);
+        rel.insert(rel.end(), name, name + _tcslen(name) + 1);
+
+        if (isExcluded(ctx, rules.get(), rel.data(), name, false))
+        {
+            ++excluded;
+            continue;
+        }
+
+        appendPath(out, rel.data());
+        ++files;
+    }
+
+    std::vector<Job> subDirs;
+
+    for (const TCHAR* name = entry._dirs.data(); name < entry._dirs.data() + entry._dirs.size();
+            name += _tcslen(name) + 1)
+    {
+        if (isSkippedDir(name))
+            continue;
+
+        rel.resize(relLen);
+        rel.insert(rel.end(), name, name + _tcslen(name) + 1);
+
+        if (isExcluded(ctx, rules.get(), rel.data(), name, true))
+        {
+            ++excluded;
+            continue;
+        }
+
+        subDirs.push_back(Job());
+
+        Job& subDir = subDirs.back();
+        subDir._path = job._path;
+        subDir._path += name;
+        subDir._path += _T("\\");
+        subDir._rel = rel.data();
+        subDir._rel += _T("/");
+        subDir._rules = rules;
+    }
+
+    {
+        AUTOLOCK(ctx._lock);
+
+        ctx._jobs.insert(ctx._jobs.end(), subDirs.begin(), subDirs.end());
+        ctx._pending += subDirs.size();
+
+        ++ctx._dirs;
+        if (cached)
+            ++ctx._cachedDirs;
+        ctx._files += files;
+        ctx._excluded += excluded;
+    }
+
+    if (!subDirs.empty())
+        ReleaseSemaphore(ctx._hWork, subDirs.size(), NULL);
+}
+
+
+/**
+ *  \brief  Gets the folder listing - from the cache if the folder is not modified since it was cached
+ */
+bool FileWalker::listDir(const CPath& path, DirEntry& entry, bool& cached)
+{
+    cached = false;
+
+    WIN32_FILE_ATTRIBUTE_DATA attr;
+    if (!GetFileAttributesEx(path.C_str(), GetFileExInfoStandard, &attr))
+        return false;
+
+    {
+        AUTOLOCK(_lock);
+
+        std::unordered_map<CPath, DirEntry, CPathHash, CPathEqual>::iterator iDir = _cache.find(path);
+        if (iDir != _cache.end() && !CompareFileTime(&iDir->second._mtime, &attr.ftLastWriteTime))
+        {
+            entry = iDir->second;
+            cached = true;
+        }
+    }
+
+    bool reloadRules = false;
+
+    if (cached)
+    {
+        // Editing the ignore file doesn't change the folder time
+        for (unsigned i = 0; i < _countof(cIgnoreFiles); ++i)
+        {
+            if (!entry._ignoreTimes[i].dwLowDateTime && !entry._ignoreTimes[i].dwHighDateTime)
+                continue;
+
+            CPath ignoreFile(path);
+            ignoreFile += cIgnoreFiles[i];
+
+            WIN32_FILE_ATTRIBUTE_DATA ignoreAttr;
+            if (!GetFileAttributesEx(ignoreFile.C_str(), GetFileExInfoStandard, &ignoreAttr))
+                ignoreAttr.ftLastWriteTime.dwLowDateTime = ignoreAttr.ftLastWriteTime.dwHighDateTime = 0;
+
+            if (CompareFileTime(&entry._ignoreTimes[i], &ignoreAttr.ftLastWriteTime))
+            {
+                entry._ignoreTimes[i] = ignoreAttr.ftLastWriteTime;
+                reloadRules = true;
+            }
+        }
+
+        if (!reloadRules)
+            return true;
+    }
+    else
+    {
+        CPath pattern(path);
+        pattern += _T("*");
+
+        WIN32_FIND_DATA fd;
+        HANDLE hFind = findFirst(pattern.C_str(), fd);
+        if (hFind == INVALID_HANDLE_VALUE)
+            return false;
+
+        entry._mtime = attr.ftLastWriteTime;
+        for (unsigned i = 0; i < _countof(cIgnoreFiles); ++i)
+            entry._ignoreTimes[i].dwLowDateTime = entry._ignoreTimes[i].dwHighDateTime = 0;
+
+        do
+        {
+            const TCHAR* name = fd.cFileName;
+
+            if (fd.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
+            {
+                // Links could make the walk loop forever
+                if ((fd.dwFileAttributes & FILE_ATTRIBUTE_REPARSE_POINT) ||
+                        !_tcscmp(name, _T(".")) || !_tcscmp(name, _T("..")))
+                    continue;
+
+                entry._dirs.insert(entry._dirs.end(), name, name + _tcslen(name) + 1);
+            }
+            else
+            {
+                entry._files.insert(entry._files.end(), name, name + _tcslen(name) + 1);
+
+                for (unsigned i = 0; i < _countof(cIgnoreFiles); ++i)
+                    if (!_tcsicmp(name, cIgnoreFiles[i]))
+                        entry._ignoreTimes[i] = fd.ftLastWriteTime;
+            }
+        }
+        while (FindNextFile(hFind, &fd));
+
+        FindClose(hFind);
+    }
+
+    entry._rules.clear();
+
+    for (unsigned i = 0; i < _countof(cIgnoreFiles); ++i)
+    {
+        if (!entry._ignoreTimes[i].dwLowDateTime && !entry._ignoreTimes[i].dwHighDateTime)
+            continue;
+
+        CPath ignoreFile(path);
+        ignoreFile += cIgnoreFiles[i];
+        readRules(ignoreFile, entry._rules);
+    }
+
+    AUTOLOCK(_lock);
+
+    if (_cache.size() >= cMaxCachedDirs)
+        _cache.clear();
+
+    _cache[path] = entry;
+
+    return true;
+}
+
+
+/**
+ *  \brief  Reads the ';' separated patterns of the plugin exclude list
+ */
+void FileWalker::loadExcludeList(std::vector<Rule>& rules)
+{
+    const TCHAR* list = Config._excludeList.C_str();
+
+    for (const TCHAR* sep = list;; list = sep + 1)
+    {
+        sep = _tcschr(list, _T(';'));
+        if (!sep)
+        {
+            addRule(list, _tcslen(list), rules);
+            break;
+        }
+
+        addRule(list, sep - list, rules);
+    }
+}
+
+} // namespace GTags
@@ -0,0 +1,185 @@
+/**
+ *  \file
+ *  \brief  GTags project file walker
+ *
+ *  \author  Pavel Nedev <pg.nedev@gmail.com>
+ *
+ *  \section COPYRIGHT
+ *  Copyright(C) 2015 Pavel Nedev
+ *
+ *  \section LICENSE
+ *  This program is free software; you can redistribute it and/or modify it
+ *  under the terms of the GNU General Public License version 2 as published
+ *  by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful, but
+ *  WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ *  or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ *  for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+
+#include <windows.h>
+#include <tchar.h>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <unordered_map>
+#include "Common.h"
+#include "AutoLock.h"
+
+
+namespace GTags
+{
+
+/**
+ *  \class  FileWalker
+ *  \brief  Walks the project tree in several threads and writes the list of files gtags shall index.
+ *          Skips VCS metadata, the paths matched by .gitignore / .ignore files and by the plugin exclude
+ *          list. Folder listings are cached and re-read only when the folder modification time changes
+ */
+class FileWalker
+{
+public:
+    static FileWalker& Get() { return Instance; }
+
+    bool Walk(const CPath& dbPath, CPath& listFile);
+    bool IsExcluded(const CPath& dbPath, const CPath& file);
+    void Invalidate(const CPath& dbPath);
+    void GetStats(CText& stats);
+
+private:
+    static const unsigned   cMaxThreads;
+    static const unsigned   cMaxCachedDirs;
+    static const TCHAR*     cIgnoreFiles[];
+    static const TCHAR*     cSkipDirs[];
+    static const TCHAR      cSnapshotPrefix[];
+
+    /**
+     *  \struct  Rule
+     *  \brief  Single ignore pattern
+     */
+    struct Rule
+    {
+        Rule() : _negate(false), _dirOnly(false), _anchored(false) {}
+
+        CText   _pattern;
+        bool    _negate;
+        bool    _dirOnly;
+        // Matched against the path relative to the ignore file folder instead of the name only
+        bool    _anchored;
+    };
+
+    /**
+     *  \struct  Rules
+     *  \brief  Rules of one folder ignore files chained to the rules of its parent folders
+     */
+    struct Rules
+    {
+        std::shared_ptr<const Rules>    _parent;
+        // Folder path relative to the DB root ('/' separated, with trailing '/')
+        CText                           _base;
+        std::vector<Rule>               _rules;
+    };
+
+    /**
+     *  \struct  DirEntry
+     *  \brief  Cached folder listing - the names are '\0' separated
+     */
+    struct DirEntry
+    {
+        FILETIME            _mtime;
+        std::vector<TCHAR>  _files;
+        std::vector<TCHAR>  _dirs;
+        FILETIME            _ignoreTimes[2];
+        std::vector<Rule>   _rules;
+    };
+
+    /**
+     *  \struct  Job
+     *  \brief  Folder waiting to be walked
+     */
+    struct Job
+    {
+        CPath                           _path;
+        CText                           _rel;
+        std::shared_ptr<const Rules>    _rules;
+    };
+
+    /**
+     *  \struct  Context
+     *  \brief  State shared by the threads of a single walk
+     */
+    struct Context
+    {
+        Context(const CPath& root) : _root(root), _pending(0), _hWork(NULL),
+            _dirs(0), _cachedDirs(0), _files(0), _excluded(0) {}
+
+        const CPath&            _root;
+        std::vector<Rule>       _exclude;
+
+        Mutex                   _lock;
+        std::deque<Job>         _jobs;
+        // Jobs queued or being walked
+        unsigned                _pending;
+        HANDLE                  _hWork;
+
+        // Each thread writes its own part of the list
+        std::vector<std::vector<char>> _out;
+
+        unsigned                _dirs;
+        unsigned                _cachedDirs;
+        unsigned                _files;
+        unsigned                _excluded;
+    };
+
+    /**
+     *  \struct  Worker
+     *  \brief  Walker thread parameters
+     */
+    struct Worker
+    {
+        Context*    _ctx;
+        unsigned    _idx;
+    };
+
+    static FileWalker Instance;
+
+    static unsigned __stdcall threadFunc(void* data);
+    static bool globMatch(const TCHAR* pattern, const TCHAR* str);
+    static void addRule(const TCHAR* str, unsigned len, std::vector<Rule>& rules);
+    static void readRules(const CPath& file, std::vector<Rule>& rules);
+    static void appendPath(std::vector<char>& out, const TCHAR* rel);
+    static bool matches(const std::vector<Rule>& rules, const TCHAR* rel, const TCHAR* name, bool isDir,
+            bool& excluded);
+    static bool isExcluded(const Context& ctx, const Rules* rules, const TCHAR* rel, const TCHAR* name,
+            bool isDir);
+    static bool isSkippedDir(const TCHAR* name);
+
+    FileWalker() : _walks(0), _lastTime(0), _dirs(0), _cachedDirs(0), _files(0), _excluded(0) {}
+    FileWalker(const FileWalker&);
+    ~FileWalker() {}
+
+    void work(Context& ctx, unsigned idx);
+    void walkDir(Context& ctx, const Job& job, std::vector<char>& out);
+    bool listDir(const CPath& path, DirEntry& entry, bool& cached);
+    void loadExcludeList(std::vector<Rule>& rules);
+
+    Mutex   _lock;
+
+    std::unordered_map<CPath, DirEntry, CPathHash, CPathEqual> _cache;
+
+    unsigned    _walks;
+    unsigned    _lastTime;
+    unsigned    _dirs;
+    unsigned    _cachedDirs;
+    unsigned    _files;
+    unsigned    _excluded;
+};
+
+} // namespace GTags
@@ -26,12 +26,26 @@
 #include <tchar.h>
 #include <shlobj.h>
 #include <list>
+#include <vector>
+#include <unordered_map>
+#include <unordered_set>
 #include "AutoLock.h"
+#include "Trace.h"
 #include "Common.h"
 #include "INpp.h"
 #include "Config.h"
 #include "DbManager.h"
 #include "CmdEngine.h"
+#include "ComplCache.h"
+#include "ComplRank.h"
+#include "TagIndex.h"
+#include "PathIndex.h"
+#include "PathTable.h"
+#include "UpdateFilter.h"
+#include "DbWatcher.h"
+#include "DbWarmer.h"
+#include "FileWalker.h"
+#include "TagFilter.h"
 #include "DocLocation.h"
 #include "SearchWin.h"
 #include "ActivityWin.h"
@@ -53,19 +67,67 @@ using namespace GTags;
 
 const TCHAR cCreateDatabase[]   = _T("Create Database");
 const TCHAR cUpdateSingle[]     = _T("Database Single File Update");
+const TCHAR cUpdateIncremental[] = _T("Database Incremental Update");
 const TCHAR cAutoCompl[]        = _T("AutoComplete");
 const TCHAR cAutoComplFile[]    = _T("AutoComplete Filename");
 const TCHAR cFindFile[]         = _T("Find File");
+const TCHAR cFindSibling[]      = _T("Find Header / Source");
 const TCHAR cFindDefinition[]   = _T("Find Definition");
 const TCHAR cFindReference[]    = _T("Find Reference");
 const TCHAR cFindSymbol[]       = _T("Find Symbol");
 const TCHAR cSearch[]           = _T("Search");
 const TCHAR cVersion[]          = _T("About");
 
+const TCHAR cTraceFile[]        = _T("NppGTags_trace.json");
+const TCHAR cTimingsFile[]      = _T("NppGTags_timings.json");
+// Saved trace covers that many last ms
+const DWORD cTracePeriod        = 30000;
 
-std::list<CPath> UpdateList;
+
+/**
+ *  \struct  UpdateRequest
+ *  \brief  Saved file or DB (interned path id) to be updated as a whole
+ */
+struct UpdateRequest
+{
+    UpdateRequest(const CPath& file, DWORD time) : _file(file), _db(cNoPath), _time(time) {}
+    UpdateRequest(PathId db, DWORD time) : _db(db), _time(time) {}
+
+    CPath   _file;
+    PathId  _db;
+    DWORD   _time;
+};
+
+// Update requests from any thread without locking, moved to the lists below by runUpdate
+MpscQueue<UpdateRequest> UpdateQueue;
+
+// Saved files waiting for DB update and the time they were saved. Files are not interned -
+// the path table never drops entries and files changed outside Notepad++ are countless
+std::unordered_map<CPath, DWORD, CPathHash, CPathEqual> UpdateList;
+// DBs (interned path ids) to be updated as a whole - too many or unknown files changed
+std::unordered_set<PathId> FullUpdateList;
+// Earliest save time and files count of the running DB updates
+std::unordered_map<DbHandle, std::pair<DWORD, unsigned>> UpdateStart;
+// Guards the lists above
 Mutex UpdateLock;
 
+// Saves are collected for this long after the last one and then the DB is updated for all of them at once
+const UINT cUpdateDelay = 300;
+UINT_PTR UpdateTimer = 0;
+volatile DWORD LastSave = 0;
+
+// DB updates lost because the path table is full
+volatile LONG DroppedUpdates = 0;
+
+unsigned UpdateBatches  = 0;
+unsigned UpdatedFiles   = 0;
+unsigned UpdateTotalTime = 0;
+unsigned UpdateMaxTime  = 0;
+
+unsigned CreateCount    = 0;
+unsigned CreateLastTime = 0;
+unsigned CreateMaxTime  = 0;
+
 
 /**
 *  \brief
@@ -146,6 +208,8 @@ CText getSelection(bool autoSelectWord = false, bool skipPreSelect = false)
  */
 DbHandle getDatabase(bool writeEn = false)
 {
+    TRACE_SPAN("getDatabase");
+
     INpp& npp = INpp::Get();
     bool success;
     CPath currentFile;
@@ -161,6 +225,11 @@ DbHandle getDatabase(bool writeEn = false)
         MessageBox(npp.GetHandle(), _T("GTags database is currently in use"), cPluginName, MB_OK | MB_ICONINFORMATION);
         db = NULL;
     }
+    else if (Config._autoUpdate)
+    {
+        // Keep the DB fresh for changes made outside Notepad++ too
+        DbWatcher::Get().Watch(*db);
+    }
 
     return db;
 }
@@ -178,49 +247,74 @@ int CALLBACK browseFolderCB(HWND hWnd, UINT uMsg, LPARAM, LPARAM lpData)
 
 
 /**
- *  \brief
+ *  \brief  Records the time from the first save in the update batch until the DB is fresh.
+ *          Returns the number of saved files in the batch, 0 for whole DB update
  */
-void sheduleForUpdate(const CPath& file)
+unsigned updateDone(const std::shared_ptr<Cmd>& cmd)
 {
     AUTOLOCK(UpdateLock);
 
-    std::list<CPath>::reverse_iterator iFile;
-    for (iFile = UpdateList.rbegin(); iFile != UpdateList.rend(); ++iFile)
-        if (*iFile == file)
-            return;
+    std::unordered_map<DbHandle, std::pair<DWORD, unsigned>>::iterator iStart = UpdateStart.find(cmd->Db());
+    if (iStart == UpdateStart.end())
+        return 0;
+
+    const unsigned files = iStart->second.second;
+
+    if (cmd->Status() == OK)
+    {
+        unsigned time = GetTickCount() - iStart->second.first;
+
+        ++UpdateBatches;
+        UpdatedFiles += iStart->second.second;
+        UpdateTotalTime += time;
+        if (UpdateMaxTime < time)
+            UpdateMaxTime = time;
+    }
+
+    UpdateStart.erase(iStart);
 
-    UpdateList.push_back(file);
+    return files;
 }
 
 
 /**
- *  \brief
+ *  \brief  Records the DB creation time
  */
-bool runSheduledUpdate(const TCHAR* dbPath)
+void createDone(const std::shared_ptr<Cmd>& cmd)
 {
-    CPath file;
+    AUTOLOCK(UpdateLock);
+
+    std::unordered_map<DbHandle, std::pair<DWORD, unsigned>>::iterator iStart = UpdateStart.find(cmd->Db());
+    if (iStart == UpdateStart.end())
+        return;
+
+    if (cmd->Status() == OK)
     {
-        AUTOLOCK(UpdateLock);
+        CreateLastTime = GetTickCount() - iStart->second.first;
 
-        if (UpdateList.empty())
-            return false;
+        ++CreateCount;
+        if (CreateMaxTime < CreateLastTime)
+            CreateMaxTime = CreateLastTime;
+    }
 
-        std::list<CPath>::iterator iFile;
-        for (iFile = UpdateList.begin(); iFile != UpdateList.end(); ++iFile)
-            if (iFile->IsSubpathOf(dbPath))
-                break;
+    UpdateStart.erase(iStart);
+}
 
-        if (iFile == UpdateList.end())
-            return false;
 
-        file = *iFile;
-        UpdateList.erase(iFile);
+/**
+ *  \brief  Starts DB creation. Existing DB is re-created in a snapshot (it is update locked) so lookups
+ *          can still use the old DB until the new one is ready
+ */
+void runCreate(DbHandle db, CompletionCB complCB)
+{
+    {
+        AUTOLOCK(UpdateLock);
+        UpdateStart[db] = std::make_pair(GetTickCount(), 0U);
     }
 
-    if (!UpdateSingleFile(file))
-        return runSheduledUpdate(dbPath);
-
-    return true;
+    std::shared_ptr<Cmd> cmd(new Cmd(CREATE_DATABASE, cCreateDatabase, db));
+    releaseKeys();
+    CmdEngine::Run(cmd, complCB);
 }
 
 
@@ -229,12 +323,50 @@ bool runSheduledUpdate(const TCHAR* dbPath)
  */
 void dbWriteReady(const std::shared_ptr<Cmd>& cmd)
 {
-    if (cmd->Status() != OK && cmd->Id() == CREATE_DATABASE)
+    unsigned updatedFiles = 0;
+
+    if (cmd->Id() == UPDATE_SINGLE || cmd->Id() == UPDATE_INCREMENTAL)
+        updatedFiles = updateDone(cmd);
+    else if (cmd->Id() == CREATE_DATABASE)
+        createDone(cmd);
+
+    // The hashes of the files that failed to update don't match the DB content
+    if (cmd->Status() != OK || cmd->Id() == CREATE_DATABASE)
+        UpdateFilter::Get().Invalidate(cmd->DbPath());
+    else
+        UpdateFilter::Get().Commit(cmd->DbPath());
+
+    ComplCache::Get().Invalidate(cmd->DbPath());
+    TagIndex::Get().Invalidate(cmd->DbPath());
+
+    // Ranking the whole DB is costly - saved files only count towards its re-build
+    if (updatedFiles)
+        ComplRank::Get().FilesUpdated(cmd->DbPath(), updatedFiles);
+    else
+        ComplRank::Get().Invalidate(cmd->DbPath());
+
+    // gtags incremental update picks up all changed project files, not just the saved ones
+    if (cmd->Id() == UPDATE_SINGLE)
+        TagFilter::Get().DbUpdated(cmd->DbPath());
+    else
+        TagFilter::Get().Invalidate(cmd->DbPath());
+
+    // Single file updates only add or remove that file path
+    if (cmd->Id() == UPDATE_SINGLE && cmd->Status() == OK)
+        PathIndex::Get().FileUpdated(cmd->DbPath(), cmd->Tag());
+    else
+        PathIndex::Get().Invalidate(cmd->DbPath());
+
+    // Failed re-creation leaves the old DB intact
+    if (cmd->Status() != OK && cmd->Id() == CREATE_DATABASE && !DbManager::Get().IsUpdateLocked(cmd->Db()))
         DbManager::Get().UnregisterDb(cmd->Db());
     else
         DbManager::Get().PutDb(cmd->Db());
 
-    runSheduledUpdate(cmd->DbPath());
+    if (cmd->Id() == CREATE_DATABASE && cmd->Status() == OK)
+        TagFilter::Get().Prefetch(cmd->DbPath());
+
+    RunSheduledUpdate(cmd->DbPath());
 
     if (cmd->Status() == RUN_ERROR)
     {
@@ -249,25 +381,250 @@ void dbWriteReady(const std::shared_ptr<Cmd>& cmd)
 
 
 /**
- *  \brief
+ *  \brief  Moves the queued update requests to the update lists - UpdateLock must be held
  */
-void autoComplReady(const std::shared_ptr<Cmd>& cmd)
+void takeQueued()
 {
-    DbManager::Get().PutDb(cmd->Db());
+    std::vector<UpdateRequest> queued;
+    if (!UpdateQueue.PopAll(queued))
+        return;
 
-    runSheduledUpdate(cmd->DbPath());
+    for (std::vector<UpdateRequest>::iterator iReq = queued.begin(); iReq != queued.end(); ++iReq)
+    {
+        if (iReq->_db != cNoPath)
+            FullUpdateList.insert(iReq->_db);
+        else
+            UpdateList.insert(std::make_pair(iReq->_file, iReq->_time));
+    }
+}
 
-    if (cmd->Status() == OK)
+
+/**
+ *  \brief  Checks if the path is one of the busy DBs or in one of them
+ */
+bool inBusyDb(PathId path, const std::vector<PathId>& busyDbs)
+{
+    PathTable& paths = PathTable::Get();
+
+    for (std::vector<PathId>::const_iterator iDb = busyDbs.begin(); iDb != busyDbs.end(); ++iDb)
+        if (path == *iDb || paths.IsSubpath(path, *iDb))
+            return true;
+
+    return false;
+}
+
+
+/**
+ *  \brief  Checks if the file is in one of the busy DBs
+ */
+bool inBusyDb(const CPath& file, const std::vector<PathId>& busyDbs)
+{
+    PathTable& paths = PathTable::Get();
+
+    for (std::vector<PathId>::const_iterator iDb = busyDbs.begin(); iDb != busyDbs.end(); ++iDb)
+        if (file.IsSubpathOf(paths.Path(*iDb)))
+            return true;
+
+    return false;
+}
+
+
+/**
+ *  \brief  Starts single DB update for all saved files in it. Updates the first DB with pending files
+ *          if dbPath is NULL skipping the DBs found busy - they are updated when released
+ */
+bool runUpdate(const TCHAR* dbPath, std::vector<PathId>& busyDbs)
+{
+    PathTable& paths = PathTable::Get();
+
+    // A DB never interned has no whole DB update pending
+    const PathId dbId = dbPath ? paths.Find(dbPath) : cNoPath;
+
+    CPath file;
     {
-        if (cmd->Result())
-            AutoCompleteWin::Show(cmd);
+        AUTOLOCK(UpdateLock);
+
+        takeQueued();
+
+        // Still collecting - the update timer armed by the last save will start it
+        if ((UpdateList.empty() && FullUpdateList.empty()) || GetTickCount() - LastSave < cUpdateDelay)
+            return false;
+
+        std::unordered_set<PathId>::iterator iDb;
+        if (dbPath)
+        {
+            iDb = FullUpdateList.find(dbId);
+        }
+        else
+        {
+            for (iDb = FullUpdateList.begin(); iDb != FullUpdateList.end(); ++iDb)
+                if (!inBusyDb(*iDb, busyDbs))
+                    break;
+        }
+
+        if (iDb != FullUpdateList.end())
+        {
+            file = paths.Path(*iDb);
+        }
         else
-            INpp::Get().ClearSelection();
+        {
+            std::unordered_map<CPath, DWORD, CPathHash, CPathEqual>::iterator iFile;
+            for (iFile = UpdateList.begin(); iFile != UpdateList.end(); ++iFile)
+                if (dbPath ? iFile->first.IsSubpathOf(dbPath) : !inBusyDb(iFile->first, busyDbs))
+                    break;
+
+            if (iFile == UpdateList.end())
+                return false;
+
+            file = iFile->first;
+        }
     }
-    else if (cmd->Status() == FAILED)
+
+    bool success;
+    DbHandle db = DbManager::Get().UpdateDb(file, &success);
+
+    // The update is re-attempted when the DB is released, meanwhile other DBs can be updated
+    if (db && !success)
+    {
+        const PathId busyId = dbPath ? cNoPath : paths.Intern(*db);
+        if (busyId == cNoPath)
+            return false;
+
+        busyDbs.push_back(busyId);
+        return runUpdate(NULL, busyDbs);
+    }
+
+    std::vector<CPath> batch;
+    DWORD now = GetTickCount();
+    DWORD maxAge = 0;
+    bool full;
+    {
+        // A DB that could not be interned has no whole DB update pending
+        const PathId updateId = paths.Find(db ? *db : file);
+
+        AUTOLOCK(UpdateLock);
+
+        takeQueued();
+
+        full = (updateId != cNoPath && FullUpdateList.erase(updateId) > 0);
+
+        CPathEqual equal;
+        std::unordered_map<CPath, DWORD, CPathHash, CPathEqual>::iterator iFile;
+        for (iFile = UpdateList.begin(); iFile != UpdateList.end();)
+        {
+            if (db ? iFile->first.IsSubpathOf(*db) : equal(iFile->first, file))
+            {
+                if (maxAge < now - iFile->second)
+                    maxAge = now - iFile->second;
+
+                batch.push_back(iFile->first);
+                iFile = UpdateList.erase(iFile);
+            }
+            else
+            {
+                ++iFile;
+            }
+        }
+    }
+
+    // File is not in a DB - drop it and move on
+    if (!db)
+        return runUpdate(dbPath, busyDbs);
+
+    // Don't run gtags for files saved unchanged or not indexed at all. Whole DB update
+    // makes the known file hashes obsolete
+    if (full)
+        UpdateFilter::Get().Invalidate(*db);
+    else
+        UpdateFilter::Get().Filter(*db, batch);
+
+    if (full || !batch.empty())
+    {
+        AUTOLOCK(UpdateLock);
+        UpdateStart[db] = std::make_pair(now - maxAge, full ? 0U : (unsigned)batch.size());
+    }
+    else
+    {
+        DbManager::Get().PutDb(db);
+        return runUpdate(dbPath, busyDbs);
+    }
+
+    // Single file update is cheapest for one file, gtags incremental update re-parses
+    // only the changed files for the whole batch in one run
+    std::shared_ptr<Cmd> cmd;
+    if (!full && batch.size() == 1)
+    {
+        // The saved file names must be in the tag filter before the DB has them
+        TagFilter::Get().FilesUpdated(*db, batch);
+        cmd.reset(new Cmd(UPDATE_SINGLE, cUpdateSingle, db, batch[0].C_str()));
+    }
+    else
+        cmd.reset(new Cmd(UPDATE_INCREMENTAL, cUpdateIncremental, db));
+
+    releaseKeys();
+
+    // Release the DB and drop the batch file hashes the same way a failed update does
+    if (!CmdEngine::Run(cmd, dbWriteReady))
+    {
+        dbWriteReady(cmd);
+        return false;
+    }
+
+    // Other DBs may have pending files too
+    if (!dbPath)
+        runUpdate(NULL, busyDbs);
+
+    return true;
+}
+
+
+/**
+ *  \brief
+ */
+bool runUpdate(const TCHAR* dbPath)
+{
+    std::vector<PathId> busyDbs;
+    return runUpdate(dbPath, busyDbs);
+}
+
+
+/**
+ *  \brief  Ends the saves collecting - the timer may fire a tick before the delay is over by GetTickCount()
+ *          and the updates requested from other threads from now on must not wait for it
+ */
+VOID CALLBACK updateTimerCB(HWND, UINT, UINT_PTR, DWORD)
+{
+    KillTimer(NULL, UpdateTimer);
+    UpdateTimer = 0;
+
+    LastSave = GetTickCount() - cUpdateDelay;
+
+    runUpdate(NULL);
+}
+
+
+/**
+ *  \brief
+ */
+void autoComplReady(const std::shared_ptr<Cmd>& cmd)
+{
+    // Symbols completion follows the definitions one unless there are enough candidates already
+    if (cmd->Id() == AUTOCOMPLETE && cmd->Status() == OK && AutoCompleteWin::WantsMore(cmd))
+    {
+        cmd->Id(AUTOCOMPLETE_SYMBOL);
+        CmdEngine::Run(cmd, autoComplReady);
+        return;
+    }
+
+    DbManager::Get().PutDb(cmd->Db());
+
+    RunSheduledUpdate(cmd->DbPath());
+
+    AutoCompleteWin::ResultReady(cmd);
+
+    if (cmd->Status() == FAILED)
     {
         releaseKeys();
-        INpp::Get().ClearSelection();
 
         CText msg(cmd->Result());
         msg += _T("\nTry re-creating database.");
@@ -276,14 +633,9 @@ void autoComplReady(const std::shared_ptr<Cmd>& cmd)
     else if (cmd->Status() == RUN_ERROR)
     {
         releaseKeys();
-        INpp::Get().ClearSelection();
 
         MessageBox(INpp::Get().GetHandle(), _T("Running GTags failed"), cmd->Name(), MB_OK | MB_ICONERROR);
     }
-    else
-    {
-        INpp::Get().ClearSelection();
-    }
 }
 
 
@@ -294,7 +646,7 @@ void showResult(const std::shared_ptr<Cmd>& cmd)
 {
     DbManager::Get().PutDb(cmd->Db());
 
-    runSheduledUpdate(cmd->DbPath());
+    RunSheduledUpdate(cmd->DbPath());
 
     releaseKeys();
 
@@ -344,6 +696,38 @@ void findReady(const std::shared_ptr<Cmd>& cmd)
 }
 
 
+/**
+ *  \brief
+ */
+void siblingReady(const std::shared_ptr<Cmd>& cmd)
+{
+    const char* eol = (cmd->Status() == OK && cmd->Result()) ? strchr(cmd->Result(), '\n') : NULL;
+
+    // Single counterpart found - switch to it directly
+    if (eol && !eol[1])
+    {
+        DbManager::Get().PutDb(cmd->Db());
+
+        RunSheduledUpdate(cmd->DbPath());
+
+        cmd->Result()[eol - cmd->Result()] = 0;
+
+        CPath file(cmd->DbPath());
+        file += cmd->Result();
+
+        DocLocation::Get().Push();
+        INpp::Get().OpenFile(file.C_str());
+        return;
+    }
+
+    // Show the candidates as file search results
+    if (cmd->Status() == OK)
+        cmd->Id(FIND_FILE);
+
+    showResult(cmd);
+}
+
+
 /**
  *  \brief
  */
@@ -397,22 +781,22 @@ void AutoComplete()
     if (tag.IsEmpty())
         return;
 
+    // The user may continue typing while the completion runs
+    INpp::Get().ClearSelection();
+
     DbHandle db = getDatabase();
     if (!db)
-    {
-        INpp::Get().ClearSelection();
         return;
-    }
 
-    std::shared_ptr<Cmd> cmd(new Cmd(AUTOCOMPLETE, cAutoCompl, db, tag.C_str()));
+    // Build in background the ranking data if missing - used by this and the following completions
+    ComplRank::Get().Prefetch(db);
 
-    if (CmdEngine::Run(cmd))
-    {
-        cmd->Id(AUTOCOMPLETE_SYMBOL);
-        CmdEngine::Run(cmd);
-    }
+    std::shared_ptr<Cmd> cmd(new Cmd(AUTOCOMPLETE, cAutoCompl, db, tag.C_str()));
+    cmd->Silent(true);
+    cmd->Stream(AutoCompleteWin::ResultChunk);
 
-    autoComplReady(cmd);
+    AutoCompleteWin::Show(cmd);
+    CmdEngine::Run(cmd, autoComplReady);
 }
 
 
@@ -427,17 +811,19 @@ void AutoCompleteFile()
 
     tag.Insert(0, _T('/'));
 
+    // The user may continue typing while the completion runs
+    INpp::Get().ClearSelection();
+
     DbHandle db = getDatabase();
     if (!db)
-    {
-        INpp::Get().ClearSelection();
         return;
-    }
 
     std::shared_ptr<Cmd> cmd(new Cmd(AUTOCOMPLETE_FILE, cAutoComplFile, db, tag.C_str()));
+    cmd->Silent(true);
+    cmd->Stream(AutoCompleteWin::ResultChunk);
 
-    CmdEngine::Run(cmd);
-    autoComplReady(cmd);
+    AutoCompleteWin::Show(cmd);
+    CmdEngine::Run(cmd, autoComplReady);
 }
 
 
@@ -472,6 +858,26 @@ void FindFile()
 }
 
 
+/**
+ *  \brief  Looks up the files with the same name as the current one but different extension
+ */
+void FindSibling()
+{
+    SearchWin::Close();
+
+    DbHandle db = getDatabase();
+    if (!db)
+        return;
+
+    CPath file;
+    INpp::Get().GetFilePath(file);
+
+    std::shared_ptr<Cmd> cmd(new Cmd(FIND_SIBLING, cFindSibling, db, file.C_str()));
+
+    CmdEngine::Run(cmd, siblingReady);
+}
+
+
 /**
  *  \brief
  */
@@ -591,7 +997,7 @@ void CreateDatabase()
     INpp& npp = INpp::Get();
     npp.GetFilePath(currentFile);
 
-    DbHandle db = DbManager::Get().GetDb(currentFile, true, &success);
+    DbHandle db = DbManager::Get().UpdateDb(currentFile, &success);
     if (db)
     {
         if (!success)
@@ -643,9 +1049,7 @@ void CreateDatabase()
         db = DbManager::Get().RegisterDb(currentFile);
     }
 
-    std::shared_ptr<Cmd> cmd(new Cmd(CREATE_DATABASE, cCreateDatabase, db));
-    releaseKeys();
-    CmdEngine::Run(cmd, dbWriteReady);
+    runCreate(db, dbWriteReady);
 }
 
 
@@ -670,6 +1074,15 @@ void DeleteDatabase()
         return;
     }
 
+    ComplCache::Get().Invalidate(*db);
+    TagIndex::Get().Invalidate(*db);
+    ComplRank::Get().Invalidate(*db);
+    PathIndex::Get().Invalidate(*db);
+    UpdateFilter::Get().Invalidate(*db);
+    FileWalker::Get().Invalidate(*db);
+    TagFilter::Get().Invalidate(*db);
+    DbWatcher::Get().Unwatch(*db);
+
     if (DbManager::Get().UnregisterDb(db))
         MessageBox(npp.GetHandle(), _T("GTags database deleted"), cPluginName, MB_OK | MB_ICONINFORMATION);
     else
@@ -697,6 +1110,217 @@ void SettingsCfg()
 }
 
 
+/**
+ *  \brief  Turns span recording on / off
+ */
+void TraceLookups()
+{
+    Trace::Enable(!Trace::IsEnabled());
+    INpp::Get().SetPluginMenuFlag(Menu[18]._cmdID, Trace::IsEnabled());
+}
+
+
+/**
+ *  \brief  Saves the last recorded spans and the command run times to files in the temp folder
+ */
+void SaveTrace()
+{
+    TCHAR tmpDir[MAX_PATH];
+    if (!GetTempPath(_countof(tmpDir), tmpDir))
+        return;
+
+    CPath traceFile(tmpDir);
+    traceFile += cTraceFile;
+
+    CPath timingsFile(tmpDir);
+    timingsFile += cTimingsFile;
+
+    TCHAR buf[1024];
+
+    if (Trace::Save(traceFile, cTracePeriod) && CmdEngine::SaveTimings(timingsFile))
+    {
+        _sntprintf_s(buf, _countof(buf), _TRUNCATE,
+                _T("Trace of the last %u seconds saved to\n\"%s\"\n\nLoad it in chrome://tracing to view it\n\n")
+                _T("Command run times saved to\n\"%s\""),
+                cTracePeriod / 1000, traceFile.C_str(), timingsFile.C_str());
+        MessageBox(INpp::Get().GetHandle(), buf, cPluginName, MB_OK | MB_ICONINFORMATION);
+    }
+    else
+    {
+        _sntprintf_s(buf, _countof(buf), _TRUNCATE, _T("Saving trace to\n\"%s\"\nfailed"), tmpDir);
+        MessageBox(INpp::Get().GetHandle(), buf, cPluginName, MB_OK | MB_ICONERROR);
+    }
+}
+
+
+#ifdef DEVELOPMENT
+
+/**
+ *  \brief  Appends the plugin internals statistics - development builds only
+ */
+void appendStats(CText& msg)
+{
+    CText stats;
+    TagIndex::Get().GetStats(stats);
+    if (!stats.IsEmpty())
+    {
+        msg += _T("\nIgnore-case tag indexes:\n");
+        msg += stats;
+    }
+
+    stats.Clear();
+    SearchWin::GetStats(stats);
+    if (!stats.IsEmpty())
+    {
+        msg += _T("\nSearch completion:\n");
+        msg += stats;
+    }
+
+    stats.Clear();
+    if (UpdateBatches)
+    {
+        TCHAR buf[160];
+        _sntprintf_s(buf, _countof(buf), _TRUNCATE,
+                _T(" %u batches, %u files, save to DB fresh avg %u ms, max %u ms\n"),
+                UpdateBatches, UpdatedFiles, UpdateTotalTime / UpdateBatches, UpdateMaxTime);
+        stats += buf;
+    }
+    if (DroppedUpdates)
+    {
+        TCHAR buf[128];
+        _sntprintf_s(buf, _countof(buf), _TRUNCATE, _T(" %ld DB updates dropped - path table full\n"),
+                DroppedUpdates);
+        stats += buf;
+    }
+    UpdateFilter::Get().GetStats(stats);
+    if (!stats.IsEmpty())
+    {
+        msg += _T("\nDatabase updates:\n");
+        msg += stats;
+    }
+
+    if (CreateCount)
+    {
+        TCHAR buf[128];
+        _sntprintf_s(buf, _countof(buf), _TRUNCATE, _T(" %u builds, last %u ms, max %u ms\n"),
+                CreateCount, CreateLastTime, CreateMaxTime);
+        msg += _T("\nDatabase creation:\n");
+        msg += buf;
+    }
+
+    stats.Clear();
+    DbWatcher::Get().GetStats(stats);
+    if (!stats.IsEmpty())
+    {
+        msg += _T("\nDatabase folder watchers:\n");
+        msg += stats;
+    }
+
+    stats.Clear();
+    DbWarmer::Get().GetStats(stats);
+    if (!stats.IsEmpty())
+    {
+        msg += _T("\nDatabase warm-up:\n");
+        msg += stats;
+    }
+
+    stats.Clear();
+    ResultWin::GetStats(stats);
+    if (!stats.IsEmpty())
+    {
+        msg += _T("\nResults window Scintilla messages:\n");
+        msg += stats;
+    }
+
+    stats.Clear();
+    CmdEngine::GetTimings(stats);
+    if (!stats.IsEmpty())
+    {
+        msg += _T("\nCommand run times:\n");
+        msg += stats;
+    }
+
+    stats.Clear();
+    CmdEngine::GetStats(stats);
+    if (!stats.IsEmpty())
+    {
+        msg += _T("\nLibrary databases:\n");
+        msg += stats;
+    }
+
+    stats.Clear();
+    TagFilter::Get().GetStats(stats);
+    if (!stats.IsEmpty())
+    {
+        msg += _T("\nTag name filters:\n");
+        msg += stats;
+    }
+
+    stats.Clear();
+    FileWalker::Get().GetStats(stats);
+    if (!stats.IsEmpty())
+    {
+        msg += _T("\nProject file walker:\n");
+        msg += stats;
+    }
+
+    stats.Clear();
+    DbManager::Get().GetStats(stats);
+    if (!stats.IsEmpty())
+    {
+        msg += _T("\nDatabase lookup cache:\n");
+        msg += stats;
+    }
+
+    stats.Clear();
+    PathIndex::Get().GetStats(stats);
+    if (!stats.IsEmpty())
+    {
+        msg += _T("\nFile path indexes:\n");
+        msg += stats;
+    }
+
+    stats.Clear();
+    PathTable::Get().GetStats(stats);
+    if (!stats.IsEmpty())
+    {
+        msg += _T("\nInterned paths:\n");
+        msg += stats;
+    }
+
+    {
+        unsigned acquired, contended;
+        UpdateLock.GetContention(acquired, contended);
+
+        TCHAR buf[128];
+        _sntprintf_s(buf, _countof(buf), _TRUNCATE, _T(" lock taken %u times, %u contended\n"),
+                acquired, contended);
+        msg += _T("\nUpdate scheduler:\n");
+        msg += buf;
+    }
+
+    {
+        TCHAR buf[128];
+        _sntprintf_s(buf, _countof(buf), _TRUNCATE, _T(" %ld heap allocations\n"), TextHeapAllocs);
+        msg += _T("\nText buffers:\n");
+        msg += buf;
+    }
+
+    if (TextConversions)
+    {
+        TCHAR buf[160];
+        _sntprintf_s(buf, _countof(buf), _TRUNCATE,
+                _T(" %ld conversions, %ld chars (avg %ld), %ld%% on ASCII fast path\n"),
+                TextConversions, TextConvertedChars, TextConvertedChars / TextConversions,
+                TextConvertedChars ? (LONG)((LONGLONG)TextAsciiChars * 100 / TextConvertedChars) : 0);
+        msg += _T("\nUTF-8 conversions:\n");
+        msg += buf;
+    }
+}
+
+#endif
+
+
 /**
  *  \brief
  */
@@ -712,6 +1336,10 @@ void About()
     else
         msg = _T("VERSION READ FAILED\n");
 
+#ifdef DEVELOPMENT
+    appendStats(msg);
+#endif
+
     AboutWin::Show(msg.C_str());
 }
 
@@ -721,25 +1349,29 @@ void About()
 namespace GTags
 {
 
-FuncItem Menu[18] = {
+FuncItem Menu[22] = {
     /* 0 */  FuncItem(cAutoCompl, AutoComplete),
     /* 1 */  FuncItem(cAutoComplFile, AutoCompleteFile),
     /* 2 */  FuncItem(cFindFile, FindFile),
-    /* 3 */  FuncItem(cFindDefinition, FindDefinition),
-    /* 4 */  FuncItem(cFindReference, FindReference),
-    /* 5 */  FuncItem(cSearch, Search),
-    /* 6 */  FuncItem(),
-    /* 7 */  FuncItem(_T("Go Back"), GoBack),
-    /* 8 */  FuncItem(_T("Go Forward"), GoForward),
-    /* 9 */  FuncItem(),
-    /* 10 */ FuncItem(cCreateDatabase, CreateDatabase),
-    /* 11 */ FuncItem(_T("Delete Database"), DeleteDatabase),
-    /* 12 */ FuncItem(),
-    /* 13 */ FuncItem(_T("Toggle Results Window Focus"), ToggleResultWinFocus),
-    /* 14 */ FuncItem(),
-    /* 15 */ FuncItem(_T("Settings"), SettingsCfg),
-    /* 16 */ FuncItem(),
-    /* 17 */ FuncItem(cVersion, About)
+    /* 3 */  FuncItem(cFindSibling, FindSibling),
+    /* 4 */  FuncItem(cFindDefinition, FindDefinition),
+    /* 5 */  FuncItem(cFindReference, FindReference),
+    /* 6 */  FuncItem(cSearch, Search),
+    /* 7 */  FuncItem(),
+    /* 8 */  FuncItem(_T("Go Back"), GoBack),
+    /* 9 */  FuncItem(_T("Go Forward"), GoForward),
+    /* 10 */ FuncItem(),
+    /* 11 */ FuncItem(cCreateDatabase, CreateDatabase),
+    /* 12 */ FuncItem(_T("Delete Database"), DeleteDatabase),
+    /* 13 */ FuncItem(),
+    /* 14 */ FuncItem(_T("Toggle Results Window Focus"), ToggleResultWinFocus),
+    /* 15 */ FuncItem(),
+    /* 16 */ FuncItem(_T("Settings"), SettingsCfg),
+    /* 17 */ FuncItem(),
+    /* 18 */ FuncItem(_T("Trace Lookups"), TraceLookups),
+    /* 19 */ FuncItem(_T("Save Lookups Trace"), SaveTrace),
+    /* 20 */ FuncItem(),
+    /* 21 */ FuncItem(cVersion, About)
 };
 
 HINSTANCE HMod = NULL;
@@ -806,33 +1438,79 @@ void PluginDeInit()
     AutoCompleteWin::Unregister();
     ResultWin::Unregister();
 
+    if (UpdateTimer)
+    {
+        KillTimer(NULL, UpdateTimer);
+        UpdateTimer = 0;
+    }
+
+    DbWatcher::Get().UnwatchAll();
+    DbWarmer::Get().Stop();
+
     HMod = NULL;
 }
 
 
 /**
- *  \brief
+ *  \brief  Schedules DB update for the saved file. Must be called from the main thread -
+ *          the update is started by a timer once the saves stop coming
  */
 bool UpdateSingleFile(const CPath& file)
 {
-    bool success;
-    DbHandle db = DbManager::Get().GetDb(file, true, &success);
-    if (!db)
-        return false;
+    LastSave = GetTickCount();
+    UpdateQueue.Push(UpdateRequest(file, LastSave));
 
-    if (!success)
-    {
-        sheduleForUpdate(file);
+    if (UpdateTimer)
+        KillTimer(NULL, UpdateTimer);
+
+    UpdateTimer = SetTimer(NULL, 0, cUpdateDelay, updateTimerCB);
+    if (UpdateTimer)
         return true;
-    }
 
-    std::shared_ptr<Cmd> cmd(new Cmd(UPDATE_SINGLE, cUpdateSingle, db, file.C_str()));
+    // Nothing would start the update once the saves stop - don't wait for them
+    LastSave = GetTickCount() - cUpdateDelay;
 
-    releaseKeys();
-    if (!CmdEngine::Run(cmd, dbWriteReady))
-        return false;
+    return runUpdate(NULL);
+}
 
-    return true;
+
+/**
+ *  \brief  Schedules DB update for files changed outside Notepad++. Can be called from any thread
+ */
+void UpdateFiles(const std::vector<CPath>& files)
+{
+    DWORD now = GetTickCount();
+
+    for (std::vector<CPath>::const_iterator iFile = files.begin(); iFile != files.end(); ++iFile)
+        UpdateQueue.Push(UpdateRequest(*iFile, now));
+
+    // While saves are collected the update timer is armed and takes the queued files too
+    runUpdate(NULL);
+}
+
+
+/**
+ *  \brief  Schedules incremental update of the whole DB. Can be called from any thread
+ */
+void UpdateDatabase(const CPath& dbPath)
+{
+    const PathId dbId = PathTable::Get().Intern(dbPath);
+    if (dbId != cNoPath)
+        UpdateQueue.Push(UpdateRequest(dbId, GetTickCount()));
+    else
+        InterlockedIncrement(&DroppedUpdates);
+
+    // While saves are collected the update timer is armed and takes the queued DB too
+    runUpdate(NULL);
+}
+
+
+/**
+ *  \brief
+ */
+bool RunSheduledUpdate(const TCHAR* dbPath)
+{
+    return runUpdate(dbPath);
 }
 
 
@@ -879,7 +1557,7 @@ const CPath CreateLibraryDatabase(HWND hWnd)
             return libraryPath;
 
         bool success;
-        db = DbManager::Get().GetDb(libraryPath, true, &success);
+        db = DbManager::Get().UpdateDb(libraryPath, &success);
 
         if (!success)
         {
@@ -894,6 +1572,11 @@ const CPath CreateLibraryDatabase(HWND hWnd)
         db = DbManager::Get().RegisterDb(libraryPath);
     }
 
+    {
+        AUTOLOCK(UpdateLock);
+        UpdateStart[db] = std::make_pair(GetTickCount(), 0U);
+    }
+
     std::shared_ptr<Cmd> cmd(new Cmd(CREATE_DATABASE, cCreateDatabase, db));
     releaseKeys();
     CmdEngine::Run(cmd);
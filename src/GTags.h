@@ -26,6 +26,7 @@
 
 
 #include <tchar.h>
+#include <vector>
 #include "resource.h"
 
 
@@ -40,7 +41,7 @@ namespace GTags
 const TCHAR cPluginName[]   = VER_PLUGIN_NAME;
 const TCHAR cBinsDir[]      = VER_PLUGIN_NAME;
 
-extern FuncItem     Menu[18];
+extern FuncItem     Menu[22];
 
 extern HINSTANCE    HMod;
 extern CPath        DllPath;
@@ -57,6 +58,9 @@ void PluginInit();
 void PluginDeInit();
 
 bool UpdateSingleFile(const CPath& file);
+void UpdateFiles(const std::vector<CPath>& files);
+void UpdateDatabase(const CPath& dbPath);
+bool RunSheduledUpdate(const TCHAR* dbPath);
 const CPath CreateLibraryDatabase(HWND hWnd);
 
 } // namespace GTags
@@ -265,6 +265,17 @@ public:
         return wordEnd - wordStart;
     }
 
+    inline long GetWordStartPos() const
+    {
+        long currPos = SendMessage(_hSC, SCI_GETCURRENTPOS, 0, 0);
+        return SendMessage(_hSC, SCI_WORDSTARTPOSITION, currPos, true);
+    }
+
+    inline void* GetDocPointer() const
+    {
+        return (void*)SendMessage(_hSC, SCI_GETDOCPOINTER, 0, 0);
+    }
+
     void GetWord(CTextA& word, bool select) const;
     void ReplaceWord(const char* replText) const;
     bool SearchText(const char* text, bool matchCase, bool wholeWord, bool regExp,
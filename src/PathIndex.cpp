@@ -0,0 +1,972 @@
+/**
+ *  \file
+ *  \brief  Compressed in-memory index of the DB file paths
+ *
+ *  \author  Pavel Nedev <pg.nedev@gmail.com>
+ *
+ *  \section COPYRIGHT
+ *  Copyright(C) 2015 Pavel Nedev
+ *
+ *  \section LICENSE
+ *  This program is free software; you can redistribute it and/or modify it
+ *  under the terms of the GNU General Public License version 2 as published
+ *  by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful, but
+ *  WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ *  or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ *  for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+#include <windows.h>
+#include <tchar.h>
+#include <string.h>
+#include <algorithm>
+#include <iterator>
+#include "PathIndex.h"
+
+
+namespace
+{
+
+using namespace GTags;
+
+
+/**
+ *  \struct  Query
+ *  \brief
+ */
+struct Query
+{
+    CmdId_t     _id;
+    const char* _pattern;
+    unsigned    _len;
+    bool        _matchCase;
+};
+
+
+/**
+ *  \struct  BlockLess
+ *  \brief  Compares path with the first (not front-coded) path of a block
+ */
+struct BlockLess
+{
+    BlockLess(const char* data) : _data(data) {}
+
+    bool operator()(const char* path, unsigned block) const
+    {
+        return (strcmp(path, _data + block + 1) < 0);
+    }
+
+    const char* _data;
+};
+
+
+/**
+ *  \brief
+ */
+inline char fold(char c)
+{
+    return (c >= 'A' && c <= 'Z') ? c + ('a' - 'A') : c;
+}
+
+
+/**
+ *  \brief
+ */
+inline unsigned gramKey(const char* str)
+{
+    return ((unsigned)(unsigned char)fold(str[0]) << 16) | ((unsigned)(unsigned char)fold(str[1]) << 8) |
+            (unsigned)(unsigned char)fold(str[2]);
+}
+
+
+/**
+ *  \brief
+ */
+void addGrams(const char* str, unsigned len, unsigned id, std::vector<std::pair<unsigned, unsigned>>& keyIds)
+{
+    for (unsigned i = 0; i + 2 < len; ++i)
+        keyIds.push_back(std::make_pair(gramKey(str + i), id));
+}
+
+
+/**
+ *  \brief  Compares the first len chars, str might be shorter
+ */
+bool equalChars(const char* str, const char* pattern, unsigned len, bool matchCase)
+{
+    for (unsigned i = 0; i < len; ++i)
+    {
+        if (matchCase ? (str[i] != pattern[i]) : (fold(str[i]) != fold(pattern[i])))
+            return false;
+    }
+
+    return true;
+}
+
+
+/**
+ *  \brief
+ */
+bool contains(const char* str, const char* pattern, unsigned len, bool matchCase)
+{
+    for (; *str; ++str)
+        if (equalChars(str, pattern, len, matchCase))
+            return true;
+
+    return !len;
+}
+
+
+/**
+ *  \brief
+ */
+inline const char* fileName(const char* path)
+{
+    const char* name = strrchr(path, '/');
+
+    return name ? name + 1 : path;
+}
+
+
+/**
+ *  \brief  File name length without the extension
+ */
+unsigned stemLen(const char* name)
+{
+    const char* ext = strrchr(name, '.');
+
+    return (ext && ext != name) ? ext - name : strlen(name);
+}
+
+
+/**
+ *  \brief  Case-insensitive FNV-1a hash of the file name without the extension
+ */
+unsigned stemHash(const char* name)
+{
+    unsigned len = stemLen(name);
+    unsigned hash = 2166136261U;
+
+    for (unsigned i = 0; i < len; ++i)
+    {
+        hash ^= (unsigned char)fold(name[i]);
+        hash *= 16777619U;
+    }
+
+    return hash;
+}
+
+
+/**
+ *  \brief
+ */
+bool lessStr(const char* lhs, const char* rhs)
+{
+    return (strcmp(lhs, rhs) < 0);
+}
+
+
+/**
+ *  \brief
+ */
+bool equalStr(const char* lhs, const char* rhs)
+{
+    return !strcmp(lhs, rhs);
+}
+
+
+/**
+ *  \brief  Converts to the ANSI code page - gtags prints the GPATH paths in it. CTextA conversion gives UTF-8
+ */
+void toAnsi(const TCHAR* str, CTextA& dst)
+{
+    dst.Clear();
+
+    int len = WideCharToMultiByte(CP_ACP, 0, str, -1, NULL, 0, NULL, NULL);
+    if (len <= 1)
+        return;
+
+    dst.Resize(len - 1);
+    WideCharToMultiByte(CP_ACP, 0, str, -1, dst.C_str(), len, NULL, NULL);
+    dst.AutoFit();
+}
+
+
+/**
+ *  \brief
+ */
+bool lessLine(const CTextA& lhs, const CTextA& rhs)
+{
+    return (strcmp(lhs.C_str(), rhs.C_str()) < 0);
+}
+
+
+/**
+ *  \brief  Adds path to lines if it matches the query the way global does
+ */
+void match(const Query& q, const char* path, std::vector<CTextA>& lines)
+{
+    if (q._id == FIND_FILE)
+    {
+        if (contains(path, q._pattern, q._len, q._matchCase))
+            lines.push_back(CTextA(path));
+    }
+    else if (q._id == AUTOCOMPLETE_FILE)
+    {
+        // Like --match-part=all: every path component starting with the prefix
+        // is a completion that spans to the end of the path
+        for (const char* part = path; part; part = strchr(part, '/'))
+        {
+            if (*part == '/')
+                ++part;
+
+            if (equalChars(part, q._pattern, q._len, q._matchCase))
+            {
+                CTextA line("/");
+                line += part;
+                lines.push_back(line);
+            }
+        }
+    }
+    else if (q._id == FIND_SIBLING)
+    {
+        const char* name = fileName(path);
+        const char* origName = fileName(q._pattern);
+        unsigned len = stemLen(name);
+
+        if (len == stemLen(origName) && equalChars(name, origName, len, false) &&
+                !(strlen(path) == q._len && equalChars(path, q._pattern, q._len, false)))
+            lines.push_back(CTextA(path));
+    }
+}
+
+} // anonymous namespace
+
+
+namespace GTags
+{
+
+const unsigned PathIndex::Paths::cBlockSize = 16;
+const unsigned PathIndex::cMaxDelta = 256;
+
+PathIndex PathIndex::Instance;
+
+
+/**
+ *  \brief  Parses the list buffer (global path search output)
+ */
+PathIndex::Paths::Paths(std::vector<char>& list) : _count(0), _rawSize(0)
+{
+    list.push_back(0);
+
+    std::vector<const char*> paths;
+    bool newToken = true;
+
+    for (unsigned i = 0; i < list.size(); ++i)
+    {
+        if (list[i] == '\n' || list[i] == '\r' || list[i] == 0)
+        {
+            list[i] = 0;
+            newToken = true;
+        }
+        else if (newToken)
+        {
+            const char* path = list.data() + i;
+            if (path[0] == '.' && path[1] == '/')
+                path += 2;
+
+            paths.push_back(path);
+            newToken = false;
+        }
+    }
+
+    std::sort(paths.begin(), paths.end(), lessStr);
+    paths.erase(std::unique(paths.begin(), paths.end(), equalStr), paths.end());
+
+    _count = paths.size();
+
+    std::vector<std::pair<unsigned, unsigned>> nameKeys;
+    std::vector<std::pair<unsigned, unsigned>> dirKeys;
+
+    const char* prevPath = "";
+    unsigned prevDirLen = 0;
+
+    for (unsigned id = 0; id < _count; ++id)
+    {
+        const char* path = paths[id];
+        unsigned len = strlen(path);
+
+        _rawSize += len + 1;
+
+        // Store only the suffix that differs from the previous path, block starts are stored whole
+        unsigned shared = 0;
+        if (id % cBlockSize)
+        {
+            while (shared < 255 && path[shared] && path[shared] == prevPath[shared])
+                ++shared;
+        }
+        else
+        {
+            _blocks.push_back(_data.size());
+        }
+
+        _data.push_back((char)shared);
+        _data.insert(_data.end(), path + shared, path + len + 1);
+
+        const char* name = fileName(path);
+        unsigned dirLen = name - path;
+
+        _stems.push_back(std::make_pair(stemHash(name), id));
+        addGrams(name, len - dirLen, id, nameKeys);
+
+        if (_runs.empty() || dirLen != prevDirLen || strncmp(path, prevPath, dirLen))
+        {
+            Run run = { id, 1 };
+            _runs.push_back(run);
+
+            if (dirLen)
+                addGrams(path, dirLen - 1, _runs.size() - 1, dirKeys);
+        }
+        else
+        {
+            ++_runs.back()._count;
+        }
+
+        prevPath = path;
+        prevDirLen = dirLen;
+    }
+
+    std::sort(_stems.begin(), _stems.end());
+
+    _nameGrams.Build(nameKeys);
+    _dirGrams.Build(dirKeys);
+
+    _data.shrink_to_fit();
+    _blocks.shrink_to_fit();
+    _runs.shrink_to_fit();
+}
+
+
+/**
+ *  \brief
+ */
+bool PathIndex::Paths::Find(const char* path, unsigned& id) const
+{
+    std::vector<unsigned>::const_iterator iBlock =
+            std::upper_bound(_blocks.begin(), _blocks.end(), path, BlockLess(_data.data()));
+    if (iBlock == _blocks.begin())
+        return false;
+
+    unsigned first = (iBlock - _blocks.begin() - 1) * cBlockSize;
+    unsigned last = std::min(first + cBlockSize, _count);
+
+    Cursor cursor;
+
+    for (id = first; id < last; ++id)
+    {
+        Decode(id, cursor);
+
+        int r = strcmp(cursor._path.data(), path);
+        if (r == 0)
+            return true;
+        if (r > 0)
+            break;
+    }
+
+    return false;
+}
+
+
+/**
+ *  \brief  Returns the id of the first path not less than path, Count() if there is none
+ */
+unsigned PathIndex::Paths::LowerBound(const char* path) const
+{
+    std::vector<unsigned>::const_iterator iBlock =
+            std::upper_bound(_blocks.begin(), _blocks.end(), path, BlockLess(_data.data()));
+
+    unsigned id = (iBlock == _blocks.begin()) ? 0 : (iBlock - _blocks.begin() - 1) * cBlockSize;
+    unsigned last = std::min(id + cBlockSize, _count);
+
+    Cursor cursor;
+
+    for (; id < last; ++id)
+    {
+        Decode(id, cursor);
+
+        if (strcmp(cursor._path.data(), path) >= 0)
+            break;
+    }
+
+    return id;
+}
+
+
+/**
+ *  \brief
+ */
+void PathIndex::Paths::Decode(unsigned id, Cursor& cursor) const
+{
+    unsigned current;
+
+    if (!cursor._path.empty() && id >= cursor._id && id / cBlockSize == cursor._id / cBlockSize)
+    {
+        if (id == cursor._id)
+            return;
+
+        current = cursor._id + 1;
+    }
+    else
+    {
+        current = id - id % cBlockSize;
+        cursor._pos = _blocks[id / cBlockSize];
+    }
+
+    for (;; ++current)
+    {
+        unsigned shared = (unsigned char)_data[cursor._pos];
+        const char* suffix = _data.data() + cursor._pos + 1;
+        unsigned len = strlen(suffix);
+
+        cursor._path.resize(shared);
+        cursor._path.insert(cursor._path.end(), suffix, suffix + len + 1);
+        cursor._pos += len + 2;
+
+        if (current == id)
+            break;
+    }
+
+    cursor._id = id;
+}
+
+
+/**
+ *  \brief  Fills the ascending ids of the paths that might contain pattern.
+ *          Returns false if the pattern is too short or spans directories - all paths are candidates then
+ */
+bool PathIndex::Paths::Candidates(const char* pattern, std::vector<unsigned>& ids) const
+{
+    if (strchr(pattern, '/'))
+        return false;
+
+    // No slash in the pattern so it matches either in the file name or in the directory
+    if (!_nameGrams.Lookup(pattern, ids))
+        return false;
+
+    std::vector<unsigned> runIds;
+    _dirGrams.Lookup(pattern, runIds);
+
+    for (std::vector<unsigned>::iterator iRun = runIds.begin(); iRun != runIds.end(); ++iRun)
+        for (unsigned i = 0; i < _runs[*iRun]._count; ++i)
+            ids.push_back(_runs[*iRun]._first + i);
+
+    std::sort(ids.begin(), ids.end());
+    ids.erase(std::unique(ids.begin(), ids.end()), ids.end());
+
+    return true;
+}
+
+
+/**
+ *  \brief  Fills the ascending ids of the paths whose file name might have the same stem
+ */
+void PathIndex::Paths::StemMatches(const char* path, std::vector<unsigned>& ids) const
+{
+    unsigned hash = stemHash(fileName(path));
+
+    std::vector<std::pair<unsigned, unsigned>>::const_iterator iStem =
+            std::lower_bound(_stems.begin(), _stems.end(), std::make_pair(hash, 0U));
+
+    for (; iStem != _stems.end() && iStem->first == hash; ++iStem)
+        ids.push_back(iStem->second);
+}
+
+
+/**
+ *  \brief
+ */
+unsigned PathIndex::Paths::MemSize() const
+{
+    return _data.size() + _blocks.size() * sizeof(unsigned) +
+            _stems.size() * sizeof(std::pair<unsigned, unsigned>) + _runs.size() * sizeof(Run) +
+            _nameGrams.MemSize() + _dirGrams.MemSize();
+}
+
+
+/**
+ *  \brief  Takes (key, id) pairs, the buffer contents are not preserved
+ */
+void PathIndex::Paths::Grams::Build(std::vector<std::pair<unsigned, unsigned>>& keyIds)
+{
+    std::sort(keyIds.begin(), keyIds.end());
+    keyIds.erase(std::unique(keyIds.begin(), keyIds.end()), keyIds.end());
+
+    unsigned prevId = 0;
+
+    for (std::vector<std::pair<unsigned, unsigned>>::iterator iKey = keyIds.begin(); iKey != keyIds.end(); ++iKey)
+    {
+        if (_keys.empty() || _keys.back() != iKey->first)
+        {
+            _keys.push_back(iKey->first);
+            _offsets.push_back(_postings.size());
+            prevId = 0;
+        }
+
+        unsigned delta = iKey->second - prevId;
+        prevId = iKey->second;
+
+        for (; delta >= 0x80; delta >>= 7)
+            _postings.push_back((unsigned char)(delta | 0x80));
+        _postings.push_back((unsigned char)delta);
+    }
+
+    _offsets.push_back(_postings.size());
+
+    _keys.shrink_to_fit();
+    _offsets.shrink_to_fit();
+    _postings.shrink_to_fit();
+}
+
+
+/**
+ *  \brief  Fills the ascending ids containing all pattern trigrams.
+ *          Returns false if the pattern is shorter than a trigram
+ */
+bool PathIndex::Paths::Grams::Lookup(const char* pattern, std::vector<unsigned>& ids) const
+{
+    unsigned len = strlen(pattern);
+    if (len < 3)
+        return false;
+
+    std::vector<unsigned> gramIds;
+    std::vector<unsigned> common;
+
+    for (unsigned i = 0; i + 2 < len; ++i)
+    {
+        unsigned key = gramKey(pattern + i);
+
+        std::vector<unsigned>::const_iterator iKey = std::lower_bound(_keys.begin(), _keys.end(), key);
+        if (iKey == _keys.end() || *iKey != key)
+        {
+            ids.clear();
+            return true;
+        }
+
+        gramIds.clear();
+        decode(iKey - _keys.begin(), gramIds);
+
+        if (i == 0)
+        {
+            ids.swap(gramIds);
+        }
+        else
+        {
+            common.clear();
+            std::set_intersection(ids.begin(), ids.end(), gramIds.begin(), gramIds.end(),
+                    std::back_inserter(common));
+            ids.swap(common);
+        }
+
+        if (ids.empty())
+            break;
+    }
+
+    return true;
+}
+
+
+/**
+ *  \brief
+ */
+void PathIndex::Paths::Grams::decode(unsigned keyIdx, std::vector<unsigned>& ids) const
+{
+    unsigned id = 0;
+
+    for (unsigned pos = _offsets[keyIdx]; pos < _offsets[keyIdx + 1];)
+    {
+        unsigned delta = 0;
+
+        for (unsigned shift = 0;; shift += 7)
+        {
+            unsigned char byte = _postings[pos++];
+            delta |= (unsigned)(byte & 0x7F) << shift;
+            if (!(byte & 0x80))
+                break;
+        }
+
+        id += delta;
+        ids.push_back(id);
+    }
+}
+
+
+/**
+ *  \brief  Returns true if cmd is a lookup the index can serve
+ */
+bool PathIndex::Serves(const Cmd& cmd)
+{
+    switch (cmd.Id())
+    {
+        // Empty pattern lists all paths - that is how the index itself is built
+        case FIND_FILE:
+            return (!cmd.RegExp() && cmd.TagLen());
+
+        case AUTOCOMPLETE_FILE:
+            return !cmd.RegExp();
+
+        case FIND_SIBLING:
+            return true;
+
+        default:
+            return false;
+    }
+}
+
+
+/**
+ *  \brief  Fills result the same way global does - new line separated paths.
+ *          Must be called with the DB read-locked. Returns false if the index cannot be built
+ */
+bool PathIndex::Run(const Cmd& cmd, std::vector<char>& result)
+{
+    PathsPtr paths;
+    DeltaPtr delta;
+
+    if (!acquire(cmd, paths, delta))
+        return false;
+
+    CTextA pattern;
+
+    if (cmd.Id() == FIND_SIBLING)
+        relativePath(cmd.DbPath(), cmd.Tag(), pattern);
+    else
+        toAnsi(cmd.Tag(), pattern);
+
+    Query q;
+    q._id           = cmd.Id();
+    q._pattern      = pattern.C_str();
+    q._len          = pattern.Len();
+    q._matchCase    = cmd.MatchCase();
+
+    // File name completion prefix starts with slash - component start
+    if (q._id == AUTOCOMPLETE_FILE && *q._pattern == '/')
+    {
+        ++q._pattern;
+        --q._len;
+    }
+
+    std::vector<unsigned> ids;
+    bool filtered = true;
+
+    if (q._id == FIND_SIBLING)
+        paths->StemMatches(q._pattern, ids);
+    else
+        filtered = paths->Candidates(q._pattern, ids);
+
+    if (!filtered)
+    {
+        ids.resize(paths->Count());
+        for (unsigned id = 0; id < ids.size(); ++id)
+            ids[id] = id;
+    }
+
+    std::vector<CTextA> lines;
+    Paths::Cursor cursor;
+
+    for (std::vector<unsigned>::iterator iId = ids.begin(); iId != ids.end(); ++iId)
+    {
+        if (std::binary_search(delta->_removed.begin(), delta->_removed.end(), *iId))
+            continue;
+
+        paths->Decode(*iId, cursor);
+        match(q, cursor._path.data(), lines);
+    }
+
+    unsigned baseCount = lines.size();
+
+    for (std::vector<CTextA>::const_iterator iAdded = delta->_added.begin(); iAdded != delta->_added.end(); ++iAdded)
+        match(q, iAdded->C_str(), lines);
+
+    // Paths come sorted from the index but completions and added files need ordering
+    if (q._id == AUTOCOMPLETE_FILE)
+    {
+        std::sort(lines.begin(), lines.end(), lessLine);
+        lines.erase(std::unique(lines.begin(), lines.end()), lines.end());
+    }
+    else if (baseCount != lines.size())
+    {
+        std::inplace_merge(lines.begin(), lines.begin() + baseCount, lines.end(), lessLine);
+    }
+
+    for (std::vector<CTextA>::iterator iLine = lines.begin(); iLine != lines.end(); ++iLine)
+    {
+        result.insert(result.end(), iLine->C_str(), iLine->C_str() + iLine->Len());
+        result.push_back('\n');
+    }
+
+    if (!result.empty())
+        result.push_back(0);
+
+    return true;
+}
+
+
+/**
+ *  \brief  Records single file update result in the DB index if there is one.
+ *          Too many changes drop the index so it gets rebuilt on next use
+ */
+void PathIndex::FileUpdated(const CPath& dbPath, const CPath& file)
+{
+    CTextA path;
+    relativePath(dbPath.C_str(), file.C_str(), path);
+
+    const bool exists = file.FileExists();
+
+    AUTOLOCK(_lock);
+
+    ++_generation;
+
+    std::list<Item>::iterator iItem;
+    for (iItem = _items.begin(); iItem != _items.end(); ++iItem)
+        if (iItem->_dbPath == dbPath)
+            break;
+
+    if (iItem == _items.end())
+        return;
+
+    std::shared_ptr<Delta> delta(new Delta(*iItem->_delta));
+
+    unsigned id;
+    if (iItem->_paths->Find(path.C_str(), id))
+    {
+        std::vector<unsigned>::iterator iRemoved =
+                std::lower_bound(delta->_removed.begin(), delta->_removed.end(), id);
+        bool removed = (iRemoved != delta->_removed.end() && *iRemoved == id);
+
+        if (exists && removed)
+            delta->_removed.erase(iRemoved);
+        else if (!exists && !removed)
+            delta->_removed.insert(iRemoved, id);
+    }
+    else
+    {
+        std::vector<CTextA>::iterator iAdded =
+                std::lower_bound(delta->_added.begin(), delta->_added.end(), path, lessLine);
+        bool added = (iAdded != delta->_added.end() && *iAdded == path);
+
+        if (exists && !added)
+            delta->_added.insert(iAdded, path);
+        else if (!exists && added)
+            delta->_added.erase(iAdded);
+    }
+
+    if (delta->_added.size() + delta->_removed.size() > cMaxDelta)
+        _items.erase(iItem);
+    else
+        iItem->_delta = delta;
+}
+
+
+/**
+ *  \brief  Checks if the DB has files in the folder under the DB root (the folder itself may be gone).
+ *          Returns false if that cannot be told - the DB is busy or the index cannot be built
+ */
+bool PathIndex::HasFilesIn(const CPath& dbPath, const CPath& dir, bool& has)
+{
+    has = false;
+
+    bool success;
+    DbHandle db = DbManager::Get().GetDb(dbPath, false, &success);
+    if (!db)
+        return false;
+
+    // Read lock on an update snapshot - the index of the DB itself isn't served from there
+    if (!success || !CPathEqual()(*db, dbPath))
+    {
+        if (success)
+            DbManager::Get().PutDb(db);
+        return false;
+    }
+
+    PathsPtr paths;
+    DeltaPtr delta;
+
+    Cmd cmd(FIND_FILE, _T("Watcher Path Check"), db);
+    cmd.Silent(true);
+
+    bool known = acquire(cmd, paths, delta);
+
+    DbManager::Get().PutDb(db);
+
+    if (!known)
+        return false;
+
+    CTextA prefix;
+    relativePath(cmd.DbPath(), dir.C_str(), prefix);
+    prefix += "/";
+
+    Paths::Cursor cursor;
+
+    for (unsigned id = paths->LowerBound(prefix.C_str()); id < paths->Count(); ++id)
+    {
+        paths->Decode(id, cursor);
+        if (strncmp(cursor._path.data(), prefix.C_str(), prefix.Len()))
+            break;
+
+        if (!std::binary_search(delta->_removed.begin(), delta->_removed.end(), id))
+        {
+            has = true;
+            return true;
+        }
+    }
+
+    for (std::vector<CTextA>::const_iterator iAdded = delta->_added.begin(); iAdded != delta->_added.end(); ++iAdded)
+    {
+        if (!strncmp(iAdded->C_str(), prefix.C_str(), prefix.Len()))
+        {
+            has = true;
+            break;
+        }
+    }
+
+    return true;
+}
+
+
+/**
+ *  \brief  Drops the index of the given DB - to be called when the DB is re-created or deleted
+ */
+void PathIndex::Invalidate(const CPath& dbPath)
+{
+    AUTOLOCK(_lock);
+
+    ++_generation;
+
+    for (std::list<Item>::iterator iItem = _items.begin(); iItem != _items.end();)
+    {
+        if (iItem->_dbPath == dbPath)
+            iItem = _items.erase(iItem);
+        else
+            ++iItem;
+    }
+}
+
+
+/**
+ *  \brief
+ */
+void PathIndex::GetStats(CText& stats)
+{
+    AUTOLOCK(_lock);
+
+    for (std::list<Item>::iterator iItem = _items.begin(); iItem != _items.end(); ++iItem)
+    {
+        TCHAR buf[160];
+        _sntprintf_s(buf, _countof(buf), _TRUNCATE,
+                _T(": %u paths, %u KB (%u KB raw), +%u / -%u since built in %u ms\n"),
+                iItem->_paths->Count(), iItem->_paths->MemSize() / 1024, iItem->_paths->RawSize() / 1024,
+                iItem->_delta->_added.size(), iItem->_delta->_removed.size(), iItem->_buildTime);
+
+        stats += iItem->_dbPath;
+        stats += buf;
+    }
+}
+
+
+/**
+ *  \brief  Converts file full path to the DB relative form global prints
+ */
+void PathIndex::relativePath(const TCHAR* dbPath, const TCHAR* file, CTextA& path)
+{
+    toAnsi(file + _tcslen(dbPath), path);
+
+    for (char* c = path.C_str(); *c; ++c)
+        if (*c == '\\')
+            *c = '/';
+}
+
+
+/**
+ *  \brief
+ */
+bool PathIndex::acquire(const Cmd& cmd, PathsPtr& paths, DeltaPtr& delta)
+{
+    unsigned generation;
+    {
+        AUTOLOCK(_lock);
+
+        for (std::list<Item>::iterator iItem = _items.begin(); iItem != _items.end(); ++iItem)
+        {
+            if (iItem->_dbPath == cmd.DbPath())
+            {
+                paths = iItem->_paths;
+                delta = iItem->_delta;
+                return true;
+            }
+        }
+
+        generation = _generation;
+    }
+
+    DWORD startTime = GetTickCount();
+
+    paths = build(cmd);
+    if (!paths)
+        return false;
+
+    delta.reset(new Delta);
+
+    Item item;
+    item._dbPath    = cmd.DbPath();
+    item._paths     = paths;
+    item._delta     = delta;
+    item._buildTime = GetTickCount() - startTime;
+
+    AUTOLOCK(_lock);
+
+    // Don't keep index that was built while the DB was being changed
+    if (generation != _generation)
+        return true;
+
+    for (std::list<Item>::iterator iItem = _items.begin(); iItem != _items.end(); ++iItem)
+    {
+        if (iItem->_dbPath == item._dbPath)
+        {
+            _items.erase(iItem);
+            break;
+        }
+    }
+
+    _items.push_back(item);
+
+    return true;
+}
+
+
+/**
+ *  \brief
+ */
+PathIndex::PathsPtr PathIndex::build(const Cmd& cmd)
+{
+    std::shared_ptr<Cmd> buildCmd(new Cmd(FIND_FILE, _T("Build Path Index"), cmd.Db()));
+    buildCmd->Silent(cmd.Silent());
+
+    // Empty pattern - list all DB paths
+    if (!CmdEngine::Run(buildCmd))
+        return PathsPtr();
+
+    std::vector<char> list;
+    if (buildCmd->Result())
+        list.assign(buildCmd->Result(), buildCmd->Result() + buildCmd->ResultLen());
+
+    return PathsPtr(new Paths(list));
+}
+
+} // namespace GTags
@@ -0,0 +1,190 @@
+/**
+ *  \file
+ *  \brief  Compressed in-memory index of the DB file paths
+ *
+ *  \author  Pavel Nedev <pg.nedev@gmail.com>
+ *
+ *  \section COPYRIGHT
+ *  Copyright(C) 2015 Pavel Nedev
+ *
+ *  \section LICENSE
+ *  This program is free software; you can redistribute it and/or modify it
+ *  under the terms of the GNU General Public License version 2 as published
+ *  by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful, but
+ *  WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ *  or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ *  for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+#pragma once
+
+
+#include <windows.h>
+#include <tchar.h>
+#include <list>
+#include <memory>
+#include <vector>
+#include "Common.h"
+#include "AutoLock.h"
+#include "DbManager.h"
+#include "CmdEngine.h"
+
+
+namespace GTags
+{
+
+/**
+ *  \class  PathIndex
+ *  \brief  In-memory index of the DB file paths (GPATH) built on first use.
+ *          Serves file search, file name completion and header / source lookups
+ *          without running global. Kept in sync on single file updates
+ */
+class PathIndex
+{
+public:
+    /**
+     *  \class  Paths
+     *  \brief  Sorted front-coded paths plus stem hash and trigram lookup tables - immutable once built
+     */
+    class Paths
+    {
+    public:
+        /**
+         *  \struct  Cursor
+         *  \brief  Last decoded path - ascending ids decode without going back to the block start
+         */
+        struct Cursor
+        {
+            Cursor() : _id(0), _pos(0) {}
+
+            unsigned            _id;
+            unsigned            _pos;
+            std::vector<char>   _path;
+        };
+
+        Paths(std::vector<char>& list);
+        ~Paths() {}
+
+        bool Find(const char* path, unsigned& id) const;
+        unsigned LowerBound(const char* path) const;
+        void Decode(unsigned id, Cursor& cursor) const;
+
+        bool Candidates(const char* pattern, std::vector<unsigned>& ids) const;
+        void StemMatches(const char* path, std::vector<unsigned>& ids) const;
+
+        inline unsigned Count() const { return _count; }
+        inline unsigned RawSize() const { return _rawSize; }
+        unsigned MemSize() const;
+
+    private:
+        static const unsigned cBlockSize;
+
+        /**
+         *  \class  Grams
+         *  \brief  Case-folded trigram posting lists - ascending ids, delta and varint encoded
+         */
+        class Grams
+        {
+        public:
+            void Build(std::vector<std::pair<unsigned, unsigned>>& keyIds);
+            bool Lookup(const char* pattern, std::vector<unsigned>& ids) const;
+
+            inline unsigned MemSize() const
+            {
+                return (_keys.size() + _offsets.size()) * sizeof(unsigned) + _postings.size();
+            }
+
+        private:
+            void decode(unsigned keyIdx, std::vector<unsigned>& ids) const;
+
+            std::vector<unsigned>       _keys;
+            std::vector<unsigned>       _offsets;
+            std::vector<unsigned char>  _postings;
+        };
+
+        /**
+         *  \struct  Run
+         *  \brief  Consecutive paths in the same directory
+         */
+        struct Run
+        {
+            unsigned _first;
+            unsigned _count;
+        };
+
+        Paths(const Paths&);
+        const Paths& operator=(const Paths&);
+
+        unsigned                                    _count;
+        unsigned                                    _rawSize;
+        std::vector<char>                           _data;
+        std::vector<unsigned>                       _blocks;
+        std::vector<std::pair<unsigned, unsigned>>  _stems;
+        std::vector<Run>                            _runs;
+        Grams                                       _nameGrams;
+        Grams                                       _dirGrams;
+    };
+
+    typedef std::shared_ptr<const Paths> PathsPtr;
+
+    /**
+     *  \struct  Delta
+     *  \brief  Files added to / removed from the DB since the paths were built - immutable once set
+     */
+    struct Delta
+    {
+        std::vector<CTextA>     _added;
+        std::vector<unsigned>   _removed;
+    };
+
+    typedef std::shared_ptr<const Delta> DeltaPtr;
+
+    static PathIndex& Get() { return Instance; }
+
+    static bool Serves(const Cmd& cmd);
+
+    bool Run(const Cmd& cmd, std::vector<char>& result);
+    void FileUpdated(const CPath& dbPath, const CPath& file);
+    bool HasFilesIn(const CPath& dbPath, const CPath& dir, bool& has);
+    void Invalidate(const CPath& dbPath);
+    void GetStats(CText& stats);
+
+private:
+    static const unsigned cMaxDelta;
+
+    /**
+     *  \struct  Item
+     *  \brief
+     */
+    struct Item
+    {
+        CPath       _dbPath;
+        PathsPtr    _paths;
+        DeltaPtr    _delta;
+        DWORD       _buildTime;
+    };
+
+    static PathIndex Instance;
+
+    static void relativePath(const TCHAR* dbPath, const TCHAR* file, CTextA& path);
+
+    PathIndex() : _generation(0) {}
+    PathIndex(const PathIndex&);
+    ~PathIndex() {}
+
+    bool acquire(const Cmd& cmd, PathsPtr& paths, DeltaPtr& delta);
+    PathsPtr build(const Cmd& cmd);
+
+    Mutex               _lock;
+    unsigned            _generation;
+    std::list<Item>     _items;
+};
+
+} // namespace GTags
@@ -0,0 +1,151 @@
+/**
+ *  \file
+ *  \brief  Process-wide table of interned paths
+ *
+ *  \author  Pavel Nedev <pg.nedev@gmail.com>
+ *
+ *  \section COPYRIGHT
+ *  Copyright(C) 2015 Pavel Nedev
+ *
+ *  \section LICENSE
+ *  This program is free software; you can redistribute it and/or modify it
+ *  under the terms of the GNU General Public License version 2 as published
+ *  by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful, but
+ *  WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ *  or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ *  for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+#include "PathTable.h"
+
+
+namespace GTags
+{
+
+PathTable PathTable::Instance;
+
+
+/**
+ *  \brief
+ */
+PathTable::~PathTable()
+{
+    for (unsigned i = 0; i < cMaxChunks && _chunks[i]; ++i)
+        delete [] _chunks[i];
+}
+
+
+/**
+ *  \brief  Returns the path id adding the path if it is new, cNoPath if the table is full
+ */
+PathId PathTable::Intern(const CPath& path)
+{
+    if (path.IsEmpty())
+        return cNoPath;
+
+    {
+        AUTOLOCK_SHARED(_lock);
+
+        IdMap::iterator iId = _ids.find(path);
+        if (iId != _ids.end())
+            return iId->second;
+    }
+
+    AUTOLOCK(_lock);
+
+    // Could have been added meanwhile
+    IdMap::iterator iId = _ids.find(path);
+    if (iId != _ids.end())
+        return iId->second;
+
+    return add(path);
+}
+
+
+/**
+ *  \brief  Returns the path id, cNoPath if the path was never interned
+ */
+PathId PathTable::Find(const CPath& path)
+{
+    AUTOLOCK_SHARED(_lock);
+
+    IdMap::iterator iId = _ids.find(path);
+
+    return (iId != _ids.end()) ? iId->second : cNoPath;
+}
+
+
+/**
+ *  \brief
+ */
+void PathTable::GetStats(CText& stats)
+{
+    AUTOLOCK_SHARED(_lock);
+
+    if (_count <= 1)
+        return;
+
+    TCHAR buf[128];
+    _sntprintf_s(buf, _countof(buf), _TRUNCATE, _T(" %u paths, %u KB of path text\n"),
+            _count - 1, (unsigned)(_pathChars * sizeof(TCHAR) / 1024));
+
+    stats += buf;
+
+#ifdef DEVELOPMENT
+    unsigned acquired, contended;
+    _lock.GetContention(acquired, contended);
+    _sntprintf_s(buf, _countof(buf), _TRUNCATE, _T(" lock taken %u times, %u contended\n"), acquired, contended);
+
+    stats += buf;
+#endif
+}
+
+
+/**
+ *  \brief  Adds the path and those of its parent folders that are not in the table yet
+ */
+PathId PathTable::add(const CPath& path)
+{
+    PathId parentId = cNoPath;
+
+    // Parents first - adding them moves the next free id
+    CPath parent(path);
+    if (parent.DirUp())
+    {
+        IdMap::iterator iId = _ids.find(parent);
+        parentId = (iId != _ids.end()) ? iId->second : add(parent);
+
+        if (parentId == cNoPath)
+            return cNoPath;
+    }
+
+    const PathId id = _count;
+    const unsigned chunk = id >> cChunkBits;
+    if (chunk >= cMaxChunks)
+        return cNoPath;
+
+    if (!_chunks[chunk])
+        _chunks[chunk] = new Entry[cChunkSize];
+
+    ++_count;
+
+    Entry& e = _chunks[chunk][id & (cChunkSize - 1)];
+    e._path = path;
+    if (parentId != cNoPath)
+        e._chain = entry(parentId)._chain;
+    e._chain.push_back(id);
+
+    _ids.insert(IdMap::value_type(path, id));
+    _pathChars += path.Len();
+
+    return id;
+}
+
+} // namespace GTags
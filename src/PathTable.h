@@ -0,0 +1,126 @@
+/**
+ *  \file
+ *  \brief  Process-wide table of interned paths
+ *
+ *  \author  Pavel Nedev <pg.nedev@gmail.com>
+ *
+ *  \section COPYRIGHT
+ *  Copyright(C) 2015 Pavel Nedev
+ *
+ *  \section LICENSE
+ *  This program is free software; you can redistribute it and/or modify it
+ *  under the terms of the GNU General Public License version 2 as published
+ *  by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful, but
+ *  WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ *  or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ *  for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+#pragma once
+
+
+#include <windows.h>
+#include <tchar.h>
+#include <vector>
+#include <unordered_map>
+#include "Common.h"
+#include "AutoLock.h"
+
+
+namespace GTags
+{
+
+typedef unsigned PathId;
+
+// No path
+const PathId cNoPath = 0;
+
+
+/**
+ *  \class  PathTable
+ *  \brief  Hands out stable integer ids for paths (case-insensitive) so they are compared as integers.
+ *          Each path keeps the ids of all its parent folders so subpath tests need no string work.
+ *          Entries are never removed, ids read without the lock must have been got from Intern()/Find()
+ */
+class PathTable
+{
+public:
+    static PathTable& Get() { return Instance; }
+
+    PathId Intern(const CPath& path);
+    PathId Find(const CPath& path);
+    void GetStats(CText& stats);
+
+    inline const CPath& Path(PathId id) const { return entry(id)._path; }
+
+    inline PathId Parent(PathId id) const
+    {
+        if (id == cNoPath)
+            return cNoPath;
+
+        const Entry& e = entry(id);
+        return (e._chain.size() > 1) ? e._chain[e._chain.size() - 2] : cNoPath;
+    }
+
+    /**
+     *  \brief  True if id is a path inside the folder dirId
+     */
+    inline bool IsSubpath(PathId id, PathId dirId) const
+    {
+        if (id == cNoPath || dirId == cNoPath)
+            return false;
+
+        const std::vector<PathId>& chain = entry(id)._chain;
+        const unsigned depth = entry(dirId)._chain.size() - 1;
+
+        return (depth + 1 < chain.size() && chain[depth] == dirId);
+    }
+
+private:
+    static const unsigned cChunkBits = 12;
+    static const unsigned cChunkSize = 1 << cChunkBits;
+    static const unsigned cMaxChunks = 1024;
+
+    /**
+     *  \struct  Entry
+     *  \brief  The chain holds the ids from the root folder down to the path itself
+     */
+    struct Entry
+    {
+        CPath               _path;
+        std::vector<PathId> _chain;
+    };
+
+    typedef std::unordered_map<CPath, PathId, CPathHash, CPathEqual> IdMap;
+
+    static PathTable Instance;
+
+    PathTable() : _count(1), _pathChars(0)
+    {
+        ZeroMemory(_chunks, sizeof(_chunks));
+    }
+    PathTable(const PathTable&);
+    ~PathTable();
+
+    inline const Entry& entry(PathId id) const
+    {
+        return _chunks[id >> cChunkBits][id & (cChunkSize - 1)];
+    }
+
+    PathId add(const CPath& path);
+
+    RWMutex     _lock;
+    IdMap       _ids;
+    Entry*      _chunks[cMaxChunks];
+    unsigned    _count;
+    unsigned    _pathChars;
+};
+
+} // namespace GTags
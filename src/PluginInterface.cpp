@@ -26,7 +26,9 @@
 #include "INpp.h"
 #include "Config.h"
 #include "ResultWin.h"
+#include "DbWarmer.h"
 #include "GTags.h"
+#include "Trace.h"
 
 
 namespace
@@ -52,6 +54,7 @@ BOOL APIENTRY DllMain(HINSTANCE hModule, DWORD reasonForCall, LPVOID lpReserved)
         break;
 
         case DLL_THREAD_DETACH:
+            Trace::ThreadExit();
         break;
     }
 
@@ -140,6 +143,14 @@ extern "C" __declspec(dllexport) void beNotified(SCNotification* notifyCode)
             }
         break;
 
+        case NPPN_BUFFERACTIVATED:
+        {
+            CPath file;
+            INpp::Get().GetFilePathFromBufID(notifyCode->nmhdr.idFrom, file);
+            GTags::DbWarmer::Get().Activate(file);
+        }
+        break;
+
         case NPPN_WORDSTYLESUPDATED:
         {
             INpp& npp = INpp::Get();
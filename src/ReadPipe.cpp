@@ -24,6 +24,7 @@
 
 #include "ReadPipe.h"
 #include <process.h>
+#include "Trace.h"
 
 
 const unsigned ReadPipe::cChunkSize = 4096;
@@ -32,7 +33,7 @@ const unsigned ReadPipe::cChunkSize = 4096;
 /**
  *  \brief
  */
-ReadPipe::ReadPipe() : _hIn(NULL), _hOut(NULL), _hThread(NULL)
+ReadPipe::ReadPipe() : _hIn(NULL), _hOut(NULL), _hThread(NULL), _readLen(0)
 {
     SECURITY_ATTRIBUTES attr    = {0};
     attr.nLength                = sizeof(attr);
@@ -119,6 +120,27 @@ std::vector<char>& ReadPipe::GetOutput()
 }
 
 
+/**
+ *  \brief  Copies the complete lines read after offset from while the pipe is still being read.
+ *          Returns the offset after the copied lines
+ */
+unsigned ReadPipe::PeekLines(std::vector<char>& lines, unsigned from)
+{
+    AUTOLOCK(_lock);
+
+    unsigned end = _readLen;
+    while (end > from && _output[end - 1] != '\n')
+        --end;
+
+    if (end <= from)
+        return from;
+
+    lines.insert(lines.end(), _output.begin() + from, _output.begin() + end);
+
+    return end;
+}
+
+
 /**
  *  \brief
  */
@@ -141,17 +163,29 @@ unsigned ReadPipe::thread()
     {
         if (!chunkRemainingSize)
         {
+            AUTOLOCK(_lock);
+
             _output.resize(totalBytesRead + cChunkSize);
             chunkRemainingSize = cChunkSize;
         }
 
-        if (!ReadFile(_hOut, _output.data() + totalBytesRead, chunkRemainingSize, &bytesRead, NULL))
-            break;
+        {
+            TRACE_SPAN("ReadPipe::read");
+
+            if (!ReadFile(_hOut, _output.data() + totalBytesRead, chunkRemainingSize, &bytesRead, NULL))
+                break;
+        }
 
         chunkRemainingSize -= bytesRead;
         totalBytesRead += bytesRead;
+
+        // Let PeekLines() see the new data
+        AUTOLOCK(_lock);
+        _readLen = totalBytesRead;
     }
 
+    AUTOLOCK(_lock);
+
     _output.resize(totalBytesRead);
     if (totalBytesRead)
         _output.push_back('\0');
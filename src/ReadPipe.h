@@ -27,6 +27,7 @@
 
 #include <windows.h>
 #include <vector>
+#include "AutoLock.h"
 
 
 /**
@@ -43,6 +44,7 @@ public:
     bool Open();
     DWORD Wait(DWORD time_ms);
     std::vector<char>& GetOutput();
+    unsigned PeekLines(std::vector<char>& lines, unsigned from);
 
 private:
     static const unsigned cChunkSize;
@@ -58,5 +60,7 @@ private:
     HANDLE              _hIn;
     HANDLE              _hOut;
     HANDLE              _hThread;
+    Mutex               _lock;
+    unsigned            _readLen;
     std::vector<char>   _output;
 };
@@ -0,0 +1,154 @@
+/**
+ *  \file
+ *  \brief  GTags command result model
+ *
+ *  \author  Pavel Nedev <pg.nedev@gmail.com>
+ *
+ *  \section COPYRIGHT
+ *  Copyright(C) 2015 Pavel Nedev
+ *
+ *  \section LICENSE
+ *  This program is free software; you can redistribute it and/or modify it
+ *  under the terms of the GNU General Public License version 2 as published
+ *  by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful, but
+ *  WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ *  or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ *  for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+#include <string.h>
+#include "ResultModel.h"
+
+
+namespace GTags
+{
+
+/**
+ *  \brief  Returns false if the result lines don't match the files content (the DB is outdated)
+ */
+bool ResultModel::Compose(CTextA& dst, const Cmd& cmd)
+{
+    // Add the search header - cmd name + search word + project path
+    dst = cmd.Name();
+    dst += " \"";
+    dst += cmd.Tag();
+    dst += "\" (";
+    dst += cmd.RegExp() ? "regexp, ": "literal, ";
+    dst += cmd.MatchCase() ? "match case": "ignore case";
+    dst += ") in \"";
+    dst += cmd.DbPath();
+    dst += "\"";
+
+    if (!cmd.Result())
+        return true;
+
+    // parsing result buffer and composing UI buffer
+    if (cmd.Id() == FIND_FILE)
+    {
+        parseFindFile(dst, cmd.Result());
+        return true;
+    }
+
+    return parseCmd(dst, cmd.Result());
+}
+
+
+/**
+ *  \brief
+ */
+bool ResultModel::parseCmd(CTextA& dst, const char* src)
+{
+    const char* pLine;
+    const char* pPreviousFile = NULL;
+    unsigned pPreviousFileLen = 0;
+
+    for (;;)
+    {
+        while (*src == '\n' || *src == '\r')
+            ++src;
+        if (*src == 0) break;
+
+        // The drive letter separator is not the line number one
+        pLine = IsAbsolutePath(src) ? src + 2 : src;
+        while (*pLine != ':' && *pLine != 0)
+            ++pLine;
+
+        // Not a grep format line
+        if (*pLine == 0)
+            return false;
+
+        // add new file name to the UI buffer only if it is different
+        // than the previous one
+        if ((pPreviousFile == NULL) || ((unsigned)(pLine - src) != pPreviousFileLen) ||
+                strncmp(src, pPreviousFile, pPreviousFileLen))
+        {
+            pPreviousFile = src;
+            pPreviousFileLen = pLine - src;
+            dst += "\n\t";
+            dst.Append(pPreviousFile, pPreviousFileLen);
+        }
+
+        src = ++pLine;
+        while (*src != ':' && *src != 0)
+            ++src;
+
+        if (*src == 0)
+            return false;
+
+        dst += "\n\t\tline ";
+        dst.Append(pLine, src - pLine);
+        dst += ":\t";
+
+        pLine = ++src;
+        while (*pLine == ' ' || *pLine == '\t')
+            ++pLine;
+
+        if (*pLine == 0)
+            return false;
+
+        src = pLine + 1;
+        while (*src != '\n' && *src != '\r' && *src != 0)
+            ++src;
+
+        // Empty source line - the file has changed since the DB update
+        if (src == pLine + 1)
+            return false;
+
+        dst.Append(pLine, src - pLine);
+    }
+
+    return true;
+}
+
+
+/**
+ *  \brief
+ */
+void ResultModel::parseFindFile(CTextA& dst, const char* src)
+{
+    const char* eol;
+
+    for (;;)
+    {
+        while (*src == '\n' || *src == '\r' || *src == ' ' || *src == '\t')
+            ++src;
+        if (*src == 0) break;
+
+        eol = src;
+        while (*eol != '\n' && *eol != '\r' && *eol != 0)
+            ++eol;
+
+        dst += "\n\t";
+        dst.Append(src, eol - src);
+        src = eol;
+    }
+}
+
+} // namespace GTags
@@ -0,0 +1,66 @@
+/**
+ *  \file
+ *  \brief  GTags command result model
+ *
+ *  \author  Pavel Nedev <pg.nedev@gmail.com>
+ *
+ *  \section COPYRIGHT
+ *  Copyright(C) 2015 Pavel Nedev
+ *
+ *  \section LICENSE
+ *  This program is free software; you can redistribute it and/or modify it
+ *  under the terms of the GNU General Public License version 2 as published
+ *  by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful, but
+ *  WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ *  or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ *  for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+#pragma once
+
+
+#include "Common.h"
+#include "Cmd.h"
+
+
+namespace GTags
+{
+
+/**
+ *  \class  ResultModel
+ *  \brief  Groups the command result lines by file the way the results window shows them -
+ *          header line, then each file followed by its result lines. Has no UI dependencies
+ */
+class ResultModel
+{
+public:
+    static bool Compose(CTextA& dst, const Cmd& cmd);
+
+    /**
+     *  \brief  Library results on another drive than the project have absolute paths (D:/lib/file.c or
+     *          //server/share/lib/file.c)
+     */
+    static inline bool IsAbsolutePath(const char* path)
+    {
+        if (path[0] == '/' && path[1] == '/')
+            return true;
+
+        return (((path[0] >= 'A' && path[0] <= 'Z') || (path[0] >= 'a' && path[0] <= 'z')) &&
+                path[1] == ':' && (path[2] == '/' || path[2] == '\\'));
+    }
+
+private:
+    static bool parseCmd(CTextA& dst, const char* src);
+    static void parseFindFile(CTextA& dst, const char* src);
+
+    ResultModel();
+};
+
+} // namespace GTags
@@ -0,0 +1,516 @@
+/**
+ *  \file
+ *  \brief  GTags result Scintilla view - text, styling, folding and navigation
+ *
+ *  \author  Pavel Nedev <pg.nedev@gmail.com>
+ *
+ *  \section COPYRIGHT
+ *  Copyright(C) 2015 Pavel Nedev
+ *
+ *  \section LICENSE
+ *  This program is free software; you can redistribute it and/or modify it
+ *  under the terms of the GNU General Public License version 2 as published
+ *  by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful, but
+ *  WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ *  or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ *  for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+#include "ResultView.h"
+#include "ResultModel.h"
+#include <vector>
+#include <string.h>
+#include <stdlib.h>
+
+
+namespace
+{
+
+/**
+ *  \brief
+ */
+inline void addStyle(std::vector<char>& styles, int len, int style)
+{
+    if (len > 0)
+        styles.insert(styles.end(), len, static_cast<char>(style));
+}
+
+} // anonymous namespace
+
+
+namespace GTags
+{
+
+// SciOp_t names
+const TCHAR* const cSciOpNames[] =
+{
+    _T("Tab load"),
+    _T("Styling"),
+    _T("Result open"),
+    _T("Key navigation")
+};
+
+
+/**
+ *  \brief
+ */
+ResultView::Tab::Tab(const std::shared_ptr<Cmd>& cmd) :
+    _cmdId(cmd->Id()), _regExp(cmd->RegExp()), _matchCase(cmd->MatchCase()),
+    _projectId(PathTable::Get().Intern(cmd->DbPath())), _projectPathLen(0), _search(cmd->Tag()), _outdated(false),
+    _currentLine(1), _firstVisibleLine(0)
+{
+    _outdated = !ResultModel::Compose(_uiBuf, *cmd);
+
+    // The header line ends with the UTF-8 project path
+    _projectPathLen = CTextA(cmd->DbPath()).Len();
+}
+
+
+/**
+ *  \brief
+ */
+void ResultView::Tab::SetFolded(int lineNum)
+{
+    for (std::vector<int>::iterator i = _expandedLines.begin(); i != _expandedLines.end(); ++i)
+    {
+        if (*i == lineNum)
+        {
+            _expandedLines.erase(i);
+            break;
+        }
+    }
+}
+
+
+/**
+ *  \brief
+ */
+void ResultView::Tab::ClearFolded(int lineNum)
+{
+    _expandedLines.push_back(lineNum);
+}
+
+
+/**
+ *  \brief
+ */
+bool ResultView::Tab::IsFolded(int lineNum)
+{
+    const int size = _expandedLines.size();
+
+    for (int i = 0; i < size; ++i)
+        if (_expandedLines[i] == lineNum)
+            return false;
+
+    return true;
+}
+
+
+/**
+ *  \brief
+ */
+ResultView::SciOpCounter::~SciOpCounter()
+{
+    unsigned calls = _view._sciCalls - _start;
+    SciOpStats& stats = _view._opStats[_op];
+
+    ++stats._count;
+    stats._calls += calls;
+    if (stats._maxCalls < calls)
+        stats._maxCalls = calls;
+}
+
+
+/**
+ *  \brief
+ */
+void ResultView::Load(Tab* tab)
+{
+    SciOpCounter counter(*this, LOAD_TAB_OP);
+
+    Send(SCI_SETCURSOR, SC_CURSORWAIT);
+
+    // store current view if there is one
+    if (_activeTab)
+    {
+        _activeTab->_currentLine = Send(SCI_LINEFROMPOSITION, Send(SCI_GETCURRENTPOS));
+        _activeTab->_firstVisibleLine = Send(SCI_GETFIRSTVISIBLELINE);
+    }
+
+    _activeTab = NULL;
+
+    Send(SCI_SETREADONLY, 0);
+    Send(SCI_CLEARALL);
+
+    _activeTab = tab;
+
+    Send(SCI_SETTEXT, 0, reinterpret_cast<LPARAM>(tab->_uiBuf.C_str()));
+    Send(SCI_SETREADONLY, 1);
+
+    Send(SCI_SETFIRSTVISIBLELINE, tab->_firstVisibleLine);
+    Send(SCI_GOTOLINE, tab->_currentLine);
+
+    Send(SCI_SETCURSOR, SC_CURSORNORMAL);
+}
+
+
+/**
+ *  \brief  Drops the active tab (the caller owns it) and empties the view
+ */
+void ResultView::Clear()
+{
+    _activeTab = NULL;
+
+    Send(SCI_SETREADONLY, 0);
+    Send(SCI_CLEARALL);
+    Send(SCI_SETREADONLY, 1);
+}
+
+
+/**
+ *  \brief  Styles the lines from the end of the styled text up to pos
+ */
+void ResultView::Style(int pos)
+{
+    if (_activeTab == NULL)
+        return;
+
+    SciOpCounter counter(*this, STYLE_OP);
+
+    // The document is the tab UI buffer - read it directly instead of char by char through Scintilla
+    const char* text = _activeTab->_uiBuf.C_str();
+    const int textLen = _activeTab->_uiBuf.Len();
+
+    int lineNum = Send(SCI_LINEFROMPOSITION, Send(SCI_GETENDSTYLED));
+    const int stylingStartPos = Send(SCI_POSITIONFROMLINE, lineNum);
+    const int endStylingPos = (pos < textLen) ? pos : textLen;
+
+    if (endStylingPos <= stylingStartPos)
+        return;
+
+    // The whole range is styled with a single message
+    std::vector<char> styles;
+    styles.reserve(endStylingPos - stylingStartPos);
+
+    for (int startPos = stylingStartPos, endPos; endStylingPos > startPos; startPos = endPos, ++lineNum)
+    {
+        const char* eol = static_cast<const char*>(memchr(text + startPos, '\n', textLen - startPos));
+        endPos = eol ? (eol - text) + 1 : textLen;
+
+        const int lineLen = endPos - startPos;
+
+        if (text[startPos] != '\t')
+        {
+            int pathLen = _activeTab->_projectPathLen;
+
+            // 2 * '"' + LF + CR = 4
+            addStyle(styles, lineLen - pathLen - 4, SCE_GTAGS_HEADER);
+            addStyle(styles, pathLen + 4, SCE_GTAGS_PROJECT_PATH);
+        }
+        else
+        {
+            if (text[startPos + 1] != '\t')
+            {
+                if (_activeTab->_cmdId == FIND_FILE)
+                {
+                    int findBegin = startPos;
+                    int findEnd = endPos;
+                    int stylePos = startPos;
+
+                    // Highlight all matches in a single result line
+                    while (FindString(_activeTab->_search.C_str(), &findBegin, &findEnd,
+                            _activeTab->_matchCase, false, _activeTab->_regExp))
+                    {
+                        addStyle(styles, findBegin - stylePos, SCE_GTAGS_FILE);
+                        addStyle(styles, findEnd - findBegin, SCE_GTAGS_WORD2SEARCH);
+
+                        findBegin = stylePos = findEnd;
+                        findEnd = endPos;
+                    }
+
+                    addStyle(styles, endPos - stylePos, SCE_GTAGS_FILE);
+                }
+                else
+                {
+                    addStyle(styles, lineLen, SCE_GTAGS_FILE);
+                    Send(SCI_SETFOLDLEVEL, lineNum, FILE_HEADER_LVL | SC_FOLDLEVELHEADERFLAG);
+
+                    if (_activeTab->IsFolded(lineNum))
+                        Send(SCI_FOLDLINE, lineNum, SC_FOLDACTION_CONTRACT);
+                }
+            }
+            else
+            {
+                // "\t\tline: Num" - 'N' is at position 8
+                int previewPos = startPos + 8;
+                while (previewPos < endPos && text[previewPos] != '\t')
+                    ++previewPos;
+
+                int findBegin = previewPos;
+                int findEnd = endPos;
+
+                bool wholeWord = (_activeTab->_cmdId != GREP);
+
+                if (FindString(_activeTab->_search.C_str(), &findBegin, &findEnd,
+                    _activeTab->_matchCase, wholeWord, _activeTab->_regExp))
+                {
+                    addStyle(styles, previewPos - startPos, SCE_GTAGS_LINE_NUM);
+
+                    // Highlight all matches in a single result line
+                    do
+                    {
+                        addStyle(styles, findBegin - previewPos, STYLE_DEFAULT);
+                        addStyle(styles, findEnd - findBegin, SCE_GTAGS_WORD2SEARCH);
+
+                        findBegin = previewPos = findEnd;
+                        findEnd = endPos;
+                    }
+                    while (FindString(_activeTab->_search.C_str(), &findBegin, &findEnd,
+                            _activeTab->_matchCase, wholeWord, _activeTab->_regExp));
+
+                    addStyle(styles, endPos - previewPos, STYLE_DEFAULT);
+                }
+                else
+                {
+                    addStyle(styles, lineLen, STYLE_DEFAULT);
+                }
+
+                Send(SCI_SETFOLDLEVEL, lineNum, RESULT_LVL);
+            }
+        }
+
+        // Keep the styles in sync with the positions whatever the line content
+        styles.resize(endPos - stylingStartPos, STYLE_DEFAULT);
+    }
+
+    Send(SCI_STARTSTYLING, stylingStartPos, 0xFF);
+    Send(SCI_SETSTYLINGEX, styles.size(), reinterpret_cast<LPARAM>(styles.data()));
+}
+
+
+/**
+ *  \brief  Moves to the result line and gets the file and the (0 based) line it points to
+ */
+bool ResultView::GetItem(int lineNum, CPath& file, int& line)
+{
+    SciOpCounter counter(*this, OPEN_ITEM_OP);
+
+    Send(SCI_GOTOLINE, lineNum);
+
+    int lineLen = Send(SCI_LINELENGTH, lineNum);
+    if (lineLen <= 0)
+        return false;
+
+    std::vector<char> lineTxt;
+    lineTxt.resize(lineLen + 1, 0);
+
+    Send(SCI_GETLINE, lineNum, reinterpret_cast<LPARAM>(lineTxt.data()));
+
+    line = 0;
+    int i;
+
+    if (_activeTab->_cmdId != FIND_FILE)
+    {
+        for (i = 7; i <= lineLen && lineTxt[i] != ':'; ++i);
+        lineTxt[i] = 0;
+        line = atoi(&lineTxt[7]) - 1;
+
+        lineNum = Send(SCI_GETFOLDPARENT, lineNum);
+        if (lineNum == -1)
+            return false;
+
+        lineLen = Send(SCI_LINELENGTH, lineNum);
+        if (lineLen <= 0)
+            return false;
+
+        lineTxt.resize(lineLen + 1, 0);
+        Send(SCI_GETLINE, lineNum, reinterpret_cast<LPARAM>(lineTxt.data()));
+    }
+
+    for (i = 1; (i <= lineLen) && (lineTxt[i] != '\r') && (lineTxt[i] != '\n'); ++i);
+
+    if (_activeTab->_projectId == cNoPath)
+        return false;
+
+    // Only the relative path needs converting, the project path is kept wide in the path table
+    CTextA relPath;
+    relPath.Append(&lineTxt[1], i - 1);
+
+    if (ResultModel::IsAbsolutePath(relPath.C_str()))
+        file.Clear();
+    else
+        file = PathTable::Get().Path(_activeTab->_projectId);
+    file += relPath.C_str();
+
+    return true;
+}
+
+
+/**
+ *  \brief  Moves the caret on up / down / page up / page down and expands / collapses on + / -,
+ *          skipping the folded lines
+ */
+bool ResultView::Navigate(WORD keyCode)
+{
+    SciOpCounter counter(*this, KEY_NAV_OP);
+
+    bool handled = true;
+    int lineNum = Send(SCI_LINEFROMPOSITION, Send(SCI_GETCURRENTPOS));
+
+    switch (keyCode)
+    {
+        case VK_UP:
+            if (--lineNum >= 0)
+            {
+                if (!(Send(SCI_GETFOLDLEVEL, lineNum) & SC_FOLDLEVELHEADERFLAG))
+                {
+                    int foldLine = Send(SCI_GETFOLDPARENT, lineNum);
+                    if (!Send(SCI_GETFOLDEXPANDED, foldLine))
+                        lineNum = foldLine;
+                }
+
+                Send(SCI_GOTOLINE, lineNum);
+            }
+        break;
+
+        case VK_DOWN:
+            if (++lineNum < Send(SCI_GETLINECOUNT))
+            {
+                if (!(Send(SCI_GETFOLDLEVEL, lineNum) & SC_FOLDLEVELHEADERFLAG))
+                {
+                    int foldLine = Send(SCI_GETFOLDPARENT, lineNum);
+                    if (!Send(SCI_GETFOLDEXPANDED, foldLine))
+                    {
+                        int nextFold = Send(SCI_GETLASTCHILD, foldLine, Send(SCI_GETFOLDLEVEL, foldLine)) + 1;
+                        lineNum = (nextFold < Send(SCI_GETLINECOUNT)) ? nextFold : foldLine;
+                    }
+                }
+
+                Send(SCI_GOTOLINE, lineNum);
+            }
+        break;
+
+        case VK_PRIOR:
+        {
+            int linesOnScreen = Send(SCI_LINESONSCREEN);
+            Send(SCI_LINESCROLL, 0, -linesOnScreen);
+            lineNum = Send(SCI_DOCLINEFROMVISIBLE, Send(SCI_GETFIRSTVISIBLELINE));
+            Send(SCI_GOTOLINE, lineNum);
+        }
+        break;
+
+        case VK_NEXT:
+        {
+            int linesOnScreen       = Send(SCI_LINESONSCREEN);
+            int firstVisibleLine    = Send(SCI_GETFIRSTVISIBLELINE);
+            Send(SCI_LINESCROLL, 0, linesOnScreen);
+            int newFirstVisible     = Send(SCI_GETFIRSTVISIBLELINE);
+
+            if (newFirstVisible - firstVisibleLine >= linesOnScreen)
+            {
+                lineNum = Send(SCI_DOCLINEFROMVISIBLE, newFirstVisible);
+            }
+            else
+            {
+                lineNum = Send(SCI_GETLINECOUNT) - 1;
+                int foldLine = Send(SCI_GETFOLDPARENT, lineNum);
+                if (!Send(SCI_GETFOLDEXPANDED, foldLine))
+                    lineNum = foldLine;
+            }
+
+            Send(SCI_GOTOLINE, lineNum);
+        }
+        break;
+
+        case VK_ADD:
+            if (!(Send(SCI_GETFOLDLEVEL, lineNum) & SC_FOLDLEVELHEADERFLAG))
+                lineNum = Send(SCI_GETFOLDPARENT, lineNum);
+            if (lineNum > 0 && !Send(SCI_GETFOLDEXPANDED, lineNum))
+                ToggleFolding(lineNum);
+        break;
+
+        case VK_SUBTRACT:
+            if (!(Send(SCI_GETFOLDLEVEL, lineNum) & SC_FOLDLEVELHEADERFLAG))
+                lineNum = Send(SCI_GETFOLDPARENT, lineNum);
+            if (lineNum > 0 && Send(SCI_GETFOLDEXPANDED, lineNum))
+                ToggleFolding(lineNum);
+        break;
+
+        default:
+            handled = false;
+    }
+
+    return handled;
+}
+
+
+/**
+ *  \brief
+ */
+void ResultView::ToggleFolding(int lineNum)
+{
+    Send(SCI_GOTOLINE, lineNum);
+    Send(SCI_TOGGLEFOLD, lineNum);
+    if (Send(SCI_GETFOLDEXPANDED, lineNum))
+        _activeTab->ClearFolded(lineNum);
+    else
+        _activeTab->SetFolded(lineNum);
+}
+
+
+/**
+ *  \brief
+ */
+bool ResultView::FindString(const char* str, int* startPos, int* endPos, bool matchCase, bool wholeWord,
+        bool regExp)
+{
+    int searchFlags = 0;
+    if (matchCase)
+        searchFlags |= SCFIND_MATCHCASE;
+    if (wholeWord)
+        searchFlags |= SCFIND_WHOLEWORD;
+    if (regExp)
+        searchFlags |= (SCFIND_REGEXP | SCFIND_POSIX);
+
+    Send(SCI_SETSEARCHFLAGS, searchFlags);
+    Send(SCI_SETTARGETSTART, *startPos);
+    Send(SCI_SETTARGETEND, *endPos);
+
+    if (Send(SCI_SEARCHINTARGET, strlen(str), reinterpret_cast<LPARAM>(str)) >= 0)
+    {
+        *startPos = Send(SCI_GETTARGETSTART);
+        *endPos = Send(SCI_GETTARGETEND);
+        return true;
+    }
+
+    return false;
+}
+
+
+/**
+ *  \brief  Scintilla messages count per operation
+ */
+void ResultView::GetStats(CText& stats)
+{
+    for (unsigned op = 0; op < SCI_OP_END; ++op)
+    {
+        if (!_opStats[op]._count)
+            continue;
+
+        TCHAR buf[128];
+        _sntprintf_s(buf, _countof(buf), _TRUNCATE, _T(" %s: %u times, %u messages average, %u max\n"),
+                cSciOpNames[op], _opStats[op]._count, _opStats[op]._calls / _opStats[op]._count,
+                _opStats[op]._maxCalls);
+
+        stats += buf;
+    }
+}
+
+} // namespace GTags
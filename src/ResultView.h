@@ -0,0 +1,174 @@
+/**
+ *  \file
+ *  \brief  GTags result Scintilla view - text, styling, folding and navigation
+ *
+ *  \author  Pavel Nedev <pg.nedev@gmail.com>
+ *
+ *  \section COPYRIGHT
+ *  Copyright(C) 2015 Pavel Nedev
+ *
+ *  \section LICENSE
+ *  This program is free software; you can redistribute it and/or modify it
+ *  under the terms of the GNU General Public License version 2 as published
+ *  by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful, but
+ *  WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ *  or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ *  for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+#pragma once
+
+
+#include <windows.h>
+#include <tchar.h>
+#include <vector>
+#include <memory>
+#include "Scintilla.h"
+#include "Common.h"
+#include "Cmd.h"
+#include "PathTable.h"
+#include "SciSurface.h"
+
+
+// Scintilla user defined styles IDs
+enum SciStyles_t
+{
+    SCE_GTAGS_HEADER = 151,
+    SCE_GTAGS_PROJECT_PATH,
+    SCE_GTAGS_FILE,
+    SCE_GTAGS_LINE_NUM,
+    SCE_GTAGS_WORD2SEARCH
+};
+
+
+// Scintilla fold levels
+enum SciFoldLevels_t
+{
+    FILE_HEADER_LVL = SC_FOLDLEVELBASE,
+    RESULT_LVL
+};
+
+
+namespace GTags
+{
+
+/**
+ *  \class  ResultView
+ *  \brief  The results window Scintilla part - loads the tab text, styles and folds it and moves through
+ *          the results. Talks to Scintilla only through SciSurface so it runs without a window
+ */
+class ResultView
+{
+public:
+    enum SciOp_t
+    {
+        LOAD_TAB_OP = 0,
+        STYLE_OP,
+        OPEN_ITEM_OP,
+        KEY_NAV_OP,
+        SCI_OP_END
+    };
+
+    /**
+     *  \struct  SciOpStats
+     *  \brief  Scintilla messages sent by one kind of results view operation
+     */
+    struct SciOpStats
+    {
+        unsigned    _count;
+        unsigned    _calls;
+        unsigned    _maxCalls;
+    };
+
+    /**
+     *  \struct  Tab
+     *  \brief
+     */
+    struct Tab
+    {
+        Tab(const std::shared_ptr<Cmd>& cmd);
+        ~Tab() {}
+
+        inline bool operator==(const Tab& tab) const
+        {
+            return (_cmdId == tab._cmdId && _projectId == tab._projectId && _search == tab._search);
+        }
+
+        const CmdId_t       _cmdId;
+        const bool          _regExp;
+        const bool          _matchCase;
+        const PathId        _projectId;
+        unsigned            _projectPathLen;
+        CTextA              _search;
+        bool                _outdated;
+        CTextA              _uiBuf;
+        int                 _currentLine;
+        int                 _firstVisibleLine;
+
+        void SetFolded(int lineNum);
+        void ClearFolded(int lineNum);
+        bool IsFolded(int lineNum);
+
+    private:
+        std::vector<int> _expandedLines;
+    };
+
+    ResultView(SciSurface& sci) : _sci(sci), _activeTab(NULL), _sciCalls(0), _opStats() {}
+    ~ResultView() {}
+
+    inline LRESULT Send(UINT msg, WPARAM wParam = 0, LPARAM lParam = 0)
+    {
+        ++_sciCalls;
+        return _sci.Send(msg, wParam, lParam);
+    }
+
+    inline Tab* ActiveTab() const { return _activeTab; }
+    inline const SciOpStats& OpStats(SciOp_t op) const { return _opStats[op]; }
+
+    void Load(Tab* tab);
+    void Clear();
+    void Style(int pos);
+    bool GetItem(int lineNum, CPath& file, int& line);
+    bool Navigate(WORD keyCode);
+    void ToggleFolding(int lineNum);
+    bool FindString(const char* str, int* startPos, int* endPos, bool matchCase, bool wholeWord, bool regExp);
+    void GetStats(CText& stats);
+
+private:
+    /**
+     *  \class  SciOpCounter
+     *  \brief  Adds the Scintilla messages sent while in scope to the operation stats
+     */
+    class SciOpCounter
+    {
+    public:
+        SciOpCounter(ResultView& view, SciOp_t op) : _view(view), _op(op), _start(view._sciCalls) {}
+        ~SciOpCounter();
+
+    private:
+        SciOpCounter(const SciOpCounter&);
+        const SciOpCounter& operator=(const SciOpCounter&);
+
+        ResultView&     _view;
+        const SciOp_t   _op;
+        const unsigned  _start;
+    };
+
+    ResultView(const ResultView&);
+    const ResultView& operator=(const ResultView&);
+
+    SciSurface& _sci;
+    Tab*        _activeTab;
+
+    unsigned    _sciCalls;
+    SciOpStats  _opStats[SCI_OP_END];
+};
+
+} // namespace GTags
@@ -31,27 +31,8 @@
 #include "DocLocation.h"
 #include "ActivityWin.h"
 #include <commctrl.h>
-#include <vector>
 #include "Common.h"
-
-
-// Scintilla user defined styles IDs
-enum SciStyles_t
-{
-    SCE_GTAGS_HEADER = 151,
-    SCE_GTAGS_PROJECT_PATH,
-    SCE_GTAGS_FILE,
-    SCE_GTAGS_LINE_NUM,
-    SCE_GTAGS_WORD2SEARCH
-};
-
-
-// Scintilla fold levels
-enum SciFoldLevels_t
-{
-    FILE_HEADER_LVL = SC_FOLDLEVELBASE,
-    RESULT_LVL
-};
+#include "Trace.h"
 
 
 namespace GTags
@@ -63,153 +44,6 @@ const TCHAR ResultWin::cClassName[]   = _T("ResultWin");
 ResultWin* ResultWin::RW = NULL;
 
 
-/**
- *  \brief
- */
-ResultWin::Tab::Tab(const std::shared_ptr<Cmd>& cmd) :
-    _cmdId(cmd->Id()), _regExp(cmd->RegExp()), _matchCase(cmd->MatchCase()), _projectPath(cmd->DbPath()),
-    _search(cmd->Tag()), _outdated(false), _currentLine(1), _firstVisibleLine(0)
-{
-    // Add the search header - cmd name + search word + project path
-    _uiBuf = cmd->Name();
-    _uiBuf += " \"";
-    _uiBuf += _search.C_str();
-    _uiBuf += "\" (";
-    _uiBuf += _regExp ? "regexp, ": "literal, ";
-    _uiBuf += _matchCase ? "match case": "ignore case";
-    _uiBuf += ") in \"";
-    _uiBuf += _projectPath;
-    _uiBuf += "\"";
-
-    // parsing result buffer and composing UI buffer
-    if (_cmdId == FIND_FILE)
-        parseFindFile(_uiBuf, cmd->Result());
-    else
-        parseCmd(_uiBuf, cmd->Result());
-}
-
-
-/**
- *  \brief
- */
-void ResultWin::Tab::parseCmd(CTextA& dst, const char* src)
-{
-    const char* pLine;
-    const char* pPreviousFile = NULL;
-    unsigned pPreviousFileLen = 0;
-
-    for (;;)
-    {
-        while (*src == '\n' || *src == '\r')
-            ++src;
-        if (*src == 0) break;
-
-        pLine = src;
-        while (*pLine != ':')
-            ++pLine;
-
-        // add new file name to the UI buffer only if it is different
-        // than the previous one
-        if ((pPreviousFile == NULL) || ((unsigned)(pLine - src) != pPreviousFileLen) ||
-                strncmp(src, pPreviousFile, pPreviousFileLen))
-        {
-            pPreviousFile = src;
-            pPreviousFileLen = pLine - src;
-            dst += "\n\t";
-            dst.Append(pPreviousFile, pPreviousFileLen);
-        }
-
-        src = ++pLine;
-        while (*src != ':')
-            ++src;
-
-        dst += "\n\t\tline ";
-        dst.Append(pLine, src - pLine);
-        dst += ":\t";
-
-        pLine = ++src;
-        while (*pLine == ' ' || *pLine == '\t')
-            ++pLine;
-
-        src = pLine + 1;
-        while (*src != '\n' && *src != '\r')
-            ++src;
-
-        if (src == pLine + 1)
-        {
-            _outdated = true;
-            break;
-        }
-
-        dst.Append(pLine, src - pLine);
-    }
-}
-
-
-/**
- *  \brief
- */
-void ResultWin::Tab::parseFindFile(CTextA& dst, const char* src)
-{
-    const char* eol;
-
-    for (;;)
-    {
-        while (*src == '\n' || *src == '\r' || *src == ' ' || *src == '\t')
-            ++src;
-        if (*src == 0) break;
-
-        eol = src;
-        while (*eol != '\n' && *eol != '\r' && *eol != 0)
-            ++eol;
-
-        dst += "\n\t";
-        dst.Append(src, eol - src);
-        src = eol;
-    }
-}
-
-
-/**
- *  \brief
- */
-void ResultWin::Tab::SetFolded(int lineNum)
-{
-    for (std::vector<int>::iterator i = _expandedLines.begin(); i != _expandedLines.end(); ++i)
-    {
-        if (*i == lineNum)
-        {
-            _expandedLines.erase(i);
-            break;
-        }
-    }
-}
-
-
-/**
- *  \brief
- */
-void ResultWin::Tab::ClearFolded(int lineNum)
-{
-    _expandedLines.push_back(lineNum);
-}
-
-
-/**
- *  \brief
- */
-bool ResultWin::Tab::IsFolded(int lineNum)
-{
-    const int size = _expandedLines.size();
-
-    for (int i = 0; i < size; ++i)
-        if (_expandedLines[i] == lineNum)
-            return false;
-
-    return true;
-}
-
-
 /**
  *  \brief
  */
@@ -311,8 +145,13 @@ void ResultWin::show(const std::shared_ptr<Cmd>& cmd)
             return;
     }
 
-    // parsing results happens here
-    Tab* tab = new Tab(cmd);
+    Tab* tab;
+    {
+        TRACE_SPAN("ResultWin::Tab");
+
+        // parsing results happens here
+        tab = new Tab(cmd);
+    }
 
     AUTOLOCK(_lock);
 
@@ -323,8 +162,8 @@ void ResultWin::show(const std::shared_ptr<Cmd>& cmd)
 
         if (oldTab && (*tab == *oldTab)) // same search tab already present?
         {
-            if (_activeTab == oldTab) // is this the currently active tab?
-                _activeTab = NULL;
+            if (_view.ActiveTab() == oldTab) // is this the currently active tab?
+                _view.Clear();
             delete oldTab;
             break;
         }
@@ -379,7 +218,7 @@ void ResultWin::show(const std::shared_ptr<Cmd>& cmd)
 
     if (tab == NULL)
     {
-        if (_activeTab)
+        if (_view.ActiveTab())
             return;
 
         int cnt = TabCtrl_GetItemCount(_hTab);
@@ -462,6 +301,15 @@ ResultWin::~ResultWin()
 }
 
 
+/**
+ *  \brief
+ */
+void ResultWin::getStats(CText& stats)
+{
+    _view.GetStats(stats);
+}
+
+
 /**
  *  \brief
  */
@@ -546,14 +394,17 @@ HWND ResultWin::composeWindow()
     if (_hWnd == NULL)
         return NULL;
 
+    SciFnDirect sciFunc = NULL;
+    sptr_t sciPtr = 0;
+
     _hSci = npp.CreateSciHandle(_hWnd);
     if (_hSci)
     {
-        _sciFunc    = (SciFnDirect)::SendMessage(_hSci, SCI_GETDIRECTFUNCTION, 0, 0);
-        _sciPtr     = (sptr_t)::SendMessage(_hSci, SCI_GETDIRECTPOINTER, 0, 0);
+        sciFunc = (SciFnDirect)::SendMessage(_hSci, SCI_GETDIRECTFUNCTION, 0, 0);
+        sciPtr  = (sptr_t)::SendMessage(_hSci, SCI_GETDIRECTPOINTER, 0, 0);
     }
 
-    if (_hSci == NULL || _sciFunc == NULL || _sciPtr == 0)
+    if (_hSci == NULL || sciFunc == NULL || sciPtr == 0)
     {
         SendMessage(_hWnd, WM_CLOSE, 0, 0);
         _hWnd = NULL;
@@ -561,6 +412,8 @@ HWND ResultWin::composeWindow()
         return NULL;
     }
 
+    _sci.Attach(sciFunc, sciPtr);
+
     AdjustWindowRect(&win, style, FALSE);
     MoveWindow(_hWnd, win.left, win.top, win.right - win.left, win.bottom - win.top, TRUE);
     GetClientRect(_hWnd, &win);
@@ -644,29 +497,9 @@ ResultWin::Tab* ResultWin::getTab(int i)
  */
 void ResultWin::loadTab(ResultWin::Tab* tab)
 {
-    sendSci(SCI_SETCURSOR, SC_CURSORWAIT);
+    TRACE_SPAN("ResultWin::loadTab");
 
-    // store current view if there is one
-    if (_activeTab)
-    {
-        _activeTab->_currentLine = sendSci(SCI_LINEFROMPOSITION, sendSci(SCI_GETCURRENTPOS));
-        _activeTab->_firstVisibleLine = sendSci(SCI_GETFIRSTVISIBLELINE);
-    }
-
-    _activeTab = NULL;
-
-    sendSci(SCI_SETREADONLY, 0);
-    sendSci(SCI_CLEARALL);
-
-    _activeTab = tab;
-
-    sendSci(SCI_SETTEXT, 0, reinterpret_cast<LPARAM>(tab->_uiBuf.C_str()));
-    sendSci(SCI_SETREADONLY, 1);
-
-    sendSci(SCI_SETFIRSTVISIBLELINE, tab->_firstVisibleLine);
-    sendSci(SCI_GOTOLINE, tab->_currentLine);
-
-    sendSci(SCI_SETCURSOR, SC_CURSORNORMAL);
+    _view.Load(tab);
 }
 
 
@@ -675,45 +508,12 @@ void ResultWin::loadTab(ResultWin::Tab* tab)
  */
 bool ResultWin::openItem(int lineNum, unsigned matchNum)
 {
-    sendSci(SCI_GOTOLINE, lineNum);
+    CPath file;
+    int line;
 
-    int lineLen = sendSci(SCI_LINELENGTH, lineNum);
-    if (lineLen <= 0)
+    if (!_view.GetItem(lineNum, file, line))
         return false;
 
-    std::vector<char> lineTxt;
-    lineTxt.resize(lineLen + 1, 0);
-
-    sendSci(SCI_GETLINE, lineNum, reinterpret_cast<LPARAM>(lineTxt.data()));
-
-    int line = 0;
-    int i;
-
-    if (_activeTab->_cmdId != FIND_FILE)
-    {
-        for (i = 7; i <= lineLen && lineTxt[i] != ':'; ++i);
-        lineTxt[i] = 0;
-        line = atoi(&lineTxt[7]) - 1;
-
-        lineNum = sendSci(SCI_GETFOLDPARENT, lineNum);
-        if (lineNum == -1)
-            return false;
-
-        lineLen = sendSci(SCI_LINELENGTH, lineNum);
-        if (lineLen <= 0)
-            return false;
-
-        lineTxt.resize(lineLen + 1, 0);
-        sendSci(SCI_GETLINE, lineNum, reinterpret_cast<LPARAM>(lineTxt.data()));
-    }
-
-    for (i = 1; (i <= lineLen) && (lineTxt[i] != '\r') && (lineTxt[i] != '\n'); ++i);
-    lineTxt[i] = 0;
-
-    CPath file(_activeTab->_projectPath.C_str());
-    CText str(&lineTxt[1]);
-    file += str.C_str();
-
     INpp& npp = INpp::Get();
     if (!file.FileExists())
     {
@@ -728,20 +528,21 @@ bool ResultWin::openItem(int lineNum, unsigned matchNum)
     npp.OpenFile(file.C_str());
     SetFocus(npp.GetSciHandle());
 
-    if (_activeTab->_cmdId == FIND_FILE)
+    const Tab* tab = _view.ActiveTab();
+
+    if (tab->_cmdId == FIND_FILE)
         return true;
 
     const long endPos = npp.LineEndPosition(line);
 
-    const bool wholeWord = (_activeTab->_cmdId != GREP);
+    const bool wholeWord = (tab->_cmdId != GREP);
 
     // Highlight the corresponding match number if there are more than one
     // matches on single result line
     for (long findBegin = npp.PositionFromLine(line), findEnd = endPos;
         matchNum; findBegin = findEnd, findEnd = endPos, --matchNum)
     {
-        if (!npp.SearchText(_activeTab->_search.C_str(), _activeTab->_matchCase, wholeWord, _activeTab->_regExp,
-                &findBegin, &findEnd))
+        if (!npp.SearchText(tab->_search.C_str(), tab->_matchCase, wholeWord, tab->_regExp, &findBegin, &findEnd))
         {
             MessageBox(npp.GetHandle(),
                     _T("Look-up mismatch, present results are outdated.")
@@ -755,166 +556,20 @@ bool ResultWin::openItem(int lineNum, unsigned matchNum)
 }
 
 
-/**
- *  \brief
- */
-bool ResultWin::findString(const char* str, int* startPos, int* endPos, bool matchCase, bool wholeWord, bool regExp)
-{
-    int searchFlags = 0;
-    if (matchCase)
-        searchFlags |= SCFIND_MATCHCASE;
-    if (wholeWord)
-        searchFlags |= SCFIND_WHOLEWORD;
-    if (regExp)
-        searchFlags |= (SCFIND_REGEXP | SCFIND_POSIX);
-
-    sendSci(SCI_SETSEARCHFLAGS, searchFlags);
-    sendSci(SCI_SETTARGETSTART, *startPos);
-    sendSci(SCI_SETTARGETEND, *endPos);
-
-    if (sendSci(SCI_SEARCHINTARGET, strlen(str), reinterpret_cast<LPARAM>(str)) >= 0)
-    {
-        *startPos = sendSci(SCI_GETTARGETSTART);
-        *endPos = sendSci(SCI_GETTARGETEND);
-        return true;
-    }
-
-    return false;
-}
-
-
-/**
- *  \brief
- */
-void ResultWin::toggleFolding(int lineNum)
-{
-    sendSci(SCI_GOTOLINE, lineNum);
-    sendSci(SCI_TOGGLEFOLD, lineNum);
-    if (sendSci(SCI_GETFOLDEXPANDED, lineNum))
-        _activeTab->ClearFolded(lineNum);
-    else
-        _activeTab->SetFolded(lineNum);
-}
-
-
 /**
  *  \brief
  */
 void ResultWin::onStyleNeeded(SCNotification* notify)
 {
-    if (_activeTab == NULL)
+    TRACE_SPAN("ResultWin::onStyleNeeded");
+
+    if (_view.ActiveTab() == NULL)
         return;
 
     IF_AUTO_TRYLOCK_FAIL(_lock)
         return;
 
-    int lineNum = sendSci(SCI_LINEFROMPOSITION, sendSci(SCI_GETENDSTYLED));
-    const int endStylingPos = notify->position;
-
-    for (int startPos = sendSci(SCI_POSITIONFROMLINE, lineNum); endStylingPos > startPos;
-            startPos = sendSci(SCI_POSITIONFROMLINE, ++lineNum))
-    {
-        const int lineLen = sendSci(SCI_LINELENGTH, lineNum);
-        if (lineLen <= 0)
-            continue;
-
-        const int endPos = startPos + lineLen;
-
-        sendSci(SCI_STARTSTYLING, startPos, 0xFF);
-
-        if ((char)sendSci(SCI_GETCHARAT, startPos) != '\t')
-        {
-            int pathLen = _activeTab->_projectPath.Len();
-
-            // 2 * '"' + LF + CR = 4
-            sendSci(SCI_SETSTYLING, lineLen - pathLen - 4, SCE_GTAGS_HEADER);
-            sendSci(SCI_SETSTYLING, pathLen + 4, SCE_GTAGS_PROJECT_PATH);
-        }
-        else
-        {
-            if ((char)sendSci(SCI_GETCHARAT, startPos + 1) != '\t')
-            {
-                if (_activeTab->_cmdId == FIND_FILE)
-                {
-                    int findBegin = startPos;
-                    int findEnd = endPos;
-
-                    if (findString(_activeTab->_search.C_str(), &findBegin, &findEnd,
-                        _activeTab->_matchCase, false, _activeTab->_regExp))
-                    {
-                        // Highlight all matches in a single result line
-                        do
-                        {
-                            if (findBegin - startPos)
-                                sendSci(SCI_SETSTYLING, findBegin - startPos, SCE_GTAGS_FILE);
-
-                            sendSci(SCI_SETSTYLING, findEnd - findBegin, SCE_GTAGS_WORD2SEARCH);
-
-                            findBegin = startPos = findEnd;
-                            findEnd = endPos;
-                        }
-                        while (findString(_activeTab->_search.C_str(), &findBegin, &findEnd,
-                                _activeTab->_matchCase, false, _activeTab->_regExp));
-
-                        if (endPos - startPos)
-                            sendSci(SCI_SETSTYLING, endPos - startPos, SCE_GTAGS_FILE);
-                    }
-                    else
-                    {
-                        sendSci(SCI_SETSTYLING, lineLen, SCE_GTAGS_FILE);
-                    }
-                }
-                else
-                {
-                    sendSci(SCI_SETSTYLING, lineLen, SCE_GTAGS_FILE);
-                    sendSci(SCI_SETFOLDLEVEL, lineNum, FILE_HEADER_LVL | SC_FOLDLEVELHEADERFLAG);
-
-                    if (_activeTab->IsFolded(lineNum))
-                        sendSci(SCI_FOLDLINE, lineNum, SC_FOLDACTION_CONTRACT);
-                }
-            }
-            else
-            {
-                // "\t\tline: Num" - 'N' is at position 8
-                int previewPos = startPos + 8;
-                for (; (char)sendSci(SCI_GETCHARAT, previewPos) != '\t'; ++previewPos);
-
-                int findBegin = previewPos;
-                int findEnd = endPos;
-
-                bool wholeWord = (_activeTab->_cmdId != GREP);
-
-                if (findString(_activeTab->_search.C_str(), &findBegin, &findEnd,
-                    _activeTab->_matchCase, wholeWord, _activeTab->_regExp))
-                {
-                    sendSci(SCI_SETSTYLING, previewPos - startPos, SCE_GTAGS_LINE_NUM);
-
-                    // Highlight all matches in a single result line
-                    do
-                    {
-                        if (findBegin - previewPos)
-                            sendSci(SCI_SETSTYLING, findBegin - previewPos, STYLE_DEFAULT);
-
-                        sendSci(SCI_SETSTYLING, findEnd - findBegin, SCE_GTAGS_WORD2SEARCH);
-
-                        findBegin = previewPos = findEnd;
-                        findEnd = endPos;
-                    }
-                    while (findString(_activeTab->_search.C_str(), &findBegin, &findEnd,
-                            _activeTab->_matchCase, wholeWord, _activeTab->_regExp));
-
-                    if (endPos - previewPos)
-                        sendSci(SCI_SETSTYLING, endPos - previewPos, STYLE_DEFAULT);
-                }
-                else
-                {
-                    sendSci(SCI_SETSTYLING, lineLen, STYLE_DEFAULT);
-                }
-
-                sendSci(SCI_SETFOLDLEVEL, lineNum, RESULT_LVL);
-            }
-        }
-    }
+    _view.Style(notify->position);
 }
 
 
@@ -926,23 +581,26 @@ void ResultWin::onHotspotClick(SCNotification* notify)
     IF_AUTO_TRYLOCK_FAIL(_lock)
         return;
 
+    const Tab* tab = _view.ActiveTab();
     const int lineNum = sendSci(SCI_LINEFROMPOSITION, notify->position);
     unsigned matchNum = 1;
 
-    if (_activeTab->_cmdId != FIND_FILE)
+    if (tab->_cmdId != FIND_FILE)
     {
         const int endLine = sendSci(SCI_GETLINEENDPOSITION, lineNum);
 
         // "\t\tline: Num" - 'N' is at position 8
         int findBegin = sendSci(SCI_POSITIONFROMLINE, lineNum) + 8;
-        for (; (char)sendSci(SCI_GETCHARAT, findBegin) != '\t'; ++findBegin);
 
-        bool wholeWord = (_activeTab->_cmdId != GREP);
+        const char* text = tab->_uiBuf.C_str();
+        for (; findBegin < endLine && text[findBegin] != '\t'; ++findBegin);
+
+        bool wholeWord = (tab->_cmdId != GREP);
 
         // Find which hotspot was clicked in case there are more than one
         // matches on single result line
-        for (int findEnd = endLine; findString(_activeTab->_search.C_str(), &findBegin, &findEnd,
-                    _activeTab->_matchCase, wholeWord, _activeTab->_regExp);
+        for (int findEnd = endLine; _view.FindString(tab->_search.C_str(), &findBegin, &findEnd,
+                    tab->_matchCase, wholeWord, tab->_regExp);
                 findBegin = findEnd, findEnd = endLine, ++matchNum)
             if (notify->position >= findBegin && notify->position <= findEnd)
                 break;
@@ -987,7 +645,7 @@ void ResultWin::onDoubleClick(int pos)
     if (lineNum > 0)
     {
         if (sendSci(SCI_GETFOLDLEVEL, lineNum) & SC_FOLDLEVELHEADERFLAG)
-            toggleFolding(lineNum);
+            _view.ToggleFolding(lineNum);
         else
             openItem(lineNum);
     }
@@ -1009,7 +667,7 @@ void ResultWin::onMarginClick(SCNotification* notify)
 
     if (lineNum > 0)
     {
-        toggleFolding(lineNum);
+        _view.ToggleFolding(lineNum);
     }
     else
     {
@@ -1027,42 +685,8 @@ bool ResultWin::onKeyPress(WORD keyCode)
     IF_AUTO_TRYLOCK_FAIL(_lock)
         return false;
 
-    bool handled = true;
-    int lineNum = sendSci(SCI_LINEFROMPOSITION, sendSci(SCI_GETCURRENTPOS));
-
     switch (keyCode)
     {
-        case VK_UP:
-            if (--lineNum >= 0)
-            {
-                if (!(sendSci(SCI_GETFOLDLEVEL, lineNum) & SC_FOLDLEVELHEADERFLAG))
-                {
-                    int foldLine = sendSci(SCI_GETFOLDPARENT, lineNum);
-                    if (!sendSci(SCI_GETFOLDEXPANDED, foldLine))
-                        lineNum = foldLine;
-                }
-
-                sendSci(SCI_GOTOLINE, lineNum);
-            }
-        break;
-
-        case VK_DOWN:
-            if (++lineNum < sendSci(SCI_GETLINECOUNT))
-            {
-                if (!(sendSci(SCI_GETFOLDLEVEL, lineNum) & SC_FOLDLEVELHEADERFLAG))
-                {
-                    int foldLine = sendSci(SCI_GETFOLDPARENT, lineNum);
-                    if (!sendSci(SCI_GETFOLDEXPANDED, foldLine))
-                    {
-                        int nextFold = sendSci(SCI_GETLASTCHILD, foldLine, sendSci(SCI_GETFOLDLEVEL, foldLine)) + 1;
-                        lineNum = (nextFold < sendSci(SCI_GETLINECOUNT)) ? nextFold : foldLine;
-                    }
-                }
-
-                sendSci(SCI_GOTOLINE, lineNum);
-            }
-        break;
-
         case VK_LEFT:
         {
             int i = TabCtrl_GetCurSel(_hTab);
@@ -1095,57 +719,11 @@ bool ResultWin::onKeyPress(WORD keyCode)
         }
         break;
 
-        case VK_PRIOR:
-        {
-            int linesOnScreen = sendSci(SCI_LINESONSCREEN);
-            sendSci(SCI_LINESCROLL, 0, -linesOnScreen);
-            lineNum = sendSci(SCI_DOCLINEFROMVISIBLE, sendSci(SCI_GETFIRSTVISIBLELINE));
-            sendSci(SCI_GOTOLINE, lineNum);
-        }
-        break;
-
-        case VK_NEXT:
-        {
-            int linesOnScreen       = sendSci(SCI_LINESONSCREEN);
-            int firstVisibleLine    = sendSci(SCI_GETFIRSTVISIBLELINE);
-            sendSci(SCI_LINESCROLL, 0, linesOnScreen);
-            int newFirstVisible     = sendSci(SCI_GETFIRSTVISIBLELINE);
-
-            if (newFirstVisible - firstVisibleLine >= linesOnScreen)
-            {
-                lineNum = sendSci(SCI_DOCLINEFROMVISIBLE, newFirstVisible);
-            }
-            else
-            {
-                lineNum = sendSci(SCI_GETLINECOUNT) - 1;
-                int foldLine = sendSci(SCI_GETFOLDPARENT, lineNum);
-                if (!sendSci(SCI_GETFOLDEXPANDED, foldLine))
-                    lineNum = foldLine;
-            }
-
-            sendSci(SCI_GOTOLINE, lineNum);
-        }
-        break;
-
-        case VK_ADD:
-            if (!(sendSci(SCI_GETFOLDLEVEL, lineNum) & SC_FOLDLEVELHEADERFLAG))
-                lineNum = sendSci(SCI_GETFOLDPARENT, lineNum);
-            if (lineNum > 0 && !sendSci(SCI_GETFOLDEXPANDED, lineNum))
-                toggleFolding(lineNum);
-        break;
-
-        case VK_SUBTRACT:
-            if (!(sendSci(SCI_GETFOLDLEVEL, lineNum) & SC_FOLDLEVELHEADERFLAG))
-                lineNum = sendSci(SCI_GETFOLDPARENT, lineNum);
-            if (lineNum > 0 && sendSci(SCI_GETFOLDEXPANDED, lineNum))
-                toggleFolding(lineNum);
-        break;
-
         default:
-            handled = false;
+            return _view.Navigate(keyCode);
     }
 
-    return handled;
+    return true;
 }
 
 
@@ -1172,8 +750,9 @@ void ResultWin::onCloseTab()
         return;
 
     int i = TabCtrl_GetCurSel(_hTab);
-    delete _activeTab;
-    _activeTab = NULL;
+    Tab* activeTab = _view.ActiveTab();
+    _view.Clear();
+    delete activeTab;
     TabCtrl_DeleteItem(_hTab, i);
 
     if (TabCtrl_GetItemCount(_hTab))
@@ -1186,10 +765,6 @@ void ResultWin::onCloseTab()
     }
     else
     {
-        sendSci(SCI_SETREADONLY, 0);
-        sendSci(SCI_CLEARALL);
-        sendSci(SCI_SETREADONLY, 1);
-
         hideWindow();
     }
 }
@@ -1200,7 +775,7 @@ void ResultWin::onCloseTab()
  */
 void ResultWin::closeAllTabs()
 {
-    _activeTab = NULL;
+    _view.Clear();
 
     for (int i = TabCtrl_GetItemCount(_hTab); i; --i)
     {
@@ -1210,10 +785,6 @@ void ResultWin::closeAllTabs()
         TabCtrl_DeleteItem(_hTab, i - 1);
     }
 
-    sendSci(SCI_SETREADONLY, 0);
-    sendSci(SCI_CLEARALL);
-    sendSci(SCI_SETREADONLY, 1);
-
     hideWindow();
 }
 
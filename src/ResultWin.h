@@ -33,6 +33,9 @@
 #include "Common.h"
 #include "GTags.h"
 #include "CmdEngine.h"
+#include "PathTable.h"
+#include "SciSurface.h"
+#include "ResultView.h"
 
 
 namespace GTags
@@ -66,41 +69,14 @@ public:
             RW->applyStyle();
     }
 
-private:
-    /**
-     *  \struct  Tab
-     *  \brief
-     */
-    struct Tab
+    static void GetStats(CText& stats)
     {
-        Tab(const std::shared_ptr<Cmd>& cmd);
-        ~Tab() {}
-
-        inline bool operator==(const Tab& tab) const
-        {
-            return (_cmdId == tab._cmdId && _projectPath == tab._projectPath && _search == tab._search);
-        }
-
-        const CmdId_t       _cmdId;
-        const bool          _regExp;
-        const bool          _matchCase;
-        CTextA              _projectPath;
-        CTextA              _search;
-        bool                _outdated;
-        CTextA              _uiBuf;
-        int                 _currentLine;
-        int                 _firstVisibleLine;
-
-        void SetFolded(int lineNum);
-        void ClearFolded(int lineNum);
-        bool IsFolded(int lineNum);
-
-    private:
-        void parseCmd(CTextA& dst, const char* src);
-        void parseFindFile(CTextA& dst, const char* src);
-
-        std::vector<int> _expandedLines;
-    };
+        if (RW)
+            RW->getStats(stats);
+    }
+
+private:
+    typedef ResultView::Tab Tab;
 
     static const COLORREF   cBlack = RGB(0,0,0);
     static const COLORREF   cWhite = RGB(255,255,255);
@@ -110,18 +86,18 @@ private:
     static LRESULT CALLBACK keyHookProc(int code, WPARAM wParam, LPARAM lParam);
     static LRESULT APIENTRY wndProc(HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM lParam);
 
-    ResultWin() : _hWnd(NULL), _hSci(NULL), _hKeyHook(NULL), _sciFunc(NULL), _sciPtr(0), _activeTab(NULL) {}
+    ResultWin() : _hWnd(NULL), _hSci(NULL), _hKeyHook(NULL), _view(_sci) {}
     ResultWin(const ResultWin&);
     ~ResultWin();
 
     void show();
     void show(const std::shared_ptr<Cmd>& cmd);
     void applyStyle();
+    void getStats(CText& stats);
 
     inline LRESULT sendSci(UINT Msg, WPARAM wParam = 0, LPARAM lParam = 0)
     {
-        return _sciFunc(_sciPtr, static_cast<unsigned int>(Msg),
-                static_cast<uptr_t>(wParam), static_cast<sptr_t>(lParam));
+        return _view.Send(Msg, wParam, lParam);
     }
 
     void setStyle(int style, COLORREF fore = cBlack, COLORREF back = cWhite, bool bold = false, bool italic = false,
@@ -141,8 +117,6 @@ private:
     void loadTab(Tab* tab);
     bool openItem(int lineNum, unsigned matchNum = 1);
 
-    bool findString(const char* str, int* startPos, int* endPos, bool matchCase, bool wholeWord, bool regExp);
-    void toggleFolding(int lineNum);
     void onStyleNeeded(SCNotification* notify);
     void onHotspotClick(SCNotification* notify);
     void onDoubleClick(int pos);
@@ -160,9 +134,8 @@ private:
     HWND        _hSci;
     HWND        _hTab;
     HHOOK       _hKeyHook;
-    SciFnDirect _sciFunc;
-    sptr_t      _sciPtr;
-    Tab*        _activeTab;
+    SciDirect   _sci;
+    ResultView  _view;
 };
 
 } // namespace GTags
@@ -0,0 +1,74 @@
+/**
+ *  \file
+ *  \brief  Scintilla editor surface interface
+ *
+ *  \author  Pavel Nedev <pg.nedev@gmail.com>
+ *
+ *  \section COPYRIGHT
+ *  Copyright(C) 2015 Pavel Nedev
+ *
+ *  \section LICENSE
+ *  This program is free software; you can redistribute it and/or modify it
+ *  under the terms of the GNU General Public License version 2 as published
+ *  by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful, but
+ *  WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ *  or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ *  for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+#pragma once
+
+
+#include <windows.h>
+#include "Scintilla.h"
+
+
+namespace GTags
+{
+
+/**
+ *  \class  SciSurface
+ *  \brief  The Scintilla messages sink of a view - the real editor or an in-memory one
+ */
+class SciSurface
+{
+public:
+    virtual ~SciSurface() {}
+
+    virtual LRESULT Send(UINT msg, WPARAM wParam = 0, LPARAM lParam = 0) = 0;
+};
+
+
+/**
+ *  \class  SciDirect
+ *  \brief  Sends the messages to Scintilla window through its direct function
+ */
+class SciDirect : public SciSurface
+{
+public:
+    SciDirect() : _func(NULL), _ptr(0) {}
+
+    inline void Attach(SciFnDirect func, sptr_t ptr)
+    {
+        _func = func;
+        _ptr = ptr;
+    }
+
+    virtual LRESULT Send(UINT msg, WPARAM wParam = 0, LPARAM lParam = 0)
+    {
+        return _func(_ptr, static_cast<unsigned int>(msg), static_cast<uptr_t>(wParam), static_cast<sptr_t>(lParam));
+    }
+
+private:
+    SciFnDirect _func;
+    sptr_t      _ptr;
+};
+
+} // namespace GTags
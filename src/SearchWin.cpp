@@ -40,10 +40,18 @@ namespace GTags
 const TCHAR SearchWin::cClassName[] = _T("SearchWin");
 const int SearchWin::cWidth         = 420;
 const int SearchWin::cComplAfter    = 2;
+const int SearchWin::cListRows      = 8;
+const DWORD SearchWin::cKeyBudget   = 16;
+const UINT SearchWin::cComplReadyMsg = WM_USER + 1;
 
 
 SearchWin* SearchWin::SW = NULL;
 
+unsigned SearchWin::KeyCount        = 0;
+unsigned SearchWin::OverBudgetCount = 0;
+unsigned SearchWin::TotalTime       = 0;
+unsigned SearchWin::MaxTime         = 0;
+
 
 /**
  *  \brief
@@ -62,7 +70,7 @@ void SearchWin::Register()
 
     INITCOMMONCONTROLSEX icex   = {0};
     icex.dwSize                 = sizeof(icex);
-    icex.dwICC                  = ICC_STANDARD_CLASSES;
+    icex.dwICC                  = ICC_STANDARD_CLASSES | ICC_LISTVIEW_CLASSES;
 
     InitCommonControlsEx(&icex);
 }
@@ -106,6 +114,23 @@ void SearchWin::Close()
 }
 
 
+/**
+ *  \brief  Per keystroke completion list update times since the plugin load
+ */
+void SearchWin::GetStats(CText& stats)
+{
+    if (!KeyCount)
+        return;
+
+    TCHAR buf[160];
+    _sntprintf_s(buf, _countof(buf), _TRUNCATE,
+            _T(" %u keystrokes, avg %u us, max %u us, %u over the %u ms budget\n"),
+            KeyCount, TotalTime / KeyCount, MaxTime, OverBudgetCount, cKeyBudget);
+
+    stats += buf;
+}
+
+
 /**
  *  \brief
  */
@@ -245,19 +270,36 @@ HWND SearchWin::composeWindow(HWND hOwner, bool enRE, bool enMC)
             2 * width + 15, 5, width, btnHeight,
             _hWnd, NULL, HMod, NULL);
 
-    _hSearch = CreateWindowEx(0, WC_COMBOBOX, NULL,
-            WS_CHILD | WS_VISIBLE | WS_VSCROLL |
-            CBS_DROPDOWN | CBS_HASSTRINGS | CBS_AUTOHSCROLL | CBS_SORT,
+    _hSearch = CreateWindowEx(WS_EX_CLIENTEDGE, _T("EDIT"), NULL,
+            WS_CHILD | WS_VISIBLE | ES_AUTOHSCROLL,
             2, btnHeight + 10, win.right - win.left - 4, txtHeight,
             _hWnd, NULL, HMod, NULL);
 
+    // Completion drop-down - virtual list, only the visible rows are ever materialized
+    _hList = CreateWindowEx(WS_EX_NOACTIVATE, WC_LISTVIEW, NULL,
+            WS_POPUP | WS_BORDER |
+            LVS_REPORT | LVS_OWNERDATA | LVS_NOCOLUMNHEADER | LVS_SINGLESEL | LVS_SHOWSELALWAYS,
+            0, 0, 0, 0,
+            _hWnd, NULL, HMod, NULL);
+
+    ListView_SetExtendedListViewStyle(_hList, LVS_EX_FULLROWSELECT | LVS_EX_DOUBLEBUFFER);
+
+    LVCOLUMN lvCol  = {0};
+    lvCol.mask      = LVCF_WIDTH;
+    lvCol.cx        = win.right - win.left;
+    ListView_InsertColumn(_hList, 0, &lvCol);
+
     if (_hTxtFont)
+    {
         SendMessage(_hSearch, WM_SETFONT, (WPARAM)_hTxtFont, TRUE);
-
-    ComboBox_SetMinVisible(_hSearch, 8);
+        SendMessage(_hList, WM_SETFONT, (WPARAM)_hTxtFont, TRUE);
+    }
 
     if (_cmd->Tag())
-        ComboBox_SetText(_hSearch, _cmd->Tag());
+    {
+        setText(_cmd->Tag());
+        Edit_SetSel(_hSearch, 0, -1);
+    }
 
     if (_hBtnFont)
     {
@@ -275,6 +317,9 @@ HWND SearchWin::composeWindow(HWND hOwner, bool enRE, bool enMC)
 
     _hKeyHook = SetWindowsHookEx(WH_KEYBOARD, keyHookProc, NULL, GetCurrentThreadId());
 
+    // Start fetching the completion for the initial text before the user has started typing
+    prefetchCompletion();
+
     ShowWindow(_hWnd, SW_SHOWNORMAL);
     UpdateWindow(_hWnd);
 
@@ -283,56 +328,53 @@ HWND SearchWin::composeWindow(HWND hOwner, bool enRE, bool enMC)
 
 
 /**
- *  \brief
+ *  \brief  Uses the cached completion list if available or requests it
+ *          and waits for cComplReadyMsg
  */
 void SearchWin::startCompletion()
 {
     if (Button_GetCheck(_hRE) == BST_CHECKED)
         return;
 
-    TCHAR tag[cComplAfter + 2];
+    TCHAR tag[cComplAfter + 1];
+    GetWindowText(_hSearch, tag, _countof(tag));
 
-    if (_cmd->Id() == FIND_FILE)
-    {
-        tag[0] = _T('/');
-        ComboBox_GetText(_hSearch, tag + 1, _countof(tag) - 1);
-        tag[cComplAfter + 1] = 0;
-    }
-    else
-    {
-        ComboBox_GetText(_hSearch, tag, _countof(tag));
-        tag[cComplAfter] = 0;
-    }
+    _compl = ComplCache::Get().Find(_cmd->DbPath(), complId(), tag);
+    if (_compl)
+        endCompletion();
+    else if (!ComplCache::Get().Prefetch(_cmd->Db(), complId(), tag, _hWnd, cComplReadyMsg))
+        _completionDone = true; // Completion is not available, don't retry until the prefix changes
+}
 
-    std::shared_ptr<Cmd> cmpl(new Cmd(AUTOCOMPLETE, _T("AutoComplete"), _cmd->Db(), tag, false,
-            (Button_GetCheck(_hMC) == BST_CHECKED)));
 
-    if (_cmd->Id() == FIND_FILE)
-    {
-        cmpl->Id(AUTOCOMPLETE_FILE);
-    }
-    else
+/**
+ *  \brief  Requests in background the completion list for the already typed chars and
+ *          the one for their first char that covers all the next prefixes after a correction
+ */
+void SearchWin::prefetchCompletion()
+{
+    if (Button_GetCheck(_hRE) == BST_CHECKED)
+        return;
+
+    TCHAR tag[cComplAfter + 1];
+    GetWindowText(_hSearch, tag, _countof(tag));
+
+    ComplCache::Get().Prefetch(_cmd->Db(), complId(), tag, _hWnd, cComplReadyMsg);
+
+    if (tag[0] && tag[1])
     {
-        CmdEngine::Run(cmpl);
-        cmpl->Id(AUTOCOMPLETE_SYMBOL);
+        tag[1] = 0;
+        ComplCache::Get().Prefetch(_cmd->Db(), complId(), tag);
     }
-
-    CmdEngine::Run(cmpl);
-    endCompletion(cmpl);
 }
 
 
 /**
  *  \brief
  */
-void SearchWin::endCompletion(const std::shared_ptr<Cmd>& cmpl)
+void SearchWin::endCompletion()
 {
-    if (cmpl->Status() == OK && cmpl->Result())
-    {
-        _complData = cmpl->Result();
-        parseCompletion();
-        filterComplList();
-    }
+    filterComplList();
 
     _completionDone = true;
 }
@@ -341,112 +383,207 @@ void SearchWin::endCompletion(const std::shared_ptr<Cmd>& cmpl)
 /**
  *  \brief
  */
-void SearchWin::parseCompletion()
+void SearchWin::clearCompletion()
 {
-    TCHAR* pTmp = NULL;
-    for (TCHAR* pToken = _tcstok_s(_complData.C_str(), _T("\n\r"), &pTmp); pToken;
-            pToken = _tcstok_s(NULL, _T("\n\r"), &pTmp))
-    {
-        if (_cmd->Id() == FIND_FILE)
-            ++pToken;
-        _complIndex.push_back(pToken);
-    }
+    showList(0);
+
+    _compl.reset();
+    _completionDone = false;
 }
 
 
 /**
  *  \brief
  */
-void SearchWin::clearCompletion()
+void SearchWin::filterComplList()
 {
-    CText txt(ComboBox_GetTextLength(_hSearch));
+    if (!_compl || !_compl->Size())
+    {
+        showList(0);
+        return;
+    }
 
-    ComboBox_GetText(_hSearch, txt.C_str(), txt.Size());
-    int pos = HIWORD(SendMessage(_hSearch, CB_GETEDITSEL, 0, 0));
+    CText filter(GetWindowTextLength(_hSearch));
+    GetWindowText(_hSearch, filter.C_str(), filter.Size());
 
-    ComboBox_ResetContent(_hSearch);
-    ComboBox_ShowDropdown(_hSearch, FALSE);
-    ComboBox_SetText(_hSearch, txt.C_str());
-    PostMessage(_hSearch, CB_SETEDITSEL, 0, MAKELPARAM(pos, pos));
+    _complMC = (Button_GetCheck(_hMC) == BST_CHECKED);
 
-    _complIndex.clear();
-    _completionDone = false;
+    // The cached list is case-insensitive superset of the filter prefix so it always needs narrowing.
+    // It is kept sorted so the matching candidates are a range in it
+    showList(_compl->Narrow(filter.C_str(), _complMC, _complFirst));
 }
 
 
 /**
- *  \brief
+ *  \brief  Sets the drop-down list size to count rows and shows it under the search box
  */
-void SearchWin::filterComplList()
+void SearchWin::showList(unsigned count)
 {
-    if (_complIndex.empty())
+    ListView_SetItemState(_hList, -1, 0, LVIS_FOCUSED | LVIS_SELECTED);
+    ListView_SetItemCountEx(_hList, count, 0);
+
+    if (!count)
+    {
+        ShowWindow(_hList, SW_HIDE);
         return;
+    }
 
-    CText filter(ComboBox_GetTextLength(_hSearch));
+    ListView_EnsureVisible(_hList, 0, FALSE);
 
-    ComboBox_GetText(_hSearch, filter.C_str(), filter.Size());
+    int rowsCount = (count < (unsigned)cListRows) ? count : cListRows;
+    DWORD rectSize = ListView_ApproximateViewRect(_hList, -1, -1, rowsCount - 1);
 
-    int pos = HIWORD(SendMessage(_hSearch, CB_GETEDITSEL, 0, 0));
+    RECT win;
+    GetWindowRect(_hSearch, &win);
 
-    int (*pCompare)(const TCHAR*, const TCHAR*, size_t);
+    int width = win.right - win.left;
+    int height = HIWORD(rectSize) + 2 * GetSystemMetrics(SM_CYBORDER);
 
-    if (Button_GetCheck(_hMC) == BST_CHECKED)
-        pCompare = &_tcsncmp;
-    else
-        pCompare = &_tcsnicmp;
+    ListView_SetColumnWidth(_hList, 0, width - GetSystemMetrics(SM_CXVSCROLL) - 2 * GetSystemMetrics(SM_CXBORDER));
+
+    SetWindowPos(_hList, HWND_TOP, win.left, win.bottom, width, height, SWP_NOACTIVATE | SWP_SHOWWINDOW);
+}
+
+
+/**
+ *  \brief  Sets the search box text without triggering completion
+ */
+void SearchWin::setText(const TCHAR* txt)
+{
+    _settingText = true;
+    SetWindowText(_hSearch, txt);
+    _settingText = false;
+}
+
+
+/**
+ *  \brief
+ */
+void SearchWin::onEditChange()
+{
+    // Last update was over the budget - let the queued keystrokes through first,
+    // the list is updated on the last one
+    MSG msg;
+    if (_overBudget && PeekMessage(&msg, _hSearch, WM_KEYFIRST, WM_KEYLAST, PM_NOREMOVE))
+        return;
 
-    ComboBox_ResetContent(_hSearch);
-    ComboBox_ShowDropdown(_hSearch, FALSE);
-    ComboBox_SetText(_hSearch, filter.C_str());
-    PostMessage(_hSearch, CB_SETEDITSEL, 0, MAKELPARAM(pos, pos));
+    LARGE_INTEGER start;
+    QueryPerformanceCounter(&start);
 
-    SendMessage(_hSearch, WM_SETREDRAW, FALSE, 0);
+    int len = GetWindowTextLength(_hSearch);
 
-    if (filter.Len() == cComplAfter)
+    if (_completionDone)
     {
-        for (unsigned i = 0; i < _complIndex.size(); ++i)
-            ComboBox_AddString(_hSearch, _complIndex[i]);
+        DWORD pos;
+        SendMessage(_hSearch, EM_GETSEL, 0, (LPARAM)&pos);
+
+        if (pos <= (DWORD)cComplAfter)
+            clearCompletion();
+        else
+            filterComplList();
     }
-    else
+
+    if (!_completionDone)
     {
-        for (unsigned i = 0; i < _complIndex.size(); ++i)
-            if (!pCompare(_complIndex[i], filter.C_str(), filter.Len()))
-                ComboBox_AddString(_hSearch, _complIndex[i]);
+        if (len >= cComplAfter)
+            startCompletion();
+        else if (len)
+            prefetchCompletion();
     }
 
-    if (ComboBox_GetCount(_hSearch))
-    {
-        ComboBox_ShowDropdown(_hSearch, TRUE);
+    LARGE_INTEGER end, freq;
+    QueryPerformanceCounter(&end);
+    QueryPerformanceFrequency(&freq);
 
-        if (_keyPressed == VK_BACK || _keyPressed == VK_DELETE)
-            ComboBox_SetText(_hSearch, filter.C_str());
+    unsigned time = (unsigned)((end.QuadPart - start.QuadPart) * 1000000 / freq.QuadPart);
 
-        PostMessage(_hSearch, CB_SETEDITSEL, 0, MAKELPARAM(pos, -1));
-    }
+    _overBudget = (time > cKeyBudget * 1000);
 
-    SendMessage(_hSearch, WM_SETREDRAW, TRUE, 0);
-    RedrawWindow(_hSearch, NULL, NULL, RDW_UPDATENOW);
+    ++KeyCount;
+    TotalTime += time;
+    if (MaxTime < time)
+        MaxTime = time;
+    if (_overBudget)
+        ++OverBudgetCount;
 }
 
 
 /**
- *  \brief
+ *  \brief  Moves the drop-down list selection and puts the selected candidate in the search box
  */
-void SearchWin::onEditChange()
+void SearchWin::onListKey(int keyCode)
 {
-    int len = ComboBox_GetTextLength(_hSearch);
+    int count = ListView_GetItemCount(_hList);
+    int sel = ListView_GetNextItem(_hList, -1, LVNI_SELECTED);
 
-    if (_completionDone)
+    switch (keyCode)
     {
-        int pos = HIWORD(SendMessage(_hSearch, CB_GETEDITSEL, 0, 0));
+        case VK_UP:
+            --sel;
+        break;
 
-        if (pos <= cComplAfter)
-            clearCompletion();
-        else
-            filterComplList();
+        case VK_DOWN:
+            ++sel;
+        break;
+
+        case VK_PRIOR:
+            sel -= cListRows - 1;
+        break;
+
+        case VK_NEXT:
+            sel += (sel < 0) ? cListRows : cListRows - 1;
+        break;
     }
 
-    if (!_completionDone && len >= cComplAfter)
+    if (sel >= count)
+        sel = count - 1;
+    if (sel < 0)
+        sel = 0;
+
+    ListView_SetItemState(_hList, sel, LVIS_FOCUSED | LVIS_SELECTED, LVIS_FOCUSED | LVIS_SELECTED);
+    ListView_EnsureVisible(_hList, sel, FALSE);
+
+    const TCHAR* txt = _compl->Sorted(_complMC, _complFirst + sel);
+    setText(txt);
+    Edit_SetSel(_hSearch, _tcslen(txt), -1);
+}
+
+
+/**
+ *  \brief  Puts the clicked candidate in the search box
+ */
+void SearchWin::onListPick()
+{
+    int sel = ListView_GetNextItem(_hList, -1, LVNI_SELECTED);
+    if (sel < 0)
+        return;
+
+    const TCHAR* txt = _compl->Sorted(_complMC, _complFirst + sel);
+    setText(txt);
+    Edit_SetSel(_hSearch, _tcslen(txt), -1);
+
+    ShowWindow(_hList, SW_HIDE);
+    SetFocus(_hSearch);
+}
+
+
+/**
+ *  \brief  Supplies the text of a visible drop-down row
+ */
+void SearchWin::onGetDispInfo(NMLVDISPINFO* dispInfo)
+{
+    if ((dispInfo->item.mask & LVIF_TEXT) && _compl)
+        _tcsncpy_s(dispInfo->item.pszText, dispInfo->item.cchTextMax,
+                _compl->Sorted(_complMC, _complFirst + dispInfo->item.iItem), _TRUNCATE);
+}
+
+
+/**
+ *  \brief
+ */
+void SearchWin::onComplReady()
+{
+    if (!_completionDone && GetWindowTextLength(_hSearch) >= cComplAfter)
         startCompletion();
 }
 
@@ -456,11 +593,11 @@ void SearchWin::onEditChange()
  */
 void SearchWin::onOK()
 {
-    if (ComboBox_GetTextLength(_hSearch))
+    if (GetWindowTextLength(_hSearch))
     {
-        CText tag(ComboBox_GetTextLength(_hSearch));
+        CText tag(GetWindowTextLength(_hSearch));
 
-        ComboBox_GetText(_hSearch, tag.C_str(), tag.Size());
+        GetWindowText(_hSearch, tag.C_str(), tag.Size());
 
         bool re = (Button_GetCheck(_hRE) == BST_CHECKED);
         bool mc = (Button_GetCheck(_hMC) == BST_CHECKED);
@@ -490,9 +627,14 @@ LRESULT CALLBACK SearchWin::keyHookProc(int code, WPARAM wParam, LPARAM lParam)
             // Key is pressed
             if (!(lParam & (1 << 31)))
             {
+                const bool listShown = (IsWindowVisible(SW->_hList) != FALSE);
+
                 if (wParam == VK_ESCAPE)
                 {
-                    SendMessage(SW->_hWnd, WM_CLOSE, 0, 0);
+                    if (listShown)
+                        ShowWindow(SW->_hList, SW_HIDE);
+                    else
+                        SendMessage(SW->_hWnd, WM_CLOSE, 0, 0);
                     return 1;
                 }
                 if (wParam == VK_RETURN)
@@ -500,8 +642,12 @@ LRESULT CALLBACK SearchWin::keyHookProc(int code, WPARAM wParam, LPARAM lParam)
                     SW->onOK();
                     return 1;
                 }
-
-                SW->_keyPressed = wParam;
+                if (listShown &&
+                        (wParam == VK_UP || wParam == VK_DOWN || wParam == VK_PRIOR || wParam == VK_NEXT))
+                {
+                    SW->onListKey(wParam);
+                    return 1;
+                }
             }
         }
     }
@@ -532,19 +678,57 @@ LRESULT APIENTRY SearchWin::wndProc(HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM
                     SW->onOK();
                     return 0;
                 }
+                else if ((HWND)lParam == SW->_hMC)
+                {
+                    if (SW->_completionDone)
+                        SW->filterComplList();
+                    return 0;
+                }
                 else if (SW->_completionDone)
                 {
                     SW->clearCompletion();
                     return 0;
                 }
             }
-            else if (HIWORD(wParam) == CBN_EDITCHANGE)
+            else if (HIWORD(wParam) == EN_CHANGE && (HWND)lParam == SW->_hSearch)
             {
-                SW->onEditChange();
+                if (!SW->_settingText)
+                    SW->onEditChange();
                 return 0;
             }
         break;
 
+        case WM_NOTIFY:
+            if (((LPNMHDR)lParam)->hwndFrom == SW->_hList)
+            {
+                switch (((LPNMHDR)lParam)->code)
+                {
+                    case LVN_GETDISPINFO:
+                        SW->onGetDispInfo((NMLVDISPINFO*)lParam);
+                    return 0;
+
+                    case NM_CLICK:
+                    case NM_DBLCLK:
+                        SW->onListPick();
+                    return 0;
+                }
+            }
+        break;
+
+        case WM_MOVE:
+            if (SW && SW->_hList)
+                ShowWindow(SW->_hList, SW_HIDE);
+        break;
+
+        case WM_ACTIVATE:
+            if (LOWORD(wParam) == WA_INACTIVE && SW && SW->_hList)
+                ShowWindow(SW->_hList, SW_HIDE);
+        break;
+
+        case cComplReadyMsg:
+            SW->onComplReady();
+        return 0;
+
         case WM_DESTROY:
             delete SW;
             SW = NULL;
@@ -29,9 +29,11 @@
 #include <tchar.h>
 #include <memory>
 #include <vector>
+#include <commctrl.h>
 #include "Common.h"
 #include "GTags.h"
 #include "CmdEngine.h"
+#include "ComplCache.h"
 
 
 namespace GTags
@@ -49,39 +51,57 @@ public:
 
     static void Show(const std::shared_ptr<Cmd>& cmd, CompletionCB complCB, bool enRE = true, bool enMC = true);
     static void Close();
+    static void GetStats(CText& stats);
 
 private:
     static const TCHAR  cClassName[];
     static const int    cWidth;
     static const int    cComplAfter;
+    static const int    cListRows;
+    static const DWORD  cKeyBudget;
+    static const UINT   cComplReadyMsg;
 
     static LRESULT CALLBACK keyHookProc(int code, WPARAM wParam, LPARAM lParam);
     static LRESULT APIENTRY wndProc(HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM lParam);
     static RECT adjustSizeAndPos(HWND hOwner, DWORD styleEx, DWORD style, int width, int height);
 
     SearchWin(const std::shared_ptr<Cmd>& cmd, CompletionCB complCB) :
-        _cmd(cmd), _complCB(complCB), _hKeyHook(NULL), _cancelled(true), _keyPressed(0), _completionDone(false) {}
+        _cmd(cmd), _complCB(complCB), _hList(NULL), _hKeyHook(NULL), _cancelled(true), _completionDone(false),
+        _settingText(false), _overBudget(false), _complFirst(0), _complMC(false) {}
     SearchWin(const SearchWin&);
     ~SearchWin();
 
     HWND composeWindow(HWND hOwner, bool enRE, bool enMC);
+    CmdId_t complId() const { return (_cmd->Id() == FIND_FILE) ? AUTOCOMPLETE_FILE : AUTOCOMPLETE; }
     void startCompletion();
-    void endCompletion(const std::shared_ptr<Cmd>&);
+    void prefetchCompletion();
+    void endCompletion();
 
-    void parseCompletion();
     void clearCompletion();
     void filterComplList();
+    void showList(unsigned count);
+    void setText(const TCHAR* txt);
 
     void onEditChange();
+    void onListKey(int keyCode);
+    void onListPick();
+    void onGetDispInfo(NMLVDISPINFO* dispInfo);
+    void onComplReady();
     void onOK();
 
     static SearchWin* SW;
 
+    static unsigned     KeyCount;
+    static unsigned     OverBudgetCount;
+    static unsigned     TotalTime;
+    static unsigned     MaxTime;
+
     std::shared_ptr<Cmd>    _cmd;
     CompletionCB const      _complCB;
 
     HWND                _hWnd;
     HWND                _hSearch;
+    HWND                _hList;
     HWND                _hRE;
     HWND                _hMC;
     HWND                _hOK;
@@ -89,10 +109,13 @@ private:
     HFONT               _hBtnFont;
     HHOOK               _hKeyHook;
     bool                _cancelled;
-    int                 _keyPressed;
     bool                _completionDone;
-    CText               _complData;
-    std::vector<TCHAR*> _complIndex;
+    bool                _settingText;
+    bool                _overBudget;
+
+    ComplCache::EntryPtr    _compl;
+    unsigned                _complFirst;
+    bool                    _complMC;
 };
 
 } // namespace GTags
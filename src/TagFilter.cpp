@@ -0,0 +1,579 @@
+/**
+ *  \file
+ *  \brief  GTags DB tag names Bloom filter
+ *
+ *  \author  Pavel Nedev <pg.nedev@gmail.com>
+ *
+ *  \section COPYRIGHT
+ *  Copyright(C) 2015 Pavel Nedev
+ *
+ *  \section LICENSE
+ *  This program is free software; you can redistribute it and/or modify it
+ *  under the terms of the GNU General Public License version 2 as published
+ *  by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful, but
+ *  WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ *  or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ *  for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <windows.h>
+#include <tchar.h>
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include "GTags.h"
+#include "TagFilter.h"
+
+
+namespace GTags
+{
+
+// About 1% false positives
+const unsigned  TagFilter::cBitsPerKey  = 10;
+const unsigned  TagFilter::cHashes      = 7;
+// Completion prefixes up to that long are added to the filter
+const unsigned  TagFilter::cPrefixLen   = 4;
+const unsigned  TagFilter::cMaxTokenLen = 256;
+// Bigger saved files invalidate the filter instead of being scanned for names
+const DWORD     TagFilter::cMaxFileSize = 4 * 1024 * 1024;
+
+
+TagFilter TagFilter::Instance;
+
+
+/**
+ *  \brief
+ */
+TagFilter::Bloom::Bloom(unsigned keys) : _capacity(keys), _keys(0)
+{
+    _bits.resize((keys * cBitsPerKey) / 64 + 16, 0);
+}
+
+
+/**
+ *  \brief  Double hashing - the bit positions are derived from the two halves of the 64-bit hash
+ */
+void TagFilter::Bloom::Add(unsigned long long hash)
+{
+    unsigned long long bitsCount = _bits.size() * 64;
+    unsigned long long h1 = hash & 0xFFFFFFFF;
+    unsigned long long h2 = (hash >> 32) | 1;
+
+    for (unsigned i = 0; i < cHashes; ++i)
+    {
+        unsigned long long bit = (h1 + i * h2) % bitsCount;
+        _bits[bit / 64] |= 1ULL << (bit % 64);
+    }
+
+    ++_keys;
+}
+
+
+/**
+ *  \brief
+ */
+bool TagFilter::Bloom::Test(unsigned long long hash) const
+{
+    unsigned long long bitsCount = _bits.size() * 64;
+    unsigned long long h1 = hash & 0xFFFFFFFF;
+    unsigned long long h2 = (hash >> 32) | 1;
+
+    for (unsigned i = 0; i < cHashes; ++i)
+    {
+        unsigned long long bit = (h1 + i * h2) % bitsCount;
+        if (!(_bits[bit / 64] & (1ULL << (bit % 64))))
+            return false;
+    }
+
+    return true;
+}
+
+
+/**
+ *  \brief  Starts building the DB filters in background if they are missing
+ */
+void TagFilter::Prefetch(const CPath& dbPath)
+{
+    {
+        AUTOLOCK(_lock);
+
+        std::list<Item>::iterator iItem = findItem(dbPath);
+        if (iItem == _items.end())
+        {
+            _items.push_back(Item());
+            iItem = --_items.end();
+            iItem->_dbPath = dbPath;
+        }
+
+        if (iItem->_building || iItem->_filters[TagIndex::DEFINITIONS])
+            return;
+
+        iItem->_building = true;
+        iItem->_pending.clear();
+    }
+
+    bool success;
+    DbHandle db = DbManager::Get().GetDb(dbPath, false, &success);
+
+    if (db && success && !CPathEqual()(*db, dbPath))
+    {
+        DbManager::Get().PutDb(db);
+        db = NULL;
+    }
+
+    if (!db || !success)
+    {
+        AUTOLOCK(_lock);
+
+        std::list<Item>::iterator iItem = findItem(dbPath);
+        if (iItem != _items.end())
+            iItem->_building = false;
+        return;
+    }
+
+    // Empty tag - list all definition names
+    std::shared_ptr<Cmd> cmd(new Cmd(AUTOCOMPLETE, _T("Build Tag Filter"), db));
+    cmd->Silent(true);
+
+    CmdEngine::Run(cmd, buildReady);
+}
+
+
+/**
+ *  \brief  Returns false if the DB surely has no tag (no tag starting with tag if prefix is true).
+ *          Sets checked if the DB has filter of that kind
+ */
+bool TagFilter::MayContain(const CPath& dbPath, TagIndex::Kind_t kind, const TCHAR* tag, bool prefix,
+        bool& checked)
+{
+    checked = false;
+
+    unsigned len = _tcslen(tag);
+    if (len == 0)
+        return true;
+
+    // The names code page in the DB is unknown
+    for (unsigned i = 0; i < len; ++i)
+        if (tag[i] & ~0x7F)
+            return true;
+
+    CTextA name(tag);
+
+    unsigned long long hash = prefix ?
+            nameHash(name.C_str(), (len < cPrefixLen) ? len : cPrefixLen, true) :
+            nameHash(name.C_str(), len, false);
+
+    AUTOLOCK_SHARED(_lock);
+
+    std::list<Item>::iterator iItem = findItem(dbPath);
+    if (iItem == _items.end() || !iItem->_filters[kind])
+        return true;
+
+    checked = true;
+    InterlockedIncrement(&_checks);
+
+    if (iItem->_filters[kind]->Test(hash))
+        return true;
+
+    InterlockedIncrement(&_negatives);
+
+    return false;
+}
+
+
+/**
+ *  \brief  Counts lookup that passed the filter but found nothing
+ */
+void TagFilter::FalsePositive()
+{
+    InterlockedIncrement(&_falsePositives);
+}
+
+
+/**
+ *  \brief  Adds the names in the files to the DB filters - to be called before the files DB update
+ */
+void TagFilter::FilesUpdated(const CPath& dbPath, const std::vector<CPath>& files)
+{
+    {
+        AUTOLOCK(_lock);
+
+        if (findItem(dbPath) == _items.end())
+            return;
+    }
+
+    std::vector<unsigned long long> keys;
+    std::vector<char> text;
+
+    for (unsigned i = 0; i < files.size(); ++i)
+    {
+        if (readFile(files[i], text))
+        {
+            tokenize(text, keys);
+        }
+        else if (files[i].FileExists())
+        {
+            Invalidate(dbPath);
+            return;
+        }
+    }
+
+    std::sort(keys.begin(), keys.end());
+    keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+
+    AUTOLOCK(_lock);
+
+    std::list<Item>::iterator iItem = findItem(dbPath);
+    if (iItem == _items.end())
+        return;
+
+    if (iItem->_building)
+        iItem->_pending.insert(iItem->_pending.end(), keys.begin(), keys.end());
+
+    for (unsigned kind = 0; kind < TagIndex::KIND_LIST_END; ++kind)
+    {
+        BloomPtr& filter = iItem->_filters[kind];
+        if (!filter)
+            continue;
+
+        for (unsigned i = 0; i < keys.size(); ++i)
+            filter->Add(keys[i]);
+
+        // Too many false positives - re-build on next use
+        if (filter->Keys() > 2 * filter->Capacity())
+            filter.reset();
+    }
+}
+
+
+/**
+ *  \brief  Drops the filters being built from the DB content before the update - to be called when
+ *          the files DB update is done
+ */
+void TagFilter::DbUpdated(const CPath& dbPath)
+{
+    AUTOLOCK(_lock);
+
+    std::list<Item>::iterator iItem = findItem(dbPath);
+    if (iItem != _items.end() && iItem->_building)
+        iItem->_stale = true;
+}
+
+
+/**
+ *  \brief  Drops the DB filters - to be called when the DB is re-created or updated by gtags scanning
+ *          the whole project
+ */
+void TagFilter::Invalidate(const CPath& dbPath)
+{
+    AUTOLOCK(_lock);
+
+    std::list<Item>::iterator iItem = findItem(dbPath);
+    if (iItem == _items.end())
+        return;
+
+    // Filters being built now come from the old DB
+    if (iItem->_building)
+    {
+        iItem->_stale = true;
+        for (unsigned kind = 0; kind < TagIndex::KIND_LIST_END; ++kind)
+            iItem->_filters[kind].reset();
+        return;
+    }
+
+    _items.erase(iItem);
+}
+
+
+/**
+ *  \brief
+ */
+void TagFilter::GetStats(CText& stats)
+{
+    static const TCHAR* const cKindNames[TagIndex::KIND_LIST_END] =
+    {
+        _T("definitions"),
+        _T("references"),
+        _T("symbols")
+    };
+
+    AUTOLOCK_SHARED(_lock);
+
+    for (std::list<Item>::iterator iItem = _items.begin(); iItem != _items.end(); ++iItem)
+    {
+        for (unsigned kind = 0; kind < TagIndex::KIND_LIST_END; ++kind)
+        {
+            if (!iItem->_filters[kind])
+                continue;
+
+            TCHAR buf[128];
+            _sntprintf_s(buf, _countof(buf), _TRUNCATE, _T(" %s: %u keys, %u KB\n"),
+                    cKindNames[kind], iItem->_filters[kind]->Keys(), iItem->_filters[kind]->MemSize() / 1024);
+
+            stats += iItem->_dbPath;
+            stats += buf;
+        }
+    }
+
+    if (!_checks)
+        return;
+
+    const unsigned checks = _checks;
+    const unsigned negatives = _negatives;
+    const unsigned falsePositives = _falsePositives;
+
+    // Rate among the lookups of names not in the DB
+    unsigned rate = (falsePositives * 1000) / (falsePositives + negatives ? falsePositives + negatives : 1);
+
+    TCHAR buf[160];
+    _sntprintf_s(buf, _countof(buf), _TRUNCATE,
+            _T(" %u checks, %u lookups saved, %u false positives (%u.%u%%)\n"),
+            checks, negatives, falsePositives, rate / 10, rate % 10);
+
+    stats += buf;
+
+#ifdef DEVELOPMENT
+    unsigned acquired, contended;
+    _lock.GetContention(acquired, contended);
+    _sntprintf_s(buf, _countof(buf), _TRUNCATE, _T(" lock taken %u times, %u contended\n"), acquired, contended);
+
+    stats += buf;
+#endif
+}
+
+
+/**
+ *  \brief  64-bit FNV-1a of the ASCII case-folded name. Prefixes are hashed differently than whole names
+ */
+unsigned long long TagFilter::nameHash(const char* name, unsigned len, bool prefix)
+{
+    unsigned long long hash = prefix ? 0x9E3779B97F4A7C15ULL : 14695981039346656037ULL;
+
+    for (unsigned i = 0; i < len; ++i)
+    {
+        unsigned char c = name[i];
+        if (c >= 'A' && c <= 'Z')
+            c += 'a' - 'A';
+
+        hash ^= c;
+        hash *= 1099511628211ULL;
+    }
+
+    return hash;
+}
+
+
+/**
+ *  \brief
+ */
+void TagFilter::addKeys(std::vector<unsigned long long>& keys, const char* name, unsigned len)
+{
+    if (len == 0 || len > cMaxTokenLen)
+        return;
+
+    keys.push_back(nameHash(name, len, false));
+
+    for (unsigned i = 1; i <= len && i <= cPrefixLen; ++i)
+        keys.push_back(nameHash(name, i, true));
+}
+
+
+/**
+ *  \brief  Collects the keys of every word in text that could be a tag name. Words are split on white space
+ *          and brackets, both the whole words and their parts between punctuation chars are added -
+ *          the parsers don't agree on the chars allowed in names
+ */
+void TagFilter::tokenize(const std::vector<char>& text, std::vector<unsigned long long>& keys)
+{
+    static const char cPunct[] = ":.-@$=+*/<>!&|^~%#?\\";
+
+    const char* end = text.data() + text.size();
+
+    for (const char* word = text.data(); word < end;)
+    {
+        unsigned char c = *word;
+
+        if (c <= ' ' || strchr("()[]{};,\"'`", c))
+        {
+            ++word;
+            continue;
+        }
+
+        const char* wordEnd = word;
+        bool hasPunct = false;
+
+        for (; wordEnd < end; ++wordEnd)
+        {
+            c = *wordEnd;
+            if (c <= ' ' || strchr("()[]{};,\"'`", c))
+                break;
+            if (strchr(cPunct, c))
+                hasPunct = true;
+        }
+
+        addKeys(keys, word, wordEnd - word);
+
+        if (hasPunct)
+        {
+            for (const char* part = word; part < wordEnd;)
+            {
+                const char* partEnd = part;
+                while (partEnd < wordEnd && !strchr(cPunct, *partEnd))
+                    ++partEnd;
+
+                addKeys(keys, part, partEnd - part);
+                part = partEnd + 1;
+            }
+        }
+
+        word = wordEnd;
+    }
+}
+
+
+/**
+ *  \brief
+ */
+bool TagFilter::readFile(const CPath& file, std::vector<char>& buf)
+{
+    buf.clear();
+
+    WIN32_FILE_ATTRIBUTE_DATA attr;
+    if (!GetFileAttributesEx(file.C_str(), GetFileExInfoStandard, &attr) ||
+            attr.nFileSizeHigh || attr.nFileSizeLow > cMaxFileSize)
+        return false;
+
+    FILE* fp;
+    _tfopen_s(&fp, file.C_str(), _T("rb"));
+    if (fp == NULL)
+        return false;
+
+    buf.resize(attr.nFileSizeLow);
+    buf.resize(fread(buf.data(), 1, buf.size(), fp));
+
+    fclose(fp);
+
+    return true;
+}
+
+
+/**
+ *  \brief  Runs the other kinds names listings and builds the filters
+ */
+void TagFilter::buildReady(const std::shared_ptr<Cmd>& cmd)
+{
+    static const CmdId_t cListCmd[TagIndex::KIND_LIST_END] =
+    {
+        AUTOCOMPLETE,
+        AUTOCOMPLETE_REFERENCE,
+        AUTOCOMPLETE_SYMBOL
+    };
+
+    BloomPtr filters[TagIndex::KIND_LIST_END];
+
+    if (cmd->Status() == OK)
+    {
+        filters[TagIndex::DEFINITIONS] = build(cmd->Result(), cmd->ResultLen());
+
+        for (unsigned kind = TagIndex::REFERENCES; kind < TagIndex::KIND_LIST_END; ++kind)
+        {
+            std::shared_ptr<Cmd> listCmd(new Cmd(cListCmd[kind], cmd->Name(), cmd->Db()));
+            listCmd->Silent(true);
+
+            // Parsers without references support fail here - such lookups are not filtered then
+            if (CmdEngine::Run(listCmd))
+                filters[kind] = build(listCmd->Result(), listCmd->ResultLen());
+        }
+    }
+
+    DbManager::Get().PutDb(cmd->Db());
+
+    RunSheduledUpdate(cmd->DbPath());
+
+    AUTOLOCK(Instance._lock);
+
+    std::list<Item>::iterator iItem = Instance.findItem(cmd->DbPath());
+    if (iItem == Instance._items.end())
+        return;
+
+    // The DB was invalidated meanwhile - re-build on next use
+    if (iItem->_stale)
+    {
+        Instance._items.erase(iItem);
+        return;
+    }
+
+    iItem->_building = false;
+
+    for (unsigned kind = 0; kind < TagIndex::KIND_LIST_END; ++kind)
+    {
+        if (!filters[kind])
+            continue;
+
+        // Names of the files updated while building
+        for (unsigned i = 0; i < iItem->_pending.size(); ++i)
+            filters[kind]->Add(iItem->_pending[i]);
+
+        iItem->_filters[kind] = filters[kind];
+    }
+
+    iItem->_pending.clear();
+}
+
+
+/**
+ *  \brief  Builds filter from new line separated names list
+ */
+TagFilter::BloomPtr TagFilter::build(const char* names, unsigned len)
+{
+    std::vector<unsigned long long> keys;
+
+    if (names)
+    {
+        const char* namesEnd = names + len;
+
+        for (const char* name = names; name < namesEnd && *name;)
+        {
+            const char* end = name;
+            while (end < namesEnd && *end && *end != '\n' && *end != '\r')
+                ++end;
+
+            addKeys(keys, name, end - name);
+
+            name = end;
+            while (name < namesEnd && (*name == '\n' || *name == '\r'))
+                ++name;
+        }
+    }
+
+    std::sort(keys.begin(), keys.end());
+    keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+
+    BloomPtr filter(new Bloom(keys.size()));
+
+    for (unsigned i = 0; i < keys.size(); ++i)
+        filter->Add(keys[i]);
+
+    return filter;
+}
+
+
+/**
+ *  \brief  Must be called under lock
+ */
+std::list<TagFilter::Item>::iterator TagFilter::findItem(const CPath& dbPath)
+{
+    std::list<Item>::iterator iItem;
+    for (iItem = _items.begin(); iItem != _items.end(); ++iItem)
+        if (CPathEqual()(iItem->_dbPath, dbPath))
+            break;
+
+    return iItem;
+}
+
+} // namespace GTags
@@ -0,0 +1,133 @@
+/**
+ *  \file
+ *  \brief  GTags DB tag names Bloom filter
+ *
+ *  \author  Pavel Nedev <pg.nedev@gmail.com>
+ *
+ *  \section COPYRIGHT
+ *  Copyright(C) 2015 Pavel Nedev
+ *
+ *  \section LICENSE
+ *  This program is free software; you can redistribute it and/or modify it
+ *  under the terms of the GNU General Public License version 2 as published
+ *  by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful, but
+ *  WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ *  or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ *  for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+
+#include <windows.h>
+#include <tchar.h>
+#include <list>
+#include <memory>
+#include <vector>
+#include "Common.h"
+#include "AutoLock.h"
+#include "TagIndex.h"
+
+
+namespace GTags
+{
+
+/**
+ *  \class  TagFilter
+ *  \brief  Per DB and tag kind Bloom filters of the tag names and their first few chars (for completion).
+ *          Lookups of names surely not in the DB are answered without running global.
+ *          Built in background from the DB name lists, saved files names are added before
+ *          the DB update so the filter never misses a name the DB has
+ */
+class TagFilter
+{
+public:
+    static TagFilter& Get() { return Instance; }
+
+    void Prefetch(const CPath& dbPath);
+    bool MayContain(const CPath& dbPath, TagIndex::Kind_t kind, const TCHAR* tag, bool prefix, bool& checked);
+    void FalsePositive();
+    void FilesUpdated(const CPath& dbPath, const std::vector<CPath>& files);
+    void DbUpdated(const CPath& dbPath);
+    void Invalidate(const CPath& dbPath);
+    void GetStats(CText& stats);
+
+private:
+    static const unsigned   cBitsPerKey;
+    static const unsigned   cHashes;
+    static const unsigned   cPrefixLen;
+    static const unsigned   cMaxTokenLen;
+    static const DWORD      cMaxFileSize;
+
+    /**
+     *  \class  Bloom
+     *  \brief
+     */
+    class Bloom
+    {
+    public:
+        Bloom(unsigned keys);
+        ~Bloom() {}
+
+        void Add(unsigned long long hash);
+        bool Test(unsigned long long hash) const;
+
+        inline unsigned Keys() const { return _keys; }
+        inline unsigned Capacity() const { return _capacity; }
+        inline unsigned MemSize() const { return _bits.size() * sizeof(unsigned long long); }
+
+    private:
+        std::vector<unsigned long long> _bits;
+        unsigned                        _capacity;
+        unsigned                        _keys;
+    };
+
+    typedef std::shared_ptr<Bloom> BloomPtr;
+
+    /**
+     *  \struct  Item
+     *  \brief
+     */
+    struct Item
+    {
+        Item() : _building(false), _stale(false) {}
+
+        CPath       _dbPath;
+        BloomPtr    _filters[TagIndex::KIND_LIST_END];
+        bool        _building;
+        // DB re-created while building - the built filters are dropped
+        bool        _stale;
+        // Keys of the files updated while building - the new filters are built from the old DB content
+        std::vector<unsigned long long> _pending;
+    };
+
+    static TagFilter Instance;
+
+    static unsigned long long nameHash(const char* name, unsigned len, bool prefix);
+    static void addKeys(std::vector<unsigned long long>& keys, const char* name, unsigned len);
+    static void tokenize(const std::vector<char>& text, std::vector<unsigned long long>& keys);
+    static bool readFile(const CPath& file, std::vector<char>& buf);
+    static void buildReady(const std::shared_ptr<Cmd>& cmd);
+    static BloomPtr build(const char* names, unsigned len);
+
+    TagFilter() : _checks(0), _negatives(0), _falsePositives(0) {}
+    TagFilter(const TagFilter&);
+    ~TagFilter() {}
+
+    std::list<Item>::iterator findItem(const CPath& dbPath);
+
+    // Lookups only test the filters so they share the lock
+    RWMutex             _lock;
+    std::list<Item>     _items;
+
+    volatile LONG   _checks;
+    volatile LONG   _negatives;
+    volatile LONG   _falsePositives;
+};
+
+} // namespace GTags
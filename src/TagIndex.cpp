@@ -0,0 +1,260 @@
+/**
+ *  \file
+ *  \brief  Case-folded tag names index
+ *
+ *  \author  Pavel Nedev <pg.nedev@gmail.com>
+ *
+ *  \section COPYRIGHT
+ *  Copyright(C) 2015 Pavel Nedev
+ *
+ *  \section LICENSE
+ *  This program is free software; you can redistribute it and/or modify it
+ *  under the terms of the GNU General Public License version 2 as published
+ *  by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful, but
+ *  WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ *  or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ *  for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+#include <windows.h>
+#include <tchar.h>
+#include "GTags.h"
+#include "TagIndex.h"
+
+
+namespace GTags
+{
+
+TagIndex TagIndex::Instance;
+
+
+/**
+ *  \brief  Returns the index kind that can serve ignore-case cmdId lookup
+ */
+bool TagIndex::GetKind(CmdId_t cmdId, Kind_t& kind)
+{
+    switch (cmdId)
+    {
+        case AUTOCOMPLETE:
+        case FIND_DEFINITION:
+            kind = DEFINITIONS;
+            return true;
+
+        case FIND_REFERENCE:
+            kind = REFERENCES;
+            return true;
+
+        case AUTOCOMPLETE_SYMBOL:
+        case FIND_SYMBOL:
+            kind = SYMBOLS;
+            return true;
+
+        default:
+            return false;
+    }
+}
+
+
+/**
+ *  \brief  Returns the names index for cmd DB if it is built. Otherwise starts building it in background
+ *          and returns empty pointer - global is run meanwhile. Must be called with the DB read-locked
+ */
+TagIndex::NamesPtr TagIndex::Acquire(const Cmd& cmd, Kind_t kind)
+{
+    {
+        AUTOLOCK(_lock);
+
+        for (std::list<Item>::iterator iItem = _items.begin(); iItem != _items.end(); ++iItem)
+            if (iItem->_kind == kind && iItem->_dbPath == cmd.DbPath())
+                return iItem->_names;
+
+        Item item;
+        item._dbPath    = cmd.DbPath();
+        item._kind      = kind;
+        item._cmd       = NULL;
+        item._buildTime = GetTickCount();
+
+        _items.push_back(item);
+    }
+
+    build(cmd, kind);
+
+    return NamesPtr();
+}
+
+
+/**
+ *  \brief  Returns the names index of the DB only if it is already built
+ */
+TagIndex::NamesPtr TagIndex::Peek(const CPath& dbPath, Kind_t kind)
+{
+    AUTOLOCK(_lock);
+
+    for (std::list<Item>::iterator iItem = _items.begin(); iItem != _items.end(); ++iItem)
+        if (iItem->_kind == kind && CPathEqual()(iItem->_dbPath, dbPath))
+            return iItem->_names;
+
+    return NamesPtr();
+}
+
+
+/**
+ *  \brief  Drops the indexes of the given DB - to be called when the DB has changed
+ */
+void TagIndex::Invalidate(const CPath& dbPath)
+{
+    AUTOLOCK(_lock);
+
+    // Indexes still building are dropped as well - their results are not stored then
+    for (std::list<Item>::iterator iItem = _items.begin(); iItem != _items.end();)
+    {
+        if (iItem->_dbPath == dbPath)
+            iItem = _items.erase(iItem);
+        else
+            ++iItem;
+    }
+}
+
+
+/**
+ *  \brief
+ */
+void TagIndex::GetStats(CText& stats)
+{
+    static const TCHAR* const cKindNames[KIND_LIST_END] =
+    {
+        _T("definitions"),
+        _T("references"),
+        _T("symbols")
+    };
+
+    AUTOLOCK(_lock);
+
+    for (std::list<Item>::iterator iItem = _items.begin(); iItem != _items.end(); ++iItem)
+    {
+        if (!iItem->_names)
+            continue;
+
+        TCHAR buf[128];
+        _sntprintf_s(buf, _countof(buf), _TRUNCATE, _T(" %s: %u names, %u KB, built in %u ms\n"),
+                cKindNames[iItem->_kind], iItem->_names->Count(), iItem->_names->MemSize() / 1024,
+                iItem->_buildTime);
+
+        stats += iItem->_dbPath;
+        stats += buf;
+    }
+}
+
+
+/**
+ *  \brief  Starts listing all DB names of the kind. Library DBs have no handle and are listed by path
+ */
+void TagIndex::build(const Cmd& cmd, Kind_t kind)
+{
+    static const CmdId_t cBuildCmd[KIND_LIST_END] =
+    {
+        AUTOCOMPLETE,
+        AUTOCOMPLETE_REFERENCE,
+        AUTOCOMPLETE_SYMBOL
+    };
+
+    DbHandle db = NULL;
+    bool success = true;
+
+    // The listing holds its own DB lock as the lookup releases its one when done
+    if (cmd.Db())
+    {
+        db = DbManager::Get().GetDb(cmd.DbPath(), false, &success);
+
+        if (db && success && !CPathEqual()(*db, cmd.DbPath()))
+        {
+            DbManager::Get().PutDb(db);
+            db = NULL;
+        }
+
+        success = (db && success);
+    }
+
+    std::shared_ptr<Cmd> buildCmd;
+
+    if (success)
+    {
+        buildCmd.reset(new Cmd(cBuildCmd[kind], _T("Build Tag Index"), db));
+        buildCmd->DbPath(cmd.DbPath());
+        buildCmd->Silent(true);
+    }
+
+    {
+        AUTOLOCK(_lock);
+
+        for (std::list<Item>::iterator iItem = _items.begin(); iItem != _items.end(); ++iItem)
+        {
+            if (iItem->_kind == kind && iItem->_dbPath == cmd.DbPath() && !iItem->_names && !iItem->_cmd)
+            {
+                if (buildCmd)
+                    iItem->_cmd = buildCmd.get();
+                else
+                    _items.erase(iItem);
+                break;
+            }
+        }
+    }
+
+    // Empty prefix - list all tag names
+    if (buildCmd && !CmdEngine::Run(buildCmd, buildReady))
+        buildReady(buildCmd);
+}
+
+
+/**
+ *  \brief  Builds the index from the names listing unless the DB was changed meanwhile
+ */
+void TagIndex::buildReady(const std::shared_ptr<Cmd>& cmd)
+{
+    NamesPtr names;
+
+    if (cmd->Status() == OK)
+    {
+        std::vector<char> buf;
+        if (cmd->Result())
+            buf.assign(cmd->Result(), cmd->Result() + cmd->ResultLen());
+
+        names.reset(new TagNames(buf));
+    }
+
+    if (cmd->Db())
+    {
+        DbManager::Get().PutDb(cmd->Db());
+
+        RunSheduledUpdate(cmd->DbPath());
+    }
+
+    AUTOLOCK(Instance._lock);
+
+    for (std::list<Item>::iterator iItem = Instance._items.begin(); iItem != Instance._items.end(); ++iItem)
+    {
+        if (iItem->_cmd == cmd.get())
+        {
+            // Failed listings are retried on next use
+            if (!names)
+            {
+                Instance._items.erase(iItem);
+                break;
+            }
+
+            iItem->_names       = names;
+            iItem->_cmd         = NULL;
+            iItem->_buildTime   = GetTickCount() - iItem->_buildTime;
+            break;
+        }
+    }
+}
+
+} // namespace GTags
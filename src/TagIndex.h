@@ -0,0 +1,102 @@
+/**
+ *  \file
+ *  \brief  Case-folded tag names index
+ *
+ *  \author  Pavel Nedev <pg.nedev@gmail.com>
+ *
+ *  \section COPYRIGHT
+ *  Copyright(C) 2015 Pavel Nedev
+ *
+ *  \section LICENSE
+ *  This program is free software; you can redistribute it and/or modify it
+ *  under the terms of the GNU General Public License version 2 as published
+ *  by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful, but
+ *  WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ *  or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ *  for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+#pragma once
+
+
+#include <windows.h>
+#include <tchar.h>
+#include <list>
+#include <memory>
+#include <vector>
+#include "Common.h"
+#include "AutoLock.h"
+#include "DbManager.h"
+#include "CmdEngine.h"
+#include "TagNames.h"
+
+
+namespace GTags
+{
+
+/**
+ *  \class  TagIndex
+ *  \brief  In-memory case-folded index of the DB tag names built in background on first use.
+ *          global has to scan the whole DB on ignore-case queries while the
+ *          index resolves them to the exact names which global looks up fast
+ */
+class TagIndex
+{
+public:
+    enum Kind_t
+    {
+        DEFINITIONS = 0,
+        REFERENCES,
+        SYMBOLS,
+        KIND_LIST_END
+    };
+
+    typedef std::shared_ptr<const TagNames> NamesPtr;
+
+    static TagIndex& Get() { return Instance; }
+
+    static bool GetKind(CmdId_t cmdId, Kind_t& kind);
+
+    NamesPtr Acquire(const Cmd& cmd, Kind_t kind);
+    NamesPtr Peek(const CPath& dbPath, Kind_t kind);
+    void Invalidate(const CPath& dbPath);
+    void GetStats(CText& stats);
+
+private:
+    /**
+     *  \struct  Item
+     *  \brief
+     */
+    struct Item
+    {
+        CPath       _dbPath;
+        Kind_t      _kind;
+        NamesPtr    _names;
+        // The command building the names, NULL once built
+        const Cmd*  _cmd;
+        // Build start until built
+        DWORD       _buildTime;
+    };
+
+    static TagIndex Instance;
+
+    static void buildReady(const std::shared_ptr<Cmd>& cmd);
+
+    TagIndex() {}
+    TagIndex(const TagIndex&);
+    ~TagIndex() {}
+
+    void build(const Cmd& cmd, Kind_t kind);
+
+    Mutex               _lock;
+    std::list<Item>     _items;
+};
+
+} // namespace GTags
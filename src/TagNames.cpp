@@ -0,0 +1,167 @@
+/**
+ *  \file
+ *  \brief  Case-folded sorted tag names
+ *
+ *  \author  Pavel Nedev <pg.nedev@gmail.com>
+ *
+ *  \section COPYRIGHT
+ *  Copyright(C) 2015 Pavel Nedev
+ *
+ *  \section LICENSE
+ *  This program is free software; you can redistribute it and/or modify it
+ *  under the terms of the GNU General Public License version 2 as published
+ *  by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful, but
+ *  WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ *  or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ *  for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+
+
+#include <string.h>
+#include <algorithm>
+#include "TagNames.h"
+
+
+namespace GTags
+{
+
+/**
+ *  \brief  Takes the ownership of the names buffer (global completion output)
+ */
+TagNames::TagNames(std::vector<char>& names)
+{
+    _names.swap(names);
+
+    bool newToken = true;
+
+    for (unsigned i = 0; i < _names.size(); ++i)
+    {
+        if (_names[i] == '\n' || _names[i] == '\r' || _names[i] == 0)
+        {
+            _names[i] = 0;
+            newToken = true;
+        }
+        else if (newToken)
+        {
+            _index.push_back(i);
+            newToken = false;
+        }
+    }
+
+    if (!_names.empty() && _names.back())
+        _names.push_back(0);
+
+    std::sort(_index.begin(), _index.end(), FoldedLess(_names.data()));
+}
+
+
+/**
+ *  \brief  Returns all name spellings that differ from the given one only by case
+ */
+void TagNames::GetVariants(const char* name, std::vector<CTextA>& variants) const
+{
+    std::pair<std::vector<unsigned>::const_iterator, std::vector<unsigned>::const_iterator> range =
+            std::equal_range(_index.begin(), _index.end(), name, FoldedLess(_names.data()));
+
+    for (; range.first != range.second; ++range.first)
+        variants.push_back(CTextA(_names.data() + *range.first));
+}
+
+
+/**
+ *  \brief  Fills result the same way global completion does - new line separated names
+ */
+void TagNames::Complete(const char* prefix, std::vector<char>& result) const
+{
+    FoldedLess less(_names.data(), strlen(prefix));
+
+    std::vector<unsigned>::const_iterator iName = std::lower_bound(_index.begin(), _index.end(), prefix, less);
+    std::vector<unsigned>::const_iterator iEnd = std::upper_bound(iName, _index.end(), prefix, less);
+
+    for (; iName != iEnd; ++iName)
+    {
+        const char* name = _names.data() + *iName;
+        result.insert(result.end(), name, name + strlen(name));
+        result.push_back('\n');
+    }
+
+    if (!result.empty())
+        result.push_back(0);
+}
+
+
+/**
+ *  \brief  Case-insensitive check for the name or for a name starting with prefix
+ */
+bool TagNames::Contains(const char* name, bool prefix) const
+{
+    FoldedLess less(_names.data(), prefix ? strlen(name) : 0);
+
+    std::vector<unsigned>::const_iterator iName = std::lower_bound(_index.begin(), _index.end(), name, less);
+
+    return (iName != _index.end() && !less(name, *iName));
+}
+
+
+/**
+ *  \brief  Case-insensitive compare of the first len chars (whole strings if len is 0)
+ */
+int TagNames::FoldedLess::compare(const char* lhs, const char* rhs, unsigned len)
+{
+    for (unsigned i = 0; !len || i < len; ++i)
+    {
+        int l = (unsigned char)lhs[i];
+        int r = (unsigned char)rhs[i];
+
+        if (l >= 'A' && l <= 'Z')
+            l += 'a' - 'A';
+        if (r >= 'A' && r <= 'Z')
+            r += 'a' - 'A';
+
+        if (l != r || !l)
+            return l - r;
+    }
+
+    return 0;
+}
+
+
+/**
+ *  \brief  Sorts case-insensitively, names differing only by case are in exact order
+ */
+bool TagNames::FoldedLess::operator()(unsigned lhs, unsigned rhs) const
+{
+    int r = compare(_names + lhs, _names + rhs, 0);
+    if (r == 0)
+        r = strcmp(_names + lhs, _names + rhs);
+
+    return (r < 0);
+}
+
+
+/**
+ *  \brief
+ */
+bool TagNames::FoldedLess::operator()(unsigned lhs, const char* rhs) const
+{
+    return (compare(_names + lhs, rhs, _len) < 0);
+}
+
+
+/**
+ *  \brief
+ */
+bool TagNames::FoldedLess::operator()(const char* lhs, unsigned rhs) const
+{
+    return (compare(lhs, _names + rhs, _len) < 0);
+}
+
+} // namespace GTags
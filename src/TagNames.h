@@ -0,0 +1,81 @@
+/**
+ *  \file
+ *  \brief  Case-folded sorted tag names
+ *
+ *  \author  Pavel Nedev <pg.nedev@gmail.com>
+ *
+ *  \section COPYRIGHT
+ *  Copyright(C) 2015 Pavel Nedev
+ *
+ *  \section LICENSE
+ *  This program is free software; you can redistribute it and/or modify it
+ *  under the terms of the GNU General Public License version 2 as published
+ *  by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful, but
+ *  WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ *  or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ *  for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+
+#pragma once
+
+
+#include <vector>
+#include "Common.h"
+
+
+namespace GTags
+{
+
+/**
+ *  \class  TagNames
+ *  \brief  Tag names of single kind sorted in case-insensitive order - immutable once built.
+ *          Has no UI or process dependencies
+ */
+class TagNames
+{
+public:
+    TagNames(std::vector<char>& names);
+    ~TagNames() {}
+
+    void GetVariants(const char* name, std::vector<CTextA>& variants) const;
+    void Complete(const char* prefix, std::vector<char>& result) const;
+    bool Contains(const char* name, bool prefix) const;
+
+    inline unsigned Count() const { return _index.size(); }
+    inline unsigned MemSize() const { return _names.size() + _index.size() * sizeof(unsigned); }
+
+private:
+    /**
+     *  \struct  FoldedLess
+     *  \brief
+     */
+    struct FoldedLess
+    {
+        FoldedLess(const char* names, unsigned len = 0) : _names(names), _len(len) {}
+
+        static int compare(const char* lhs, const char* rhs, unsigned len);
+
+        bool operator()(unsigned lhs, unsigned rhs) const;
+        bool operator()(unsigned lhs, const char* rhs) const;
+        bool operator()(const char* lhs, unsigned rhs) const;
+
+        const char*     _names;
+        const unsigned  _len;
+    };
+
+    TagNames(const TagNames&);
+    const TagNames& operator=(const TagNames&);
+
+    std::vector<char>       _names;
+    std::vector<unsigned>   _index;
+};
+
+} // namespace GTags
@@ -0,0 +1,241 @@
+/**
+ *  \file
+ *  \brief  Lookup latency tracing
+ *
+ *  \author  Pavel Nedev <pg.nedev@gmail.com>
+ *
+ *  \section COPYRIGHT
+ *  Copyright(C) 2015 Pavel Nedev
+ *
+ *  \section LICENSE
+ *  This program is free software; you can redistribute it and/or modify it
+ *  under the terms of the GNU General Public License version 2 as published
+ *  by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful, but
+ *  WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ *  or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ *  for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+#include "Trace.h"
+#include <stdio.h>
+#include <vector>
+#include <algorithm>
+#include "Common.h"
+
+
+namespace
+{
+
+/**
+ *  \brief
+ */
+struct EventEarlier
+{
+    template <typename T>
+    bool operator()(const T& a, const T& b) const
+    {
+        return a._start < b._start;
+    }
+};
+
+} // anonymous namespace
+
+
+// Several seconds of lookups per thread
+const unsigned  Trace::cRingSize = 4096;
+
+volatile bool       Trace::Enabled  = false;
+DWORD               Trace::TlsIndex = TLS_OUT_OF_INDEXES;
+Mutex               Trace::Lock;
+std::list<Trace::Ring>  Trace::Rings;
+std::list<Trace::Ring*> Trace::FreeRings;
+
+
+/**
+ *  \brief
+ */
+Trace::Ring::Ring() : _head(0)
+{
+    _events = new Event[cRingSize];
+}
+
+
+/**
+ *  \brief
+ */
+Trace::Ring::~Ring()
+{
+    delete [] _events;
+}
+
+
+/**
+ *  \brief
+ */
+void Trace::Enable(bool enable)
+{
+    AUTOLOCK(Lock);
+
+    if (TlsIndex == TLS_OUT_OF_INDEXES)
+    {
+        TlsIndex = TlsAlloc();
+        if (TlsIndex == TLS_OUT_OF_INDEXES)
+            return;
+    }
+
+    Enabled = enable;
+}
+
+
+/**
+ *  \brief  Gives the thread ring to the next new thread - called on thread detach from the DLL
+ */
+void Trace::ThreadExit()
+{
+    if (TlsIndex == TLS_OUT_OF_INDEXES)
+        return;
+
+    Ring* ring = static_cast<Ring*>(TlsGetValue(TlsIndex));
+    if (!ring)
+        return;
+
+    TlsSetValue(TlsIndex, NULL);
+
+    AUTOLOCK(Lock);
+
+    FreeRings.push_back(ring);
+}
+
+
+/**
+ *  \brief  Saves the spans ended in the last period_ms as Chrome trace event JSON
+ */
+bool Trace::Save(const CPath& file, DWORD period_ms)
+{
+    LARGE_INTEGER freq;
+    LARGE_INTEGER now;
+    QueryPerformanceFrequency(&freq);
+    QueryPerformanceCounter(&now);
+
+    const LONGLONG from = now.QuadPart - (freq.QuadPart * period_ms) / 1000;
+
+    std::vector<Event> events;
+
+    {
+        AUTOLOCK(Lock);
+
+        for (std::list<Ring>::iterator iRing = Rings.begin(); iRing != Rings.end(); ++iRing)
+        {
+            LONG head = InterlockedCompareExchange(&iRing->_head, 0, 0);
+            LONG first = (head > (LONG)cRingSize) ? head - cRingSize : 0;
+            unsigned start = events.size();
+
+            for (LONG i = first; i < head; ++i)
+                events.push_back(iRing->_events[i % cRingSize]);
+
+            // Drop the events the owner thread has overwritten meanwhile
+            head = InterlockedCompareExchange(&iRing->_head, 0, 0);
+            if (head - (LONG)cRingSize + 1 > first)
+            {
+                unsigned overwritten = head - cRingSize + 1 - first;
+                if (overwritten > events.size() - start)
+                    overwritten = events.size() - start;
+                events.erase(events.begin() + start, events.begin() + start + overwritten);
+            }
+        }
+    }
+
+    std::sort(events.begin(), events.end(), EventEarlier());
+
+    FILE* fp;
+    _tfopen_s(&fp, file.C_str(), _T("wt"));
+    if (fp == NULL)
+        return false;
+
+    fprintf(fp, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+
+    bool first = true;
+    for (std::vector<Event>::iterator iEvent = events.begin(); iEvent != events.end(); ++iEvent)
+    {
+        if (iEvent->_end < from)
+            continue;
+
+        // Microseconds since the period start
+        double ts = (double)(iEvent->_start - from) * 1000000.0 / freq.QuadPart;
+        double dur = (double)(iEvent->_end - iEvent->_start) * 1000000.0 / freq.QuadPart;
+
+        fprintf(fp, "%s{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%lu,\"ts\":%.3f,\"dur\":%.3f}",
+                first ? "" : ",\n", iEvent->_name, (unsigned long)iEvent->_tid, ts, dur);
+        first = false;
+    }
+
+    fprintf(fp, "\n]}\n");
+
+    bool success = (ferror(fp) == 0);
+    fclose(fp);
+
+    return success;
+}
+
+
+/**
+ *  \brief
+ */
+void Trace::record(const char* name, const LARGE_INTEGER& start)
+{
+    Ring* ring = static_cast<Ring*>(TlsGetValue(TlsIndex));
+    if (!ring)
+    {
+        ring = acquireRing();
+        if (!ring)
+            return;
+    }
+
+    LARGE_INTEGER end;
+    QueryPerformanceCounter(&end);
+
+    LONG head = ring->_head;
+    Event& event = ring->_events[head % cRingSize];
+
+    event._name     = name;
+    event._tid      = GetCurrentThreadId();
+    event._start    = start.QuadPart;
+    event._end      = end.QuadPart;
+
+    InterlockedExchange(&ring->_head, head + 1);
+}
+
+
+/**
+ *  \brief  Takes a ring left by a finished thread or allocates new one
+ */
+Trace::Ring* Trace::acquireRing()
+{
+    Ring* ring;
+
+    {
+        AUTOLOCK(Lock);
+
+        if (!FreeRings.empty())
+        {
+            ring = FreeRings.front();
+            FreeRings.pop_front();
+        }
+        else
+        {
+            Rings.emplace_back();
+            ring = &Rings.back();
+        }
+    }
+
+    TlsSetValue(TlsIndex, ring);
+
+    return ring;
+}
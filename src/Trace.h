@@ -0,0 +1,130 @@
+/**
+ *  \file
+ *  \brief  Lookup latency tracing
+ *
+ *  \author  Pavel Nedev <pg.nedev@gmail.com>
+ *
+ *  \section COPYRIGHT
+ *  Copyright(C) 2015 Pavel Nedev
+ *
+ *  \section LICENSE
+ *  This program is free software; you can redistribute it and/or modify it
+ *  under the terms of the GNU General Public License version 2 as published
+ *  by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful, but
+ *  WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ *  or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ *  for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+#pragma once
+
+
+#include <windows.h>
+#include <tchar.h>
+#include <list>
+#include "AutoLock.h"
+
+
+class CPath;
+
+
+// Unique span variable name per line so a scope can have several spans
+#define TRACE_CAT_(a, b)    a##b
+#define TRACE_CAT(a, b)     TRACE_CAT_(a, b)
+#define TRACE_SPAN(x)       Trace::Span TRACE_CAT(traceSpan, __LINE__)(x)
+
+
+/**
+ *  \class  Trace
+ *  \brief  Records named scope durations (spans) in per-thread ring buffers and saves the recent ones
+ *          as Chrome trace events (chrome://tracing). When off a span costs one branch on a global flag
+ */
+class Trace
+{
+public:
+    /**
+     *  \class  Span
+     *  \brief  The name must be a string literal - only the pointer is kept
+     */
+    class Span
+    {
+    public:
+        // The global flag is checked once - the destructor only tests the member set here
+        inline Span(const char* name) : _name(NULL)
+        {
+            if (Enabled)
+            {
+                _name = name;
+                QueryPerformanceCounter(&_start);
+            }
+        }
+
+        inline ~Span()
+        {
+            if (_name)
+                record(_name, _start);
+        }
+
+    private:
+        Span(const Span&);
+        const Span& operator=(const Span&);
+
+        const char*     _name;
+        LARGE_INTEGER   _start;
+    };
+
+    static void Enable(bool enable);
+    static inline bool IsEnabled() { return Enabled; }
+    static void ThreadExit();
+    static bool Save(const CPath& file, DWORD period_ms);
+
+private:
+    static const unsigned cRingSize;
+
+    /**
+     *  \struct  Event
+     *  \brief
+     */
+    struct Event
+    {
+        const char* _name;
+        DWORD       _tid;
+        LONGLONG    _start;
+        LONGLONG    _end;
+    };
+
+    /**
+     *  \struct  Ring
+     *  \brief  Written only by its owner thread, the head is published after the event is complete
+     */
+    struct Ring
+    {
+        Ring();
+        ~Ring();
+
+        volatile LONG   _head;
+        Event*          _events;
+
+    private:
+        Ring(const Ring&);
+        const Ring& operator=(const Ring&);
+    };
+
+    static void record(const char* name, const LARGE_INTEGER& start);
+    static Ring* acquireRing();
+
+    static volatile bool    Enabled;
+    static DWORD            TlsIndex;
+    static Mutex            Lock;
+    static std::list<Ring>  Rings;
+    static std::list<Ring*> FreeRings;
+
+    Trace();
+};
@@ -0,0 +1,475 @@
+/**
+ *  \file
+ *  \brief  GTags DB update filter
+ *
+ *  \author  Pavel Nedev <pg.nedev@gmail.com>
+ *
+ *  \section COPYRIGHT
+ *  Copyright(C) 2015 Pavel Nedev
+ *
+ *  \section LICENSE
+ *  This program is free software; you can redistribute it and/or modify it
+ *  under the terms of the GNU General Public License version 2 as published
+ *  by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful, but
+ *  WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ *  or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ *  for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+#include <windows.h>
+#include <tchar.h>
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include "Config.h"
+#include "GTags.h"
+#include "FileWalker.h"
+#include "UpdateFilter.h"
+
+
+namespace GTags
+{
+
+// GTags built-in parser language map used when there is no gtags.conf
+const char UpdateFilter::cDefaultLangMap[] =
+        "c:.c.h,yacc:.y,asm:.s.S,java:.java,cpp:.c++.cc.hh.cpp.cxx.hxx.hpp.C.H,php:.php.php3.phtml";
+
+const unsigned UpdateFilter::cMaxLabelDepth = 8;
+
+
+UpdateFilter UpdateFilter::Instance;
+
+
+namespace
+{
+
+/**
+ *  \brief
+ */
+bool lessStr(const CTextA& lhs, const CTextA& rhs)
+{
+    return (strcmp(lhs.C_str(), rhs.C_str()) < 0);
+}
+
+
+/**
+ *  \brief
+ */
+void toLower(char* str)
+{
+    for (; *str; ++str)
+        if (*str >= 'A' && *str <= 'Z')
+            *str += 'a' - 'A';
+}
+
+
+/**
+ *  \brief  Splits gtags.conf entry on the capability separators, escaped ones are kept
+ */
+void splitCaps(const char* entry, std::vector<CTextA>& caps)
+{
+    CTextA cap;
+
+    for (const char* c = entry; ; ++c)
+    {
+        if (*c == '\\' && c[1] == ':')
+        {
+            cap.Append(c, 2);
+            ++c;
+        }
+        else if (*c == ':' || *c == 0)
+        {
+            // Drop the continuation lines indentation
+            const char* str = cap.C_str();
+            while (*str == ' ' || *str == '\t')
+                ++str;
+            caps.push_back(CTextA(str));
+            cap.Clear();
+
+            if (*c == 0)
+                break;
+        }
+        else
+        {
+            cap += *c;
+        }
+    }
+}
+
+} // anonymous namespace
+
+
+/**
+ *  \brief  Removes from the list the files whose update would be no-op. The hashes of the kept files
+ *          are committed when their update succeeds
+ */
+void UpdateFilter::Filter(const CPath& dbPath, std::vector<CPath>& files)
+{
+    std::vector<unsigned long long> hashes(files.size());
+    std::vector<bool> exists(files.size());
+    std::vector<bool> excluded(files.size());
+
+    // Hash outside the lock - it reads the files
+    for (unsigned i = 0; i < files.size(); ++i)
+    {
+        exists[i] = contentHash(files[i], hashes[i]);
+        excluded[i] = FileWalker::Get().IsExcluded(dbPath, files[i]);
+    }
+
+    AUTOLOCK(_lock);
+
+    if (!(_parser == Config.Parser()))
+        loadLangMap();
+
+    HashTable& table = _dbs[dbPath];
+    HashTable& pending = _pending[dbPath];
+
+    pending.clear();
+
+    unsigned kept = 0;
+
+    for (unsigned i = 0; i < files.size(); ++i)
+    {
+        // Deleted or unreadable files are always updated - gtags removes them from the DB
+        if (!exists[i])
+        {
+            table.erase(files[i]);
+        }
+        else if (excluded[i])
+        {
+            ++_skippedExcluded;
+            continue;
+        }
+        else if (!isIndexed(files[i]))
+        {
+            ++_skippedNotIndexed;
+            continue;
+        }
+        else
+        {
+            HashTable::iterator iHash = table.find(files[i]);
+            if (iHash != table.end() && iHash->second == hashes[i])
+            {
+                ++_skippedSame;
+                continue;
+            }
+
+            pending[files[i]] = hashes[i];
+        }
+
+        if (kept != i)
+            files[kept] = files[i];
+        ++kept;
+    }
+
+    files.resize(kept);
+    _updated += kept;
+}
+
+
+/**
+ *  \brief  Checks if the current parser indexes the file
+ */
+bool UpdateFilter::IsIndexed(const CPath& file)
+{
+    AUTOLOCK(_lock);
+
+    if (!(_parser == Config.Parser()))
+        loadLangMap();
+
+    return isIndexed(file);
+}
+
+
+/**
+ *  \brief  The DB update of the last filtered files succeeded - their hashes match the DB content now
+ */
+void UpdateFilter::Commit(const CPath& dbPath)
+{
+    AUTOLOCK(_lock);
+
+    std::unordered_map<CPath, HashTable, CPathHash, CPathEqual>::iterator iPending = _pending.find(dbPath);
+    if (iPending == _pending.end())
+        return;
+
+    HashTable& table = _dbs[dbPath];
+
+    for (HashTable::iterator iHash = iPending->second.begin(); iHash != iPending->second.end(); ++iHash)
+        table[iHash->first] = iHash->second;
+
+    _pending.erase(iPending);
+}
+
+
+/**
+ *  \brief  Forgets the DB file hashes - needed when the DB content is not known anymore
+ */
+void UpdateFilter::Invalidate(const CPath& dbPath)
+{
+    AUTOLOCK(_lock);
+
+    _dbs.erase(dbPath);
+    _pending.erase(dbPath);
+}
+
+
+/**
+ *  \brief
+ */
+void UpdateFilter::GetStats(CText& stats)
+{
+    AUTOLOCK(_lock);
+
+    if (!_updated && !_skippedSame && !_skippedNotIndexed && !_skippedExcluded)
+        return;
+
+    TCHAR buf[192];
+    _sntprintf_s(buf, _countof(buf), _TRUNCATE,
+            _T(" %u files updated, %u skipped as unchanged, %u skipped as not indexed by the parser,")
+            _T(" %u skipped as excluded\n"),
+            _updated, _skippedSame, _skippedNotIndexed, _skippedExcluded);
+
+    stats += buf;
+}
+
+
+/**
+ *  \brief  64-bit FNV-1a of the file content with each run of spaces and tabs hashed as a single
+ *          separator byte - re-spacing doesn't move the tags but joining two words does.
+ *          '\n' is hashed as it changes the tags line numbers, the whitespace before it
+ *          (including the '\r' of CRLF) and the indentation after it are dropped
+ */
+bool UpdateFilter::contentHash(const CPath& file, unsigned long long& hash)
+{
+    std::vector<char> buf;
+    if (!readFile(file.C_str(), buf))
+        return false;
+
+    hash = 14695981039346656037ULL;
+
+    bool space = false;
+    bool lineStart = true;
+
+    for (std::vector<char>::const_iterator c = buf.begin(); c != buf.end(); ++c)
+    {
+        if (*c == ' ' || *c == '\t' || *c == '\r' || *c == '\f' || *c == '\v')
+        {
+            space = !lineStart;
+            continue;
+        }
+
+        lineStart = (*c == '\n');
+
+        if (space && !lineStart)
+        {
+            hash ^= (unsigned char)' ';
+            hash *= 1099511628211ULL;
+        }
+        space = false;
+
+        hash ^= (unsigned char)*c;
+        hash *= 1099511628211ULL;
+    }
+
+    return true;
+}
+
+
+/**
+ *  \brief
+ */
+bool UpdateFilter::readFile(const TCHAR* file, std::vector<char>& buf)
+{
+    FILE* fp;
+    _tfopen_s(&fp, file, _T("rb"));
+    if (fp == NULL)
+        return false;
+
+    char chunk[16384];
+    size_t len;
+
+    while ((len = fread(chunk, 1, sizeof(chunk), fp)) > 0)
+        buf.insert(buf.end(), chunk, chunk + len);
+
+    fclose(fp);
+
+    return true;
+}
+
+
+/**
+ *  \brief  Checks the file name against the parser language map. gtags matches the suffixes
+ *          case-insensitively on Windows
+ */
+bool UpdateFilter::isIndexed(const CPath& file)
+{
+    CTextA name(file.GetFilename());
+    toLower(name.C_str());
+
+    if (std::binary_search(_names.begin(), _names.end(), name, lessStr))
+        return true;
+
+    const char* ext = strrchr(name.C_str(), '.');
+    if (!ext)
+        return false;
+
+    return std::binary_search(_suffixes.begin(), _suffixes.end(), CTextA(ext), lessStr);
+}
+
+
+/**
+ *  \brief  Loads the current parser language map from the plugin gtags.conf
+ */
+void UpdateFilter::loadLangMap()
+{
+    _parser = Config.Parser();
+    _suffixes.clear();
+    _names.clear();
+
+    CPath confFile(DllPath);
+    confFile.StripFilename();
+    confFile += cBinsDir;
+    confFile += _T("\\gtags.conf");
+
+    std::vector<char> conf;
+    if (readFile(confFile.C_str(), conf))
+    {
+        std::vector<CTextA> entries;
+        CTextA entry;
+
+        conf.push_back('\n');
+
+        for (unsigned i = 0; i < conf.size(); ++i)
+        {
+            if (conf[i] == '\\' && (conf[i + 1] == '\n' || (conf[i + 1] == '\r' && conf[i + 2] == '\n')))
+            {
+                // Line continuation
+                i += (conf[i + 1] == '\r') ? 2 : 1;
+            }
+            else if (conf[i] == '\n' || conf[i] == '\r')
+            {
+                if (!entry.IsEmpty() && entry.C_str()[0] != '#')
+                    entries.push_back(entry);
+                entry.Clear();
+            }
+            else
+            {
+                entry += conf[i];
+            }
+        }
+
+        CTextA label(_parser.C_str());
+        addLabel(entries, label.C_str(), 0);
+    }
+
+    if (_suffixes.empty() && _names.empty())
+        addLangMap(cDefaultLangMap);
+
+    std::sort(_suffixes.begin(), _suffixes.end(), lessStr);
+    std::sort(_names.begin(), _names.end(), lessStr);
+}
+
+
+/**
+ *  \brief  Collects the language maps of gtags.conf label following the label references
+ */
+void UpdateFilter::addLabel(const std::vector<CTextA>& entries, const char* label, unsigned depth)
+{
+    if (depth > cMaxLabelDepth)
+        return;
+
+    size_t labelLen = strlen(label);
+
+    for (std::vector<CTextA>::const_iterator iEntry = entries.begin(); iEntry != entries.end(); ++iEntry)
+    {
+        std::vector<CTextA> caps;
+        splitCaps(iEntry->C_str(), caps);
+
+        // Entry names are separated by '|'
+        const char* names = caps[0].C_str();
+        bool found = false;
+
+        for (const char* name = names; *name; )
+        {
+            size_t len = strcspn(name, "|");
+            if (len == labelLen && !strncmp(name, label, len))
+            {
+                found = true;
+                break;
+            }
+            name += len;
+            if (*name)
+                ++name;
+        }
+
+        if (!found)
+            continue;
+
+        for (unsigned i = 1; i < caps.size(); ++i)
+        {
+            if (!strncmp(caps[i].C_str(), "tc=", 3))
+                addLabel(entries, caps[i].C_str() + 3, depth + 1);
+            else if (!strncmp(caps[i].C_str(), "langmap=", 8))
+                addLangMap(caps[i].C_str() + 8);
+        }
+
+        return;
+    }
+}
+
+
+/**
+ *  \brief  Parses lang\:.ext1.ext2,lang\:(name) language map
+ */
+void UpdateFilter::addLangMap(const char* langMap)
+{
+    CTextA map(langMap);
+    toLower(map.C_str());
+
+    for (char* lang = map.C_str(); *lang; )
+    {
+        char* next = lang + strcspn(lang, ",");
+        if (*next)
+            *next++ = 0;
+
+        char* list = strchr(lang, ':');
+        lang = next;
+        if (!list)
+            continue;
+
+        for (++list; *list; )
+        {
+            if (*list == '(')
+            {
+                char* end = strchr(list, ')');
+                if (!end)
+                    break;
+
+                _names.push_back(CTextA());
+                _names.back().Append(list + 1, end - list - 1);
+                list = end + 1;
+            }
+            else if (*list == '.')
+            {
+                size_t len = strcspn(list + 1, ".(");
+
+                _suffixes.push_back(CTextA());
+                _suffixes.back().Append(list, len + 1);
+                list += len + 1;
+            }
+            else
+            {
+                ++list;
+            }
+        }
+    }
+}
+
+} // namespace GTags
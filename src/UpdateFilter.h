@@ -0,0 +1,94 @@
+/**
+ *  \file
+ *  \brief  GTags DB update filter
+ *
+ *  \author  Pavel Nedev <pg.nedev@gmail.com>
+ *
+ *  \section COPYRIGHT
+ *  Copyright(C) 2015 Pavel Nedev
+ *
+ *  \section LICENSE
+ *  This program is free software; you can redistribute it and/or modify it
+ *  under the terms of the GNU General Public License version 2 as published
+ *  by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful, but
+ *  WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ *  or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ *  for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+#pragma once
+
+
+#include <windows.h>
+#include <tchar.h>
+#include <vector>
+#include <unordered_map>
+#include "Common.h"
+#include "AutoLock.h"
+
+
+namespace GTags
+{
+
+/**
+ *  \class  UpdateFilter
+ *  \brief  Drops the DB updates that would not change anything - files saved with the same
+ *          content (intra-line whitespace ignored), files the current parser doesn't index
+ *          and files excluded from the DB
+ */
+class UpdateFilter
+{
+public:
+    static UpdateFilter& Get() { return Instance; }
+
+    void Filter(const CPath& dbPath, std::vector<CPath>& files);
+    bool IsIndexed(const CPath& file);
+    void Commit(const CPath& dbPath);
+    void Invalidate(const CPath& dbPath);
+    void GetStats(CText& stats);
+
+private:
+    typedef std::unordered_map<CPath, unsigned long long, CPathHash, CPathEqual> HashTable;
+
+    static const char cDefaultLangMap[];
+    static const unsigned cMaxLabelDepth;
+
+    static UpdateFilter Instance;
+
+    static bool contentHash(const CPath& file, unsigned long long& hash);
+    static bool readFile(const TCHAR* file, std::vector<char>& buf);
+
+    UpdateFilter() : _updated(0), _skippedSame(0), _skippedNotIndexed(0), _skippedExcluded(0) {}
+    UpdateFilter(const UpdateFilter&);
+    ~UpdateFilter() {}
+
+    bool isIndexed(const CPath& file);
+    void loadLangMap();
+    void addLabel(const std::vector<CTextA>& entries, const char* label, unsigned depth);
+    void addLangMap(const char* langMap);
+
+    Mutex   _lock;
+
+    std::unordered_map<CPath, HashTable, CPathHash, CPathEqual> _dbs;
+    // Hashes of the files in the running DB update - known to the DB once it succeeds
+    std::unordered_map<CPath, HashTable, CPathHash, CPathEqual> _pending;
+
+    // Parser label the suffixes are loaded for
+    CText               _parser;
+    std::vector<CTextA> _suffixes;
+    std::vector<CTextA> _names;
+
+    unsigned    _updated;
+    unsigned    _skippedSame;
+    unsigned    _skippedNotIndexed;
+    unsigned    _skippedExcluded;
+};
+
+} // namespace GTags
@@ -0,0 +1,884 @@
+/**
+ *  \file
+ *  \brief  Plugin core benchmark on generated projects indexed by GNU Global
+ *
+ *  \author  Pavel Nedev <pg.nedev@gmail.com>
+ *
+ *  \section COPYRIGHT
+ *  Copyright(C) 2015 Pavel Nedev
+ *
+ *  \section LICENSE
+ *  This program is free software; you can redistribute it and/or modify it
+ *  under the terms of the GNU General Public License version 2 as published
+ *  by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful, but
+ *  WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ *  or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ *  for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <ftw.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <chrono>
+#include <new>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include "Headless.h"
+#include "TagNames.h"
+#include "FileWalker.h"
+
+
+namespace
+{
+
+using namespace GTags;
+
+
+const char cUsage[] =
+    "Usage: nppgtags-bench [--files <n>] [--symbols <n>] [--refs <n>] [--line-len <n>] [--seed <n>]\n"
+    "                      [--iterations <n>] [--save-all <n>] [--dir <path>] [--keep] [--generate-only]\n"
+    "                      [--out <file>]\n"
+    "       nppgtags-bench --walk <n> [--dir <path>] [--keep] [--out <file>]\n"
+    "\n"
+    "Generates C project of <files> files with <symbols> functions each, every function making <refs>\n"
+    "calls to functions of other files, lines padded to <line-len> chars. Indexes it with gtags and times\n"
+    "each plugin command flow <iterations> times through the plugin core - DB locking, running global and\n"
+    "composing the results window text - and counts its heap allocations, the text buffers ones apart.\n"
+    "Times also saving <save-all> files at once until the DB has them all - with an update per saved file\n"
+    "and with the plugin batched update. Then lists all tag names of each kind and builds the in-memory tag\n"
+    "index from them. The run times and index sizes are written as JSON to <out> (stdout by default).\n"
+    "Exits with 77 if gtags is not found.\n"
+    "\n"
+    "With --walk generates a tree of <n> empty files, 100 per folder, some of them matched by .gitignore\n"
+    "rules, and times the plugin project walker over it - the first walk and the one from the folder\n"
+    "listings cache. Fails if the walker doesn't list exactly the not ignored files. Doesn't need gtags.\n";
+
+// Tells ctest the benchmark was skipped
+const int cSkipped = 77;
+
+// The plugin collects saves for this long (GTags.cpp cUpdateDelay) before the batched update
+const unsigned cUpdateDelay = 300;
+
+
+// Counted by the replaced global operator new
+volatile LONG HeapAllocs = 0;
+
+
+/**
+ *  \struct  Options
+ *  \brief
+ */
+struct Options
+{
+    Options() : _files(200), _symbols(20), _refs(8), _lineLen(80), _seed(1), _iterations(20), _saveAll(10),
+        _walk(0), _dir(NULL), _out(NULL), _keep(false), _generateOnly(false) {}
+
+    unsigned    _files;
+    unsigned    _symbols;
+    unsigned    _refs;
+    unsigned    _lineLen;
+    unsigned    _seed;
+    unsigned    _iterations;
+    unsigned    _saveAll;
+    unsigned    _walk;
+    const char* _dir;
+    const char* _out;
+    bool        _keep;
+    bool        _generateOnly;
+};
+
+
+/**
+ *  \struct  Project
+ *  \brief  Generated project
+ */
+struct Project
+{
+    Project() : _bytes(0), _lines(0) {}
+
+    std::string                 _root;
+    std::vector<std::string>    _files;
+    unsigned long long          _bytes;
+    unsigned                    _lines;
+};
+
+
+/**
+ *  \struct  Flow
+ *  \brief  Run times of one command flow
+ */
+struct Flow
+{
+    Flow(const char* name) : _name(name), _failed(0), _resultBytes(0), _allocs(0), _textAllocs(0) {}
+
+    const char*             _name;
+    std::vector<unsigned>   _times;
+    unsigned                _failed;
+    unsigned long long      _resultBytes;
+    // All heap allocations and the CText/CTextA buffer ones made by the timed runs
+    unsigned long long      _allocs;
+    unsigned long long      _textAllocs;
+};
+
+
+/**
+ *  \struct  WalkStat
+ *  \brief  Generated walk tree and the walker results on it
+ */
+struct WalkStat
+{
+    WalkStat() : _files(0), _folders(0), _ignored(0), _listed(0), _walkTime(0), _cachedWalkTime(0) {}
+
+    unsigned    _files;
+    unsigned    _folders;
+    // Files the .gitignore rules leave out
+    unsigned    _ignored;
+    unsigned    _listed;
+    unsigned    _walkTime;
+    unsigned    _cachedWalkTime;
+};
+
+
+/**
+ *  \struct  IndexStat
+ *  \brief  Size and build time of the tag names index of one kind
+ */
+struct IndexStat
+{
+    IndexStat(const char* kind) : _kind(kind), _names(0), _bytes(0), _listTime(0), _buildTime(0) {}
+
+    const char* _kind;
+    unsigned    _names;
+    unsigned    _bytes;
+    unsigned    _listTime;
+    unsigned    _buildTime;
+};
+
+
+/**
+ *  \class  Random
+ *  \brief  Same sequence for the same seed on every platform
+ */
+class Random
+{
+public:
+    Random(unsigned seed) : _state(seed * 2654435761U + 1) {}
+
+    unsigned Next(unsigned range)
+    {
+        _state = _state * 1103515245U + 12345U;
+        return (_state >> 8) % range;
+    }
+
+private:
+    unsigned _state;
+};
+
+
+/**
+ *  \brief
+ */
+bool parseArgs(int argc, char* argv[], Options& opt)
+{
+    for (int i = 1; i < argc; ++i)
+    {
+        if (!strcmp(argv[i], "--keep"))
+        {
+            opt._keep = true;
+            continue;
+        }
+
+        if (!strcmp(argv[i], "--generate-only"))
+        {
+            opt._generateOnly = true;
+            continue;
+        }
+
+        if (i + 1 >= argc)
+            return false;
+
+        const char* name = argv[i];
+        const char* val = argv[++i];
+        unsigned num = (unsigned)std::max(1, atoi(val));
+
+        if (!strcmp(name, "--files"))
+            opt._files = num;
+        else if (!strcmp(name, "--symbols"))
+            opt._symbols = num;
+        else if (!strcmp(name, "--refs"))
+            opt._refs = num;
+        else if (!strcmp(name, "--line-len"))
+            opt._lineLen = num;
+        else if (!strcmp(name, "--seed"))
+            opt._seed = num;
+        else if (!strcmp(name, "--iterations"))
+            opt._iterations = num;
+        else if (!strcmp(name, "--save-all"))
+            opt._saveAll = num;
+        else if (!strcmp(name, "--walk"))
+            opt._walk = num;
+        else if (!strcmp(name, "--dir"))
+            opt._dir = val;
+        else if (!strcmp(name, "--out"))
+            opt._out = val;
+        else
+            return false;
+    }
+
+    return true;
+}
+
+
+/**
+ *  \brief
+ */
+std::string symbolName(unsigned file, unsigned symbol)
+{
+    char name[32];
+    snprintf(name, sizeof(name), "sym_%u_%u", file, symbol);
+    return name;
+}
+
+
+/**
+ *  \brief  Pads the line with a comment up to the line length
+ */
+void addLine(std::string& text, const std::string& line, unsigned lineLen, Project& project)
+{
+    text += line;
+
+    if (line.size() + 6 < lineLen)
+    {
+        text += " /* ";
+        text.append(lineLen - line.size() - 7, 'x');
+        text += " */";
+    }
+
+    text += '\n';
+    ++project._lines;
+}
+
+
+/**
+ *  \brief  Writes the project sources - 50 files per folder
+ */
+bool generate(const Options& opt, Project& project)
+{
+    Random rnd(opt._seed);
+
+    for (unsigned f = 0; f < opt._files; ++f)
+    {
+        char rel[64];
+        snprintf(rel, sizeof(rel), "mod%02u", f / 50);
+
+        std::string dir = project._root + rel;
+        if (f % 50 == 0 && mkdir(dir.c_str(), 0777) && errno != EEXIST)
+            return false;
+
+        snprintf(rel, sizeof(rel), "mod%02u/file%04u.c", f / 50, f);
+
+        std::string text;
+        addLine(text, "/* Generated by nppgtags-bench */", opt._lineLen, project);
+        // Used but not defined anywhere - found as symbol, not as definition
+        addLine(text, "extern int shared_counter;", opt._lineLen, project);
+        text += '\n';
+
+        for (unsigned s = 0; s < opt._symbols; ++s)
+        {
+            addLine(text, "int " + symbolName(f, s) + "(int a)", opt._lineLen, project);
+            addLine(text, "{", opt._lineLen, project);
+            addLine(text, "    int total = a;", opt._lineLen, project);
+
+            for (unsigned r = 0; r < opt._refs; ++r)
+            {
+                unsigned rf = rnd.Next(opt._files);
+                unsigned rs = rnd.Next(opt._symbols);
+
+                addLine(text, "    total += " + symbolName(rf, rs) + "(total + shared_counter);", opt._lineLen,
+                        project);
+            }
+
+            addLine(text, "    return total;", opt._lineLen, project);
+            addLine(text, "}", opt._lineLen, project);
+            text += '\n';
+        }
+
+        std::string path = project._root + rel;
+        FILE* fp = fopen(path.c_str(), "wb");
+        if (!fp)
+            return false;
+
+        bool success = (fwrite(text.data(), 1, text.size(), fp) == text.size());
+        success = (fclose(fp) == 0) && success;
+        if (!success)
+            return false;
+
+        project._files.push_back(rel);
+        project._bytes += text.size();
+    }
+
+    return true;
+}
+
+
+/**
+ *  \brief  Writes the walk tree - every 10th folder is a build/ folder and every 10th is a gen/ folder
+ *          with .c files ignored, every 10th file is an ignored .o
+ */
+bool generateWalkTree(const Options& opt, const std::string& root, WalkStat& stat)
+{
+    FILE* fp = fopen((root + ".gitignore").c_str(), "wb");
+    if (!fp)
+        return false;
+
+    fputs("*.o\nbuild/\n**/gen/*.c\n", fp);
+    if (fclose(fp))
+        return false;
+
+    // Listed by the walker too
+    stat._files = 1;
+
+    std::string dir;
+
+    for (unsigned f = 0; f < opt._walk; ++f)
+    {
+        unsigned folder = f / 100;
+
+        if (f % 100 == 0)
+        {
+            char rel[64];
+            snprintf(rel, sizeof(rel), "d%04u/", folder);
+
+            dir = root + rel;
+            if (mkdir(dir.c_str(), 0777) && errno != EEXIST)
+                return false;
+
+            if (folder % 10 == 9)
+                dir += "build/";
+            else if (folder % 10 == 8)
+                dir += "gen/";
+
+            if (mkdir(dir.c_str(), 0777) && errno != EEXIST)
+                return false;
+
+            ++stat._folders;
+        }
+
+        static const char* const cExts[] = { ".c", ".c", ".c", ".c", ".c", ".c", ".c", ".h", ".h", ".o" };
+
+        const char* ext = cExts[f % 10];
+
+        char name[32];
+        snprintf(name, sizeof(name), "f%02u%s", f % 100, ext);
+
+        fp = fopen((dir + name).c_str(), "wb");
+        if (!fp || fclose(fp))
+            return false;
+
+        ++stat._files;
+
+        if (folder % 10 == 9 || !strcmp(ext, ".o") || (folder % 10 == 8 && !strcmp(ext, ".c")))
+            ++stat._ignored;
+    }
+
+    return true;
+}
+
+
+/**
+ *  \brief  Times the walk of the generated tree and counts the files in the list
+ */
+bool timeWalk(const std::string& root, unsigned& time, unsigned& listed)
+{
+    CPath dbPath(root.c_str());
+    CPath listFile;
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    bool success = FileWalker::Get().Walk(dbPath, listFile);
+
+    time = (unsigned)std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now() - start).count();
+
+    if (!success)
+        return false;
+
+    CTextA name(listFile.C_str());
+
+    FILE* fp = fopen(name.C_str(), "rb");
+    if (!fp)
+        return false;
+
+    listed = 0;
+
+    char line[1024];
+    while (fgets(line, sizeof(line), fp))
+        ++listed;
+
+    fclose(fp);
+    unlink(name.C_str());
+
+    return true;
+}
+
+
+/**
+ *  \brief
+ */
+bool runWalk(const Options& opt, const std::string& root, WalkStat& stat)
+{
+    if (!generateWalkTree(opt, root, stat))
+    {
+        fprintf(stderr, "Generating the walk tree in '%s' failed\n", root.c_str());
+        return false;
+    }
+
+    unsigned cachedListed = 0;
+
+    if (!timeWalk(root, stat._walkTime, stat._listed) || !timeWalk(root, stat._cachedWalkTime, cachedListed))
+    {
+        fprintf(stderr, "Walking '%s' failed\n", root.c_str());
+        return false;
+    }
+
+    return (stat._listed == stat._files - stat._ignored && cachedListed == stat._listed);
+}
+
+
+/**
+ *  \brief
+ */
+bool writeWalkJson(FILE* fp, const WalkStat& stat)
+{
+    fprintf(fp, "{\"walk\":{\"files\":%u,\"folders\":%u,\"listed\":%u,\"excluded\":%u,"
+            "\"expected_excluded\":%u,\"walk_ms\":%u,\"cached_walk_ms\":%u}}\n",
+            stat._files, stat._folders, stat._listed, stat._files - stat._listed, stat._ignored,
+            stat._walkTime, stat._cachedWalkTime);
+
+    return (ferror(fp) == 0);
+}
+
+
+/**
+ *  \brief
+ */
+int removeEntry(const char* path, const struct stat*, int, struct FTW*)
+{
+    return remove(path);
+}
+
+
+/**
+ *  \brief  Appends a line to the file so the DB update has something to do
+ */
+void touchFile(const Project& project, unsigned idx, unsigned n)
+{
+    std::string path = project._root + project._files[idx % project._files.size()];
+
+    FILE* fp = fopen(path.c_str(), "ab");
+    if (fp)
+    {
+        fprintf(fp, "int edit_%u_%u(void) { return %u; }\n", idx, n, n);
+        fclose(fp);
+    }
+}
+
+
+/**
+ *  \brief  Runs the command through the plugin core and records its run time
+ */
+void timeCmd(CmdRunner& runner, const CPath& dbPath, CmdId_t id, const std::string& tag, Flow& flow)
+{
+    CText wideTag;
+    wideTag += tag.c_str();
+
+    CTextA view;
+
+    const LONG allocs = HeapAllocs;
+    const LONG textAllocs = TextHeapAllocs;
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    CmdStatus_t status = RunCmd(runner, dbPath, id, wideTag.C_str(), false, true, view);
+
+    flow._times.push_back((unsigned)std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - start).count());
+
+    flow._allocs += HeapAllocs - allocs;
+    flow._textAllocs += TextHeapAllocs - textAllocs;
+
+    if (status != OK)
+        ++flow._failed;
+    flow._resultBytes += view.Len();
+}
+
+
+/**
+ *  \brief  Times saving files at once until the DB has all of them - one single file update per save or
+ *          one incremental update for the whole batch after the plugin saves collecting delay (added to
+ *          the time, not slept). Edits are named after n so the last one can be looked up
+ */
+void timeSaveAll(CmdRunner& runner, const Options& opt, const Project& project, const CPath& dbPath,
+        Random& rnd, bool batched, unsigned n, Flow& flow)
+{
+    std::vector<unsigned> saved;
+    for (unsigned i = 0; i < opt._saveAll; ++i)
+        saved.push_back(rnd.Next(project._files.size()));
+
+    CTextA view;
+    bool success = true;
+
+    const LONG allocs = HeapAllocs;
+    const LONG textAllocs = TextHeapAllocs;
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    for (unsigned i = 0; i < saved.size(); ++i)
+    {
+        touchFile(project, saved[i], n);
+
+        if (!batched)
+        {
+            CText file;
+            file += project._files[saved[i]].c_str();
+            success &= (RunCmd(runner, dbPath, UPDATE_SINGLE, file.C_str(), false, true, view) == OK);
+        }
+    }
+
+    if (batched)
+        success = (RunCmd(runner, dbPath, UPDATE_INCREMENTAL, _T(""), false, true, view) == OK);
+
+    unsigned time = (unsigned)std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - start).count();
+
+    flow._times.push_back(batched ? time + cUpdateDelay * 1000 : time);
+
+    flow._allocs += HeapAllocs - allocs;
+    flow._textAllocs += TextHeapAllocs - textAllocs;
+
+    // The DB is fresh if it has the last edit
+    char name[64];
+    snprintf(name, sizeof(name), "edit_%u_%u", saved.back(), n);
+
+    CText tag;
+    tag += name;
+
+    if (!success || RunCmd(runner, dbPath, AUTOCOMPLETE, tag.C_str(), false, true, view) != OK ||
+            !strstr(view.C_str(), name))
+        ++flow._failed;
+}
+
+
+/**
+ *  \brief
+ */
+unsigned percentile(const std::vector<unsigned>& sorted, unsigned pct)
+{
+    return sorted[(sorted.size() - 1) * pct / 100];
+}
+
+
+/**
+ *  \brief  Same fields as the plugin NppGTags_timings.json plus the project parameters
+ */
+bool writeJson(FILE* fp, const Options& opt, const Project& project, std::vector<Flow>& flows,
+        const std::vector<IndexStat>& indexes)
+{
+    fprintf(fp, "{\"project\":{\"files\":%u,\"symbols_per_file\":%u,\"refs_per_symbol\":%u,\"line_len\":%u,"
+            "\"seed\":%u,\"lines\":%u,\"bytes\":%llu},\n\"commands\":[",
+            opt._files, opt._symbols, opt._refs, opt._lineLen, opt._seed, project._lines, project._bytes);
+
+    for (unsigned i = 0; i < flows.size(); ++i)
+    {
+        std::vector<unsigned>& times = flows[i]._times;
+        if (times.empty())
+            continue;
+
+        std::sort(times.begin(), times.end());
+
+        unsigned long long total = 0;
+        for (unsigned t = 0; t < times.size(); ++t)
+            total += times[t];
+
+        fprintf(fp, "%s\n{\"cmd\":\"%s\",\"count\":%u,\"failed\":%u,\"avg_us\":%u,"
+                "\"p50_us\":%u,\"p90_us\":%u,\"p99_us\":%u,\"max_us\":%u,\"result_bytes\":%llu,"
+                "\"allocs\":%llu,\"text_allocs\":%llu}",
+                i ? "," : "", flows[i]._name, (unsigned)times.size(), flows[i]._failed,
+                (unsigned)(total / times.size()), percentile(times, 50), percentile(times, 90),
+                percentile(times, 99), times.back(), flows[i]._resultBytes / times.size(),
+                flows[i]._allocs / times.size(), flows[i]._textAllocs / times.size());
+    }
+
+    fprintf(fp, "\n],\n\"tag_index\":[");
+
+    for (unsigned i = 0; i < indexes.size(); ++i)
+        fprintf(fp, "%s\n{\"kind\":\"%s\",\"names\":%u,\"bytes\":%u,\"list_us\":%u,\"build_us\":%u}",
+                i ? "," : "", indexes[i]._kind, indexes[i]._names, indexes[i]._bytes, indexes[i]._listTime,
+                indexes[i]._buildTime);
+
+    fprintf(fp, "\n]}\n");
+
+    return (ferror(fp) == 0);
+}
+
+
+/**
+ *  \brief
+ */
+void runFlows(const Options& opt, const Project& project, const CPath& dbPath, std::vector<Flow>& flows)
+{
+    GlobalRunner runner;
+    Random rnd(opt._seed + 1);
+
+    flows.push_back(Flow("CREATE_DATABASE"));
+    timeCmd(runner, dbPath, CREATE_DATABASE, "", flows.back());
+
+    flows.push_back(Flow("UPDATE_SINGLE"));
+    for (unsigned n = 0; n < opt._iterations; ++n)
+    {
+        unsigned idx = rnd.Next(project._files.size());
+        touchFile(project, idx, n);
+        timeCmd(runner, dbPath, UPDATE_SINGLE, project._files[idx], flows.back());
+    }
+
+    flows.push_back(Flow("UPDATE_INCREMENTAL"));
+    for (unsigned n = 0; n < opt._iterations; ++n)
+    {
+        touchFile(project, rnd.Next(project._files.size()), opt._iterations + n);
+        timeCmd(runner, dbPath, UPDATE_INCREMENTAL, "", flows.back());
+    }
+
+    flows.push_back(Flow("SAVE_ALL_SINGLE"));
+    flows.push_back(Flow("SAVE_ALL_BATCHED"));
+    for (unsigned n = 0; n < opt._iterations; ++n)
+    {
+        const unsigned edit = 2 * opt._iterations + 2 * n;
+
+        timeSaveAll(runner, opt, project, dbPath, rnd, false, edit, flows[flows.size() - 2]);
+        timeSaveAll(runner, opt, project, dbPath, rnd, true, edit + 1, flows.back());
+    }
+
+    // Name lookups of random generated symbols, prefixes matching about a file worth of names
+    static const CmdId_t cLookups[] =
+    {
+        AUTOCOMPLETE, AUTOCOMPLETE_SYMBOL, AUTOCOMPLETE_REFERENCE, AUTOCOMPLETE_FILE, FIND_FILE,
+        FIND_DEFINITION, FIND_REFERENCE, FIND_SYMBOL, GREP
+    };
+    static const char* const cLookupNames[] =
+    {
+        "AUTOCOMPLETE", "AUTOCOMPLETE_SYMBOL", "AUTOCOMPLETE_REFERENCE", "AUTOCOMPLETE_FILE", "FIND_FILE",
+        "FIND_DEFINITION", "FIND_REFERENCE", "FIND_SYMBOL", "GREP"
+    };
+
+    for (unsigned i = 0; i < _countof(cLookups); ++i)
+    {
+        flows.push_back(Flow(cLookupNames[i]));
+
+        for (unsigned n = 0; n < opt._iterations; ++n)
+        {
+            unsigned file = rnd.Next(opt._files);
+            std::string tag;
+
+            switch (cLookups[i])
+            {
+                case AUTOCOMPLETE:
+                case AUTOCOMPLETE_REFERENCE:
+                    tag = symbolName(file, 0);
+                    tag.resize(tag.size() - 1);
+                    break;
+
+                case AUTOCOMPLETE_SYMBOL:
+                    tag = "shared";
+                    break;
+
+                case AUTOCOMPLETE_FILE:
+                case FIND_FILE:
+                    tag = project._files[file].substr(project._files[file].find('/') + 1, 8);
+                    break;
+
+                case FIND_SYMBOL:
+                case GREP:
+                    tag = "shared_counter";
+                    break;
+
+                default:
+                    tag = symbolName(file, rnd.Next(opt._symbols));
+                    break;
+            }
+
+            timeCmd(runner, dbPath, cLookups[i], tag, flows.back());
+        }
+    }
+}
+
+
+/**
+ *  \brief  Lists all names of each kind the way TagIndex does and builds the index from them
+ */
+void measureIndex(const CPath& dbPath, std::vector<IndexStat>& indexes)
+{
+    static const CmdId_t cListCmds[] = { AUTOCOMPLETE, AUTOCOMPLETE_REFERENCE, AUTOCOMPLETE_SYMBOL };
+    static const char* const cKindNames[] = { "definitions", "references", "symbols" };
+
+    GlobalRunner runner;
+
+    for (unsigned i = 0; i < _countof(cListCmds); ++i)
+    {
+        indexes.push_back(IndexStat(cKindNames[i]));
+
+        CTextA view;
+
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+        if (RunCmd(runner, dbPath, cListCmds[i], _T(""), false, true, view) != OK)
+            continue;
+
+        indexes.back()._listTime = (unsigned)std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::steady_clock::now() - start).count();
+
+        std::vector<char> names(view.C_str(), view.C_str() + view.Len());
+
+        start = std::chrono::steady_clock::now();
+
+        TagNames index(names);
+
+        indexes.back()._buildTime = (unsigned)std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::steady_clock::now() - start).count();
+        indexes.back()._names = index.Count();
+        indexes.back()._bytes = index.MemSize();
+    }
+}
+
+} // anonymous namespace
+
+
+/**
+ *  \brief  Counts the heap allocations of the whole process
+ */
+void* operator new(size_t size)
+{
+    InterlockedIncrement(&HeapAllocs);
+
+    void* ptr = malloc(size ? size : 1);
+    if (!ptr)
+        throw std::bad_alloc();
+
+    return ptr;
+}
+
+
+/**
+ *  \brief
+ */
+void operator delete(void* ptr) noexcept
+{
+    free(ptr);
+}
+
+
+/**
+ *  \brief
+ */
+int main(int argc, char* argv[])
+{
+    Options opt;
+    if (!parseArgs(argc, argv, opt))
+    {
+        fputs(cUsage, stderr);
+        return 2;
+    }
+
+    if (!opt._walk && !opt._generateOnly && system("gtags --version >/dev/null 2>&1"))
+    {
+        fprintf(stderr, "gtags not found in PATH - benchmark skipped\n");
+        return cSkipped;
+    }
+
+    Project project;
+
+    if (opt._dir)
+    {
+        if (mkdir(opt._dir, 0777) && errno != EEXIST)
+        {
+            fprintf(stderr, "Cannot create '%s'\n", opt._dir);
+            return 2;
+        }
+        project._root = opt._dir;
+    }
+    else
+    {
+        char dir[] = "/tmp/nppgtags-bench-XXXXXX";
+        if (!mkdtemp(dir))
+        {
+            fprintf(stderr, "Cannot create temp folder\n");
+            return 2;
+        }
+        project._root = dir;
+    }
+
+    if (project._root[project._root.size() - 1] != '/')
+        project._root += '/';
+
+    int ret = 0;
+
+    if (opt._walk)
+    {
+        WalkStat stat;
+        if (!runWalk(opt, project._root, stat))
+            ret = 1;
+
+        FILE* fp = opt._out ? fopen(opt._out, "w") : stdout;
+        if (!fp || !writeWalkJson(fp, stat))
+            ret = 2;
+        if (fp && fp != stdout)
+            fclose(fp);
+    }
+    else if (!generate(opt, project))
+    {
+        fprintf(stderr, "Generating the project in '%s' failed\n", project._root.c_str());
+        ret = 2;
+    }
+    else if (opt._generateOnly)
+    {
+        printf("%u files, %u symbols, %u lines, %llu bytes in '%s'\n", (unsigned)project._files.size(),
+                opt._files * opt._symbols, project._lines, project._bytes, project._root.c_str());
+    }
+    else
+    {
+        CPath dbPath;
+        DbPathFromArg(project._root.c_str(), dbPath);
+
+        std::vector<Flow> flows;
+        runFlows(opt, project, dbPath, flows);
+
+        std::vector<IndexStat> indexes;
+        measureIndex(dbPath, indexes);
+
+        FILE* fp = opt._out ? fopen(opt._out, "w") : stdout;
+        if (!fp || !writeJson(fp, opt, project, flows, indexes))
+            ret = 2;
+        if (fp && fp != stdout)
+            fclose(fp);
+
+        for (unsigned i = 0; i < flows.size(); ++i)
+            if (flows[i]._failed)
+                ret = 1;
+    }
+
+    if (!opt._keep)
+        nftw(project._root.c_str(), removeEntry, 16, FTW_DEPTH | FTW_PHYS);
+
+    return ret;
+}
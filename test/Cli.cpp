@@ -0,0 +1,378 @@
+/**
+ *  \file
+ *  \brief  Headless command line driver of the plugin core
+ *
+ *  \author  Pavel Nedev <pg.nedev@gmail.com>
+ *
+ *  \section COPYRIGHT
+ *  Copyright(C) 2015 Pavel Nedev
+ *
+ *  \section LICENSE
+ *  This program is free software; you can redistribute it and/or modify it
+ *  under the terms of the GNU General Public License version 2 as published
+ *  by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful, but
+ *  WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ *  or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ *  for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <memory>
+#include "DbManager.h"
+#include "PathTable.h"
+#include "Headless.h"
+
+
+namespace
+{
+
+using namespace GTags;
+
+
+const char cUsage[] =
+    "Usage:\n"
+    "  nppgtags-cli <command> [<tag>] --db <path> [--icase] [--regexp] [--stub <dir>]\n"
+    "  nppgtags-cli replay <file> --db <path> [--threads <n>] [--repeat <n>] [--stub <dir>]\n"
+    "\n"
+    "Commands: create, update, update-single, complete, complete-symbol, complete-ref,\n"
+    "  complete-file, find-file, find-def, find-ref, find-symbol, list-defs, list-refs, grep, version\n"
+    "\n"
+    "--stub <dir> replays the recorded global output <dir>/<command>.out instead of running global.\n"
+    "Replay file lines are '<command> [<tag>]' - all of them are run <repeat> times by <threads>\n"
+    "threads at once, then the throughput, latencies and DB lock contention are printed.\n";
+
+
+/**
+ *  \struct  Options
+ *  \brief
+ */
+struct Options
+{
+    Options() : _db(NULL), _stub(NULL), _matchCase(true), _regExp(false), _threads(4), _repeat(1) {}
+
+    std::vector<const char*>    _args;
+    const char*                 _db;
+    const char*                 _stub;
+    bool                        _matchCase;
+    bool                        _regExp;
+    unsigned                    _threads;
+    unsigned                    _repeat;
+};
+
+
+/**
+ *  \struct  Job
+ *  \brief  Replayed command
+ */
+struct Job
+{
+    CmdId_t _id;
+    CText   _tag;
+};
+
+
+/**
+ *  \struct  Replay
+ *  \brief  State shared by the replay threads
+ */
+struct Replay
+{
+    Replay(CmdRunner& runner, const CPath& dbPath, const std::vector<Job>& jobs, unsigned total) :
+        _runner(runner), _dbPath(dbPath), _jobs(jobs), _total(total), _next(0), _busy(0), _failed(0) {}
+
+    CmdRunner&              _runner;
+    const CPath&            _dbPath;
+    const std::vector<Job>& _jobs;
+    const unsigned          _total;
+
+    std::atomic<unsigned>   _next;
+    std::atomic<unsigned>   _busy;
+    std::atomic<unsigned>   _failed;
+
+    // Each thread fills its own latencies (microseconds)
+    std::vector<std::vector<unsigned>> _times;
+};
+
+
+/**
+ *  \brief
+ */
+bool parseArgs(int argc, char* argv[], Options& opt)
+{
+    for (int i = 1; i < argc; ++i)
+    {
+        if (!strcmp(argv[i], "--icase"))
+        {
+            opt._matchCase = false;
+        }
+        else if (!strcmp(argv[i], "--regexp"))
+        {
+            opt._regExp = true;
+        }
+        else if (!strncmp(argv[i], "--", 2))
+        {
+            if (i + 1 >= argc)
+                return false;
+
+            const char* val = argv[++i];
+
+            if (!strcmp(argv[i - 1], "--db"))
+                opt._db = val;
+            else if (!strcmp(argv[i - 1], "--stub"))
+                opt._stub = val;
+            else if (!strcmp(argv[i - 1], "--threads"))
+                opt._threads = std::max(1, atoi(val));
+            else if (!strcmp(argv[i - 1], "--repeat"))
+                opt._repeat = std::max(1, atoi(val));
+            else
+                return false;
+        }
+        else
+        {
+            opt._args.push_back(argv[i]);
+        }
+    }
+
+    return !opt._args.empty();
+}
+
+
+/**
+ *  \brief
+ */
+void printText(const CText& text)
+{
+    CTextA out;
+    out += text.C_str();
+    fputs(out.C_str(), stdout);
+}
+
+
+/**
+ *  \brief
+ */
+int exitCode(CmdStatus_t status)
+{
+    switch (status)
+    {
+        case OK:        return 0;
+        case FAILED:    return 1;
+        case RUN_ERROR: return 2;
+        default:        return 3;
+    }
+}
+
+
+/**
+ *  \brief
+ */
+int runSingle(CmdRunner& runner, const CPath& dbPath, const Options& opt)
+{
+    const CmdInfo* info = FindCmdInfo(opt._args[0]);
+
+    CText tag;
+    if (opt._args.size() > 1)
+        tag += opt._args[1];
+
+    CTextA view;
+    CmdStatus_t status = RunCmd(runner, dbPath, info->_id, tag.C_str(), opt._regExp, opt._matchCase, view);
+
+    if (status == CANCELLED)
+        fprintf(stderr, "Database is busy\n");
+    else if (status == RUN_ERROR && view.IsEmpty())
+        fprintf(stderr, "Running GTags failed\n");
+    else if (!view.IsEmpty())
+        printf("%s\n", view.C_str());
+
+    return exitCode(status);
+}
+
+
+/**
+ *  \brief
+ */
+bool readReplay(const char* file, std::vector<Job>& jobs)
+{
+    FILE* fp = fopen(file, "r");
+    if (!fp)
+        return false;
+
+    char line[4096];
+    bool success = true;
+
+    while (success && fgets(line, sizeof(line), fp))
+    {
+        line[strcspn(line, "\r\n")] = 0;
+        if (line[0] == 0 || line[0] == '#')
+            continue;
+
+        char* tag = strchr(line, ' ');
+        if (tag)
+            *tag++ = 0;
+
+        const CmdInfo* info = FindCmdInfo(line);
+        if (!info)
+        {
+            fprintf(stderr, "Unknown command '%s' in '%s'\n", line, file);
+            success = false;
+            break;
+        }
+
+        Job job;
+        job._id = info->_id;
+        if (tag)
+            job._tag += tag;
+
+        jobs.push_back(job);
+    }
+
+    fclose(fp);
+
+    return success && !jobs.empty();
+}
+
+
+/**
+ *  \brief  Replay thread - takes the next command until all are run
+ */
+void replayWorker(Replay* replay, unsigned idx)
+{
+    for (;;)
+    {
+        unsigned n = replay->_next.fetch_add(1);
+        if (n >= replay->_total)
+            break;
+
+        const Job& job = replay->_jobs[n % replay->_jobs.size()];
+
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+        CTextA view;
+        CmdStatus_t status = RunCmd(replay->_runner, replay->_dbPath, job._id, job._tag.C_str(), false, true, view);
+
+        replay->_times[idx].push_back((unsigned)std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::steady_clock::now() - start).count());
+
+        if (status == CANCELLED)
+            ++replay->_busy;
+        else if (status != OK)
+            ++replay->_failed;
+    }
+}
+
+
+/**
+ *  \brief
+ */
+int runReplay(CmdRunner& runner, const CPath& dbPath, const Options& opt)
+{
+    if (opt._args.size() < 2)
+    {
+        fputs(cUsage, stderr);
+        return 2;
+    }
+
+    std::vector<Job> jobs;
+    if (!readReplay(opt._args[1], jobs))
+    {
+        fprintf(stderr, "No commands read from '%s'\n", opt._args[1]);
+        return 2;
+    }
+
+    Replay replay(runner, dbPath, jobs, jobs.size() * opt._repeat);
+    replay._times.resize(opt._threads);
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    std::vector<std::thread> threads;
+    for (unsigned i = 0; i < opt._threads; ++i)
+        threads.push_back(std::thread(replayWorker, &replay, i));
+    for (unsigned i = 0; i < threads.size(); ++i)
+        threads[i].join();
+
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::vector<unsigned> times;
+    for (unsigned i = 0; i < replay._times.size(); ++i)
+        times.insert(times.end(), replay._times[i].begin(), replay._times[i].end());
+    std::sort(times.begin(), times.end());
+
+    printf("%u commands, %u threads, %.3f s, %.0f commands/s\n", replay._total, opt._threads, elapsed,
+            elapsed > 0 ? replay._total / elapsed : 0.0);
+    printf("latency us: p50 %u, p95 %u, max %u\n", times[times.size() / 2], times[times.size() * 95 / 100],
+            times.back());
+    printf("%u DB busy, %u failed\n", replay._busy.load(), replay._failed.load());
+
+    CText stats;
+    DbManager::Get().GetStats(stats);
+    if (!stats.IsEmpty())
+    {
+        printf("Database lookup cache:\n");
+        printText(stats);
+    }
+
+    stats.Clear();
+    PathTable::Get().GetStats(stats);
+    if (!stats.IsEmpty())
+    {
+        printf("Interned paths:\n");
+        printText(stats);
+    }
+
+    return replay._failed ? 1 : 0;
+}
+
+} // anonymous namespace
+
+
+/**
+ *  \brief
+ */
+int main(int argc, char* argv[])
+{
+    Options opt;
+    if (!parseArgs(argc, argv, opt))
+    {
+        fputs(cUsage, stderr);
+        return 2;
+    }
+
+    if (strcmp(opt._args[0], "replay") && !FindCmdInfo(opt._args[0]))
+    {
+        fprintf(stderr, "Unknown command '%s'\n\n%s", opt._args[0], cUsage);
+        return 2;
+    }
+
+    CPath dbPath;
+    if (strcmp(opt._args[0], "version") && (!opt._db || !DbPathFromArg(opt._db, dbPath)))
+    {
+        fprintf(stderr, "Database folder not given or not found\n\n%s", cUsage);
+        return 2;
+    }
+
+    std::unique_ptr<CmdRunner> runner;
+    if (opt._stub)
+        runner.reset(new StubRunner(opt._stub));
+    else
+        runner.reset(new GlobalRunner);
+
+    if (!strcmp(opt._args[0], "replay"))
+        return runReplay(*runner, dbPath, opt);
+
+    return runSingle(*runner, dbPath, opt);
+}
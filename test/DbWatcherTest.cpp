@@ -0,0 +1,277 @@
+/**
+ *  \file
+ *  \brief  DbWatcher test - the changes made to a watched folder tree end up in batched DB updates
+ *
+ *  \author  Pavel Nedev <pg.nedev@gmail.com>
+ *
+ *  \section COPYRIGHT
+ *  Copyright(C) 2015 Pavel Nedev
+ *
+ *  \section LICENSE
+ *  This program is free software; you can redistribute it and/or modify it
+ *  under the terms of the GNU General Public License version 2 as published
+ *  by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful, but
+ *  WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ *  or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ *  for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <ftw.h>
+#include <sys/stat.h>
+#include <string>
+#include <vector>
+#include "Headless.h"
+#include "EngineStub.h"
+#include "AutoLock.h"
+#include "DbWatcher.h"
+
+
+namespace
+{
+
+using namespace GTags;
+
+
+// Wait for the first update that long at most
+const unsigned cUpdateTimeout   = 10000;
+// No more updates expected after that long - more than the watcher quiet time
+const unsigned cSettleTime      = 1500;
+
+
+/**
+ *  \struct  Updates
+ *  \brief  DB updates requested by the watcher thread
+ */
+struct Updates
+{
+    Updates() : _fullUpdates(0) {}
+
+    Mutex                   _lock;
+    std::vector<unsigned>   _batches;
+    unsigned                _fullUpdates;
+};
+
+
+Updates Requested;
+
+
+/**
+ *  \brief
+ */
+int removeEntry(const char* path, const struct stat*, int, struct FTW*)
+{
+    return remove(path);
+}
+
+
+/**
+ *  \brief
+ */
+bool check(bool ok, const char* what)
+{
+    printf("%s: %s\n", ok ? "PASS" : "FAIL", what);
+    return ok;
+}
+
+
+/**
+ *  \brief
+ */
+bool writeFile(const std::string& path)
+{
+    FILE* fp = fopen(path.c_str(), "w");
+    if (!fp)
+        return false;
+
+    fprintf(fp, "int %s;\n", strrchr(path.c_str(), '/') + 1);
+    fclose(fp);
+
+    return true;
+}
+
+
+/**
+ *  \brief  Waits for the first update and then for the watcher to calm down - returns the updates
+ *          requested meanwhile
+ */
+void collect(std::vector<unsigned>& batches, unsigned& fullUpdates, bool expectUpdate = true)
+{
+    for (unsigned waited = 0; expectUpdate && waited < cUpdateTimeout; waited += 10)
+    {
+        {
+            AUTOLOCK(Requested._lock);
+            if (!Requested._batches.empty() || Requested._fullUpdates)
+                break;
+        }
+
+        usleep(10 * 1000);
+    }
+
+    usleep(cSettleTime * 1000);
+
+    AUTOLOCK(Requested._lock);
+
+    batches.swap(Requested._batches);
+    Requested._batches.clear();
+    fullUpdates = Requested._fullUpdates;
+    Requested._fullUpdates = 0;
+}
+
+
+/**
+ *  \brief  The watcher thread sets the watch up on its own - waits until a written file is reported
+ */
+bool waitWatched(const std::string& dir)
+{
+    bool watched = false;
+
+    for (unsigned waited = 0; !watched && waited < cUpdateTimeout; waited += cSettleTime)
+    {
+        writeFile(dir + "/probe.c");
+        usleep(cSettleTime * 1000);
+
+        AUTOLOCK(Requested._lock);
+        watched = !Requested._batches.empty();
+    }
+
+    std::vector<unsigned> batches;
+    unsigned fullUpdates;
+    collect(batches, fullUpdates, false);
+
+    return check(watched, "the folder is watched");
+}
+
+
+/**
+ *  \brief  Files written in quick succession are updated in one batch
+ */
+bool testBatch(const std::string& dir)
+{
+    bool ok = true;
+
+    for (unsigned i = 0; i < 5; ++i)
+        ok &= writeFile(dir + "/batch" + std::to_string(i) + ".c");
+
+    std::vector<unsigned> batches;
+    unsigned fullUpdates;
+    collect(batches, fullUpdates);
+
+    ok &= check(batches.size() == 1 && batches[0] == 5 && !fullUpdates,
+            "5 files written together are updated in one batch");
+
+    return ok;
+}
+
+
+/**
+ *  \brief  Not indexed files, DB files and VCS metadata don't trigger updates
+ */
+bool testIgnored(const std::string& dir)
+{
+    bool ok = writeFile(dir + "/notes.txt");
+    ok &= writeFile(dir + "/GTAGS");
+    ok &= !mkdir((dir + "/.git").c_str(), 0755);
+    ok &= writeFile(dir + "/.git/hook.c");
+
+    std::vector<unsigned> batches;
+    unsigned fullUpdates;
+    collect(batches, fullUpdates, false);
+
+    ok &= check(batches.empty() && !fullUpdates, "not indexed, DB and VCS files are ignored");
+
+    // The watcher is still there
+    ok &= writeFile(dir + "/after.c");
+    collect(batches, fullUpdates);
+
+    ok &= check(batches.size() == 1 && batches[0] == 1 && !fullUpdates,
+            "an indexed file written after the ignored ones is updated alone");
+
+    return ok;
+}
+
+
+/**
+ *  \brief  Too many changed files result in one update of the whole DB instead
+ */
+bool testBackpressure(const std::string& dir)
+{
+    bool ok = !mkdir((dir + "/many").c_str(), 0755);
+
+    // Let the folder creation settle first - a non-empty new folder is a full update on its own
+    usleep(cSettleTime * 1000);
+
+    for (unsigned i = 0; ok && i < 10000; ++i)
+        ok &= writeFile(dir + "/many/file" + std::to_string(i) + ".c");
+
+    ok &= check(ok, "10000 files written");
+
+    std::vector<unsigned> batches;
+    unsigned fullUpdates;
+    collect(batches, fullUpdates);
+
+    ok &= check(batches.empty() && fullUpdates == 1, "10000 changed files make one full DB update");
+
+    return ok;
+}
+
+} // anonymous namespace
+
+
+namespace GTags
+{
+
+/**
+ *  \brief  Records the batch instead of updating the DB
+ */
+void UpdateFiles(const std::vector<CPath>& files)
+{
+    AUTOLOCK(Requested._lock);
+    Requested._batches.push_back(files.size());
+}
+
+
+/**
+ *  \brief  Records the full update instead of updating the DB
+ */
+void UpdateDatabase(const CPath&)
+{
+    AUTOLOCK(Requested._lock);
+    ++Requested._fullUpdates;
+}
+
+} // namespace GTags
+
+
+int main()
+{
+    char dir[] = "/tmp/nppgtags-watcher-XXXXXX";
+    if (!mkdtemp(dir))
+        return check(false, "temp DB folder created") ? 0 : 1;
+
+    CPath dbPath(dir);
+    dbPath += _T("/");
+
+    DbWatcher::Get().Watch(dbPath);
+
+    bool ok = waitWatched(dir);
+    ok &= testBatch(dir);
+    ok &= testIgnored(dir);
+    ok &= testBackpressure(dir);
+
+    DbWatcher::Get().UnwatchAll();
+
+    nftw(dir, removeEntry, 16, FTW_DEPTH | FTW_PHYS);
+
+    return ok ? 0 : 1;
+}
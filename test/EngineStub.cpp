@@ -0,0 +1,80 @@
+/**
+ *  \file
+ *  \brief  Test build of the command engine
+ *
+ *  \author  Pavel Nedev <pg.nedev@gmail.com>
+ *
+ *  \section COPYRIGHT
+ *  Copyright(C) 2015 Pavel Nedev
+ *
+ *  \section LICENSE
+ *  This program is free software; you can redistribute it and/or modify it
+ *  under the terms of the GNU General Public License version 2 as published
+ *  by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful, but
+ *  WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ *  or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ *  for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+
+#include "GTags.h"
+#include "CmdEngine.h"
+#include "EngineStub.h"
+
+
+namespace
+{
+
+GTags::CmdRunner* Runner = NULL;
+
+} // anonymous namespace
+
+
+namespace GTags
+{
+
+/**
+ *  \brief  Sets the runner the commands of the plugin parts under test are run with
+ */
+void SetEngineRunner(CmdRunner* runner)
+{
+    Runner = runner;
+}
+
+
+/**
+ *  \brief  Runs the command synchronously - the completion callback is called before returning
+ */
+bool CmdEngine::Run(const std::shared_ptr<Cmd>& cmd, CompletionCB complCB)
+{
+    cmd->Status(RUN_ERROR);
+
+    if (Runner)
+        Runner->Run(*cmd);
+
+    if (complCB)
+    {
+        complCB(cmd);
+        return true;
+    }
+
+    return (cmd->Status() == OK);
+}
+
+
+/**
+ *  \brief  No scheduled DB updates in the tests
+ */
+bool RunSheduledUpdate(const TCHAR*)
+{
+    return false;
+}
+
+} // namespace GTags
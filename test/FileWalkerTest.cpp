@@ -0,0 +1,279 @@
+/**
+ *  \file
+ *  \brief  FileWalker unit test - the ignore rules and the walked files list
+ *
+ *  \author  Pavel Nedev <pg.nedev@gmail.com>
+ *
+ *  \section COPYRIGHT
+ *  Copyright(C) 2015 Pavel Nedev
+ *
+ *  \section LICENSE
+ *  This program is free software; you can redistribute it and/or modify it
+ *  under the terms of the GNU General Public License version 2 as published
+ *  by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful, but
+ *  WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ *  or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ *  for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <ftw.h>
+#include <sys/stat.h>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include "Common.h"
+#include "Config.h"
+#include "GTags.h"
+#include "FileWalker.h"
+
+
+namespace
+{
+
+using namespace GTags;
+
+
+const char* const cDirs[] = {
+    "src", "src/gen", "gen", "build", "src/build", "docs", "docs/a", "docs/a/b", "out", "logs", ".git",
+    "GTAGS.1234", "Vendor", "Vendor/lib"
+};
+
+// Files with the ones the walker shall list marked
+const struct
+{
+    const char* _path;
+    bool        _listed;
+} cFiles[] = {
+    { "main.c",             true    },
+    { "top.c",              false   },  // /top.c - anchored to the root
+    { "src/top.c",          true    },
+    { "src/a.c",            true    },
+    { "src/a.o",            false   },  // *.o
+    { "src/keep.o",         true    },  // !keep.o
+    { "src/local.o",        true    },  // src/.gitignore !local.o overrides the root *.o
+    { "src/skip.c",         false   },  // src/.ignore
+    { "src/gen/g.c",        false   },  // **/gen/*.c
+    { "src/gen/g.h",        true    },
+    { "gen/h.c",            false   },  // **/ matches no folder too
+    { "build/x.c",          false   },  // build/ - folder only
+    { "src/build/y.c",      false   },
+    { "src/out",            true    },  // out/ - folder only, this is a file
+    { "out/z.c",            false   },
+    { "docs/x.md",          false   },  // docs/**/*.md
+    { "docs/a/b/c.md",      false   },
+    { "docs/a/b/c.txt",     true    },
+    { "README.md",          true    },
+    { "logs/today.c",       false   },  // logs - names folders too
+    { "Vendor/lib/v.c",     false   },  // plugin exclude list VENDOR/ - case-insensitive
+    { ".git/config.c",      false   },  // VCS metadata
+    { "GTAGS.1234/s.c",     false   },  // DB snapshot
+    { "Notes[1].c",         true    },
+    { "Notes1.c",           false   },  // Notes[0-9].c
+};
+
+const char cRootIgnore[] =
+    "# comment\n"
+    "*.o\n"
+    "!keep.o\n"
+    "/top.c\n"
+    "build/\n"
+    "out/   \n"
+    "**/gen/*.c\n"
+    "docs/**/*.md\n"
+    "logs\n"
+    "Notes[0-9].c\n"
+    "\\#not-a-comment\n";
+
+
+/**
+ *  \brief
+ */
+int removeEntry(const char* path, const struct stat*, int, struct FTW*)
+{
+    return remove(path);
+}
+
+
+/**
+ *  \brief
+ */
+bool check(bool ok, const char* what)
+{
+    printf("%s: %s\n", ok ? "PASS" : "FAIL", what);
+    return ok;
+}
+
+
+/**
+ *  \brief
+ */
+bool writeFile(const std::string& path, const char* text)
+{
+    FILE* fp = fopen(path.c_str(), "wb");
+    if (!fp)
+        return false;
+
+    fputs(text, fp);
+    fclose(fp);
+
+    return true;
+}
+
+
+/**
+ *  \brief
+ */
+bool createTree(const std::string& root)
+{
+    for (unsigned i = 0; i < _countof(cDirs); ++i)
+        if (mkdir((root + cDirs[i]).c_str(), 0777))
+            return false;
+
+    bool ok = writeFile(root + ".gitignore", cRootIgnore);
+    ok = ok && writeFile(root + "src/.gitignore", "!local.o\n");
+    ok = ok && writeFile(root + "src/.ignore", "skip.c\n");
+
+    for (unsigned i = 0; ok && i < _countof(cFiles); ++i)
+        ok = writeFile(root + cFiles[i]._path, "int x;\n");
+
+    return ok;
+}
+
+
+/**
+ *  \brief  Reads the list file written by the walker - sorted paths without the "./" prefix
+ */
+bool readList(const CPath& listFile, std::vector<std::string>& paths)
+{
+    CTextA name(listFile.C_str());
+
+    FILE* fp = fopen(name.C_str(), "rb");
+    if (!fp)
+        return false;
+
+    char line[1024];
+    while (fgets(line, sizeof(line), fp))
+    {
+        line[strcspn(line, "\n")] = 0;
+        paths.push_back(strncmp(line, "./", 2) ? line : line + 2);
+    }
+
+    fclose(fp);
+    unlink(name.C_str());
+
+    std::sort(paths.begin(), paths.end());
+
+    return true;
+}
+
+
+/**
+ *  \brief
+ */
+bool isExcluded(const std::string& root, const char* path)
+{
+    CPath dbPath(root.c_str());
+    CPath file(dbPath);
+    file += CText(path).C_str();
+
+    return FileWalker::Get().IsExcluded(dbPath, file);
+}
+
+
+/**
+ *  \brief  The gitignore rules - '**', negation, folder only and anchored patterns, deeper ignore files
+ *          taking precedence, the plugin exclude list and the skipped folders
+ */
+bool testRules(const std::string& root)
+{
+    bool ok = true;
+
+    for (unsigned i = 0; i < _countof(cFiles); ++i)
+    {
+        std::string what(cFiles[i]._path);
+        what += cFiles[i]._listed ? " is not excluded" : " is excluded";
+
+        ok &= check(isExcluded(root, cFiles[i]._path) != cFiles[i]._listed, what.c_str());
+    }
+
+    ok &= check(isExcluded(root, "#not-a-comment") && !isExcluded(root, "comment"),
+            "escaped '#' is a pattern, unescaped is a comment");
+    ok &= check(isExcluded(root, "build/removed.c") && !isExcluded(root, "removed/build"),
+            "removed files under excluded folders are excluded");
+
+    return ok;
+}
+
+
+/**
+ *  \brief  The walk lists exactly the not excluded files - twice, the second time from the listings cache
+ */
+bool testWalk(const std::string& root)
+{
+    std::vector<std::string> expected;
+    for (unsigned i = 0; i < _countof(cFiles); ++i)
+        if (cFiles[i]._listed)
+            expected.push_back(cFiles[i]._path);
+    expected.push_back(".gitignore");
+    expected.push_back("src/.gitignore");
+    expected.push_back("src/.ignore");
+    std::sort(expected.begin(), expected.end());
+
+    bool ok = true;
+
+    for (unsigned pass = 0; pass < 2; ++pass)
+    {
+        CPath listFile;
+        std::vector<std::string> paths;
+
+        ok &= check(FileWalker::Get().Walk(CPath(root.c_str()), listFile) && readList(listFile, paths),
+                "walk list written");
+
+        bool same = (paths == expected);
+        if (!same)
+            for (unsigned i = 0; i < paths.size(); ++i)
+                printf("\t%s\n", paths[i].c_str());
+
+        ok &= check(same, pass ? "cached walk lists the same files" : "walk lists the not excluded files");
+    }
+
+    CText stats;
+    FileWalker::Get().GetStats(stats);
+
+    ok &= check(_tcsstr(stats.C_str(), _T(" from cache")) != NULL, "second walk uses the cached listings");
+
+    return ok;
+}
+
+} // anonymous namespace
+
+
+int main()
+{
+    char dir[] = "/tmp/nppgtags-walker-XXXXXX";
+    if (!mkdtemp(dir))
+        return check(false, "temp DB folder created") ? 0 : 1;
+
+    std::string root(dir);
+    root += "/";
+
+    Config._excludeList = _T("VENDOR/;*.tmp");
+
+    bool ok = check(createTree(root), "project tree created");
+    ok = ok && testRules(root);
+    ok = ok && testWalk(root);
+
+    nftw(dir, removeEntry, 16, FTW_DEPTH | FTW_PHYS);
+
+    return ok ? 0 : 1;
+}
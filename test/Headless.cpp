@@ -0,0 +1,422 @@
+/**
+ *  \file
+ *  \brief  Headless plugin core front end - runs the plugin commands without the UI
+ *
+ *  \author  Pavel Nedev <pg.nedev@gmail.com>
+ *
+ *  \section COPYRIGHT
+ *  Copyright(C) 2015 Pavel Nedev
+ *
+ *  \section LICENSE
+ *  This program is free software; you can redistribute it and/or modify it
+ *  under the terms of the GNU General Public License version 2 as published
+ *  by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful, but
+ *  WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ *  or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ *  for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include "DbManager.h"
+#include "ResultModel.h"
+#include "Headless.h"
+
+
+namespace
+{
+
+using namespace GTags;
+
+
+const CmdInfo CmdInfos[] =
+{
+    { "create",             CREATE_DATABASE,        _T("Create Database") },
+    { "update-single",      UPDATE_SINGLE,          _T("Database Single File Update") },
+    { "update",             UPDATE_INCREMENTAL,     _T("Database Incremental Update") },
+    { "complete",           AUTOCOMPLETE,           _T("AutoComplete") },
+    { "complete-symbol",    AUTOCOMPLETE_SYMBOL,    _T("AutoComplete") },
+    { "complete-ref",       AUTOCOMPLETE_REFERENCE, _T("AutoComplete") },
+    { "complete-file",      AUTOCOMPLETE_FILE,      _T("AutoComplete Filename") },
+    { "find-file",          FIND_FILE,              _T("Find File") },
+    { "find-def",           FIND_DEFINITION,        _T("Find Definition") },
+    { "find-ref",           FIND_REFERENCE,         _T("Find Reference") },
+    { "find-symbol",        FIND_SYMBOL,            _T("Find Symbol") },
+    { "list-defs",          LIST_DEFINITIONS,       _T("List Definitions") },
+    { "list-refs",          LIST_REFERENCES,        _T("List References") },
+    { "grep",               GREP,                   _T("Search") },
+    { "version",            VERSION,                _T("About") }
+};
+
+
+/**
+ *  \brief
+ */
+void stripTrailingSlash(CPath& dir)
+{
+    unsigned len = dir.Len();
+    if (len && (dir.C_str()[len - 1] == _T('/') || dir.C_str()[len - 1] == _T('\\')))
+        dir.Resize(len - 1);
+}
+
+
+/**
+ *  \brief
+ */
+void readAll(FILE* fp, std::vector<char>& buf)
+{
+    char chunk[16 * 1024];
+    size_t n;
+
+    while ((n = fread(chunk, 1, sizeof(chunk), fp)) > 0)
+        buf.insert(buf.end(), chunk, chunk + n);
+}
+
+} // anonymous namespace
+
+
+namespace GTags
+{
+
+/**
+ *  \brief
+ */
+const CmdInfo* FindCmdInfo(const char* name)
+{
+    for (unsigned i = 0; i < _countof(CmdInfos); ++i)
+        if (!strcmp(CmdInfos[i]._name, name))
+            return &CmdInfos[i];
+
+    return NULL;
+}
+
+
+/**
+ *  \brief
+ */
+const CmdInfo* FindCmdInfo(CmdId_t id)
+{
+    for (unsigned i = 0; i < _countof(CmdInfos); ++i)
+        if (CmdInfos[i]._id == id)
+            return &CmdInfos[i];
+
+    return NULL;
+}
+
+
+/**
+ *  \brief
+ */
+void GlobalRunner::Run(Cmd& cmd)
+{
+    const CmdId_t id = cmd.Id();
+    const bool update = (id == UPDATE_SINGLE || id == UPDATE_INCREMENTAL);
+
+    std::string line;
+    CPath snapshotDir;
+
+    if (id != VERSION)
+    {
+        line = "cd ";
+        quote(line, cmd.DbPath());
+        line += " && ";
+    }
+
+    // The update is written to a DB snapshot so readers are not blocked meanwhile
+    if (update && !DbManager::Get().BeginUpdate(cmd.Db(), snapshotDir))
+    {
+        cmd.Status(RUN_ERROR);
+        return;
+    }
+
+    if (id == AUTOCOMPLETE || id == FIND_DEFINITION)
+        line += "GTAGSLIBPATH= ";
+
+    // Reader is pinned to a DB snapshot that is not moved to the DB folder yet
+    if (!update && id != CREATE_DATABASE && id != VERSION &&
+            DbManager::Get().GetSnapshotDir(cmd.Db(), snapshotDir))
+    {
+        CPath root(cmd.DbPath());
+        stripTrailingSlash(root);
+        stripTrailingSlash(snapshotDir);
+
+        line += "GTAGSROOT=";
+        quote(line, root.C_str());
+        line += " GTAGSDBPATH=";
+        quote(line, snapshotDir.C_str());
+        line += " ";
+    }
+
+    composeCmd(cmd, line);
+
+    if (update)
+    {
+        stripTrailingSlash(snapshotDir);
+        line += " ";
+        quote(line, snapshotDir.C_str());
+    }
+
+    char errFile[] = "/tmp/nppgtags-err-XXXXXX";
+    int errFd = mkstemp(errFile);
+    if (errFd < 0)
+    {
+        if (update)
+            DbManager::Get().EndUpdate(cmd.Db(), false);
+        cmd.Status(RUN_ERROR);
+        return;
+    }
+    close(errFd);
+
+    line += " 2>";
+    line += errFile;
+
+    std::vector<char> output;
+    std::vector<char> errors;
+    int exitCode = 127;
+
+    FILE* pipe = popen(line.c_str(), "r");
+    if (pipe)
+    {
+        readAll(pipe, output);
+
+        int status = pclose(pipe);
+        if (status != -1 && WIFEXITED(status))
+            exitCode = WEXITSTATUS(status);
+    }
+
+    FILE* fp = fopen(errFile, "rb");
+    if (fp)
+    {
+        readAll(fp, errors);
+        fclose(fp);
+    }
+    unlink(errFile);
+
+    // Shell didn't find the program
+    if (exitCode == 127)
+    {
+        if (update)
+            DbManager::Get().EndUpdate(cmd.Db(), false);
+        cmd.Status(RUN_ERROR);
+        return;
+    }
+
+    CmdStatus_t status = OK;
+
+    if (!output.empty())
+    {
+        output.push_back(0);
+        cmd.AppendResult(output);
+    }
+    else if (!errors.empty())
+    {
+        errors.push_back(0);
+        cmd.SetResult(errors);
+
+        if (id != CREATE_DATABASE)
+            status = FAILED;
+    }
+
+    if (update)
+        DbManager::Get().EndUpdate(cmd.Db(), status == OK);
+
+    cmd.Status(status);
+}
+
+
+/**
+ *  \brief  Same arguments as the CmdEngine command lines
+ */
+void GlobalRunner::composeCmd(const Cmd& cmd, std::string& line)
+{
+    switch (cmd.Id())
+    {
+        case CREATE_DATABASE:       line += "gtags -c --skip-unreadable"; break;
+        case UPDATE_SINGLE:         line += "gtags -c --skip-unreadable --single-update "; break;
+        case UPDATE_INCREMENTAL:    line += "gtags -c --skip-unreadable -i"; break;
+        case AUTOCOMPLETE:          line += "global -cT "; break;
+        case AUTOCOMPLETE_SYMBOL:   line += "global -cs "; break;
+        case AUTOCOMPLETE_REFERENCE: line += "global -cr "; break;
+        case AUTOCOMPLETE_FILE:     line += "global -cP --match-part=all "; break;
+        case FIND_FILE:
+        case FIND_SIBLING:          line += "global -P "; break;
+        case FIND_DEFINITION:       line += "global -dT --result=grep "; break;
+        case FIND_REFERENCE:        line += "global -r --result=grep "; break;
+        case FIND_SYMBOL:           line += "global -s --result=grep "; break;
+        case LIST_DEFINITIONS:      line += "global -d --result=ctags "; break;
+        case LIST_REFERENCES:       line += "global -r --result=ctags "; break;
+        case GREP:                  line += "global -g --result=grep "; break;
+        case VERSION:               line += "global --version"; break;
+    }
+
+    if (cmd.Id() == CREATE_DATABASE || cmd.Id() == UPDATE_INCREMENTAL || cmd.Id() == VERSION)
+        return;
+
+    quote(line, cmd.Tag());
+
+    if (cmd.Id() == UPDATE_SINGLE)
+        return;
+
+    line += cmd.MatchCase() ? " -M" : " -i";
+
+    if (!cmd.RegExp())
+        line += " --literal";
+}
+
+
+/**
+ *  \brief  Appends the argument single-quoted for the shell
+ */
+void GlobalRunner::quote(std::string& line, const TCHAR* arg)
+{
+    CTextA str;
+    str += arg;
+
+    line += '\'';
+
+    for (const char* c = str.C_str(); *c; ++c)
+    {
+        if (*c == '\'')
+            line += "'\\''";
+        else
+            line += *c;
+    }
+
+    line += '\'';
+}
+
+
+/**
+ *  \brief
+ */
+void StubRunner::Run(Cmd& cmd)
+{
+    std::vector<char> output;
+
+    {
+        AUTOLOCK(_lock);
+
+        std::map<CmdId_t, std::vector<char>>::iterator iOut = _outputs.find(cmd.Id());
+        if (iOut == _outputs.end())
+        {
+            iOut = _outputs.insert(std::make_pair(cmd.Id(), std::vector<char>())).first;
+
+            std::string file(_dir);
+            file += '/';
+            file += FindCmdInfo(cmd.Id())->_name;
+            file += ".out";
+
+            FILE* fp = fopen(file.c_str(), "rb");
+            if (fp)
+            {
+                readAll(fp, iOut->second);
+                fclose(fp);
+            }
+        }
+
+        output = iOut->second;
+    }
+
+    if (!output.empty())
+    {
+        output.push_back(0);
+        cmd.SetResult(output);
+    }
+
+    cmd.Status(OK);
+}
+
+
+/**
+ *  \brief  DB folder given on the command line to the absolute path with trailing slash DbManager expects
+ */
+bool DbPathFromArg(const char* arg, CPath& dbPath)
+{
+    char* absPath = realpath(arg, NULL);
+    if (!absPath)
+        return false;
+
+    dbPath.Clear();
+    dbPath += absPath;
+    free(absPath);
+
+    if (dbPath.Len() == 0 || dbPath.C_str()[dbPath.Len() - 1] != _T('/'))
+        dbPath += _T("/");
+
+    return true;
+}
+
+
+/**
+ *  \brief  Locks the DB the way the plugin does for the command, runs it and composes the text
+ *          the results window would show. Returns CANCELLED if the DB is busy
+ */
+CmdStatus_t RunCmd(CmdRunner& runner, const CPath& dbPath, CmdId_t id, const TCHAR* tag, bool regExp,
+        bool matchCase, CTextA& view)
+{
+    view.Clear();
+
+    DbHandle db = NULL;
+    bool success = true;
+
+    if (id == CREATE_DATABASE)
+        db = DbManager::Get().RegisterDb(dbPath);
+    else if (id == UPDATE_SINGLE || id == UPDATE_INCREMENTAL)
+        db = DbManager::Get().UpdateDb(dbPath, &success);
+    else if (id != VERSION)
+        db = DbManager::Get().GetDb(dbPath, false, &success);
+
+    if (id != VERSION && !db)
+    {
+        view = "No database found";
+        return RUN_ERROR;
+    }
+
+    if (!success)
+        return CANCELLED;
+
+    Cmd cmd(id, FindCmdInfo(id)->_title, db, tag, regExp, matchCase);
+    cmd.Silent(true);
+
+    runner.Run(cmd);
+
+    if (id == CREATE_DATABASE && cmd.Status() != OK)
+        DbManager::Get().UnregisterDb(db);
+    else if (db)
+        DbManager::Get().PutDb(db);
+
+    if (cmd.Status() != OK)
+    {
+        if (cmd.Result())
+            view = cmd.Result();
+        return cmd.Status();
+    }
+
+    // Only the lookups go to the results window - completions and tag lists are shown as they are
+    if (id != FIND_FILE && id != FIND_DEFINITION && id != FIND_REFERENCE && id != FIND_SYMBOL && id != GREP)
+    {
+        if (cmd.Result())
+            view = cmd.Result();
+        return OK;
+    }
+
+    // Result lines don't match the files content
+    if (!ResultModel::Compose(view, cmd))
+    {
+        view = "Database is outdated - update it";
+        return FAILED;
+    }
+
+    return OK;
+}
+
+} // namespace GTags
@@ -0,0 +1,110 @@
+/**
+ *  \file
+ *  \brief  Headless plugin core front end - runs the plugin commands without the UI
+ *
+ *  \author  Pavel Nedev <pg.nedev@gmail.com>
+ *
+ *  \section COPYRIGHT
+ *  Copyright(C) 2015 Pavel Nedev
+ *
+ *  \section LICENSE
+ *  This program is free software; you can redistribute it and/or modify it
+ *  under the terms of the GNU General Public License version 2 as published
+ *  by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful, but
+ *  WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ *  or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ *  for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+#pragma once
+
+
+#include <tchar.h>
+#include <string>
+#include <vector>
+#include <map>
+#include "Common.h"
+#include "AutoLock.h"
+#include "Cmd.h"
+
+
+namespace GTags
+{
+
+/**
+ *  \struct  CmdInfo
+ *  \brief  Command line name of a plugin command
+ */
+struct CmdInfo
+{
+    const char*     _name;
+    CmdId_t         _id;
+    const TCHAR*    _title;
+};
+
+
+const CmdInfo* FindCmdInfo(const char* name);
+const CmdInfo* FindCmdInfo(CmdId_t id);
+
+
+/**
+ *  \class  CmdRunner
+ *  \brief  Runs a command against its DB, already locked by the caller. Sets the command status and result
+ *          the same way CmdEngine does
+ */
+class CmdRunner
+{
+public:
+    virtual ~CmdRunner() {}
+
+    virtual void Run(Cmd& cmd) = 0;
+};
+
+
+/**
+ *  \class  GlobalRunner
+ *  \brief  Runs GNU Global found in PATH. Follows CmdEngine command lines, DB snapshot handling and
+ *          result status rules
+ */
+class GlobalRunner : public CmdRunner
+{
+public:
+    virtual void Run(Cmd& cmd);
+
+private:
+    static void composeCmd(const Cmd& cmd, std::string& line);
+    static void quote(std::string& line, const TCHAR* arg);
+};
+
+
+/**
+ *  \class  StubRunner
+ *  \brief  Replays recorded global output - <dir>/<command name>.out (empty result if there is none).
+ *          The outputs are read once
+ */
+class StubRunner : public CmdRunner
+{
+public:
+    StubRunner(const char* dir) : _dir(dir) {}
+
+    virtual void Run(Cmd& cmd);
+
+private:
+    std::string                                 _dir;
+    Mutex                                       _lock;
+    std::map<CmdId_t, std::vector<char>>        _outputs;
+};
+
+
+bool DbPathFromArg(const char* arg, CPath& dbPath);
+CmdStatus_t RunCmd(CmdRunner& runner, const CPath& dbPath, CmdId_t id, const TCHAR* tag, bool regExp,
+        bool matchCase, CTextA& view);
+
+} // namespace GTags
@@ -0,0 +1,224 @@
+/**
+ *  \file
+ *  \brief  Locking primitives stress test
+ *
+ *  \author  Pavel Nedev <pg.nedev@gmail.com>
+ *
+ *  \section COPYRIGHT
+ *  Copyright(C) 2015 Pavel Nedev
+ *
+ *  \section LICENSE
+ *  This program is free software; you can redistribute it and/or modify it
+ *  under the terms of the GNU General Public License version 2 as published
+ *  by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful, but
+ *  WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ *  or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ *  for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+#include <stdio.h>
+#include <thread>
+#include <atomic>
+#include <vector>
+#include "AutoLock.h"
+
+
+namespace
+{
+
+const unsigned cThreads     = 8;
+const unsigned cIterations  = 20000;
+
+
+Mutex       CountLock;
+unsigned    Count = 0;
+
+RWMutex     TableLock;
+// Writers keep both equal, readers must never see them differ
+unsigned    TableA = 0;
+unsigned    TableB = 0;
+unsigned    TornReads = 0;
+Mutex       TornLock;
+
+/**
+ *  \struct  Item
+ *  \brief
+ */
+struct Item
+{
+    unsigned _producer;
+    unsigned _seq;
+};
+
+MpscQueue<Item> Queue;
+
+
+/**
+ *  \brief  Recursive lock - the inner lock must not deadlock
+ */
+void countWorker()
+{
+    for (unsigned i = 0; i < cIterations; ++i)
+    {
+        AUTOLOCK(CountLock);
+        {
+            AUTOLOCK(CountLock);
+            ++Count;
+        }
+    }
+}
+
+
+/**
+ *  \brief
+ */
+void tableWorker(unsigned idx)
+{
+    for (unsigned i = 0; i < cIterations; ++i)
+    {
+        // One write per 16 reads - the PathTable / TagFilter load
+        if ((i + idx) % 16 == 0)
+        {
+            AUTOLOCK(TableLock);
+            ++TableA;
+            ++TableB;
+        }
+        else
+        {
+            bool torn;
+            {
+                AUTOLOCK_SHARED(TableLock);
+                torn = (TableA != TableB);
+            }
+
+            if (torn)
+            {
+                AUTOLOCK(TornLock);
+                ++TornReads;
+            }
+        }
+    }
+}
+
+
+/**
+ *  \brief
+ */
+void queueWorker(unsigned idx)
+{
+    for (unsigned i = 0; i < cIterations; ++i)
+    {
+        Item item = { idx, i };
+        Queue.Push(item);
+    }
+}
+
+
+/**
+ *  \brief  Takes all queued items while the producers run. Each producer items must come in push order
+ */
+void drainQueue(std::vector<unsigned>* next, std::atomic<bool>* done, bool* ordered)
+{
+    *ordered = true;
+
+    for (;;)
+    {
+        // Read the flag before draining - nothing is pushed after it is set
+        bool last = done->load();
+
+        std::vector<Item> items;
+        Queue.PopAll(items);
+
+        for (unsigned i = 0; i < items.size(); ++i)
+        {
+            if (items[i]._seq != (*next)[items[i]._producer])
+                *ordered = false;
+            (*next)[items[i]._producer] = items[i]._seq + 1;
+        }
+
+        if (last)
+            break;
+
+        std::this_thread::yield();
+    }
+}
+
+
+/**
+ *  \brief
+ */
+bool check(bool ok, const char* what)
+{
+    printf("%s: %s\n", ok ? "PASS" : "FAIL", what);
+    return ok;
+}
+
+} // anonymous namespace
+
+
+/**
+ *  \brief
+ */
+int main()
+{
+    bool ok = true;
+
+    {
+        std::vector<std::thread> threads;
+        for (unsigned i = 0; i < cThreads; ++i)
+            threads.push_back(std::thread(countWorker));
+        for (unsigned i = 0; i < threads.size(); ++i)
+            threads[i].join();
+
+        ok &= check(Count == cThreads * cIterations, "Mutex recursive lock counts every increment");
+    }
+
+    {
+        std::vector<std::thread> threads;
+        for (unsigned i = 0; i < cThreads; ++i)
+            threads.push_back(std::thread(tableWorker, i));
+        for (unsigned i = 0; i < threads.size(); ++i)
+            threads[i].join();
+
+        ok &= check(TornReads == 0 && TableA == TableB, "RWMutex readers never see a partial write");
+    }
+
+    {
+        std::vector<unsigned> next(cThreads, 0);
+        std::atomic<bool> done(false);
+
+        std::vector<std::thread> threads;
+        for (unsigned i = 0; i < cThreads; ++i)
+            threads.push_back(std::thread(queueWorker, i));
+
+        bool ordered;
+        std::thread consumer(drainQueue, &next, &done, &ordered);
+
+        for (unsigned i = 0; i < threads.size(); ++i)
+            threads[i].join();
+
+        done.store(true);
+        consumer.join();
+
+        bool complete = Queue.IsEmpty();
+        for (unsigned i = 0; i < cThreads; ++i)
+            complete &= (next[i] == cIterations);
+
+        ok &= check(ordered && complete, "MpscQueue delivers every item in per-producer push order");
+    }
+
+#ifdef DEVELOPMENT
+    unsigned acquired, contended;
+    TableLock.GetContention(acquired, contended);
+    printf("RWMutex: %u locks, %u contended\n", acquired, contended);
+#endif
+
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,371 @@
+/**
+ *  \file
+ *  \brief  PathIndex unit test
+ *
+ *  \author  Pavel Nedev <pg.nedev@gmail.com>
+ *
+ *  \section COPYRIGHT
+ *  Copyright(C) 2015 Pavel Nedev
+ *
+ *  \section LICENSE
+ *  This program is free software; you can redistribute it and/or modify it
+ *  under the terms of the GNU General Public License version 2 as published
+ *  by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful, but
+ *  WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ *  or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ *  for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include "Headless.h"
+#include "EngineStub.h"
+#include "DbManager.h"
+#include "PathIndex.h"
+
+
+namespace
+{
+
+using namespace GTags;
+
+
+/**
+ *  \class  ListRunner
+ *  \brief  Answers the path index build (all DB paths listing) with a fixed list
+ */
+class ListRunner : public CmdRunner
+{
+public:
+    ListRunner(const std::string& list) : _list(list), _builds(0) {}
+
+    virtual void Run(Cmd& cmd)
+    {
+        if (cmd.Id() != FIND_FILE || cmd.TagLen())
+            return;
+
+        ++_builds;
+
+        std::vector<char> result(_list.begin(), _list.end());
+        result.push_back(0);
+        cmd.AppendResult(result);
+        cmd.Status(OK);
+    }
+
+    unsigned Builds() const { return _builds; }
+
+private:
+    std::string _list;
+    unsigned    _builds;
+};
+
+
+/**
+ *  \brief
+ */
+bool check(bool ok, const char* what)
+{
+    printf("%s: %s\n", ok ? "PASS" : "FAIL", what);
+    return ok;
+}
+
+
+/**
+ *  \brief
+ */
+bool containsFolded(const std::string& str, const char* pattern)
+{
+    std::string s(str);
+    std::string p(pattern);
+
+    for (unsigned i = 0; i < s.size(); ++i)
+        s[i] = tolower(s[i]);
+    for (unsigned i = 0; i < p.size(); ++i)
+        p[i] = tolower(p[i]);
+
+    return (s.find(p) != std::string::npos);
+}
+
+
+/**
+ *  \brief  Paths in many directories, names differing by case, a directory longer than the shared
+ *          prefix limit and names with rare trigrams far apart
+ */
+void generatePaths(std::vector<std::string>& paths)
+{
+    char buf[128];
+
+    paths.push_back("aaa/xyzzy.c");
+
+    for (unsigned m = 0; m < 20; ++m)
+    {
+        for (unsigned s = 0; s < 4; ++s)
+        {
+            for (unsigned f = 0; f < 25; ++f)
+            {
+                unsigned n = (m * 4 + s) * 25 + f;
+
+                snprintf(buf, sizeof(buf), "src/module%02u/sub%u/file%04u.c", m, s, n);
+                paths.push_back(buf);
+
+                snprintf(buf, sizeof(buf), "src/module%02u/sub%u/File%04u.H", m, s, n);
+                paths.push_back(buf);
+            }
+        }
+    }
+
+    std::string longDir("deep/");
+    longDir.append(300, 'd');
+    longDir += "/";
+
+    paths.push_back(longDir + "one.c");
+    paths.push_back(longDir + "two.c");
+    paths.push_back(longDir + "three.c");
+
+    paths.push_back("zzz/XYZZY.h");
+}
+
+
+/**
+ *  \brief
+ */
+bool testFrontCoding(const std::vector<std::string>& sorted, const std::string& list)
+{
+    std::vector<char> buf(list.begin(), list.end());
+    PathIndex::Paths paths(buf);
+
+    bool ok = check(paths.Count() == sorted.size(), "duplicate and './' prefixed paths are stored once");
+
+    PathIndex::Paths::Cursor cursor;
+    bool same = true;
+
+    for (unsigned id = 0; id < paths.Count() && same; ++id)
+    {
+        paths.Decode(id, cursor);
+        same = (sorted[id] == cursor._path.data());
+    }
+
+    ok &= check(same, "ascending decode restores every path in sorted order");
+
+    // Backwards and across blocks - the cursor has to go back to the block start
+    same = true;
+    for (unsigned id = paths.Count(); id-- > 0 && same;)
+    {
+        paths.Decode(id, cursor);
+        same = (sorted[id] == cursor._path.data());
+    }
+
+    ok &= check(same, "descending decode restores every path");
+
+    bool found = true;
+    for (unsigned id = 0; id < sorted.size() && found; ++id)
+    {
+        unsigned foundId;
+        found = (paths.Find(sorted[id].c_str(), foundId) && foundId == id);
+    }
+
+    unsigned id;
+    ok &= check(found && !paths.Find("src/module00/sub0/file9999.c", id) && !paths.Find("", id),
+            "Find gives the id of every stored path and nothing else");
+
+    unsigned lower = paths.LowerBound("src/module07/");
+    ok &= check(lower < sorted.size() && sorted[lower].compare(0, 13, "src/module07/") == 0 &&
+            sorted[lower - 1] < "src/module07/", "LowerBound gives the first path of the folder");
+
+    ok &= check(paths.LowerBound("~") == paths.Count(), "LowerBound past the last path gives Count()");
+
+    return ok;
+}
+
+
+/**
+ *  \brief  Trigram candidates must include every path containing the pattern
+ */
+bool testGrams(const std::vector<std::string>& sorted, const std::string& list)
+{
+    static const char* const cPatterns[] =
+    {
+        "xyzzy", "XyZ", "file0123", "FILE01", "module13", "sub3", "ddddd", ".h", "0.c", "none"
+    };
+
+    std::vector<char> buf(list.begin(), list.end());
+    PathIndex::Paths paths(buf);
+
+    bool ok = true;
+
+    for (unsigned i = 0; i < _countof(cPatterns); ++i)
+    {
+        std::vector<unsigned> ids;
+        bool filtered = paths.Candidates(cPatterns[i], ids);
+
+        if (strlen(cPatterns[i]) < 3)
+        {
+            ok &= check(!filtered, "patterns shorter than a trigram are not filtered");
+            continue;
+        }
+
+        bool complete = filtered;
+        unsigned expected = 0;
+
+        for (unsigned id = 0; id < sorted.size() && complete; ++id)
+        {
+            if (containsFolded(sorted[id], cPatterns[i]))
+            {
+                ++expected;
+                complete = std::binary_search(ids.begin(), ids.end(), id);
+            }
+        }
+
+        std::string what("candidates of '");
+        what += cPatterns[i];
+        what += "' include all matching paths";
+
+        ok &= check(complete && std::is_sorted(ids.begin(), ids.end()) && (expected || ids.empty()),
+                what.c_str());
+    }
+
+    // The rare trigram is in the first and the last path - multi-byte delta in the posting list
+    std::vector<unsigned> ids;
+    paths.Candidates("yzz", ids);
+    ok &= check(ids.size() == 2 && ids[0] == 0 && ids[1] == sorted.size() - 1,
+            "posting list ids far apart decode exactly");
+
+    ids.clear();
+    ok &= check(!paths.Candidates("module01/sub", ids), "patterns spanning folders are not filtered");
+
+    ids.clear();
+    paths.StemMatches("src/module01/sub2/FILE0137.cpp", ids);
+
+    unsigned siblings = 0;
+    for (unsigned i = 0; i < ids.size(); ++i)
+        if (containsFolded(sorted[ids[i]], "/file0137."))
+            ++siblings;
+
+    ok &= check(siblings == 2, "stem matches find the sources and headers of the same name");
+
+    return ok;
+}
+
+
+/**
+ *  \brief  Single file updates are kept in the delta until there are too many of them
+ */
+bool testDelta(const std::vector<std::string>& sorted, const std::string& list)
+{
+    char dir[] = "/tmp/nppgtags-pathindex-XXXXXX";
+    if (!mkdtemp(dir))
+        return check(false, "temp DB folder created");
+
+    CPath dbPath(dir);
+    dbPath += _T("/");
+
+    ListRunner runner(list);
+    SetEngineRunner(&runner);
+
+    DbHandle db = DbManager::Get().RegisterDb(dbPath);
+
+    bool ok = true;
+
+    Cmd lookup(FIND_FILE, _T("Test"), db, _T("newfile"));
+    std::vector<char> result;
+
+    ok &= check(PathIndex::Get().Run(lookup, result) && result.empty() && runner.Builds() == 1,
+            "index is built on first lookup");
+
+    // A new file - added to the delta
+    std::string newFile(dir);
+    newFile += "/newfile.c";
+    FILE* fp = fopen(newFile.c_str(), "w");
+    if (fp)
+        fclose(fp);
+
+    CPath file(dbPath);
+    file += _T("newfile.c");
+    PathIndex::Get().FileUpdated(dbPath, file);
+
+    result.clear();
+    PathIndex::Get().Run(lookup, result);
+    ok &= check(!result.empty() && !strcmp(result.data(), "newfile.c\n") && runner.Builds() == 1,
+            "added file is found without re-building");
+
+    // The indexed paths don't exist on disk - each update removes one
+    for (unsigned i = 1; i <= 255; ++i)
+    {
+        CPath removed(dbPath);
+        removed += CText(sorted[i].c_str());
+        PathIndex::Get().FileUpdated(dbPath, removed);
+    }
+
+    Cmd all(FIND_FILE, _T("Test"), db, _T("module00"));
+    result.clear();
+    PathIndex::Get().Run(all, result);
+
+    unsigned lines = std::count(result.begin(), result.end(), '\n');
+    unsigned expected = 0;
+    for (unsigned i = 256; i < sorted.size(); ++i)
+        if (containsFolded(sorted[i], "module00"))
+            ++expected;
+
+    ok &= check(lines == expected && runner.Builds() == 1, "removed files are left out up to the delta cap");
+
+    CPath removed(dbPath);
+    removed += CText(sorted[256].c_str());
+    PathIndex::Get().FileUpdated(dbPath, removed);
+
+    result.clear();
+    PathIndex::Get().Run(all, result);
+    ok &= check(runner.Builds() == 2, "one more update over the cap drops the index and it is re-built");
+
+    unlink(newFile.c_str());
+    rmdir(dir);
+
+    DbManager::Get().UnregisterDb(db);
+    SetEngineRunner(NULL);
+
+    return ok;
+}
+
+} // anonymous namespace
+
+
+/**
+ *  \brief
+ */
+int main()
+{
+    std::vector<std::string> paths;
+    generatePaths(paths);
+
+    std::vector<std::string> sorted(paths);
+    std::sort(sorted.begin(), sorted.end());
+
+    // The list as global prints it plus a duplicate and a './' prefixed path
+    std::string list;
+    for (unsigned i = 0; i < paths.size(); ++i)
+    {
+        list += (i % 7) ? "" : "./";
+        list += paths[i];
+        list += "\n";
+    }
+    list += paths[3];
+    list += "\n";
+
+    bool ok = testFrontCoding(sorted, list);
+    ok &= testGrams(sorted, list);
+    ok &= testDelta(sorted, list);
+
+    return ok ? 0 : 1;
+}
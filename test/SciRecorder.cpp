@@ -0,0 +1,498 @@
+/**
+ *  \file
+ *  \brief  Recording in-memory Scintilla for the headless view tests
+ *
+ *  \author  Pavel Nedev <pg.nedev@gmail.com>
+ *
+ *  \section COPYRIGHT
+ *  Copyright(C) 2015 Pavel Nedev
+ *
+ *  \section LICENSE
+ *  This program is free software; you can redistribute it and/or modify it
+ *  under the terms of the GNU General Public License version 2 as published
+ *  by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful, but
+ *  WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ *  or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ *  for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+#include "SciRecorder.h"
+#include <string.h>
+#include <ctype.h>
+#include <algorithm>
+#include <regex>
+
+
+namespace
+{
+
+/**
+ *  \brief
+ */
+inline bool isWordChar(char c)
+{
+    return (isalnum((unsigned char)c) || c == '_');
+}
+
+} // anonymous namespace
+
+
+namespace GTags
+{
+
+/**
+ *  \brief
+ */
+SciRecorder::SciRecorder(int linesOnScreen) : _linesOnScreen(linesOnScreen), _messages(0), _unhandled(0)
+{
+    setText("");
+    _searchFlags = _targetStart = _targetEnd = 0;
+}
+
+
+/**
+ *  \brief
+ */
+unsigned SciRecorder::Messages(UINT msg) const
+{
+    std::map<UINT, unsigned>::const_iterator i = _counts.find(msg);
+
+    return (i == _counts.end()) ? 0 : i->second;
+}
+
+
+/**
+ *  \brief
+ */
+void SciRecorder::ResetCounts()
+{
+    _counts.clear();
+    _messages = 0;
+    _unhandled = 0;
+}
+
+
+/**
+ *  \brief
+ */
+LRESULT SciRecorder::Send(UINT msg, WPARAM wParam, LPARAM lParam)
+{
+    ++_messages;
+    ++_counts[msg];
+
+    const int line = (int)wParam;
+
+    switch (msg)
+    {
+        case SCI_SETCURSOR:
+        case SCI_SETREADONLY:
+        return 0;
+
+        case SCI_SETTEXT:
+            setText(reinterpret_cast<const char*>(lParam));
+        return 0;
+
+        case SCI_CLEARALL:
+            setText("");
+        return 0;
+
+        case SCI_GETCURRENTPOS:
+        return _pos;
+
+        case SCI_GOTOPOS:
+            _pos = std::min(std::max((int)wParam, 0), (int)_text.size());
+            gotoLine(lineFromPos(_pos));
+        return 0;
+
+        case SCI_GOTOLINE:
+            gotoLine(line);
+        return 0;
+
+        case SCI_GETLINECOUNT:
+        return _lineStarts.size();
+
+        case SCI_LINEFROMPOSITION:
+        return lineFromPos((int)wParam);
+
+        case SCI_POSITIONFROMLINE:
+            if (line < 0 || line > (int)_lineStarts.size())
+                return -1;
+        return (line == (int)_lineStarts.size()) ? _text.size() : _lineStarts[line];
+
+        case SCI_LINELENGTH:
+            if (line < 0 || line >= (int)_lineStarts.size())
+                return 0;
+        return lineEnd(line) - _lineStarts[line];
+
+        case SCI_GETLINEENDPOSITION:
+        {
+            if (line < 0 || line >= (int)_lineStarts.size())
+                return -1;
+
+            int end = lineEnd(line);
+            while (end > _lineStarts[line] && (_text[end - 1] == '\n' || _text[end - 1] == '\r'))
+                --end;
+            return end;
+        }
+
+        case SCI_GETLINE:
+        {
+            if (line < 0 || line >= (int)_lineStarts.size())
+                return 0;
+
+            const int len = lineEnd(line) - _lineStarts[line];
+            if (lParam)
+                memcpy(reinterpret_cast<char*>(lParam), _text.data() + _lineStarts[line], len);
+            return len;
+        }
+
+        case SCI_GETFIRSTVISIBLELINE:
+        return _firstVisible;
+
+        case SCI_SETFIRSTVISIBLELINE:
+            scrollTo(line);
+        return 0;
+
+        case SCI_LINESONSCREEN:
+        return _linesOnScreen;
+
+        case SCI_LINESCROLL:
+            scrollTo(_firstVisible + (int)lParam);
+        return 0;
+
+        case SCI_DOCLINEFROMVISIBLE:
+        return docLineFromVisible(line);
+
+        case SCI_GETENDSTYLED:
+        return _endStyled;
+
+        case SCI_STARTSTYLING:
+            _stylingPos = (int)wParam;
+        return 0;
+
+        case SCI_SETSTYLINGEX:
+        {
+            const int len = std::min((int)wParam, (int)_text.size() - _stylingPos);
+            if (len > 0)
+                memcpy(&_styles[_stylingPos], reinterpret_cast<const char*>(lParam), len);
+            _stylingPos += std::max(len, 0);
+            _endStyled = _stylingPos;
+            return 0;
+        }
+
+        case SCI_SETFOLDLEVEL:
+            if (line >= 0 && line < (int)_levels.size())
+            {
+                _levels[line] = (int)lParam;
+                _foldsChanged = true;
+            }
+        return 0;
+
+        case SCI_GETFOLDLEVEL:
+        return (line >= 0 && line < (int)_levels.size()) ? _levels[line] : SC_FOLDLEVELBASE;
+
+        case SCI_GETFOLDPARENT:
+        return foldParent(line);
+
+        case SCI_GETLASTCHILD:
+        return lastChild(line, (int)lParam);
+
+        case SCI_GETFOLDEXPANDED:
+        return (line >= 0 && line < (int)_expanded.size()) ? _expanded[line] : 1;
+
+        case SCI_TOGGLEFOLD:
+            if (line >= 0 && line < (int)_expanded.size())
+            {
+                _expanded[line] = !_expanded[line];
+                _foldsChanged = true;
+            }
+        return 0;
+
+        case SCI_FOLDLINE:
+            if (line >= 0 && line < (int)_expanded.size())
+            {
+                if (lParam == SC_FOLDACTION_TOGGLE)
+                    _expanded[line] = !_expanded[line];
+                else
+                    _expanded[line] = (lParam == SC_FOLDACTION_EXPAND);
+                _foldsChanged = true;
+            }
+        return 0;
+
+        case SCI_SETSEARCHFLAGS:
+            _searchFlags = (int)wParam;
+        return 0;
+
+        case SCI_SETTARGETSTART:
+            _targetStart = (int)wParam;
+        return 0;
+
+        case SCI_SETTARGETEND:
+            _targetEnd = (int)wParam;
+        return 0;
+
+        case SCI_GETTARGETSTART:
+        return _targetStart;
+
+        case SCI_GETTARGETEND:
+        return _targetEnd;
+
+        case SCI_SEARCHINTARGET:
+        return search(reinterpret_cast<const char*>(lParam), (int)wParam);
+    }
+
+    ++_unhandled;
+
+    return 0;
+}
+
+
+/**
+ *  \brief  Resets the document state as Scintilla does on new text
+ */
+void SciRecorder::setText(const char* text)
+{
+    _text = text ? text : "";
+
+    _lineStarts.assign(1, 0);
+    for (int i = 0; i < (int)_text.size(); ++i)
+        if (_text[i] == '\n')
+            _lineStarts.push_back(i + 1);
+
+    _levels.assign(_lineStarts.size(), SC_FOLDLEVELBASE);
+    _expanded.assign(_lineStarts.size(), 1);
+    _styles.assign(_text.size(), 0);
+    _foldsChanged = true;
+
+    _endStyled = _stylingPos = _pos = _firstVisible = 0;
+}
+
+
+/**
+ *  \brief
+ */
+int SciRecorder::lineFromPos(int pos) const
+{
+    if (pos <= 0)
+        return 0;
+
+    return (std::upper_bound(_lineStarts.begin(), _lineStarts.end(), pos) - _lineStarts.begin()) - 1;
+}
+
+
+/**
+ *  \brief  Position after the line EOL
+ */
+int SciRecorder::lineEnd(int line) const
+{
+    return (line + 1 < (int)_lineStarts.size()) ? _lineStarts[line + 1] : _text.size();
+}
+
+
+/**
+ *  \brief  The closest header line above with lower fold level
+ */
+int SciRecorder::foldParent(int line) const
+{
+    if (line < 0 || line >= (int)_levels.size())
+        return -1;
+
+    const int level = _levels[line] & SC_FOLDLEVELNUMBERMASK;
+
+    // Nothing folds the base level lines
+    if (level <= SC_FOLDLEVELBASE)
+        return -1;
+
+    for (int i = line - 1; i >= 0; --i)
+        if ((_levels[i] & SC_FOLDLEVELHEADERFLAG) && (_levels[i] & SC_FOLDLEVELNUMBERMASK) < level)
+            return i;
+
+    return -1;
+}
+
+
+/**
+ *  \brief
+ */
+int SciRecorder::lastChild(int line, int level) const
+{
+    if (line < 0 || line >= (int)_levels.size())
+        return -1;
+
+    if (level == -1)
+        level = _levels[line];
+    level &= SC_FOLDLEVELNUMBERMASK;
+
+    int i = line + 1;
+    while (i < (int)_levels.size() && (_levels[i] & SC_FOLDLEVELNUMBERMASK) > level)
+        ++i;
+
+    return i - 1;
+}
+
+
+/**
+ *  \brief  Hidden if any of the fold parents is contracted
+ */
+bool SciRecorder::isVisible(int line) const
+{
+    for (int parent = foldParent(line); parent >= 0; parent = foldParent(parent))
+        if (!_expanded[parent])
+            return false;
+
+    return true;
+}
+
+
+/**
+ *  \brief  Recounts the visible lines after the fold levels or states change
+ */
+void SciRecorder::updateVisible()
+{
+    if (!_foldsChanged)
+        return;
+
+    _visibleBefore.assign(1, 0);
+    for (int i = 0; i < (int)_lineStarts.size(); ++i)
+        _visibleBefore.push_back(_visibleBefore.back() + (isVisible(i) ? 1 : 0));
+
+    _foldsChanged = false;
+}
+
+
+/**
+ *  \brief
+ */
+int SciRecorder::visibleLines()
+{
+    updateVisible();
+
+    return _visibleBefore.back();
+}
+
+
+/**
+ *  \brief  Visible lines before the line
+ */
+int SciRecorder::visibleIndex(int line)
+{
+    updateVisible();
+
+    return _visibleBefore[line];
+}
+
+
+/**
+ *  \brief
+ */
+int SciRecorder::docLineFromVisible(int visible)
+{
+    if (visible < 0)
+        return 0;
+
+    updateVisible();
+
+    // The first line with that many visible lines before it and visible itself
+    std::vector<int>::const_iterator i =
+            std::upper_bound(_visibleBefore.begin(), _visibleBefore.end(), visible);
+    if (i == _visibleBefore.end())
+        return _lineStarts.size() - 1;
+
+    return (i - _visibleBefore.begin()) - 1;
+}
+
+
+/**
+ *  \brief  Scrolling stops when the last line gets to the bottom of the screen
+ */
+void SciRecorder::scrollTo(int firstVisible)
+{
+    const int maxFirst = std::max(visibleLines() - _linesOnScreen, 0);
+
+    _firstVisible = std::min(std::max(firstVisible, 0), maxFirst);
+}
+
+
+/**
+ *  \brief  Moves the caret to the line start and scrolls the line into view
+ */
+void SciRecorder::gotoLine(int line)
+{
+    line = std::min(std::max(line, 0), (int)_lineStarts.size() - 1);
+    _pos = _lineStarts[line];
+
+    const int visible = visibleIndex(line);
+
+    if (visible < _firstVisible)
+        scrollTo(visible);
+    else if (visible >= _firstVisible + _linesOnScreen)
+        scrollTo(visible - _linesOnScreen + 1);
+}
+
+
+/**
+ *  \brief  Searches the target range, sets the target to the match
+ */
+int SciRecorder::search(const char* str, int len)
+{
+    const int start = std::max(_targetStart, 0);
+    const int end = std::min(_targetEnd, (int)_text.size());
+
+    if (!str || len <= 0 || start >= end)
+        return -1;
+
+    const std::string pattern(str, len);
+
+    if (_searchFlags & SCFIND_REGEXP)
+    {
+        std::regex::flag_type flags = std::regex::extended;
+        if (!(_searchFlags & SCFIND_MATCHCASE))
+            flags |= std::regex::icase;
+
+        std::cmatch match;
+        if (!std::regex_search(_text.data() + start, _text.data() + end, match, std::regex(pattern, flags)) ||
+                match.length(0) == 0)
+            return -1;
+
+        _targetStart = start + match.position(0);
+        _targetEnd = _targetStart + match.length(0);
+
+        return _targetStart;
+    }
+
+    for (int pos = start; pos + len <= end; ++pos)
+    {
+        int i = 0;
+
+        if (_searchFlags & SCFIND_MATCHCASE)
+            while (i < len && _text[pos + i] == pattern[i])
+                ++i;
+        else
+            while (i < len && tolower((unsigned char)_text[pos + i]) == tolower((unsigned char)pattern[i]))
+                ++i;
+
+        if (i < len)
+            continue;
+
+        if ((_searchFlags & SCFIND_WHOLEWORD) &&
+                ((pos > 0 && isWordChar(_text[pos - 1])) ||
+                (pos + len < (int)_text.size() && isWordChar(_text[pos + len]))))
+            continue;
+
+        _targetStart = pos;
+        _targetEnd = pos + len;
+
+        return pos;
+    }
+
+    return -1;
+}
+
+} // namespace GTags
@@ -0,0 +1,103 @@
+/**
+ *  \file
+ *  \brief  Recording in-memory Scintilla for the headless view tests
+ *
+ *  \author  Pavel Nedev <pg.nedev@gmail.com>
+ *
+ *  \section COPYRIGHT
+ *  Copyright(C) 2015 Pavel Nedev
+ *
+ *  \section LICENSE
+ *  This program is free software; you can redistribute it and/or modify it
+ *  under the terms of the GNU General Public License version 2 as published
+ *  by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful, but
+ *  WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ *  or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ *  for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+#pragma once
+
+
+#include <windows.h>
+#include <string>
+#include <vector>
+#include <map>
+#include "Scintilla.h"
+#include "SciSurface.h"
+
+
+namespace GTags
+{
+
+/**
+ *  \class  SciRecorder
+ *  \brief  Counts the messages sent and keeps the document, styles, fold levels, caret and scroll state
+ *          for the handful of SCI_* messages the results view uses. Any other message is counted as
+ *          unhandled and returns 0
+ */
+class SciRecorder : public SciSurface
+{
+public:
+    SciRecorder(int linesOnScreen = 40);
+
+    virtual LRESULT Send(UINT msg, WPARAM wParam = 0, LPARAM lParam = 0);
+
+    inline unsigned Messages() const { return _messages; }
+    unsigned Messages(UINT msg) const;
+    inline unsigned Unhandled() const { return _unhandled; }
+    void ResetCounts();
+
+    inline const std::string& Text() const { return _text; }
+    inline const std::vector<char>& Styles() const { return _styles; }
+    inline int EndStyled() const { return _endStyled; }
+    inline int LineCount() const { return _lineStarts.size(); }
+    inline int FoldLevel(int line) const { return _levels[line]; }
+    inline bool FoldExpanded(int line) const { return _expanded[line] != 0; }
+    inline int CurrentLine() const { return lineFromPos(_pos); }
+
+private:
+    void setText(const char* text);
+    int lineFromPos(int pos) const;
+    int lineEnd(int line) const;
+    int foldParent(int line) const;
+    int lastChild(int line, int level) const;
+    bool isVisible(int line) const;
+    void updateVisible();
+    int visibleLines();
+    int visibleIndex(int line);
+    int docLineFromVisible(int visible);
+    void scrollTo(int firstVisible);
+    void gotoLine(int line);
+    int search(const char* str, int len);
+
+    const int                   _linesOnScreen;
+
+    std::string                 _text;
+    std::vector<int>            _lineStarts;
+    std::vector<int>            _levels;
+    std::vector<char>           _expanded;
+    std::vector<int>            _visibleBefore;
+    bool                        _foldsChanged;
+    std::vector<char>           _styles;
+    int                         _endStyled;
+    int                         _stylingPos;
+    int                         _pos;
+    int                         _firstVisible;
+    int                         _searchFlags;
+    int                         _targetStart;
+    int                         _targetEnd;
+
+    std::map<UINT, unsigned>    _counts;
+    unsigned                    _messages;
+    unsigned                    _unhandled;
+};
+
+} // namespace GTags
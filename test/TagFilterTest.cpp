@@ -0,0 +1,265 @@
+/**
+ *  \file
+ *  \brief  TagFilter unit test - the Bloom filters built from the DB names and the saved files tokens
+ *
+ *  \author  Pavel Nedev <pg.nedev@gmail.com>
+ *
+ *  \section COPYRIGHT
+ *  Copyright(C) 2015 Pavel Nedev
+ *
+ *  \section LICENSE
+ *  This program is free software; you can redistribute it and/or modify it
+ *  under the terms of the GNU General Public License version 2 as published
+ *  by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful, but
+ *  WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ *  or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ *  for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <string>
+#include <vector>
+#include "Headless.h"
+#include "EngineStub.h"
+#include "TagFilter.h"
+
+
+namespace
+{
+
+using namespace GTags;
+
+
+const unsigned cNames           = 2000;
+// Absent names looked up to measure the false positive rate
+const unsigned cAbsentNames     = 20000;
+// About 1% expected with 10 bits per key
+const unsigned cMaxFalsePct     = 3;
+
+
+/**
+ *  \class  NamesRunner
+ *  \brief  Answers the definition and symbol names listings, fails the references one as parsers
+ *          without references support do
+ */
+class NamesRunner : public CmdRunner
+{
+public:
+    NamesRunner() : _lists(0) {}
+
+    virtual void Run(Cmd& cmd)
+    {
+        if (cmd.TagLen())
+            return;
+
+        std::string list;
+
+        if (cmd.Id() == AUTOCOMPLETE)
+        {
+            for (unsigned i = 0; i < cNames; ++i)
+                list += defName(i) + "\n";
+            list += "Main_Loop\r\n";
+        }
+        else if (cmd.Id() == AUTOCOMPLETE_SYMBOL)
+        {
+            list = "shared_counter\nerrno\n";
+        }
+        else
+        {
+            return;
+        }
+
+        ++_lists;
+
+        std::vector<char> result(list.begin(), list.end());
+        result.push_back(0);
+        cmd.AppendResult(result);
+        cmd.Status(OK);
+    }
+
+    unsigned Lists() const { return _lists; }
+
+    static std::string defName(unsigned i)
+    {
+        char name[32];
+        snprintf(name, sizeof(name), "def_%u_name", i * 7919);
+        return name;
+    }
+
+private:
+    unsigned _lists;
+};
+
+
+/**
+ *  \brief
+ */
+bool check(bool ok, const char* what)
+{
+    printf("%s: %s\n", ok ? "PASS" : "FAIL", what);
+    return ok;
+}
+
+
+/**
+ *  \brief
+ */
+bool mayContain(const CPath& dbPath, TagIndex::Kind_t kind, const char* name, bool prefix, bool& checked)
+{
+    CText tag(name);
+    return TagFilter::Get().MayContain(dbPath, kind, tag.C_str(), prefix, checked);
+}
+
+
+/**
+ *  \brief
+ */
+bool mayContain(const CPath& dbPath, const char* name, bool prefix = false)
+{
+    bool checked;
+    return mayContain(dbPath, TagIndex::DEFINITIONS, name, prefix, checked);
+}
+
+
+/**
+ *  \brief  The listed names always pass, the absent ones mostly don't
+ */
+bool testBuild(const CPath& dbPath, NamesRunner& runner)
+{
+    bool checked;
+    bool ok = check(mayContain(dbPath, TagIndex::DEFINITIONS, "absent_name", false, checked) && !checked,
+            "no filter before prefetch - every name passes unchecked");
+
+    TagFilter::Get().Prefetch(dbPath);
+
+    ok &= check(runner.Lists() == 2, "filters built from the definitions and symbols listings");
+
+    bool all = true;
+    for (unsigned i = 0; i < cNames; ++i)
+        all &= mayContain(dbPath, NamesRunner::defName(i).c_str());
+
+    ok &= check(all, "every listed name passes");
+    ok &= check(mayContain(dbPath, "main_loop") && mayContain(dbPath, "MAIN_LOOP"),
+            "names are case-folded and CRLF separated names are found");
+
+    unsigned passed = 0;
+    for (unsigned i = 0; i < cAbsentNames; ++i)
+    {
+        char name[32];
+        snprintf(name, sizeof(name), "absent_%u", i);
+        if (mayContain(dbPath, name))
+            ++passed;
+    }
+
+    printf("\t%u of %u absent names passed\n", passed, cAbsentNames);
+    ok &= check(passed * 100 <= cAbsentNames * cMaxFalsePct, "absent names are rejected");
+
+    ok &= check(mayContain(dbPath, "d", true) && mayContain(dbPath, "def_", true) &&
+            mayContain(dbPath, "DEF_9", true), "prefixes of the listed names pass");
+    ok &= check(mayContain(dbPath, "def_zzz", true), "prefixes are checked up to 4 chars");
+    ok &= check(!mayContain(dbPath, "qxz", true), "absent prefix is rejected");
+
+    ok &= check(mayContain(dbPath, TagIndex::SYMBOLS, "errno", false, checked) && checked &&
+            !mayContain(dbPath, TagIndex::SYMBOLS, "def_0_name", false, checked),
+            "each kind has its own filter");
+    ok &= check(mayContain(dbPath, TagIndex::REFERENCES, "absent_name", false, checked) && !checked,
+            "kind with failed listing passes unchecked");
+
+    ok &= check(TagFilter::Get().MayContain(dbPath, TagIndex::DEFINITIONS, _T("caf\u00E9"), false, checked) &&
+            !checked, "non-ASCII names pass unchecked");
+
+    return ok;
+}
+
+
+/**
+ *  \brief  The saved files words are added - whole and split on punctuation
+ */
+bool testTokenize(const CPath& dbPath, const std::string& dir)
+{
+    const std::string path = dir + "/saved.c";
+
+    FILE* fp = fopen(path.c_str(), "wb");
+    if (!fp)
+        return check(false, "saved file written");
+
+    fputs("int new_func(void){obj->member_x;ns::Class_y a.b.c_z;$var_w @attr_v\r\n"
+            "char* s=\"quoted_u\";x[idx_t]}\n", fp);
+    fclose(fp);
+
+    bool ok = check(!mayContain(dbPath, "new_func") && !mayContain(dbPath, "member_x"), "names not added yet");
+
+    TagFilter::Get().FilesUpdated(dbPath, std::vector<CPath>(1, CPath(path.c_str())));
+
+    ok &= check(mayContain(dbPath, "new_func") && mayContain(dbPath, "int"), "words split on brackets");
+    ok &= check(mayContain(dbPath, "obj->member_x") && mayContain(dbPath, "obj") &&
+            mayContain(dbPath, "member_x"), "whole word and its parts between '-' and '>'");
+    ok &= check(mayContain(dbPath, "ns::Class_y") && mayContain(dbPath, "class_y") &&
+            mayContain(dbPath, "c_z") && mayContain(dbPath, "var_w") && mayContain(dbPath, "attr_v"),
+            "parts between ':', '.', '$' and '@'");
+    ok &= check(mayContain(dbPath, "quoted_u") && mayContain(dbPath, "idx_t"),
+            "quotes and square brackets split words");
+    ok &= check(mayContain(dbPath, "new_", true) && mayContain(dbPath, "memb", true),
+            "prefixes of the added words");
+
+    // Twice the filter capacity - dropped to be re-built
+    std::string text;
+    for (unsigned i = 0; i < cNames * 6; ++i)
+        text += "word_" + std::to_string(i) + "\n";
+
+    fp = fopen(path.c_str(), "wb");
+    if (fp)
+    {
+        fputs(text.c_str(), fp);
+        fclose(fp);
+    }
+
+    TagFilter::Get().FilesUpdated(dbPath, std::vector<CPath>(1, CPath(path.c_str())));
+
+    bool checked;
+    ok &= check(mayContain(dbPath, TagIndex::DEFINITIONS, "absent_name", false, checked) && !checked,
+            "overfilled filter is dropped");
+
+    unlink(path.c_str());
+
+    return ok;
+}
+
+} // anonymous namespace
+
+
+int main()
+{
+    char dir[] = "/tmp/nppgtags-tagfilter-XXXXXX";
+    if (!mkdtemp(dir))
+        return check(false, "temp DB folder created") ? 0 : 1;
+
+    CPath dbPath(dir);
+    dbPath += _T("/");
+
+    // The DB is found by its files
+    const std::string gtags = std::string(dir) + "/GTAGS";
+    FILE* fp = fopen(gtags.c_str(), "wb");
+    if (fp)
+        fclose(fp);
+
+    NamesRunner runner;
+    SetEngineRunner(&runner);
+
+    bool ok = testBuild(dbPath, runner);
+    ok &= testTokenize(dbPath, dir);
+
+    unlink(gtags.c_str());
+    rmdir(dir);
+
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,207 @@
+/**
+ *  \file
+ *  \brief  UpdateFilter unit test - the content hash and the gtags.conf language map
+ *
+ *  \author  Pavel Nedev <pg.nedev@gmail.com>
+ *
+ *  \section COPYRIGHT
+ *  Copyright(C) 2015 Pavel Nedev
+ *
+ *  \section LICENSE
+ *  This program is free software; you can redistribute it and/or modify it
+ *  under the terms of the GNU General Public License version 2 as published
+ *  by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful, but
+ *  WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ *  or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ *  for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <ftw.h>
+#include <sys/stat.h>
+#include <string>
+#include <vector>
+#include "Common.h"
+#include "Config.h"
+#include "GTags.h"
+#include "UpdateFilter.h"
+
+
+namespace
+{
+
+using namespace GTags;
+
+
+// Labels chained with tc=, a label reference loop, escaped ':', names list and a suffixes list
+const char cGtagsConf[] =
+    "# Test config\n"
+    "default:\\\n"
+    "\t:tc=native:tc=user:\n"
+    "native:\\\n"
+    "\t:langmap=c\\:.c.h,cpp\\:.cpp.HPP:tc=default:\n"
+    "user|custom:\\\r\n"
+    "\t:langmap=python\\:.py(SConstruct)(wscript):\n"
+    "ctags:\\\n"
+    "\t:langmap=java\\:.java:\n";
+
+
+/**
+ *  \brief
+ */
+int removeEntry(const char* path, const struct stat*, int, struct FTW*)
+{
+    return remove(path);
+}
+
+
+/**
+ *  \brief
+ */
+bool check(bool ok, const char* what)
+{
+    printf("%s: %s\n", ok ? "PASS" : "FAIL", what);
+    return ok;
+}
+
+
+/**
+ *  \brief
+ */
+bool writeFile(const std::string& path, const char* text)
+{
+    FILE* fp = fopen(path.c_str(), "wb");
+    if (!fp)
+        return false;
+
+    fputs(text, fp);
+    fclose(fp);
+
+    return true;
+}
+
+
+/**
+ *  \brief
+ */
+bool isIndexed(const std::string& dir, const char* name)
+{
+    CPath file(dir.c_str());
+    file += _T("/");
+    file += CText(name).C_str();
+
+    return UpdateFilter::Get().IsIndexed(file);
+}
+
+
+/**
+ *  \brief  Runs the filter on a single file and tells if its update is kept
+ */
+bool isKept(const CPath& dbPath, const std::string& path, const char* text, bool commit = true)
+{
+    writeFile(path, text);
+
+    std::vector<CPath> files(1, CPath(path.c_str()));
+    UpdateFilter::Get().Filter(dbPath, files);
+
+    if (commit)
+        UpdateFilter::Get().Commit(dbPath);
+
+    return !files.empty();
+}
+
+
+/**
+ *  \brief  Re-indenting and line end changes are skipped, token and line changes are not
+ */
+bool testContentHash(const std::string& dir)
+{
+    CPath dbPath(dir.c_str());
+    dbPath += _T("/");
+
+    const std::string path = dir + "/hash.c";
+
+    bool ok = check(isKept(dbPath, path, "int  a;\tint b;\r\nint c;\n"), "new file is updated");
+
+    ok &= check(!isKept(dbPath, path, "int a; int b;\nint c;\n"),
+            "spaces, tabs and CRLF changes are skipped");
+    ok &= check(!isKept(dbPath, path, "  int\ta;    int b;   \n\tint c;\n"),
+            "indentation and trailing whitespace changes are skipped");
+    ok &= check(isKept(dbPath, path, "inta; int b;\nint c;\n"), "joining two words is updated");
+    ok &= check(isKept(dbPath, path, "inta; int b;\n\nint c;\n"), "added line is updated");
+    ok &= check(isKept(dbPath, path, "inta; int b; int c;\n"), "joined lines are updated");
+
+    // Not committed - the DB didn't get it so the same content is updated again
+    ok &= check(isKept(dbPath, path, "int a;\n", false), "changed file is updated");
+    ok &= check(isKept(dbPath, path, "int a;\n"), "failed update is retried");
+    ok &= check(!isKept(dbPath, path, "int a;\n"), "same content after success is skipped");
+
+    return ok;
+}
+
+
+/**
+ *  \brief  The language map of the current parser label with the tc= references followed
+ */
+bool testLangMap(const std::string& dir)
+{
+    bool ok = check(isIndexed(dir, "main.c") && isIndexed(dir, "App.java") && !isIndexed(dir, "tool.py"),
+            "no gtags.conf - the built-in language map is used");
+
+    const std::string binsDir = dir + "/NppGTags";
+
+    if (mkdir(binsDir.c_str(), 0777) || !writeFile(binsDir + "/gtags.conf", cGtagsConf))
+        return check(false, "gtags.conf written");
+
+    DllPath = (dir + "/NppGTags.dll").c_str();
+
+    // Parser change reloads the map
+    Config._parserIdx = CConfig::CTAGS_PARSER;
+
+    ok &= check(isIndexed(dir, "App.java") && !isIndexed(dir, "main.c"), "parser label language map");
+
+    Config._parserIdx = CConfig::DEFAULT_PARSER;
+
+    ok &= check(isIndexed(dir, "main.c") && isIndexed(dir, "main.h") && isIndexed(dir, "util.cpp"),
+            "tc= referenced label suffixes with escaped ':'");
+    ok &= check(isIndexed(dir, "MAIN.C") && isIndexed(dir, "util.hpp"), "suffixes match case-insensitively");
+    ok &= check(isIndexed(dir, "tool.py") && isIndexed(dir, "SConstruct") && isIndexed(dir, "wscript"),
+            "'|' separated label names and (name) entries after CRLF continuation");
+    ok &= check(!isIndexed(dir, "App.java") && !isIndexed(dir, "notes.txt") && !isIndexed(dir, "Makefile"),
+            "only the label map is used");
+
+    Config._parserIdx = CConfig::PYGMENTS_PARSER;
+
+    ok &= check(isIndexed(dir, "App.java") && !isIndexed(dir, "tool.py"),
+            "parser without a label - the built-in language map is used");
+
+    Config._parserIdx = CConfig::DEFAULT_PARSER;
+
+    return ok;
+}
+
+} // anonymous namespace
+
+
+int main()
+{
+    char dir[] = "/tmp/nppgtags-filter-XXXXXX";
+    if (!mkdtemp(dir))
+        return check(false, "temp DB folder created") ? 0 : 1;
+
+    bool ok = testContentHash(dir);
+    ok &= testLangMap(dir);
+
+    nftw(dir, removeEntry, 16, FTW_DEPTH | FTW_PHYS);
+
+    return ok ? 0 : 1;
+}
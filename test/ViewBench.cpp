@@ -0,0 +1,429 @@
+/**
+ *  \file
+ *  \brief  Headless results view benchmark with Scintilla message budgets
+ *
+ *  \author  Pavel Nedev <pg.nedev@gmail.com>
+ *
+ *  \section COPYRIGHT
+ *  Copyright(C) 2015 Pavel Nedev
+ *
+ *  \section LICENSE
+ *  This program is free software; you can redistribute it and/or modify it
+ *  under the terms of the GNU General Public License version 2 as published
+ *  by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful, but
+ *  WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ *  or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ *  for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <memory>
+#include "Common.h"
+#include "Cmd.h"
+#include "ResultView.h"
+#include "SciRecorder.h"
+
+
+namespace
+{
+
+using namespace GTags;
+
+
+const char cUsage[] =
+    "Usage: result_view_bench [--files <n>] [--lines <n>] [--iterations <n>] [--screen <n>]\n"
+    "\n"
+    "Loads a find reference result of <files> files with <lines> matching lines each into the results\n"
+    "view over a recording in-memory Scintilla of <screen> lines, then styles it screen by screen, opens\n"
+    "results and moves through them with the keyboard. Prints the run time and Scintilla messages of\n"
+    "each operation and fails if any operation goes over its messages budget.\n";
+
+const char  cProject[]  = "/work/project/";
+const char  cTag[]      = "target_sym";
+
+
+/**
+ *  \struct  Options
+ *  \brief
+ */
+struct Options
+{
+    Options() : _files(100), _lines(20), _iterations(5), _screen(40) {}
+
+    unsigned    _files;
+    unsigned    _lines;
+    unsigned    _iterations;
+    unsigned    _screen;
+};
+
+
+/**
+ *  \struct  Budget
+ *  \brief  The most Scintilla messages one operation may send
+ */
+struct Budget
+{
+    ResultView::SciOp_t _op;
+    const char*         _name;
+    unsigned            _maxCalls;
+};
+
+
+// Load is 8 messages on empty view, 11 when storing the previous tab position.
+// Styling is per screen so its budget is per screen of lines - mostly one match per line
+// costs 11 messages (fold level + 2 searches), file headers cost up to 2
+const Budget cBudgets[] =
+{
+    { ResultView::LOAD_TAB_OP,  "load",     11 },
+    { ResultView::STYLE_OP,     "style",    0 },
+    { ResultView::OPEN_ITEM_OP, "open",     6 },
+    { ResultView::KEY_NAV_OP,   "keys",     10 }
+};
+
+const unsigned cStyleMsgsPerLine = 12;
+
+
+/**
+ *  \struct  Timing
+ *  \brief
+ */
+struct Timing
+{
+    Timing() : _count(0), _totalNs(0), _maxNs(0) {}
+
+    void Add(std::chrono::steady_clock::time_point start)
+    {
+        unsigned long long ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now() - start).count();
+
+        ++_count;
+        _totalNs += ns;
+        if (_maxNs < ns)
+            _maxNs = ns;
+    }
+
+    unsigned            _count;
+    unsigned long long  _totalNs;
+    unsigned long long  _maxNs;
+};
+
+
+/**
+ *  \class  Random
+ *  \brief
+ */
+class Random
+{
+public:
+    Random(unsigned seed) : _state(seed) {}
+
+    unsigned Next(unsigned range)
+    {
+        _state = _state * 1103515245U + 12345U;
+        return (_state >> 8) % range;
+    }
+
+private:
+    unsigned _state;
+};
+
+
+unsigned Failures = 0;
+
+
+/**
+ *  \brief
+ */
+void check(bool cond, const char* what)
+{
+    if (!cond)
+    {
+        ++Failures;
+        fprintf(stderr, "FAILED: %s\n", what);
+    }
+}
+
+
+/**
+ *  \brief
+ */
+bool parseArgs(int argc, char* argv[], Options& opt)
+{
+    for (int i = 1; i < argc; i += 2)
+    {
+        if (i + 1 >= argc)
+            return false;
+
+        unsigned num = (unsigned)atoi(argv[i + 1]);
+        if (num == 0)
+            return false;
+
+        if (!strcmp(argv[i], "--files"))
+            opt._files = num;
+        else if (!strcmp(argv[i], "--lines"))
+            opt._lines = num;
+        else if (!strcmp(argv[i], "--iterations"))
+            opt._iterations = num;
+        else if (!strcmp(argv[i], "--screen"))
+            opt._screen = num;
+        else
+            return false;
+    }
+
+    return true;
+}
+
+
+/**
+ *  \brief  global grep format output - every 10th line has the tag twice
+ */
+std::shared_ptr<Cmd> makeCmd(const Options& opt, unsigned& matches)
+{
+    std::string out;
+    char buf[128];
+
+    matches = 0;
+
+    for (unsigned f = 0; f < opt._files; ++f)
+    {
+        for (unsigned l = 0; l < opt._lines; ++l)
+        {
+            const bool twice = (l % 10 == 9);
+
+            snprintf(buf, sizeof(buf), "src/mod%02u/file%04u.c:%u:    total += %s(a)%s;\n",
+                    f / 50, f, l * 3 + 10, cTag, twice ? " + target_sym(b)" : " + other_sym(b)");
+            out += buf;
+
+            matches += twice ? 2 : 1;
+        }
+    }
+
+    std::vector<char> result(out.begin(), out.end());
+    result.push_back(0);
+
+    CText tag;
+    tag += cTag;
+    CText dbPath;
+    dbPath += cProject;
+
+    std::shared_ptr<Cmd> cmd(new Cmd(FIND_REFERENCE, _T("Find Reference"), NULL, tag.C_str()));
+    cmd->DbPath(dbPath.C_str());
+    cmd->SetResult(result);
+    cmd->Status(OK);
+
+    return cmd;
+}
+
+
+/**
+ *  \brief  Styles the document screen by screen as Scintilla asks for it while scrolling down
+ */
+void styleAll(ResultView& view, SciRecorder& sci, unsigned screen, Timing& timing, unsigned& screens)
+{
+    const int textLen = sci.Text().size();
+
+    while (sci.EndStyled() < textLen)
+    {
+        int line = sci.Send(SCI_LINEFROMPOSITION, sci.EndStyled()) + screen;
+        int pos = (line < sci.LineCount()) ? sci.Send(SCI_POSITIONFROMLINE, line) : textLen;
+
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        view.Style(pos);
+        timing.Add(start);
+
+        ++screens;
+    }
+}
+
+
+/**
+ *  \brief
+ */
+unsigned countMatchStyles(const std::vector<char>& styles)
+{
+    const char match = static_cast<char>(SCE_GTAGS_WORD2SEARCH);
+    unsigned runs = 0;
+
+    for (unsigned i = 0; i < styles.size(); ++i)
+        if (styles[i] == match && (i == 0 || styles[i - 1] != match))
+            ++runs;
+
+    return runs;
+}
+
+
+/**
+ *  \brief  Presses the key and times it
+ */
+bool press(ResultView& view, WORD key, Timing& timing)
+{
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    bool handled = view.Navigate(key);
+    timing.Add(start);
+
+    return handled;
+}
+
+
+/**
+ *  \brief
+ */
+void runIteration(const Options& opt, Random& rnd, Timing* timings, bool report)
+{
+    SciRecorder sci(opt._screen);
+    ResultView view(sci);
+
+    unsigned matches;
+    std::shared_ptr<Cmd> cmd = makeCmd(opt, matches);
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    std::unique_ptr<ResultView::Tab> tab(new ResultView::Tab(cmd));
+    std::unique_ptr<ResultView::Tab> otherTab(new ResultView::Tab(cmd));
+    timings[ResultView::SCI_OP_END].Add(start);
+
+    check(!tab->_outdated, "result parsed");
+
+    start = std::chrono::steady_clock::now();
+    view.Load(otherTab.get());
+    timings[ResultView::LOAD_TAB_OP].Add(start);
+
+    start = std::chrono::steady_clock::now();
+    view.Load(tab.get());
+    timings[ResultView::LOAD_TAB_OP].Add(start);
+
+    check(sci.Text() == tab->_uiBuf.C_str(), "loaded text");
+
+    // Header line + file line + result lines per file
+    const int lineCount = 1 + opt._files * (1 + opt._lines);
+    check(sci.LineCount() == lineCount, "line count");
+
+    unsigned styleMsgs = view.OpStats(ResultView::STYLE_OP)._calls;
+    unsigned screens = 0;
+    styleAll(view, sci, opt._screen, timings[ResultView::STYLE_OP], screens);
+    styleMsgs = view.OpStats(ResultView::STYLE_OP)._calls - styleMsgs;
+
+    check(countMatchStyles(sci.Styles()) == matches, "all matches highlighted");
+    check(styleMsgs <= lineCount * cStyleMsgsPerLine, "styling messages per line budget");
+    check((sci.FoldLevel(1) & SC_FOLDLEVELHEADERFLAG) && !sci.FoldExpanded(1), "file line folded");
+    check(sci.FoldLevel(2) == RESULT_LVL, "result line fold level");
+
+    // Open random results
+    for (unsigned n = 0; n < 20; ++n)
+    {
+        const unsigned f = rnd.Next(opt._files);
+        const unsigned l = rnd.Next(opt._lines);
+
+        CPath file;
+        int line;
+
+        start = std::chrono::steady_clock::now();
+        bool found = view.GetItem(1 + f * (1 + opt._lines) + 1 + l, file, line);
+        timings[ResultView::OPEN_ITEM_OP].Add(start);
+
+        char expected[128];
+        snprintf(expected, sizeof(expected), "%ssrc/mod%02u/file%04u.c", cProject, f / 50, f);
+
+        check(found && CTextA(file.C_str()) == CTextA(expected) && line == (int)(l * 3 + 9), "opened result");
+    }
+
+    // All files start folded - down walks the file lines
+    sci.Send(SCI_GOTOLINE, 1);
+    for (unsigned f = 1; f < opt._files; ++f)
+        press(view, VK_DOWN, timings[ResultView::KEY_NAV_OP]);
+
+    check(sci.CurrentLine() == 1 + (int)((opt._files - 1) * (1 + opt._lines)), "down skips folded results");
+
+    // Unfold the last file and walk into its results and back
+    press(view, VK_ADD, timings[ResultView::KEY_NAV_OP]);
+    check(sci.FoldExpanded(sci.CurrentLine()), "plus unfolds");
+
+    for (unsigned l = 0; l < opt._lines; ++l)
+        press(view, VK_DOWN, timings[ResultView::KEY_NAV_OP]);
+    check(sci.CurrentLine() == lineCount - 1, "down walks unfolded results");
+
+    press(view, VK_SUBTRACT, timings[ResultView::KEY_NAV_OP]);
+    check(!sci.FoldExpanded(sci.CurrentLine()) && sci.CurrentLine() == lineCount - 1 - (int)opt._lines,
+            "minus folds the parent file");
+
+    for (unsigned n = 0; n < 5; ++n)
+        press(view, VK_PRIOR, timings[ResultView::KEY_NAV_OP]);
+    for (unsigned n = 0; n < 5; ++n)
+        press(view, VK_NEXT, timings[ResultView::KEY_NAV_OP]);
+    for (unsigned n = 0; n < 5; ++n)
+        press(view, VK_UP, timings[ResultView::KEY_NAV_OP]);
+
+    check(!view.Navigate('A'), "other keys not handled");
+
+    for (unsigned i = 0; i < _countof(cBudgets); ++i)
+    {
+        if (!cBudgets[i]._maxCalls)
+            continue;
+
+        char what[64];
+        snprintf(what, sizeof(what), "%s messages budget (%u > %u)", cBudgets[i]._name,
+                view.OpStats(cBudgets[i]._op)._maxCalls, cBudgets[i]._maxCalls);
+        check(view.OpStats(cBudgets[i]._op)._maxCalls <= cBudgets[i]._maxCalls, what);
+    }
+
+    check(sci.Unhandled() == 0, "only the mocked Scintilla messages sent");
+
+    if (!report)
+        return;
+
+    for (unsigned i = 0; i < _countof(cBudgets); ++i)
+        printf("%s%s %u msgs max", i ? ", " : "", cBudgets[i]._name, view.OpStats(cBudgets[i]._op)._maxCalls);
+    printf("\n%u styling msgs for %d lines in %u screens\n", styleMsgs, lineCount, screens);
+}
+
+} // anonymous namespace
+
+
+/**
+ *  \brief
+ */
+int main(int argc, char* argv[])
+{
+    Options opt;
+    if (!parseArgs(argc, argv, opt))
+    {
+        fputs(cUsage, stderr);
+        return 2;
+    }
+
+    Random rnd(1);
+
+    // ResultView::SciOp_t kinds + result parsing
+    Timing timings[ResultView::SCI_OP_END + 1];
+
+    for (unsigned i = 0; i < opt._iterations; ++i)
+        runIteration(opt, rnd, timings, i == 0);
+
+    static const char* const cNames[] = { "load", "style", "open", "keys", "parse" };
+
+    printf("%u files x %u lines, %u iterations\n", opt._files, opt._lines, opt._iterations);
+
+    for (unsigned i = 0; i <= ResultView::SCI_OP_END; ++i)
+    {
+        if (!timings[i]._count)
+            continue;
+
+        printf("%-6s %6u times, %9.2f us avg, %9.2f us max\n", cNames[i], timings[i]._count,
+                timings[i]._totalNs / 1000.0 / timings[i]._count, timings[i]._maxNs / 1000.0);
+    }
+
+    printf("%u failed\n", Failures);
+
+    return Failures ? 1 : 0;
+}
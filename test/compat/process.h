@@ -0,0 +1,36 @@
+/**
+ *  \file
+ *  \brief  Win32 CRT thread start for the native (non Windows) builds of the plugin core
+ *
+ *  \author  Pavel Nedev <pg.nedev@gmail.com>
+ *
+ *  \section COPYRIGHT
+ *  Copyright(C) 2015 Pavel Nedev
+ *
+ *  \section LICENSE
+ *  This program is free software; you can redistribute it and/or modify it
+ *  under the terms of the GNU General Public License version 2 as published
+ *  by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful, but
+ *  WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ *  or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ *  for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+#pragma once
+
+
+#include <stdint.h>
+#include "windows.h"
+
+
+inline uintptr_t _beginthreadex(void*, unsigned, unsigned (__stdcall *func)(void*), void* arg, unsigned, unsigned*)
+{
+    return (uintptr_t)Win32Compat::beginThread(func, arg);
+}
@@ -0,0 +1,65 @@
+/**
+ *  \file
+ *  \brief  Generic-text mappings for the native (non Windows) builds of the plugin core - UNICODE only
+ *
+ *  \author  Pavel Nedev <pg.nedev@gmail.com>
+ *
+ *  \section COPYRIGHT
+ *  Copyright(C) 2015 Pavel Nedev
+ *
+ *  \section LICENSE
+ *  This program is free software; you can redistribute it and/or modify it
+ *  under the terms of the GNU General Public License version 2 as published
+ *  by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful, but
+ *  WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ *  or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ *  for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+#pragma once
+
+
+#include <wchar.h>
+#include <wctype.h>
+#include "windows.h"
+
+
+typedef wchar_t TCHAR;
+
+#define __T(x)  L ## x
+#define _T(x)   __T(x)
+
+#define _tcslen         wcslen
+#define _tcscmp         wcscmp
+#define _tcsncmp        wcsncmp
+#define _tcsspn         wcsspn
+#define _tcsicmp        wcscasecmp
+#define _tcsnicmp       wcsncasecmp
+#define _tcschr         wcschr
+#define _tcsrchr        wcsrchr
+#define _tcsstr         wcsstr
+#define _totlower(c)    ((wchar_t)towlower(c))
+#define _totupper(c)    ((wchar_t)towupper(c))
+#define _istspace       iswspace
+#define _istalnum       iswalnum
+#define _tstoi(s)       ((int)wcstol((s), NULL, 10))
+#define _sntprintf_s    _snwprintf_s
+
+
+inline int _tfopen_s(FILE** fp, const wchar_t* file, const wchar_t* mode)
+{
+    std::string nativeMode;
+    for (; *mode; ++mode)
+        nativeMode += (char)*mode;
+
+    *fp = fopen(Win32Compat::nativePath(file).c_str(), nativeMode.c_str());
+
+    return *fp ? 0 : errno;
+}
@@ -0,0 +1,1012 @@
+/**
+ *  \file
+ *  \brief  Minimal Win32 API subset for the native (non Windows) builds of the plugin core
+ *
+ *  \author  Pavel Nedev <pg.nedev@gmail.com>
+ *
+ *  \section COPYRIGHT
+ *  Copyright(C) 2015 Pavel Nedev
+ *
+ *  \section LICENSE
+ *  This program is free software; you can redistribute it and/or modify it
+ *  under the terms of the GNU General Public License version 2 as published
+ *  by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful, but
+ *  WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ *  or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ *  for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+#pragma once
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <wchar.h>
+#include <time.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <dirent.h>
+#include <fnmatch.h>
+#include <pthread.h>
+#include <string>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+
+
+typedef int                 BOOL;
+typedef unsigned char       BYTE;
+typedef unsigned short      WORD;
+typedef unsigned int        DWORD;
+typedef int                 LONG;
+typedef long long           LONGLONG;
+typedef unsigned int        UINT;
+typedef char                CHAR;
+typedef wchar_t             WCHAR;
+typedef void*               HANDLE;
+typedef void*               HWND;
+typedef void*               HINSTANCE;
+typedef unsigned long       ULONG_PTR;
+typedef unsigned long       WPARAM;
+typedef long                LPARAM;
+typedef long                LRESULT;
+
+#define TRUE    1
+#define FALSE   0
+
+#define __stdcall
+
+#define MAX_PATH    260
+
+#define CP_ACP                  0
+#define CP_UTF8                 65001
+#define MB_ERR_INVALID_CHARS    8
+
+#define MB_OK               0
+#define MB_ICONERROR        0x10
+#define MB_ICONEXCLAMATION  0x30
+#define MB_ICONINFORMATION  0x40
+#define IDOK                1
+
+#define INVALID_FILE_ATTRIBUTES     ((DWORD)-1)
+#define FILE_ATTRIBUTE_HIDDEN       0x02
+#define FILE_ATTRIBUTE_DIRECTORY    0x10
+#define FILE_ATTRIBUTE_NORMAL       0x80
+#define FILE_ATTRIBUTE_REPARSE_POINT 0x400
+
+#define MOVEFILE_REPLACE_EXISTING   1
+
+#define INVALID_HANDLE_VALUE    ((HANDLE)-1)
+#define ERROR_FILE_NOT_FOUND    2
+#define ERROR_INVALID_PARAMETER 87
+
+#define INFINITE        0xFFFFFFFF
+#define WAIT_OBJECT_0   0
+#define WAIT_TIMEOUT    258
+
+#define VK_PRIOR        0x21
+#define VK_NEXT         0x22
+#define VK_UP           0x26
+#define VK_DOWN         0x28
+#define VK_ADD          0x6B
+#define VK_SUBTRACT     0x6D
+
+#define INPUT_KEYBOARD  1
+#define KEYEVENTF_KEYUP 2
+
+#define _TRUNCATE   ((size_t)-1)
+
+#define _countof(a) (sizeof(a) / sizeof((a)[0]))
+
+#define ZeroMemory(p, n)    memset((p), 0, (n))
+
+
+/**
+ *  \struct  KEYBDINPUT
+ *  \brief
+ */
+struct KEYBDINPUT
+{
+    WORD        wVk;
+    WORD        wScan;
+    DWORD       dwFlags;
+    DWORD       time;
+    ULONG_PTR   dwExtraInfo;
+};
+
+
+/**
+ *  \struct  INPUT
+ *  \brief
+ */
+struct INPUT
+{
+    DWORD       type;
+    KEYBDINPUT  ki;
+};
+
+
+/**
+ *  \struct  FILETIME
+ *  \brief  100 ns units
+ */
+struct FILETIME
+{
+    DWORD       dwLowDateTime;
+    DWORD       dwHighDateTime;
+};
+
+
+/**
+ *  \struct  WIN32_FIND_DATA
+ *  \brief
+ */
+struct WIN32_FIND_DATA
+{
+    DWORD       dwFileAttributes;
+    FILETIME    ftLastWriteTime;
+    wchar_t     cFileName[MAX_PATH];
+};
+
+
+/**
+ *  \struct  WIN32_FILE_ATTRIBUTE_DATA
+ *  \brief
+ */
+struct WIN32_FILE_ATTRIBUTE_DATA
+{
+    DWORD       dwFileAttributes;
+    FILETIME    ftLastWriteTime;
+    DWORD       nFileSizeHigh;
+    DWORD       nFileSizeLow;
+};
+
+
+/**
+ *  \struct  SYSTEM_INFO
+ *  \brief
+ */
+struct SYSTEM_INFO
+{
+    DWORD       dwNumberOfProcessors;
+};
+
+
+enum GET_FILEEX_INFO_LEVELS
+{
+    GetFileExInfoStandard
+};
+
+
+enum FINDEX_INFO_LEVELS
+{
+    FindExInfoStandard,
+    FindExInfoBasic
+};
+
+
+enum FINDEX_SEARCH_OPS
+{
+    FindExSearchNameMatch
+};
+
+
+/**
+ *  \struct  PROCESS_INFORMATION
+ *  \brief
+ */
+struct PROCESS_INFORMATION
+{
+    HANDLE      hProcess;
+    HANDLE      hThread;
+    DWORD       dwProcessId;
+    DWORD       dwThreadId;
+};
+
+
+namespace Win32Compat
+{
+
+/**
+ *  \brief
+ */
+inline void appendUtf8(std::string& dst, unsigned c)
+{
+    if (c < 0x80)
+    {
+        dst += (char)c;
+    }
+    else if (c < 0x800)
+    {
+        dst += (char)(0xC0 | (c >> 6));
+        dst += (char)(0x80 | (c & 0x3F));
+    }
+    else if (c < 0x10000)
+    {
+        dst += (char)(0xE0 | (c >> 12));
+        dst += (char)(0x80 | ((c >> 6) & 0x3F));
+        dst += (char)(0x80 | (c & 0x3F));
+    }
+    else
+    {
+        dst += (char)(0xF0 | (c >> 18));
+        dst += (char)(0x80 | ((c >> 12) & 0x3F));
+        dst += (char)(0x80 | ((c >> 6) & 0x3F));
+        dst += (char)(0x80 | (c & 0x3F));
+    }
+}
+
+
+/**
+ *  \brief  Windows path to the native one - backslash separators become '/'
+ */
+inline std::string nativePath(const wchar_t* path)
+{
+    std::string native;
+
+    for (; *path; ++path)
+        appendUtf8(native, (*path == L'\\') ? L'/' : (unsigned)*path);
+
+    return native;
+}
+
+
+/**
+ *  \brief  Decodes single UTF-8 sequence, returns its length or 0 if invalid
+ */
+inline int decodeUtf8(const unsigned char* s, int len, unsigned& c)
+{
+    int n;
+
+    if (s[0] < 0x80)
+    {
+        c = s[0];
+        return 1;
+    }
+    else if ((s[0] & 0xE0) == 0xC0)
+    {
+        c = s[0] & 0x1F;
+        n = 2;
+    }
+    else if ((s[0] & 0xF0) == 0xE0)
+    {
+        c = s[0] & 0x0F;
+        n = 3;
+    }
+    else if ((s[0] & 0xF8) == 0xF0)
+    {
+        c = s[0] & 0x07;
+        n = 4;
+    }
+    else
+    {
+        return 0;
+    }
+
+    if (n > len)
+        return 0;
+
+    for (int i = 1; i < n; ++i)
+    {
+        if ((s[i] & 0xC0) != 0x80)
+            return 0;
+        c = (c << 6) | (s[i] & 0x3F);
+    }
+
+    return n;
+}
+
+
+/**
+ *  \brief  MSVC printf treats %s / %c of the wide functions as wide - glibc wants %ls / %lc
+ */
+inline std::wstring wideFormat(const wchar_t* format)
+{
+    std::wstring fmt;
+
+    for (; *format; ++format)
+    {
+        fmt += *format;
+        if (*format != L'%')
+            continue;
+
+        bool sized = false;
+        for (++format; *format && wcschr(L"-+ #0123456789.*lhzjt", *format); ++format)
+        {
+            if (*format == L'l' || *format == L'h')
+                sized = true;
+            fmt += *format;
+        }
+
+        if (!*format)
+            break;
+
+        if (!sized && (*format == L's' || *format == L'c'))
+            fmt += L'l';
+        fmt += *format;
+    }
+
+    return fmt;
+}
+
+} // namespace Win32Compat
+
+
+inline int MultiByteToWideChar(UINT codePage, DWORD flags, const char* src, int srcLen, wchar_t* dst, int dstLen)
+{
+    if (srcLen < 0)
+        srcLen = strlen(src) + 1;
+
+    const unsigned char* s = (const unsigned char*)src;
+    int count = 0;
+
+    for (int i = 0; i < srcLen;)
+    {
+        unsigned c = s[i];
+        int n = 1;
+
+        // The ANSI code page is taken as Latin-1
+        if (codePage == CP_UTF8)
+        {
+            n = Win32Compat::decodeUtf8(s + i, srcLen - i, c);
+            if (n == 0)
+            {
+                if (flags & MB_ERR_INVALID_CHARS)
+                    return 0;
+                c = 0xFFFD;
+                n = 1;
+            }
+        }
+
+        if (dstLen)
+        {
+            if (count >= dstLen)
+                return 0;
+            dst[count] = (wchar_t)c;
+        }
+
+        ++count;
+        i += n;
+    }
+
+    return count;
+}
+
+
+inline int WideCharToMultiByte(UINT, DWORD, const wchar_t* src, int srcLen, char* dst, int dstLen,
+        const char*, BOOL*)
+{
+    std::wstring str = (srcLen < 0) ? std::wstring(src, wcslen(src) + 1) : std::wstring(src, srcLen);
+
+    // The native ANSI code page is UTF-8
+    std::string native;
+    for (size_t i = 0; i < str.size(); ++i)
+        Win32Compat::appendUtf8(native, (unsigned)str[i]);
+
+    if (dstLen)
+    {
+        if ((int)native.size() > dstLen)
+            return 0;
+        memcpy(dst, native.data(), native.size());
+    }
+
+    return native.size();
+}
+
+
+inline LONG InterlockedIncrement(volatile LONG* val)
+{
+    return __atomic_add_fetch(val, 1, __ATOMIC_SEQ_CST);
+}
+
+
+inline LONG InterlockedDecrement(volatile LONG* val)
+{
+    return __atomic_sub_fetch(val, 1, __ATOMIC_SEQ_CST);
+}
+
+
+inline LONG InterlockedExchangeAdd(volatile LONG* val, LONG add)
+{
+    return __atomic_fetch_add(val, add, __ATOMIC_SEQ_CST);
+}
+
+
+inline LONG InterlockedExchange(volatile LONG* val, LONG newVal)
+{
+    return __atomic_exchange_n(val, newVal, __ATOMIC_SEQ_CST);
+}
+
+
+inline LONG InterlockedCompareExchange(volatile LONG* val, LONG newVal, LONG cmp)
+{
+    __atomic_compare_exchange_n(val, &cmp, newVal, false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+    return cmp;
+}
+
+
+inline DWORD GetTickCount()
+{
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (DWORD)(ts.tv_sec * 1000 + ts.tv_nsec / 1000000);
+}
+
+
+inline void Sleep(DWORD ms)
+{
+    usleep(ms * 1000);
+}
+
+
+inline DWORD GetFileAttributes(const wchar_t* path)
+{
+    struct stat st;
+    if (stat(Win32Compat::nativePath(path).c_str(), &st))
+        return INVALID_FILE_ATTRIBUTES;
+
+    return S_ISDIR(st.st_mode) ? FILE_ATTRIBUTE_DIRECTORY : FILE_ATTRIBUTE_NORMAL;
+}
+
+
+inline BOOL GetFileAttributesEx(const wchar_t* path, GET_FILEEX_INFO_LEVELS, WIN32_FILE_ATTRIBUTE_DATA* data)
+{
+    struct stat st;
+    if (stat(Win32Compat::nativePath(path).c_str(), &st))
+        return FALSE;
+
+    unsigned long long time = st.st_mtim.tv_sec * 10000000ULL + st.st_mtim.tv_nsec / 100;
+
+    data->dwFileAttributes = S_ISDIR(st.st_mode) ? FILE_ATTRIBUTE_DIRECTORY : FILE_ATTRIBUTE_NORMAL;
+    data->ftLastWriteTime.dwLowDateTime = (DWORD)time;
+    data->ftLastWriteTime.dwHighDateTime = (DWORD)(time >> 32);
+    data->nFileSizeHigh = (DWORD)((unsigned long long)st.st_size >> 32);
+    data->nFileSizeLow = (DWORD)st.st_size;
+
+    return TRUE;
+}
+
+
+inline LONG CompareFileTime(const FILETIME* t1, const FILETIME* t2)
+{
+    unsigned long long time1 = ((unsigned long long)t1->dwHighDateTime << 32) | t1->dwLowDateTime;
+    unsigned long long time2 = ((unsigned long long)t2->dwHighDateTime << 32) | t2->dwLowDateTime;
+
+    return (time1 < time2) ? -1 : (time1 > time2) ? 1 : 0;
+}
+
+
+inline BOOL SetFileAttributes(const wchar_t*, DWORD)
+{
+    return TRUE;
+}
+
+
+inline BOOL CreateDirectory(const wchar_t* path, void*)
+{
+    return !mkdir(Win32Compat::nativePath(path).c_str(), 0777);
+}
+
+
+inline BOOL RemoveDirectory(const wchar_t* path)
+{
+    return !rmdir(Win32Compat::nativePath(path).c_str());
+}
+
+
+inline BOOL DeleteFile(const wchar_t* path)
+{
+    return !unlink(Win32Compat::nativePath(path).c_str());
+}
+
+
+inline DWORD GetLastError()
+{
+    return (errno == ENOENT) ? ERROR_FILE_NOT_FOUND : (DWORD)errno;
+}
+
+
+namespace Win32Compat
+{
+
+/**
+ *  \struct  FindHandle
+ *  \brief  Directory listing filtered by the pattern last path component
+ */
+struct FindHandle
+{
+    DIR*            dir;
+    std::string     dirPath;
+    std::string     pattern;
+};
+
+
+/**
+ *  \brief
+ */
+inline BOOL findNext(FindHandle* find, WIN32_FIND_DATA* fd)
+{
+    for (dirent* entry = readdir(find->dir); entry; entry = readdir(find->dir))
+    {
+        if (fnmatch(find->pattern.c_str(), entry->d_name, 0))
+            continue;
+
+        std::string path = find->dirPath + entry->d_name;
+
+        struct stat st;
+        if (stat(path.c_str(), &st))
+            continue;
+
+        struct stat lst;
+        bool link = (!lstat(path.c_str(), &lst) && S_ISLNK(lst.st_mode));
+
+        unsigned long long time = st.st_mtim.tv_sec * 10000000ULL + st.st_mtim.tv_nsec / 100;
+
+        fd->dwFileAttributes = S_ISDIR(st.st_mode) ? FILE_ATTRIBUTE_DIRECTORY : FILE_ATTRIBUTE_NORMAL;
+        if (link)
+            fd->dwFileAttributes |= FILE_ATTRIBUTE_REPARSE_POINT;
+        fd->ftLastWriteTime.dwLowDateTime = (DWORD)time;
+        fd->ftLastWriteTime.dwHighDateTime = (DWORD)(time >> 32);
+        MultiByteToWideChar(CP_UTF8, 0, entry->d_name, -1, fd->cFileName, MAX_PATH);
+
+        return TRUE;
+    }
+
+    errno = ENOENT;
+    return FALSE;
+}
+
+} // namespace Win32Compat
+
+
+inline BOOL FindNextFile(HANDLE hFind, WIN32_FIND_DATA* fd)
+{
+    return Win32Compat::findNext((Win32Compat::FindHandle*)hFind, fd);
+}
+
+
+inline BOOL FindClose(HANDLE hFind)
+{
+    Win32Compat::FindHandle* find = (Win32Compat::FindHandle*)hFind;
+
+    closedir(find->dir);
+    delete find;
+
+    return TRUE;
+}
+
+
+inline HANDLE FindFirstFile(const wchar_t* pattern, WIN32_FIND_DATA* fd)
+{
+    std::string path = Win32Compat::nativePath(pattern);
+    size_t nameStart = path.rfind('/') + 1;
+
+    Win32Compat::FindHandle* find = new Win32Compat::FindHandle;
+    find->dirPath   = path.substr(0, nameStart);
+    find->pattern   = path.substr(nameStart);
+    find->dir       = opendir(find->dirPath.empty() ? "." : find->dirPath.c_str());
+
+    if (!find->dir)
+    {
+        delete find;
+        return INVALID_HANDLE_VALUE;
+    }
+
+    if (!Win32Compat::findNext(find, fd))
+    {
+        FindClose(find);
+        errno = ENOENT;
+        return INVALID_HANDLE_VALUE;
+    }
+
+    return find;
+}
+
+
+inline HANDLE FindFirstFileEx(const wchar_t* pattern, FINDEX_INFO_LEVELS, WIN32_FIND_DATA* fd, FINDEX_SEARCH_OPS,
+        void*, DWORD)
+{
+    return FindFirstFile(pattern, fd);
+}
+
+
+inline DWORD GetTempPath(DWORD len, wchar_t* buf)
+{
+    const char* dir = getenv("TMPDIR");
+    std::string tmp(dir && *dir ? dir : "/tmp");
+    if (tmp[tmp.size() - 1] != '/')
+        tmp += '/';
+
+    int count = MultiByteToWideChar(CP_UTF8, 0, tmp.c_str(), -1, buf, len);
+
+    return count ? count - 1 : 0;
+}
+
+
+inline UINT GetTempFileName(const wchar_t* dir, const wchar_t* prefix, UINT, wchar_t* tmpFile)
+{
+    std::string path = Win32Compat::nativePath(dir);
+    if (!path.empty() && path[path.size() - 1] != '/')
+        path += '/';
+    path += Win32Compat::nativePath(prefix);
+    path += "XXXXXX";
+
+    int fd = mkstemp(&path[0]);
+    if (fd < 0)
+        return 0;
+    close(fd);
+
+    return MultiByteToWideChar(CP_UTF8, 0, path.c_str(), -1, tmpFile, MAX_PATH) ? 1 : 0;
+}
+
+
+inline void GetSystemInfo(SYSTEM_INFO* si)
+{
+    long count = sysconf(_SC_NPROCESSORS_ONLN);
+    si->dwNumberOfProcessors = (count > 0) ? (DWORD)count : 1;
+}
+
+
+namespace Win32Compat
+{
+
+/**
+ *  \struct  Waitable
+ *  \brief  Event, semaphore or thread handle. The signaled states change under one lock and wake all
+ *          waiters - simple rather than fast
+ */
+struct Waitable
+{
+    enum Kind_t
+    {
+        EVENT,
+        SEMAPHORE,
+        THREAD
+    };
+
+    Waitable(Kind_t kind, LONG count, bool manualReset) :
+        _kind(kind), _count(count), _manualReset(manualReset), _refs(1) {}
+
+    Kind_t  _kind;
+    // Event and thread - 1 when signaled, semaphore - its count
+    LONG    _count;
+    bool    _manualReset;
+    // Thread handles are released by both CloseHandle and the thread exit
+    int     _refs;
+};
+
+
+/**
+ *  \struct  ThreadStart
+ *  \brief
+ */
+struct ThreadStart
+{
+    unsigned (__stdcall *_func)(void*);
+    void*       _arg;
+    Waitable*   _thread;
+};
+
+
+inline std::mutex& waitLock()
+{
+    static std::mutex lock;
+    return lock;
+}
+
+
+inline std::condition_variable& waitCond()
+{
+    static std::condition_variable cond;
+    return cond;
+}
+
+
+/**
+ *  \brief  Must be called under waitLock
+ */
+inline bool takeSignaled(Waitable* obj, bool take)
+{
+    if (obj->_count <= 0)
+        return false;
+
+    if (take && (obj->_kind == Waitable::SEMAPHORE || (obj->_kind == Waitable::EVENT && !obj->_manualReset)))
+        --obj->_count;
+
+    return true;
+}
+
+
+/**
+ *  \brief  Must be called under waitLock
+ */
+inline void release(Waitable* obj)
+{
+    if (--obj->_refs == 0)
+        delete obj;
+}
+
+
+inline void* threadMain(void* data)
+{
+    ThreadStart* start = static_cast<ThreadStart*>(data);
+
+    start->_func(start->_arg);
+
+    Waitable* thread = start->_thread;
+    delete start;
+
+    std::lock_guard<std::mutex> lock(waitLock());
+
+    thread->_count = 1;
+    release(thread);
+    waitCond().notify_all();
+
+    return NULL;
+}
+
+
+inline HANDLE beginThread(unsigned (__stdcall *func)(void*), void* arg)
+{
+    ThreadStart* start = new ThreadStart;
+    start->_func    = func;
+    start->_arg     = arg;
+    start->_thread  = new Waitable(Waitable::THREAD, 0, true);
+    start->_thread->_refs = 2;
+
+    Waitable* thread = start->_thread;
+
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+
+    pthread_t id;
+    int err = pthread_create(&id, &attr, threadMain, start);
+
+    pthread_attr_destroy(&attr);
+
+    if (err)
+    {
+        delete thread;
+        delete start;
+        return NULL;
+    }
+
+    return thread;
+}
+
+} // namespace Win32Compat
+
+
+inline HANDLE CreateEvent(void*, BOOL manualReset, BOOL initialState, const wchar_t*)
+{
+    return new Win32Compat::Waitable(Win32Compat::Waitable::EVENT, initialState ? 1 : 0, manualReset != FALSE);
+}
+
+
+inline HANDLE CreateSemaphore(void*, LONG initialCount, LONG, const wchar_t*)
+{
+    return new Win32Compat::Waitable(Win32Compat::Waitable::SEMAPHORE, initialCount, false);
+}
+
+
+inline BOOL SetEvent(HANDLE hEvent)
+{
+    std::lock_guard<std::mutex> lock(Win32Compat::waitLock());
+
+    static_cast<Win32Compat::Waitable*>(hEvent)->_count = 1;
+    Win32Compat::waitCond().notify_all();
+
+    return TRUE;
+}
+
+
+inline BOOL ResetEvent(HANDLE hEvent)
+{
+    std::lock_guard<std::mutex> lock(Win32Compat::waitLock());
+
+    static_cast<Win32Compat::Waitable*>(hEvent)->_count = 0;
+
+    return TRUE;
+}
+
+
+inline BOOL ReleaseSemaphore(HANDLE hSemaphore, LONG count, LONG* prevCount)
+{
+    std::lock_guard<std::mutex> lock(Win32Compat::waitLock());
+
+    Win32Compat::Waitable* obj = static_cast<Win32Compat::Waitable*>(hSemaphore);
+    if (prevCount)
+        *prevCount = obj->_count;
+    obj->_count += count;
+    Win32Compat::waitCond().notify_all();
+
+    return TRUE;
+}
+
+
+inline BOOL CloseHandle(HANDLE handle)
+{
+    std::lock_guard<std::mutex> lock(Win32Compat::waitLock());
+
+    Win32Compat::release(static_cast<Win32Compat::Waitable*>(handle));
+
+    return TRUE;
+}
+
+
+inline DWORD WaitForMultipleObjects(DWORD count, const HANDLE* handles, BOOL waitAll, DWORD ms)
+{
+    using namespace Win32Compat;
+
+    std::chrono::steady_clock::time_point end =
+            std::chrono::steady_clock::now() + std::chrono::milliseconds(ms == INFINITE ? 0 : ms);
+
+    std::unique_lock<std::mutex> lock(waitLock());
+
+    for (;;)
+    {
+        if (waitAll)
+        {
+            DWORD signaled = 0;
+            while (signaled < count && takeSignaled(static_cast<Waitable*>(handles[signaled]), false))
+                ++signaled;
+
+            if (signaled == count)
+            {
+                for (DWORD i = 0; i < count; ++i)
+                    takeSignaled(static_cast<Waitable*>(handles[i]), true);
+                return WAIT_OBJECT_0;
+            }
+        }
+        else
+        {
+            for (DWORD i = 0; i < count; ++i)
+                if (takeSignaled(static_cast<Waitable*>(handles[i]), true))
+                    return WAIT_OBJECT_0 + i;
+        }
+
+        if (ms == INFINITE)
+            waitCond().wait(lock);
+        else if (std::chrono::steady_clock::now() >= end)
+            return WAIT_TIMEOUT;
+        else
+            waitCond().wait_until(lock, end);
+    }
+}
+
+
+inline DWORD WaitForSingleObject(HANDLE handle, DWORD ms)
+{
+    return WaitForMultipleObjects(1, &handle, FALSE, ms);
+}
+
+
+inline BOOL MoveFileEx(const wchar_t* src, const wchar_t* dst, DWORD flags)
+{
+    std::string nativeDst = Win32Compat::nativePath(dst);
+
+    struct stat st;
+    if (!(flags & MOVEFILE_REPLACE_EXISTING) && !stat(nativeDst.c_str(), &st))
+        return FALSE;
+
+    return !rename(Win32Compat::nativePath(src).c_str(), nativeDst.c_str());
+}
+
+
+inline BOOL CopyFile(const wchar_t* src, const wchar_t* dst, BOOL failIfExists)
+{
+    std::string nativeDst = Win32Compat::nativePath(dst);
+
+    struct stat st;
+    if (failIfExists && !stat(nativeDst.c_str(), &st))
+        return FALSE;
+
+    FILE* in = fopen(Win32Compat::nativePath(src).c_str(), "rb");
+    if (!in)
+        return FALSE;
+
+    FILE* out = fopen(nativeDst.c_str(), "wb");
+    if (!out)
+    {
+        fclose(in);
+        return FALSE;
+    }
+
+    char buf[64 * 1024];
+    size_t n;
+    bool success = true;
+
+    while (success && (n = fread(buf, 1, sizeof(buf), in)) > 0)
+        success = (fwrite(buf, 1, n, out) == n);
+
+    fclose(in);
+    success = (fclose(out) == 0) && success;
+
+    return success;
+}
+
+
+inline int MessageBoxA(HWND, const char* text, const char* caption, UINT)
+{
+    fprintf(stderr, "%s: %s\n", caption ? caption : "", text ? text : "");
+    return IDOK;
+}
+
+
+inline int MessageBoxW(HWND, const wchar_t* text, const wchar_t* caption, UINT)
+{
+    fprintf(stderr, "%ls: %ls\n", caption ? caption : L"", text ? text : L"");
+    return IDOK;
+}
+
+
+inline short GetKeyState(int)
+{
+    return 0;
+}
+
+
+inline LPARAM GetMessageExtraInfo()
+{
+    return 0;
+}
+
+
+inline UINT SendInput(UINT, INPUT*, int)
+{
+    return 0;
+}
+
+
+inline int _itoa_s(int value, char* buf, size_t size, int radix)
+{
+    if (radix == 16)
+        snprintf(buf, size, "%x", value);
+    else
+        snprintf(buf, size, "%d", value);
+
+    return 0;
+}
+
+
+inline int _snwprintf_s(wchar_t* buf, size_t size, size_t, const wchar_t* format, ...)
+{
+    std::wstring fmt = Win32Compat::wideFormat(format);
+
+    va_list args;
+    va_start(args, format);
+    int len = vswprintf(buf, size, fmt.c_str(), args);
+    va_end(args);
+
+    // Truncated - the MSVC functions keep what fits
+    if (len < 0)
+    {
+        buf[size - 1] = 0;
+        len = -1;
+    }
+
+    return len;
+}
+
+
+inline int _snprintf_s(char* buf, size_t size, size_t, const char* format, ...)
+{
+    va_list args;
+    va_start(args, format);
+    int len = vsnprintf(buf, size, format, args);
+    va_end(args);
+
+    return (len < 0 || (size_t)len >= size) ? -1 : len;
+}